@@ -0,0 +1,62 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+// Heap allocation accounting for tests and benchmarks.  When civimba is built with CIVIMBA_COUNT_ALLOCATIONS the
+// global operator new / delete are replaced by counting versions, otherwise every count stays at zero.  Only one
+// translation unit may replace the global operators, so applications with their own allocator should not define it.
+
+namespace civimba {
+namespace allocation {
+
+struct Counts {
+	Counts()
+		: allocations( 0 ), bytes( 0 )
+	{ }
+
+	Counts operator-( const Counts &rhs ) const
+	{
+		Counts ret;
+		ret.allocations = allocations - rhs.allocations;
+		ret.bytes = bytes - rhs.bytes;
+		return ret;
+	}
+
+	uint64_t allocations;
+	uint64_t bytes;
+};
+
+// true when the counting allocator is compiled in
+bool isEnabled();
+
+// allocations made by the calling thread since it started
+Counts getThreadCounts();
+
+// allocations made by all threads since the process started
+Counts getTotalCounts();
+
+} // namespace allocation
+} // namespace civimba
@@ -23,15 +23,32 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "VimbaCPP/Include/VimbaCPP.h"
 
+#include "civimba/BandwidthPlanner.h"
 #include "civimba/CameraController.h"
+#include "civimba/CameraRegistry.h"
+#include "civimba/ReplayCamera.h"
+#include "civimba/SimulatedCamera.h"
 #include "civimba/BaseException.h"
 
 namespace civimba {
 
+// outcome of opening one camera with ApiController::getCameras()
+struct CameraOpenResult {
+    std::string         cameraID;
+    CameraControllerRef camera;         // null if the camera could not be opened or prepared
+    VmbErrorType        error;          // VmbErrorSuccess or the reason it failed
+    std::string         message;        // empty on success
+    double              openTime;       // seconds spent opening the camera
+    double              prepareTime;    // seconds spent adjusting the packet size and preparing the camera
+    double              adjustPacketSizeTime;   // seconds GVSPAdjustPacketSize took, 0 if the camera has none
+};
+
 class ApiController
 { 
   public:
@@ -55,21 +72,78 @@ class ApiController
     void startup();
     void shutdown();
 
+    // cached by the camera registry once getCameraRegistry() has been called
     std::vector<AVT::VmbAPI::CameraPtr> getCameraList() const;
+
+    // created on first use, startup() has to be called before
+    CameraRegistry& getCameraRegistry();
     CameraControllerRef getCamera( const std::string &cameraID );
 
+    // Opens and prepares cameraIDs like getCamera(), with up to maxConcurrent cameras in progress at once so that
+    // the packet size negotiation of many GigE cameras does not flood the network.  Does not throw for single
+    // cameras, the results are in the order of cameraIDs and hold the camera or the error.
+    std::vector<CameraOpenResult> getCameras( const std::vector<std::string> &cameraIDs, uint32_t maxConcurrent = 4 );
+
+    // camera driven by a SimulatedCamera instead of hardware, does not need startup()
+    CameraControllerRef getSimulatedCamera( const SimulatedCamera::Options &options = SimulatedCamera::Options(),
+                                            uint32_t numberFrames = 5 );
+
+    // camera that plays back a capture file written by CaptureWriter, does not need startup()
+    CameraControllerRef getReplayCamera( const ReplayCamera::Options &options, uint32_t numberFrames = 5 );
+
+    // Reopens the Vimba camera of camera, e.g. after it was unplugged, and prepares it like getCamera().  The
+    // controller stays the same object, acquisition is stopped and not restarted.  The known feature state and
+    // the user set bindings of the controller are dropped.  Throws if the camera can't be opened, the controller is
+    // then left closed and reopenCamera() can be called again.
+    void reopenCamera( const CameraControllerRef &camera );
+
+    // Applies profile to cameras, with up to maxConcurrent cameras in progress at once.  Does not throw for single
+    // cameras or features, the report holds what was written and skipped per camera and the total time.
+    CameraProfileReport applyProfile( const std::vector<CameraControllerRef> &cameras, const CameraProfile &profile,
+                                      uint32_t maxConcurrent = 8 );
+
+    // payload size, frame rate and packet size of a GigE camera and the interface it is on.  Adjust the frame rate
+    // of externally triggered cameras before planning with BandwidthPlanner::plan().  Throws for other cameras.
+    BandwidthDemand getBandwidthDemand( const CameraControllerRef &camera );
+
+    // Splits the links shared by GigE cameras between them, see BandwidthPlanner.  Throws.
+    BandwidthPlan planBandwidth( const std::vector<CameraControllerRef> &cameras,
+                                 const BandwidthPlanner::Options &options = BandwidthPlanner::Options() );
+
+    // Limits every camera of plan to its allocation through StreamBytesPerSecond, or GevSCPD for cameras without
+    // it, and takes the frame statistics verifyBandwidthPlan() compares against.  Throws.
+    void applyBandwidthPlan( BandwidthPlan &plan );
+
+    // Fills the frames observed since applyBandwidthPlan() and returns false if more than maxIncompleteRate of the
+    // frames of a camera arrived incomplete.
+    bool verifyBandwidthPlan( BandwidthPlan &plan, double maxIncompleteRate = 0.001 );
+
     std::string  getVersion() const;
 
+    // seconds getCamera() and getCameras() wait for camera commands such as GVSPAdjustPacketSize, default 5
+    void setCommandTimeout( double seconds ) { mCommandTimeout = seconds; }
+    double getCommandTimeout() const { return mCommandTimeout; }
+
   private:
+    // opens and prepares one camera into result, throws
+    void openCamera( CameraOpenResult &result );
+
+    // opens result.cameraID into camera, adjusts the packet size and prepares it.  Throws with camera closed.
+    void openVimbaCamera( CameraOpenResult &result, AVT::VmbAPI::CameraPtr &camera );
+
     // configure camera settings to ensure compatability with TransformImage
     // throws
-    void prepareCamera( CameraControllerRef& cam );
+    void prepareCamera( const AVT::VmbAPI::CameraPtr &camera );
 
     // does not throw
-    VmbErrorType setIntFeatureValueModulo2( CameraControllerRef& cam, const char* const& Name );
+    VmbErrorType setIntFeatureValueModulo2( const AVT::VmbAPI::CameraPtr &camera, const char* const& Name );
 
     // A reference to our Vimba singleton
     AVT::VmbAPI::VimbaSystem   & mSystem;
+
+    double mCommandTimeout;
+
+    std::unique_ptr<CameraRegistry> mRegistry;
 };
 
 } // namespace civimba
\ No newline at end of file
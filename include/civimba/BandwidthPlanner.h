@@ -0,0 +1,120 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "civimba/CameraController.h"
+#include "civimba/Types.h"
+
+namespace civimba {
+
+// what one GigE camera needs from its link, see ApiController::planBandwidth()
+struct BandwidthDemand {
+	BandwidthDemand() : payloadSize( 0 ), frameRate( 0.0 ), packetSize( 1500 ), timestampFrequency( 0 ) { }
+
+	std::string         cameraID;
+	std::string         interfaceID;        // cameras on the same interface share a link
+	uint64_t            payloadSize;        // bytes per frame, PayloadSize
+	double              frameRate;          // frames per second the camera is set to
+	uint32_t            packetSize;         // GevSCPSPacketSize, IP packet bytes
+	uint64_t            timestampFrequency; // ticks per second of GevSCPD, 0 if unknown
+};
+
+// the share of the link planned for one camera
+struct BandwidthAllocation {
+	BandwidthAllocation()
+		: required( 0.0 ), allocated( 0.0 ), maxFrameRate( 0.0 ), packetDelay( 0 ), limited( false ),
+		  incompleteRate( 0.0 )
+	{ }
+
+	BandwidthDemand     demand;
+	CameraControllerRef camera;             // null if planned from demands only
+	double              required;           // bytes per second on the wire at demand.frameRate
+	double              allocated;          // bytes per second the camera may send, StreamBytesPerSecond
+	double              maxFrameRate;       // frames per second the allocation carries
+	uint64_t            packetDelay;        // GevSCPD ticks that space the packets to the allocation
+	bool                limited;            // the allocation can't carry demand.frameRate
+
+	// filled by ApiController::applyBandwidthPlan() and verifyBandwidthPlan()
+	FrameStatistics     baseline;           // statistics when the plan was applied
+	FrameStatistics     observed;           // frames since then
+	double              incompleteRate;     // incomplete frames / received frames since then
+};
+
+struct BandwidthPlan {
+	BandwidthPlan() : oversubscribed( false ) { }
+
+	std::vector<BandwidthAllocation>    cameras;            // in the order of the demands
+	std::map<std::string, double>       linkLoad;           // allocated / link capacity per interface
+	bool                                oversubscribed;     // a link can't carry all its cameras at their rates
+};
+
+// Splits the capacity of each link between the GigE cameras on it.  Without limits every camera sends a frame as fast
+// as its link allows, so frames of cameras on a shared NIC collide and arrive incomplete.  Each camera gets what it
+// needs at its frame rate plus a margin, while the links have room for that; otherwise the link is shared in
+// proportion to the demands and the cameras are marked as limited.
+class BandwidthPlanner {
+  public:
+
+	class Options {
+	  public:
+		Options()
+			: mLinkCapacity( 125000000.0 ), mHeadroom( 0.9 ), mMargin( 1.1 )
+		{ }
+
+		// bytes per second of every link, 125000000 for 1000BASE-T
+		Options& linkCapacity( double bytesPerSecond ) { mLinkCapacity = bytesPerSecond; return *this; }
+		// bytes per second of the link of one interface, e.g. a 10 GigE NIC
+		Options& linkCapacity( const std::string &interfaceID, double bytesPerSecond )
+		{
+			mInterfaceCapacity[interfaceID] = bytesPerSecond;
+			return *this;
+		}
+		// fraction of each link that is planned, the rest absorbs resends and other traffic
+		Options& headroom( double fraction ) { mHeadroom = fraction; return *this; }
+		// factor over its demand a camera may send at, while the link has room
+		Options& margin( double factor ) { mMargin = factor; return *this; }
+
+		double  getLinkCapacity() const { return mLinkCapacity; }
+		double  getLinkCapacity( const std::string &interfaceID ) const;
+		double  getHeadroom() const { return mHeadroom; }
+		double  getMargin() const { return mMargin; }
+
+	  private:
+		double                          mLinkCapacity;
+		std::map<std::string, double>   mInterfaceCapacity;
+		double                          mHeadroom;
+		double                          mMargin;
+	};
+
+	static BandwidthPlan plan( const std::vector<BandwidthDemand> &demands, const Options &options = Options() );
+
+	// bytes one frame of payloadSize occupies on the wire, with GVSP, UDP, IP and Ethernet framing
+	static double getFrameWireSize( uint64_t payloadSize, uint32_t packetSize );
+};
+
+} // namespace civimba
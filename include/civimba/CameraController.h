@@ -23,24 +23,35 @@
 
 #pragma once
 
+#include <map>
 #include <memory>
 #include <mutex>
 #include <functional>
+#include <thread>
+#include <vector>
 
 #include "VimbaCPP/Include/VimbaCPP.h"
 
+#include "civimba/CameraProfile.h"
 #include "civimba/FrameObserver.h"
+#include "civimba/FrameSource.h"
+#include "civimba/SnapshotWriter.h"
+#include "civimba/ThreadPlacement.h"
 #include "civimba/Types.h"
 #include "civimba/BaseException.h"
 
+#include "cinder/Signals.h"
 #include "cinder/Surface.h"
 
 namespace civimba {
 
 typedef std::shared_ptr<class CameraController> CameraControllerRef;
 
+// Calls that change the camera or acquisition are serialized, so another thread (e.g. CameraRegistry's auto
+// reconnect) may stop, reopen and restart the camera while the application uses it.
 class CameraController {
 	friend class ApiController;
+	friend class CameraRegistry;
 
   public:
 
@@ -80,40 +91,181 @@ class CameraController {
 
 	void stopContinuousImageAcquisition();
 
+	bool isAcquiring() const
+	{
+		std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+		return nullptr != mFrameObserver;
+	}
+
+	// frame buffers queued with the camera, used from the next acquisition on
+	void setNumberFrames( uint32_t numberFrames );
+
+	uint32_t getNumberFrames() const { return mNumberFrames; }
+
 	void setFrameLogging( FrameLoggingInfo logging );
 
 	FrameLoggingInfo getFrameLogging() { return mFrameLoggingInfo; }
 
 	cinder::Surface8uRef getCurrentFrame();
 
+	// chunk data values of the frame returned by getCurrentFrame(), fields is 0 unless chunk mode is active
+	FrameMetadata getCurrentFrameMetadata();
+
 	bool checkNewFrame();
 
+	// Asks the camera to send chunk data (ChunkModeActive) with every frame, parsed into RawFrame::metadata and
+	// getCurrentFrameMetadata().  Set before starting acquisition, the payload size changes with it.
+	void setChunkMode( bool enable );
+
+	bool getChunkMode();
+
+	// writes the features of profile in dependency order, skipping those already set.  See CameraProfile.
+	CameraProfileResult applyProfile( const CameraProfile &profile );
+
+	// Reads the settings of the camera (CameraProfile::capture()) and keeps them as its known state.  Features
+	// written past this controller, e.g. through getCamera(), and values the camera changes on its own are not
+	// tracked; capture again after such changes.
+	const CameraProfile& captureFeatureSnapshot();
+
+	// the known state, empty until captured and again after ApiController::reopenCamera()
+	const CameraProfile& getFeatureSnapshot() const { return mFeatureSnapshot; }
+
+	// Applies changes such as the ROI or the pixel format with the least interruption.  With a known state only
+	// the features that differ are written, without reading them, otherwise unchanged features are skipped as
+	// with applyProfile().  During acquisition the changes are written live when all of them are writable.
+	// Otherwise only the stream is stopped: the observer and frame statistics stay, the frame buffers stay
+	// announced, and only buffers too small for the new payload are reallocated before the stream restarts.
+	CameraSwitchResult reconfigure( const CameraProfile &changes );
+
+	// moves or resizes the region of interest through reconfigure(), e.g. to follow a target
+	CameraSwitchResult reconfigureRoi( int64_t offsetX, int64_t offsetY, int64_t width, int64_t height );
+
+	// reconfigure() to target, capturing the known state first if there is none
+	CameraSwitchResult switchProfile( const CameraProfile &target );
+
+	// Saves the current settings to a camera user set (UserSetSelector, UserSetSave) and binds a fresh
+	// capture of them to it, throws.
+	void saveUserSet( const std::string &userSet );
+
+	// Loads a user set in the camera, a single command for all features.  Acquisition is stopped around the
+	// load.  The known state becomes the capture bound by saveUserSet(), or is captured with the next switch.
+	CameraSwitchResult loadUserSet( const std::string &userSet );
+
+	// Writes a still to path (.png or .tif) on a background thread and reports through callback, on that thread.
+	// SNAPSHOT_DEPTH_8 pins the frame returned by getCurrentFrame() without copying it, SNAPSHOT_DEPTH_16 writes the
+	// samples of the next raw frame from a Mono or Bayer camera.  Returns false if there is no current frame or the
+	// snapshot queue is full.
+	bool saveSnapshot( const std::string &path, SnapshotDepth depth = SNAPSHOT_DEPTH_8,
+	                   const SnapshotWriter::SnapshotCallback &callback = SnapshotWriter::SnapshotCallback() );
+
+	SnapshotWriter& getSnapshotWriter() { return *mSnapshotWriter; }
+
+	// Pins the acquisition thread (the Vimba callback thread or the thread of a frame source) and the snapshot
+	// thread.  With a NUMA node, the frame buffers allocated when acquisition starts and the transformed surfaces
+	// come from that node.  Set before starting acquisition.
+	void setThreadPlacement( const ThreadPlacement &acquisition, const ThreadPlacement &workers = ThreadPlacement() );
+
+	const ThreadPlacement& getAcquisitionPlacement() const { return mAcquisitionPlacement; }
+
+	// where the acquisition and snapshot threads run.  The acquisition thread is placed, and logged, with its first
+	// frame, the snapshot thread with the first snapshot.
+	std::vector<ThreadPlacementReport> getPlacementReport();
+
 	std::string getID();
 
 	std::string getName();
 
 	std::string getModel();
 
+	// ticks per second of the camera timestamps in RawFrame, 0 if the camera does not report it
+	uint64_t getTimestampFrequency();
+
+	// emitted on the acquisition thread for every frame, before transform.  The buffer is only valid during the
+	// call, so handlers must copy what they keep and should not block.  Connect before starting acquisition.
+	cinder::signals::Signal<void( const RawFrame & )>& getSignalRawFrame() { return mSignalRawFrame; }
+
+	// emitted on the acquisition thread once a transformed frame has been handed off to getCurrentFrame()
+	cinder::signals::Signal<void( const cinder::Surface8uRef & )>& getSignalNewFrame() { return mSignalNewFrame; }
+
+	// counters from the current or most recent acquisition
+	FrameStatistics getFrameStatistics();
+
 	// expose raw camera for low level requests that are not exposed.
-	AVT::VmbAPI::CameraPtr getCamera() { return mCamera; }
+	// null when frames come from a FrameSource such as SimulatedCamera
+	AVT::VmbAPI::CameraPtr getCamera()
+	{
+		std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+		return mCamera;
+	}
+
+	FrameSourceRef getFrameSource() { return mFrameSource; }
 
   private:
 
 	void frameObservedCallback( cinder::Surface8uRef &frame );
 
+	void rawFrameObservedCallback( const RawFrame &frame );
+
+	void placeAcquisitionThread();
+
+	// Announces mNumberFrames buffers that hold payloadSize bytes, keeping the ones that are large enough.
+	// Returns the number of buffers allocated.  Throws after releasing all frames.
+	uint32_t prepareFrames( VmbInt64_t payloadSize );
+
+	// StartCapture, queue the frames and AcquisitionStart, throws
+	void startStream();
+
+	// AcquisitionStop, EndCapture and FlushQueue.  The frames stay announced.
+	void stopStream();
+
+	void releaseFrames();
+
+	VmbInt64_t getPayloadSize();
+
+	// Runs write with the stream stopped, if acquiring, and restarts it with resized frames.  If the stream
+	// can't be restarted, acquisition ends as with stopContinuousImageAcquisition() before the error is thrown.
+	CameraSwitchResult restartStream( const std::function<void( CameraSwitchResult & )> &write );
+
+	// Serializes the camera, its frames, the observer and the settings between the application and other
+	// threads that change them, e.g. auto reconnect in CameraRegistry.  Frame callbacks never take it.
+	mutable std::recursive_mutex mStateMutex;
+
 	AVT::VmbAPI::CameraPtr mCamera;
+	FrameSourceRef mFrameSource;
 	FrameObserver *mFrameObserver;
+	// keeps the observer alive, Vimba frames hold it as well
+	AVT::VmbAPI::IFrameObserverPtr mFrameObserverPtr;
+	// announced while acquiring and across reconfigure()
+	AVT::VmbAPI::FramePtrVector mFrames;
 
 	std::mutex mFrameMutex;
 	// TODO support other formats
 	cinder::Surface8uRef mCurrentFrame;
+	FrameMetadata mCurrentMetadata;
+	// written by the raw frame callback, which runs on the acquisition thread just before the transformed frame
+	FrameMetadata mPendingMetadata;
 	std::mutex mCheckFrameMutex;
 	bool mNewFrame;
 
 	ColorProcessing mColorProcessing;
 	FrameLoggingInfo mFrameLoggingInfo;
+	FrameStatistics mLastStatistics;
+
+	cinder::signals::Signal<void( const RawFrame & )> mSignalRawFrame;
+	cinder::signals::Signal<void( const cinder::Surface8uRef & )> mSignalNewFrame;
+
+	std::unique_ptr<SnapshotWriter> mSnapshotWriter;
+
+	ThreadPlacement mAcquisitionPlacement;
+	// thread that delivered the last frame, only touched by the acquisition thread while acquiring
+	std::thread::id mAcquisitionThread;
+	std::string mAcquisitionName;
+	ThreadPlacementReport mAcquisitionReport;
 
 	uint32_t mNumberFrames;
+
+	CameraProfile mFeatureSnapshot;
+	std::map<std::string, CameraProfile> mUserSetSnapshots;
 };
 
 } // namespace civimba
\ No newline at end of file
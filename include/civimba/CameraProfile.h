@@ -0,0 +1,168 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "VimbaCPP/Include/VimbaCPP.h"
+
+#include "civimba/BaseException.h"
+
+namespace civimba {
+
+class CameraController;
+
+struct CameraProfileEntry {
+	std::string name;
+	std::string value;      // as text, converted to the type of the feature
+};
+
+struct CameraProfileError {
+	std::string     feature;
+	VmbErrorType    error;
+	std::string     message;
+};
+
+// outcome of applying a profile to one camera
+struct CameraProfileResult {
+	CameraProfileResult() : written( 0 ), skipped( 0 ), seconds( 0.0 ) { }
+
+	bool ok() const { return errors.empty(); }
+
+	std::string                     cameraID;
+	uint32_t                        written;
+	uint32_t                        skipped;    // already at the value, not written
+	std::vector<CameraProfileError> errors;
+	double                          seconds;
+};
+
+// outcome of ApiController::applyProfile()
+struct CameraProfileReport {
+	CameraProfileReport() : seconds( 0.0 ) { }
+
+	bool ok() const;
+
+	std::vector<CameraProfileResult>    cameras;    // in the order of the cameras
+	double                              seconds;    // wall time for all cameras
+};
+
+// outcome of CameraController::reconfigure(), switchProfile() and loadUserSet()
+struct CameraSwitchResult {
+	CameraSwitchResult()
+		: restarted( false ), framesAllocated( 0 ), stopSeconds( 0.0 ), applySeconds( 0.0 ), restartSeconds( 0.0 ),
+		  seconds( 0.0 )
+	{ }
+
+	bool ok() const { return profile.ok(); }
+
+	CameraProfileResult profile;            // the features that were written
+	bool                restarted;          // the stream was stopped for features that are locked while acquiring
+	uint32_t            framesAllocated;    // frame buffers too small for the new payload, the others were kept
+	double              stopSeconds;        // stopping the stream
+	double              applySeconds;       // writing the features
+	double              restartSeconds;     // from stopping until the stream was running again
+	double              seconds;
+};
+
+// A list of feature values to apply to cameras, loaded from JSON or XML:
+//
+//   { "features": [ { "name": "PixelFormat", "value": "Mono8" }, { "name": "ExposureTimeAbs", "value": 5000 } ] }
+//   <profile><feature name="PixelFormat">Mono8</feature></profile>
+//
+// "features" may also be an object of names and values, and Vimba Viewer settings files (Feature elements with a
+// Name attribute) load as well.  apply() writes the features so that each one finds the range its predecessors
+// leave: binning and decimation, pixel format, size, offset, auto modes, the remaining features in file order,
+// and the frame rate last.  A selector stays in front of the features it selects, so a feature can be set for
+// several selector values.  Features that already have their value are only read.
+//
+// capture() reads the state of a camera into a profile, with the selected features under every selector value.
+// diff() compares two such profiles, so a camera whose state is known only needs the features that differ.
+class CameraProfile {
+  public:
+
+	class CameraProfileException : public BaseException
+	{
+	  public:
+		CameraProfileException( const char *const &fun, const char *const &msg,
+		                        VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		CameraProfileException( const char *const &fun, const std::string &msg,
+		                        VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~CameraProfileException() throw()
+		{ }
+	};
+
+	// tells whether selector selects feature
+	typedef std::function<bool( const std::string &selector, const std::string &feature )> SelectsFunction;
+
+	CameraProfile() { }
+
+	// appends a feature
+	CameraProfile& set( const std::string &name, const std::string &value );
+
+	const std::vector<CameraProfileEntry>& getEntries() const { return mEntries; }
+
+	bool empty() const { return mEntries.empty(); }
+
+	// JSON or XML by content, throws
+	static CameraProfile load( const std::string &path );
+	static CameraProfile fromJson( const std::string &json );
+	static CameraProfile fromXml( const std::string &xml );
+
+	// Reads every readable feature of camera that is saved with its settings (or writable), except commands and
+	// user set features.  Selectors are stepped through all their values, so the camera is briefly switched.
+	static CameraProfile capture( CameraController &camera );
+
+	// writes the profile to camera, see CameraProfile.  Errors of single features are reported, not thrown.
+	// Without compare the features are written without reading them first, e.g. for the result of diff().
+	CameraProfileResult apply( CameraController &camera, bool compare = true ) const;
+
+	// The features of this profile whose values differ from current, each with the selector values it needs,
+	// and the selectors whose final values differ.  Numbers are compared by value, so "5000" equals "5000.0".
+	CameraProfile diff( const CameraProfile &current, const SelectsFunction &selects = selectsByName ) const;
+
+	// sets the features and final selector values of changes, e.g. after they were applied to the camera
+	CameraProfile& update( const CameraProfile &changes, const SelectsFunction &selects = selectsByName );
+
+	// entries in the order apply() writes them
+	std::vector<CameraProfileEntry> getOrderedEntries( const SelectsFunction &selects ) const;
+
+	// features are selected by the selector of the same prefix, e.g. TriggerSource by TriggerSelector
+	static bool selectsByName( const std::string &selector, const std::string &feature );
+
+	// asks the camera which features a selector selects, once per selector, falling back to selectsByName()
+	static SelectsFunction getSelects( const AVT::VmbAPI::CameraPtr &camera );
+
+  private:
+	std::vector<CameraProfileEntry> mEntries;
+};
+
+} // namespace civimba
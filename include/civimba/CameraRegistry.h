@@ -0,0 +1,157 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "VimbaCPP/Include/VimbaCPP.h"
+
+#include "cinder/Signals.h"
+
+#include "civimba/BaseException.h"
+#include "civimba/CameraController.h"
+#include "civimba/ReconnectSchedule.h"
+
+namespace civimba {
+
+class ApiController;
+
+typedef enum {
+	CAMERA_EVENT_ADDED,                 // seen for the first time
+	CAMERA_EVENT_REMOVED,               // unplugged or no longer reachable, stays known as unreachable
+	CAMERA_EVENT_REACHABLE,             // a removed camera is back
+	CAMERA_EVENT_OPEN_STATE_CHANGED,    // opened or closed, by this or another application
+	CAMERA_EVENT_RECONNECTED,           // reopened by auto reconnect, acquisition was resumed if it was running
+	CAMERA_EVENT_RECONNECT_FAILED       // auto reconnect could not reopen the camera, it tries again later
+} CameraEventType;
+
+struct CameraEvent {
+	CameraEventType type;
+	std::string     cameraID;
+};
+
+// cached enumeration result for one camera
+struct CameraInfo {
+	std::string             cameraID;
+	std::string             name;
+	std::string             model;
+	std::string             serialNumber;
+	std::string             interfaceID;
+	bool                    reachable;
+	AVT::VmbAPI::CameraPtr  camera;
+};
+
+// Keeps the camera list of the Vimba system up to date through its camera list observer, so enumeration does not
+// go to the transport layers every time, and reports cameras that appear and disappear.  Created by
+// ApiController::getCameraRegistry().
+//
+// With setAutoReconnect() the registry stops the acquisition of an unplugged camera and, as soon as the camera is
+// back, reopens and prepares it through ApiController::reopenCamera() and resumes acquisition.  A reopen that fails,
+// e.g. while the camera is still booting, is retried with growing delays (see ReconnectSchedule) until it succeeds or
+// the camera is removed again.  This happens on the registry's own thread, serialized with the application's calls by
+// the controller.  Events are emitted on the Vimba notification thread or that thread.
+class CameraRegistry {
+  public:
+
+	class CameraRegistryException : public BaseException
+	{
+	  public:
+		CameraRegistryException( const char *const &fun, const char *const &msg,
+		                         VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		CameraRegistryException( const char *const &fun, const std::string &msg,
+		                         VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~CameraRegistryException() throw()
+		{ }
+	};
+
+	// enumerates the cameras and registers for changes, Vimba has to be started
+	CameraRegistry( ApiController &api, AVT::VmbAPI::VimbaSystem &system,
+	                const ReconnectSchedule::Options &reconnectOptions = ReconnectSchedule::Options() );
+	~CameraRegistry();
+
+	// all cameras seen since the registry was created, reachable or not
+	std::vector<CameraInfo> getCameraInfos() const;
+
+	// reachable cameras, the cached equivalent of VimbaSystem::GetCameras()
+	std::vector<AVT::VmbAPI::CameraPtr> getCameras() const;
+
+	bool isReachable( const std::string &cameraID ) const;
+
+	// enumerates through the SDK again and emits events for the differences, for transports that do not report
+	// every change
+	void refresh();
+
+	cinder::signals::Signal<void( const CameraEvent & )>& getSignalCameraEvent() { return mSignalCameraEvent; }
+
+	// reopen camera and resume its acquisition when it comes back after it was unplugged.  Only applies to Vimba
+	// cameras, while enabled the registry stops and starts acquisition of camera.
+	void setAutoReconnect( const CameraControllerRef &camera, bool enable = true );
+
+	uint64_t getReconnects() const;
+
+  private:
+
+	CameraRegistry( const CameraRegistry & );
+	CameraRegistry &operator=( const CameraRegistry & );
+
+	class Observer;
+
+	struct Watched {
+		std::weak_ptr<CameraController> camera;
+		bool                            wasAcquiring;
+	};
+
+	void cameraListChanged( const AVT::VmbAPI::CameraPtr &camera, AVT::VmbAPI::UpdateTriggerType reason );
+	// updates the cache, returns false if nothing changed.  mMutex must be held.
+	bool update( const AVT::VmbAPI::CameraPtr &camera, bool reachable, CameraEvent &event );
+	void schedule( const std::string &cameraID, bool reconnect );
+	void emit( const CameraEvent &event );
+	void runReconnect();
+
+	ApiController                           &mApi;
+	AVT::VmbAPI::VimbaSystem                &mSystem;
+	AVT::VmbAPI::ICameraListObserverPtr     mObserver;
+
+	mutable std::mutex                      mMutex;
+	std::map<std::string, CameraInfo>       mCameras;
+	std::map<std::string, Watched>          mWatched;
+	uint64_t                                mReconnects;
+	ReconnectSchedule                       mSchedule;
+	std::thread                             mThread;
+
+	cinder::signals::Signal<void( const CameraEvent & )> mSignalCameraEvent;
+};
+
+} // namespace civimba
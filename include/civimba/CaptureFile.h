@@ -0,0 +1,348 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "VimbaCPP/Include/VimbaCPP.h"
+
+#include "civimba/BaseException.h"
+#include "civimba/RawFrame.h"
+
+namespace civimba {
+
+// civimba raw capture file.  All fields are little endian.
+//
+//   CaptureFileHeader                      64 bytes
+//   { CaptureFrameHeader, image data }     repeated, each record padded to a multiple of 8 bytes
+//
+// Image data is the untouched sensor buffer in the recorded pixel format.  Records flagged with
+// CAPTURE_FRAME_FLAG_COMPRESSED hold FrameCodec data instead and imageSize is the size of that data.
+//
+// Linear files end with an index once they are closed (version 2):
+//
+//   CaptureIndexHeader                     16 bytes
+//   CaptureIndexEntry                      24 bytes, one per frame in file order
+//   CaptureIndexFooter                     16 bytes, last bytes of the file
+//
+// A file without a valid footer, for example after a crash, is still readable sequentially.  MappedCaptureReader
+// rebuilds the index by scanning the records and MappedCaptureReader::rebuildIndex() writes it back.
+//
+// Ring files (version 2, CAPTURE_FILE_FLAG_RING) written by MappedRecorder follow the file header with a
+// CaptureRingHeader and store one record per fixed size slot.  Slot (framesWritten % slotCount) holds the oldest
+// frame once the ring has wrapped.  A slot whose record magic is not CAPTURE_FRAME_MAGIC is empty or was being
+// overwritten and is skipped.  A ring closed before its first frame without an explicit slot size keeps slotCount
+// and framesWritten at 0 and has no slots.  Ring files have no index.
+//
+// Synchronized files (version 2, CAPTURE_FILE_FLAG_SYNC) written by SyncRecorder hold the frames of several cameras.
+// The file header is followed by a CaptureSyncHeader and one CaptureStreamEntry per camera, the stream of a record
+// is stored in the top bits of its flags (getCaptureFrameStream()) and record timestamps are host nanoseconds.
+// Frames taken within the same window of time are grouped, the groups are written in front of the index:
+//
+//   CaptureSyncIndexHeader                 24 bytes
+//   { timestamp, frame per stream }        8 * ( 1 + streamCount ) bytes per group, frames are positions in the
+//                                          index, CAPTURE_SYNC_NO_FRAME where a camera has no frame in the group
+//   CaptureSyncIndexFooter                 16 bytes, directly in front of the CaptureIndexHeader
+//
+// Groups can be rebuilt from the records with makeCaptureSyncGroups() when a recording was not closed.
+
+static const char       CAPTURE_FILE_MAGIC[8]   = { 'C', 'I', 'V', 'I', 'M', 'B', 'A', 0 };
+static const uint32_t   CAPTURE_FILE_VERSION    = 2;
+static const uint32_t   CAPTURE_FRAME_MAGIC     = 0x52465643; // "CVFR"
+static const uint32_t   CAPTURE_INDEX_MAGIC     = 0x58495643; // "CVIX"
+static const uint32_t   CAPTURE_SYNC_MAGIC      = 0x59535643; // "CVSY"
+
+static const uint32_t   CAPTURE_FILE_FLAG_RING      = 1 << 0;
+static const uint32_t   CAPTURE_FILE_FLAG_SYNC      = 1 << 1;
+
+static const uint32_t   CAPTURE_FRAME_FLAG_ID_VALID     = 1 << 0;
+static const uint32_t   CAPTURE_FRAME_FLAG_COMPRESSED   = 1 << 1;
+static const uint32_t   CAPTURE_FRAME_STREAM_SHIFT      = 24;           // stream of a record in a synchronized file
+static const uint32_t   CAPTURE_MAX_STREAMS             = 256;
+
+static const uint64_t   CAPTURE_SYNC_NO_FRAME           = ~static_cast<uint64_t>( 0 );
+
+struct CaptureFileHeader {
+	char        magic[8];
+	uint32_t    version;
+	uint32_t    headerSize;
+	uint64_t    timestampFrequency;     // camera timestamp ticks per second, 0 if unknown
+	uint32_t    flags;
+	uint32_t    reserved;
+	char        cameraID[32];
+};
+
+struct CaptureFrameHeader {
+	uint32_t    magic;
+	uint32_t    headerSize;
+	uint64_t    frameID;
+	uint64_t    timestamp;
+	uint32_t    pixelFormat;
+	uint32_t    width;
+	uint32_t    height;
+	int32_t     receiveStatus;
+	uint32_t    imageSize;              // bytes of image data following this header
+	uint32_t    flags;
+};
+
+struct CaptureRingHeader {
+	uint64_t    slotSize;               // bytes per slot, a multiple of 8
+	uint64_t    slotCount;              // 0 until the first frame has been recorded
+	uint64_t    framesWritten;          // total frames recorded, including overwritten ones
+	uint64_t    reserved;
+};
+
+struct CaptureIndexHeader {
+	uint32_t    magic;
+	uint32_t    headerSize;
+	uint64_t    entryCount;
+};
+
+struct CaptureIndexEntry {
+	uint64_t    frameID;
+	uint64_t    timestamp;
+	uint64_t    offset;                 // file offset of the CaptureFrameHeader
+};
+
+struct CaptureIndexFooter {
+	uint64_t    indexOffset;            // file offset of the CaptureIndexHeader
+	uint32_t    magic;
+	uint32_t    reserved;
+};
+
+struct CaptureSyncHeader {
+	uint32_t    streamCount;            // CaptureStreamEntry records following this header
+	uint32_t    reserved;
+	uint64_t    window;                 // nanoseconds, frames closer than this belong to the same group
+};
+
+struct CaptureStreamEntry {
+	char        cameraID[32];
+	uint64_t    timestampFrequency;     // ticks per second of the camera clock the host timestamps were mapped from
+	uint64_t    reserved;
+};
+
+struct CaptureSyncIndexHeader {
+	uint32_t    magic;
+	uint32_t    headerSize;
+	uint64_t    groupCount;
+	uint32_t    streamCount;
+	uint32_t    reserved;
+};
+
+struct CaptureSyncIndexFooter {
+	uint64_t    size;                   // bytes from the CaptureSyncIndexHeader to the end of this footer
+	uint32_t    magic;
+	uint32_t    reserved;
+};
+
+static_assert( sizeof( CaptureFileHeader ) == 64, "CaptureFileHeader layout changed" );
+static_assert( sizeof( CaptureFrameHeader ) == 48, "CaptureFrameHeader layout changed" );
+static_assert( sizeof( CaptureRingHeader ) == 32, "CaptureRingHeader layout changed" );
+static_assert( sizeof( CaptureIndexHeader ) == 16, "CaptureIndexHeader layout changed" );
+static_assert( sizeof( CaptureIndexEntry ) == 24, "CaptureIndexEntry layout changed" );
+static_assert( sizeof( CaptureIndexFooter ) == 16, "CaptureIndexFooter layout changed" );
+static_assert( sizeof( CaptureSyncHeader ) == 16, "CaptureSyncHeader layout changed" );
+static_assert( sizeof( CaptureStreamEntry ) == 48, "CaptureStreamEntry layout changed" );
+static_assert( sizeof( CaptureSyncIndexHeader ) == 24, "CaptureSyncIndexHeader layout changed" );
+static_assert( sizeof( CaptureSyncIndexFooter ) == 16, "CaptureSyncIndexFooter layout changed" );
+
+class CaptureException : public BaseException
+{
+  public:
+	CaptureException( const char *const &fun, const char *const &msg, VmbErrorType result = VmbErrorOther )
+		: BaseException( fun, msg, result )
+	{ }
+
+	CaptureException( const char *const &fun, const std::string &msg, VmbErrorType result = VmbErrorOther )
+		: BaseException( fun, msg, result )
+	{ }
+
+	~CaptureException() throw()
+	{ }
+};
+
+// size of a frame record on disk including its header and padding
+inline uint64_t getCaptureRecordSize( uint32_t imageSize )
+{
+	return sizeof( CaptureFrameHeader ) + (( static_cast<uint64_t>( imageSize ) + 7 ) & ~static_cast<uint64_t>( 7 ));
+}
+
+inline CaptureFileHeader makeCaptureFileHeader( const std::string &cameraID, uint64_t timestampFrequency, uint32_t flags = 0 )
+{
+	CaptureFileHeader header;
+	std::memset( &header, 0, sizeof( header ));
+	std::memcpy( header.magic, CAPTURE_FILE_MAGIC, sizeof( header.magic ));
+	header.version = CAPTURE_FILE_VERSION;
+	header.headerSize = sizeof( CaptureFileHeader );
+	header.timestampFrequency = timestampFrequency;
+	header.flags = flags;
+	std::strncpy( header.cameraID, cameraID.c_str(), sizeof( header.cameraID ) - 1 );
+	return header;
+}
+
+inline CaptureFrameHeader makeCaptureFrameHeader( const RawFrame &frame )
+{
+	CaptureFrameHeader header;
+	header.magic = CAPTURE_FRAME_MAGIC;
+	header.headerSize = sizeof( CaptureFrameHeader );
+	header.frameID = frame.frameID;
+	header.timestamp = frame.timestamp;
+	header.pixelFormat = static_cast<uint32_t>( frame.pixelFormat );
+	header.width = frame.width;
+	header.height = frame.height;
+	header.receiveStatus = static_cast<int32_t>( frame.receiveStatus );
+	header.imageSize = frame.imageSize;
+	header.flags = frame.frameIDValid ? CAPTURE_FRAME_FLAG_ID_VALID : 0;
+	return header;
+}
+
+// RawFrame view of a record, data must hold header.imageSize bytes
+inline RawFrame makeRawFrame( const CaptureFrameHeader &header, const VmbUchar_t *data )
+{
+	RawFrame frame;
+	frame.buffer = data;
+	frame.imageSize = header.imageSize;
+	frame.width = header.width;
+	frame.height = header.height;
+	frame.pixelFormat = static_cast<VmbPixelFormatType>( header.pixelFormat );
+	frame.frameID = header.frameID;
+	frame.frameIDValid = ( 0 != ( header.flags & CAPTURE_FRAME_FLAG_ID_VALID ));
+	frame.timestamp = header.timestamp;
+	frame.receiveStatus = static_cast<VmbFrameStatusType>( header.receiveStatus );
+	return frame;
+}
+
+inline CaptureIndexEntry makeCaptureIndexEntry( const CaptureFrameHeader &header, uint64_t offset )
+{
+	CaptureIndexEntry entry;
+	entry.frameID = header.frameID;
+	entry.timestamp = header.timestamp;
+	entry.offset = offset;
+	return entry;
+}
+
+// serialized index for entries, to be written at indexOffset as the last bytes of the file
+std::vector<VmbUchar_t> makeCaptureIndex( const std::vector<CaptureIndexEntry> &entries, uint64_t indexOffset );
+
+inline CaptureStreamEntry makeCaptureStreamEntry( const std::string &cameraID, uint64_t timestampFrequency )
+{
+	CaptureStreamEntry entry;
+	std::memset( &entry, 0, sizeof( entry ));
+	std::strncpy( entry.cameraID, cameraID.c_str(), sizeof( entry.cameraID ) - 1 );
+	entry.timestampFrequency = timestampFrequency;
+	return entry;
+}
+
+inline uint32_t getCaptureFrameStream( const CaptureFrameHeader &header )
+{
+	return header.flags >> CAPTURE_FRAME_STREAM_SHIFT;
+}
+
+// file header, CaptureSyncHeader and stream table of a synchronized file
+std::vector<VmbUchar_t> makeCaptureSyncFileHeader( const std::vector<CaptureStreamEntry> &streams, uint64_t window );
+
+// One frame of a synchronized recording, as input for makeCaptureSyncGroups()
+struct CaptureSyncFrame {
+	uint64_t    timestamp;              // host nanoseconds
+	uint64_t    frame;                  // position in the capture index
+	uint32_t    stream;
+};
+
+// Groups frames by time, returns ( 1 + streamCount ) values per group: the timestamp of the earliest frame and the
+// frame of each stream or CAPTURE_SYNC_NO_FRAME.  A group starts with the earliest frame that is not grouped yet and
+// takes the following frames within window nanoseconds of it, one per stream.  frames is sorted by timestamp.
+std::vector<uint64_t> makeCaptureSyncGroups( std::vector<CaptureSyncFrame> &frames, uint32_t streamCount, uint64_t window );
+
+// serialized group index, to be written directly in front of the capture index
+std::vector<VmbUchar_t> makeCaptureSyncIndex( const std::vector<uint64_t> &groups, uint32_t streamCount );
+
+typedef std::shared_ptr<class CaptureWriter> CaptureWriterRef;
+typedef std::shared_ptr<class CaptureReader> CaptureReaderRef;
+
+// Appends raw frames to a capture file with buffered writes, the index is written by close().  Intended to be
+// connected to CameraController::getSignalRawFrame(), writes happen on the calling thread.
+class CaptureWriter {
+  public:
+
+	CaptureWriter( const std::string &path, const std::string &cameraID, uint64_t timestampFrequency );
+	~CaptureWriter();
+
+	void write( const RawFrame &frame );
+	// writes a prepared record, data holds header.imageSize bytes.  Used for records compressed by FrameCompressor.
+	void writeRecord( const CaptureFrameHeader &header, const VmbUchar_t *data );
+	void close();
+
+	uint64_t getFramesWritten() const { return mFramesWritten; }
+	uint64_t getBytesWritten() const { return mBytesWritten; }
+
+  private:
+
+	CaptureWriter( const CaptureWriter & );
+	CaptureWriter &operator=( const CaptureWriter & );
+
+	std::FILE                       *mFile;
+	uint64_t                        mFramesWritten;
+	uint64_t                        mBytesWritten;
+	std::vector<CaptureIndexEntry>  mIndex;
+};
+
+// Sequential reader for capture files
+class CaptureReader {
+  public:
+
+	CaptureReader( const std::string &path );
+	~CaptureReader();
+
+	const CaptureFileHeader& getFileHeader() const { return mFileHeader; }
+
+	// returns false at the end of the file.  A truncated last record is treated as the end.  Ring files are read
+	// from the oldest to the newest frame.  Compressed records are decoded, header then describes the decoded frame.
+	// Throws CaptureException if a compressed record is damaged.
+	bool readNext( CaptureFrameHeader &header, std::vector<VmbUchar_t> &data );
+
+	void rewind();
+
+	bool isRing() const { return 0 != ( mFileHeader.flags & CAPTURE_FILE_FLAG_RING ); }
+
+  private:
+
+	CaptureReader( const CaptureReader & );
+	CaptureReader &operator=( const CaptureReader & );
+
+	bool readRecord( CaptureFrameHeader &header, std::vector<VmbUchar_t> &data );
+
+	std::FILE                   *mFile;
+	CaptureFileHeader           mFileHeader;
+	CaptureRingHeader           mRingHeader;
+	uint64_t                    mRingIndex;
+	std::vector<VmbUchar_t>     mEncoded;
+};
+
+} // namespace civimba
@@ -24,10 +24,38 @@
 #pragma once
 
 #include "civimba/ApiController.h"
+#include "civimba/BandwidthPlanner.h"
 #include "civimba/BaseException.h"
+#include "civimba/CaptureFile.h"
 #include "civimba/CameraController.h"
+#include "civimba/CameraProfile.h"
+#include "civimba/CameraRegistry.h"
+#include "civimba/ClockMapper.h"
+#include "civimba/CommandRunner.h"
+#include "civimba/DiskWriter.h"
 #include "civimba/ErrorCodeToMessage.h"
+#include "civimba/FrameCodec.h"
+#include "civimba/FrameCompressor.h"
+#include "civimba/FrameHistory.h"
+#include "civimba/FrameMetadata.h"
 #include "civimba/FrameObserver.h"
+#include "civimba/FrameSetAssembler.h"
+#include "civimba/FrameStreamClient.h"
+#include "civimba/FrameStreamServer.h"
+#include "civimba/FrameSource.h"
+#include "civimba/MappedCaptureReader.h"
+#include "civimba/MappedRecorder.h"
+#include "civimba/RawFrame.h"
+#include "civimba/ReplayCamera.h"
+#include "civimba/SharedFrameConsumer.h"
+#include "civimba/SharedFramePublisher.h"
+#include "civimba/SharedFrameRing.h"
+#include "civimba/SimulatedCamera.h"
+#include "civimba/SnapshotWriter.h"
+#include "civimba/StreamTuner.h"
+#include "civimba/SyncCaptureReader.h"
+#include "civimba/SyncRecorder.h"
+#include "civimba/ThreadPlacement.h"
 #include "civimba/TransformImage.h"
 #include "civimba/Types.h"
 #include "civimba/FeatureAccessor.h"
@@ -0,0 +1,91 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace civimba {
+
+// Maps the timestamps of a camera clock to host steady clock nanoseconds.  The offset between the clocks is the
+// smallest difference between frame arrival and frame timestamp seen within the last window, which ignores transfer
+// delays and follows clock drift.  Cameras that report no timestamp frequency map to the arrival time.
+class ClockMapper {
+  public:
+
+	ClockMapper( uint64_t timestampFrequency = 0, double window = 10.0 )
+		: mFrequency( timestampFrequency ), mWindow( static_cast<uint64_t>( window * 1e9 )), mValid( false ),
+		  mPreviousOffset( 0 ), mCurrentOffset( 0 ), mWindowStart( 0 ), mLastTimestamp( 0 )
+	{ }
+
+	// timestamp in camera ticks, arrival in getHostTime() nanoseconds
+	uint64_t map( uint64_t timestamp, uint64_t arrival )
+	{
+		if( 0 == mFrequency || 0 == timestamp ) {
+			return arrival;
+		}
+
+		const uint64_t camera = timestamp / mFrequency * 1000000000 + timestamp % mFrequency * 1000000000 / mFrequency;
+		const int64_t offset = static_cast<int64_t>( arrival ) - static_cast<int64_t>( camera );
+
+		// the smallest offset belongs to the frame that was delivered fastest.  Keeping the minimum of the current
+		// and the previous window lets the estimate follow a camera clock that runs slower than the host clock.
+		if( ! mValid || timestamp < mLastTimestamp ) {
+			// first frame, or the camera clock was reset
+			mPreviousOffset = mCurrentOffset = offset;
+			mWindowStart = arrival;
+			mValid = true;
+		} else if( arrival - mWindowStart >= mWindow ) {
+			mPreviousOffset = mCurrentOffset;
+			mCurrentOffset = offset;
+			mWindowStart = arrival;
+		} else {
+			mCurrentOffset = std::min( mCurrentOffset, offset );
+		}
+		mLastTimestamp = timestamp;
+
+		const int64_t host = static_cast<int64_t>( camera ) + std::min( mPreviousOffset, mCurrentOffset );
+		return host > 0 ? static_cast<uint64_t>( host ) : 0;
+	}
+
+	uint64_t getTimestampFrequency() const { return mFrequency; }
+
+	// steady clock time in nanoseconds
+	static uint64_t getHostTime()
+	{
+		return static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch() ).count() );
+	}
+
+  private:
+	uint64_t    mFrequency;
+	uint64_t    mWindow;
+	bool        mValid;
+	int64_t     mPreviousOffset;
+	int64_t     mCurrentOffset;
+	uint64_t    mWindowStart;
+	uint64_t    mLastTimestamp;
+};
+
+} // namespace civimba
@@ -0,0 +1,122 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "VimbaCPP/Include/VimbaCPP.h"
+
+namespace civimba {
+
+// outcome of a command run by CommandRunner
+struct CommandResult {
+	VmbErrorType    error;          // VmbErrorSuccess, VmbErrorTimeout, or the error of RunCommand() / IsCommandDone()
+	double          seconds;        // from starting the command until it was done or failed
+};
+
+// Runs command features and waits for them to finish.  IsCommandDone() is polled with exponential back-off instead
+// of in a busy loop, and a deadline bounds the wait for devices that never report done.  Several commands, e.g. of
+// different cameras, are started together and waited for in the same polling loop.
+class CommandRunner {
+  public:
+
+	class Options {
+	  public:
+		Options()
+			: mTimeout( 5.0 ), mInitialDelay( 0.001 ), mMaxDelay( 0.05 )
+		{ }
+
+		// seconds after which commands that are not done fail with VmbErrorTimeout, 0 only starts them
+		Options& timeout( double seconds ) { mTimeout = seconds; return *this; }
+		// first pause between polls, doubled after every poll up to maxDelay
+		Options& initialDelay( double seconds ) { mInitialDelay = seconds; return *this; }
+		Options& maxDelay( double seconds ) { mMaxDelay = seconds; return *this; }
+
+		double getTimeout() const { return mTimeout; }
+		double getInitialDelay() const { return mInitialDelay; }
+		double getMaxDelay() const { return mMaxDelay; }
+
+	  private:
+		double mTimeout;
+		double mInitialDelay;
+		double mMaxDelay;
+	};
+
+	static CommandResult run( const AVT::VmbAPI::FeaturePtr &command, const Options &options = Options() )
+	{
+		return run( std::vector<AVT::VmbAPI::FeaturePtr>( 1, command ), options ).front();
+	}
+
+	// results are in the order of commands
+	static std::vector<CommandResult> run( const std::vector<AVT::VmbAPI::FeaturePtr> &commands, const Options &options = Options() )
+	{
+		typedef std::chrono::steady_clock Clock;
+		const Clock::time_point start = Clock::now();
+		auto elapsed = [start] { return std::chrono::duration<double>( Clock::now() - start ).count(); };
+
+		std::vector<CommandResult> results( commands.size() );
+		std::vector<size_t> pending;
+		for( size_t i = 0; i < commands.size(); ++i ) {
+			results[i].error = SP_ISNULL( commands[i] ) ? VmbErrorBadParameter : commands[i]->RunCommand();
+			results[i].seconds = elapsed();
+			if( VmbErrorSuccess == results[i].error && options.getTimeout() > 0.0 ) {
+				pending.push_back( i );
+			}
+		}
+
+		double delay = options.getInitialDelay();
+		while( ! pending.empty() ) {
+			auto last = std::remove_if( pending.begin(), pending.end(), [&]( size_t i ) {
+				bool done = false;
+				VmbErrorType error = commands[i]->IsCommandDone( done );
+				if( VmbErrorSuccess != error || done ) {
+					results[i].error = error;
+					results[i].seconds = elapsed();
+					return true;
+				}
+				return false;
+			} );
+			pending.erase( last, pending.end() );
+			if( pending.empty() ) {
+				break;
+			}
+
+			const double remaining = options.getTimeout() - elapsed();
+			if( remaining <= 0.0 ) {
+				for( size_t i : pending ) {
+					results[i].error = VmbErrorTimeout;
+					results[i].seconds = elapsed();
+				}
+				break;
+			}
+			std::this_thread::sleep_for( std::chrono::duration<double>( std::min( delay, remaining )));
+			delay = std::min( delay * 2.0, std::max( options.getMaxDelay(), options.getInitialDelay() ));
+		}
+		return results;
+	}
+};
+
+} // namespace civimba
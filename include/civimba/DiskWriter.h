@@ -0,0 +1,227 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cinder/Signals.h"
+
+#include "civimba/BaseException.h"
+#include "civimba/CameraController.h"
+#include "civimba/CaptureFile.h"
+#include "civimba/ThreadPlacement.h"
+
+namespace civimba {
+
+typedef std::shared_ptr<class DiskWriter> DiskWriterRef;
+
+typedef enum {
+	DISK_WRITER_AUTO,           // io_uring when the kernel allows it, the pwrite thread otherwise
+	DISK_WRITER_IO_URING,
+	DISK_WRITER_THREAD
+} DiskWriterBackend;
+
+// counters kept by DiskWriter since it was opened
+struct DiskWriterStatistics {
+	uint64_t framesQueued;          // frames copied into staging buffers
+	uint64_t framesDropped;         // frames that did not fit into the free staging buffers
+	uint64_t bytesWritten;          // bytes confirmed written to the file
+	uint64_t buffersWritten;
+	uint64_t submissions;           // batches handed to the kernel, each holding one or more buffers
+	uint64_t backPressureWaits;     // writes that had to wait for a free buffer
+	uint64_t maxBuffersQueued;      // high water mark of buffers waiting for or in flight to the disk
+};
+
+// Writes a capture file (see CaptureFile.h) from a dedicated I/O thread so a stalling disk never blocks the
+// acquisition thread.  write() copies the frame record into a page aligned staging buffer, full buffers are handed
+// to the I/O thread, which submits everything that is ready in one batch, through io_uring or pwritev, with O_DIRECT
+// so the page cache is bypassed.
+//
+// When no staging buffer is free, write() waits up to Options::maxWait() and then drops the frame, the drop is
+// counted in getStatistics().  Data is in the file once its buffer is full, the partially filled last buffer and
+// the index are written by close().
+class DiskWriter {
+  public:
+
+	class DiskWriterException : public BaseException
+	{
+	  public:
+		DiskWriterException( const char *const &fun, const char *const &msg,
+		                     VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		DiskWriterException( const char *const &fun, const std::string &msg,
+		                     VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~DiskWriterException() throw()
+		{ }
+	};
+
+	class Options {
+	  public:
+		Options( const std::string &path = "" )
+			: mPath( path ), mBufferSize( 8 * 1024 * 1024 ), mQueueDepth( 8 ), mDirect( true ),
+			  mBackend( DISK_WRITER_AUTO ), mMaxWait( 0.0 ), mExpectedFrames( 0 )
+		{ }
+
+		Options& path( const std::string &path ) { mPath = path; return *this; }
+		// bytes per staging buffer, rounded up to the 4096 byte alignment O_DIRECT needs
+		Options& bufferSize( size_t bytes ) { mBufferSize = bytes; return *this; }
+		// number of staging buffers, which is also the number of writes that can be in flight
+		Options& queueDepth( uint32_t depth ) { mQueueDepth = depth; return *this; }
+		// bypass the page cache, falls back to buffered writes if the file system refuses O_DIRECT
+		Options& direct( bool direct = true ) { mDirect = direct; return *this; }
+		Options& backend( DiskWriterBackend backend ) { mBackend = backend; return *this; }
+		// seconds write() may block waiting for a free buffer before dropping the frame
+		Options& maxWait( double seconds ) { mMaxWait = seconds; return *this; }
+		// index entries allocated up front, the I/O thread adds more ahead of a longer recording
+		Options& expectedFrames( uint64_t count ) { mExpectedFrames = count; return *this; }
+		// cpus and NUMA node of the I/O thread, e.g. the node of the disk controller
+		Options& placement( const ThreadPlacement &placement ) { mPlacement = placement; return *this; }
+
+		const std::string&     getPath() const { return mPath; }
+		size_t                 getBufferSize() const { return mBufferSize; }
+		uint32_t               getQueueDepth() const { return mQueueDepth; }
+		bool                   getDirect() const { return mDirect; }
+		DiskWriterBackend      getBackend() const { return mBackend; }
+		double                 getMaxWait() const { return mMaxWait; }
+		uint64_t               getExpectedFrames() const { return mExpectedFrames; }
+		const ThreadPlacement& getPlacement() const { return mPlacement; }
+
+	  private:
+		std::string            mPath;
+		size_t                 mBufferSize;
+		uint32_t               mQueueDepth;
+		bool                   mDirect;
+		DiskWriterBackend      mBackend;
+		double                 mMaxWait;
+		uint64_t               mExpectedFrames;
+		ThreadPlacement        mPlacement;
+	};
+
+	DiskWriter( const Options &options, const std::string &cameraID, uint64_t timestampFrequency );
+
+	// takes the ID and timestamp frequency from camera and attaches to it
+	DiskWriter( const Options &options, CameraController &camera );
+
+	// writes fileHeader, a CaptureFileHeader followed by headerSize - 64 bytes of extended header, e.g. from
+	// makeCaptureSyncFileHeader()
+	DiskWriter( const Options &options, const std::vector<VmbUchar_t> &fileHeader );
+
+	~DiskWriter();
+
+	// record every raw frame of camera until detach() or close()
+	void attach( CameraController &camera );
+	void detach();
+
+	// returns false if the frame was dropped
+	bool write( const RawFrame &frame );
+	// writes a prepared record, data holds header.imageSize bytes.  Used for records compressed by FrameCompressor.
+	// frame receives the position of the record in the index.
+	bool writeRecord( const CaptureFrameHeader &header, const VmbUchar_t *data, uint64_t *frame = nullptr );
+
+	// writes the remaining data, waits for the I/O thread and truncates the file to the recorded size
+	void close();
+
+	// same as close(), beforeIndex is written between the last record and the index.  Its size must be a
+	// multiple of 8.
+	void close( const std::vector<VmbUchar_t> &beforeIndex );
+
+	const Options& getOptions() const { return mOptions; }
+
+	// backend actually in use
+	DiskWriterBackend getBackend() const { return mBackend; }
+
+	DiskWriterStatistics getStatistics() const;
+
+	// true after a write error, later frames are dropped
+	bool hasFailed() const { return mFailed; }
+
+  private:
+
+	DiskWriter( const DiskWriter & );
+	DiskWriter &operator=( const DiskWriter & );
+
+	struct Buffer {
+		VmbUchar_t  *data;
+		uint64_t    offset;
+		size_t      size;
+	};
+
+	struct IoUring;
+
+	void open( const VmbUchar_t *header, size_t headerSize );
+	void release();
+
+	// copy into the staging buffers, mMutex must be held and enough space must be free
+	void append( const void *data, size_t size );
+	size_t getFreeBytes() const;
+	// allocate index chunks until entries fit, mMutex must be held
+	void reserveIndex( uint64_t entries );
+
+	void runThread();
+	void runIoUring();
+	// blocking write of a complete buffer, false on error
+	bool writeBuffer( const Buffer &buffer, size_t written );
+	void completed( size_t index, bool success );
+	void fail( const std::string &message );
+
+	Options                     mOptions;
+	DiskWriterBackend           mBackend;
+	int                         mFile;
+	bool                        mDirectWrites;          // O_DIRECT is in effect
+	size_t                      mBufferSize;
+	std::vector<Buffer>         mBuffers;
+	std::vector<size_t>         mFree;
+	std::vector<size_t>         mReady;
+	// fixed size chunks that never move, so recording a frame doesn't copy the index
+	std::vector<std::unique_ptr<CaptureIndexEntry[]>> mIndexChunks;
+	uint64_t                    mIndexCount;
+	int                         mCurrent;
+	uint64_t                    mNextOffset;
+	uint64_t                    mSize;
+	uint64_t                    mBuffersQueued;
+	bool                        mStop;
+	std::atomic<bool>           mFailed;
+	DiskWriterStatistics        mStatistics;
+	std::unique_ptr<IoUring>    mIoUring;
+
+	mutable std::mutex          mMutex;
+	std::condition_variable     mReadyCondition;
+	std::condition_variable     mFreeCondition;
+	std::thread                 mThread;
+
+	cinder::signals::Connection mConnection;
+};
+
+} // namespace civimba
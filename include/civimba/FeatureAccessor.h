@@ -26,6 +26,7 @@
 #include "VimbaCPP/Include/VimbaCPP.h"
 
 #include "civimba/BaseException.h"
+#include "civimba/CommandRunner.h"
 #include "civimba/ErrorCodeToMessage.h"
 
 #include <functional>
@@ -119,13 +120,15 @@ public:
     }
 
     //! *** Commands
-    static void runCommand(const AVT::VmbAPI::FeaturePtr &featurePtr)
+    // Runs the command and waits up to timeout seconds for it to be done (see CommandRunner), 0 only starts it.
+    // Returns the seconds it took, throws with VmbErrorTimeout if it did not finish in time.
+    static double runCommand(const AVT::VmbAPI::FeaturePtr &featurePtr, double timeout = 5.0)
     {
-        VmbErrorType res = featurePtr->RunCommand();
-        if( VmbErrorSuccess == res ) {
-            return;
+        CommandResult result = CommandRunner::run( featurePtr, CommandRunner::Options().timeout( timeout ) );
+        if( VmbErrorSuccess == result.error ) {
+            return result.seconds;
         }
-        throw FeatureAccessorException( __FUNCTION__, AVT::VmbAPI::ErrorCodeToMessage( res ), res );
+        throw FeatureAccessorException( __FUNCTION__, AVT::VmbAPI::ErrorCodeToMessage( result.error ), result.error );
     }
 
     static bool isCommandDone(const AVT::VmbAPI::FeaturePtr &featurePtr)
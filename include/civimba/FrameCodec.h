@@ -0,0 +1,82 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "VimbaCPP/Include/VimbaCPP.h"
+
+#include "civimba/BaseException.h"
+#include "civimba/RawFrame.h"
+
+namespace civimba {
+
+// Fast lossless codec for raw sensor frames.
+//
+// Mono and Bayer frames with 8 bit, 16 bit (10 to 16 significant bits) and GigE 12 bit packed samples are coded
+// predictively: each sample is predicted from the nearest sample of the same color above it (two rows up in Bayer
+// frames), the first rows of a band from the left, and the residuals are zigzag mapped and bit packed in blocks of
+// 32 with one bit width per block.  Other formats, and frames that would not get smaller, are stored.
+//
+// The frame is split into horizontal bands that are coded independently, so both encode() and decode() can spread
+// the bands over threads.
+class FrameCodec {
+  public:
+
+	class FrameCodecException : public BaseException
+	{
+	  public:
+		FrameCodecException( const char *const &fun, const char *const &msg,
+		                     VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		FrameCodecException( const char *const &fun, const std::string &msg,
+		                     VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~FrameCodecException() throw()
+		{ }
+	};
+
+	static const uint32_t DEFAULT_BANDS = 16;
+
+	// true if frames of pixelFormat are coded predictively rather than stored
+	static bool isSupported( VmbPixelFormatType pixelFormat );
+
+	// Encodes the image data of frame into encoded and returns the encoded size.
+	static size_t encode( const RawFrame &frame, std::vector<VmbUchar_t> &encoded, unsigned threads = 1,
+	                      uint32_t bands = DEFAULT_BANDS );
+
+	// Decodes data written by encode() into decoded and returns the original image size.  Throws
+	// FrameCodecException if the data is damaged.
+	static size_t decode( const VmbUchar_t *data, size_t size, std::vector<VmbUchar_t> &decoded, unsigned threads = 1 );
+
+	// true if the encoded data was stored uncompressed
+	static bool isStored( const VmbUchar_t *data, size_t size );
+};
+
+} // namespace civimba
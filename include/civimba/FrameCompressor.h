@@ -0,0 +1,165 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cinder/Signals.h"
+
+#include "civimba/BaseException.h"
+#include "civimba/CameraController.h"
+#include "civimba/CaptureFile.h"
+#include "civimba/FrameCodec.h"
+#include "civimba/ThreadPlacement.h"
+
+namespace civimba {
+
+typedef std::shared_ptr<class FrameCompressor> FrameCompressorRef;
+
+// counters kept by FrameCompressor since it was created
+struct FrameCompressorStatistics {
+	uint64_t framesQueued;
+	uint64_t framesDropped;         // frames that arrived while every job slot was busy
+	uint64_t framesCompressed;      // frames delivered as compressed records
+	uint64_t framesStored;          // frames delivered uncompressed because FrameCodec could not shrink them
+	uint64_t bytesIn;               // image bytes of the delivered frames
+	uint64_t bytesOut;              // image bytes of the delivered records
+};
+
+// Compresses raw frames with FrameCodec on a pool of worker threads and hands the finished capture records to a
+// callback, normally CaptureWriter::writeRecord(), DiskWriter::writeRecord() or MappedRecorder::writeRecord().
+//
+// write() only copies the frame into a free job slot, so the acquisition thread never waits for compression.  When
+// all Options::queueDepth() slots are busy the frame is dropped and counted.  Workers compress whole frames in
+// parallel, records are delivered one at a time in the order the frames arrived, on a worker thread.
+class FrameCompressor {
+  public:
+
+	class FrameCompressorException : public BaseException
+	{
+	  public:
+		FrameCompressorException( const char *const &fun, const char *const &msg,
+		                          VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		FrameCompressorException( const char *const &fun, const std::string &msg,
+		                          VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~FrameCompressorException() throw()
+		{ }
+	};
+
+	// data holds header.imageSize bytes and is only valid during the call
+	typedef std::function<void( const CaptureFrameHeader &header, const VmbUchar_t *data )> RecordCallback;
+
+	class Options {
+	  public:
+		Options()
+			: mThreads( 2 ), mQueueDepth( 8 ), mBands( FrameCodec::DEFAULT_BANDS )
+		{ }
+
+		// worker threads, each compresses one frame at a time
+		Options& threads( unsigned threads ) { mThreads = threads; return *this; }
+		// frames that can be queued or in compression before write() drops
+		Options& queueDepth( uint32_t depth ) { mQueueDepth = depth; return *this; }
+		// independently coded bands per frame, more bands allow more decode threads
+		Options& bands( uint32_t bands ) { mBands = bands; return *this; }
+		// cpus and NUMA node of the worker threads
+		Options& placement( const ThreadPlacement &placement ) { mPlacement = placement; return *this; }
+
+		unsigned                getThreads() const { return mThreads; }
+		uint32_t                getQueueDepth() const { return mQueueDepth; }
+		uint32_t                getBands() const { return mBands; }
+		const ThreadPlacement&  getPlacement() const { return mPlacement; }
+
+	  private:
+		unsigned        mThreads;
+		uint32_t        mQueueDepth;
+		uint32_t        mBands;
+		ThreadPlacement mPlacement;
+	};
+
+	FrameCompressor( const Options &options, const RecordCallback &callback );
+	~FrameCompressor();
+
+	// compress every raw frame of camera until detach()
+	void attach( CameraController &camera );
+	void detach();
+
+	// returns false if the frame was dropped
+	bool write( const RawFrame &frame );
+
+	// waits until every queued frame has been delivered
+	void flush();
+
+	const Options& getOptions() const { return mOptions; }
+
+	FrameCompressorStatistics getStatistics() const;
+
+  private:
+
+	FrameCompressor( const FrameCompressor & );
+	FrameCompressor &operator=( const FrameCompressor & );
+
+	struct Job {
+		CaptureFrameHeader          header;
+		std::vector<VmbUchar_t>     raw;
+		std::vector<VmbUchar_t>     encoded;
+		bool                        done;
+	};
+
+	void run();
+	void deliver();
+	// hands the oldest job to the callback if it is done, mDeliveryMutex must be held
+	bool deliverNext();
+
+	Options                     mOptions;
+	RecordCallback              mCallback;
+	std::vector<std::unique_ptr<Job>> mJobs;
+	std::vector<Job*>           mFree;
+	std::deque<Job*>            mPending;       // waiting for a worker
+	std::deque<Job*>            mInFlight;      // queued, in compression or done, in arrival order
+	bool                        mStop;
+	FrameCompressorStatistics   mStatistics;
+
+	mutable std::mutex          mMutex;
+	std::condition_variable     mPendingCondition;
+	std::condition_variable     mFreeCondition;
+	std::mutex                  mDeliveryMutex;
+	std::vector<std::thread>    mThreads;
+
+	cinder::signals::Connection mConnection;
+};
+
+} // namespace civimba
@@ -0,0 +1,184 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cinder/Signals.h"
+
+#include "civimba/BaseException.h"
+#include "civimba/CameraController.h"
+#include "civimba/CaptureFile.h"
+
+namespace civimba {
+
+typedef std::shared_ptr<class FrameHistory> FrameHistoryRef;
+
+// Keeps the most recent raw frames of a camera in preallocated memory so the frames leading up to an event can be
+// saved after the fact.  The history is limited by frame count and / or bytes, the oldest frames are overwritten.
+//
+// trigger() swaps the current ring for an empty spare in constant time, so acquisition continues right away, and a
+// background thread writes the frozen frames to a capture file.  While all spares are still being written further
+// triggers are rejected.  Memory is allocated up front for Options::frameSize(), or the camera's PayloadSize on
+// attach(), so the acquisition thread never allocates.  Without either it is sized for the first frame.
+class FrameHistory {
+  public:
+
+	class FrameHistoryException : public BaseException
+	{
+	  public:
+		FrameHistoryException( const char *const &fun, const char *const &msg,
+		                       VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		FrameHistoryException( const char *const &fun, const std::string &msg,
+		                       VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~FrameHistoryException() throw()
+		{ }
+	};
+
+	class Options {
+	  public:
+		Options()
+			: mMaxFrames( 120 ), mMaxBytes( 0 ), mFrameSize( 0 ), mSpares( 1 )
+		{ }
+
+		// frames to keep, 0 limits the history by bytes only
+		Options& maxFrames( size_t frames ) { mMaxFrames = frames; return *this; }
+		// bytes of image data to keep, 0 sizes the ring for maxFrames frames of frameSize bytes
+		Options& maxBytes( uint64_t bytes ) { mMaxBytes = bytes; return *this; }
+		// bytes of the largest frame, 0 takes the PayloadSize of the attached camera or the size of the first frame
+		Options& frameSize( size_t bytes ) { mFrameSize = bytes; return *this; }
+		// rings that can be written in the background at the same time, each costs the full history memory
+		Options& spares( uint32_t spares ) { mSpares = spares; return *this; }
+
+		size_t      getMaxFrames() const { return mMaxFrames; }
+		uint64_t    getMaxBytes() const { return mMaxBytes; }
+		size_t      getFrameSize() const { return mFrameSize; }
+		uint32_t    getSpares() const { return mSpares; }
+
+	  private:
+		size_t      mMaxFrames;
+		uint64_t    mMaxBytes;
+		size_t      mFrameSize;
+		uint32_t    mSpares;
+	};
+
+	// called on the writer thread once a dump is complete
+	typedef std::function<void( const std::string &path, size_t frameCount, bool success )> DumpCallback;
+
+	FrameHistory( const Options &options, const std::string &cameraID, uint64_t timestampFrequency );
+
+	// takes the ID and timestamp frequency from camera and attaches to it
+	FrameHistory( const Options &options, CameraController &camera );
+
+	// writes the pending dumps before returning
+	~FrameHistory();
+
+	// keep every raw frame of camera until detach(), sizes the history for its PayloadSize unless already sized
+	void attach( CameraController &camera );
+	void detach();
+
+	// returns false if the frame is larger than the whole history
+	bool write( const RawFrame &frame );
+
+	// Freezes the history and writes it to path in the background, the history starts over empty.  Returns false if
+	// no spare ring is free.
+	bool trigger( const std::string &path, DumpCallback callback = DumpCallback() );
+
+	// blocks until all triggered dumps are written
+	void waitForDumps();
+
+	const Options& getOptions() const { return mOptions; }
+
+	// frames currently held
+	size_t getFrameCount() const;
+
+	uint64_t getFramesDropped() const;
+	uint64_t getTriggersRejected() const;
+
+  private:
+
+	FrameHistory( const FrameHistory & );
+	FrameHistory &operator=( const FrameHistory & );
+
+	struct Slot {
+		CaptureFrameHeader  header;
+		size_t              offset;
+	};
+
+	struct Ring {
+		Ring() : first( 0 ), count( 0 ), head( 0 ) { }
+
+		void clear() { first = count = head = 0; }
+		void popFront() { first = ( first + 1 ) % slots.size(); --count; }
+		const Slot& front() const { return slots[first]; }
+
+		std::vector<VmbUchar_t> data;
+		std::vector<Slot>       slots;
+		size_t                  first;
+		size_t                  count;
+		size_t                  head;
+		std::string             path;
+		DumpCallback            callback;
+	};
+
+	void setup();
+	void reserve( size_t frameSize );
+	void allocate( Ring &ring ) const;
+	void run();
+
+	Options                             mOptions;
+	std::string                         mCameraID;
+	uint64_t                            mTimestampFrequency;
+
+	size_t                              mCapacity;      // bytes per ring, 0 until the frame size is known
+	size_t                              mSlotCount;
+	std::vector<std::unique_ptr<Ring>>  mRings;
+	Ring                                *mActive;
+	std::vector<Ring*>                  mSpares;
+	std::vector<Ring*>                  mPending;
+	uint64_t                            mFramesDropped;
+	uint64_t                            mTriggersRejected;
+	bool                                mStop;
+
+	mutable std::mutex                  mMutex;
+	std::condition_variable             mPendingCondition;
+	std::condition_variable             mDoneCondition;
+	std::thread                         mThread;
+
+	cinder::signals::Connection         mConnection;
+};
+
+} // namespace civimba
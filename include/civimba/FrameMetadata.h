@@ -0,0 +1,135 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <cstdint>
+
+#include "VimbaCPP/Include/VimbaCPP.h"
+
+namespace civimba {
+
+// Chunk data (ancillary data) follows the image in the Vimba frame buffer when ChunkModeActive is set.  GigE Vision
+// chunks are laid out back to front: each chunk's data is followed by a big endian chunk ID and data length, so the
+// buffer is walked from its end.
+//
+// AVT GigE cameras send one frame information chunk (AVT_FRAME_INFO_CHUNK_ID) holding, big endian:
+//
+//   0   acquisition count                  uint32
+//   4   exposure time in microseconds      uint32
+//   8   gain in dB                         uint32
+//   12  sync in (line) levels              uint16, one bit per input
+//   14  sync out levels                    uint16, one bit per output
+
+static const uint32_t AVT_FRAME_INFO_CHUNK_ID = 1000;
+
+typedef enum {
+	FRAME_METADATA_ACQUISITION_COUNT    = 1 << 0,
+	FRAME_METADATA_EXPOSURE_TIME        = 1 << 1,
+	FRAME_METADATA_GAIN                 = 1 << 2,
+	FRAME_METADATA_LINE_STATUS          = 1 << 3,
+	FRAME_METADATA_SYNC_OUT             = 1 << 4
+} FrameMetadataField;
+
+// Per frame values parsed from chunk data.  Plain data, copied with every RawFrame.
+struct FrameMetadata {
+	FrameMetadata()
+		: fields( 0 ), acquisitionCount( 0 ), exposureTime( 0 ), gain( 0 ), lineStatus( 0 ), syncOutLevels( 0 )
+	{ }
+
+	bool has( FrameMetadataField field ) const { return 0 != ( fields & field ); }
+
+	uint32_t    fields;                 // FrameMetadataField bits of the values that were present
+	uint32_t    acquisitionCount;
+	uint32_t    exposureTime;           // microseconds
+	uint32_t    gain;                   // dB
+	uint16_t    lineStatus;             // one bit per input line
+	uint16_t    syncOutLevels;          // one bit per output line
+};
+
+inline uint32_t readChunkUint32( const VmbUchar_t *data )
+{
+	return ( static_cast<uint32_t>( data[0] ) << 24 ) | ( static_cast<uint32_t>( data[1] ) << 16 )
+	       | ( static_cast<uint32_t>( data[2] ) << 8 ) | data[3];
+}
+
+inline uint16_t readChunkUint16( const VmbUchar_t *data )
+{
+	return static_cast<uint16_t>(( data[0] << 8 ) | data[1] );
+}
+
+// Finds chunk chunkID in the chunk data of a frame.  chunk points into data, nothing is copied.  Returns false if
+// the chunk is missing or the chunk data is damaged.
+inline bool findChunk( const VmbUchar_t *data, uint32_t size, uint32_t chunkID, const VmbUchar_t *&chunk, uint32_t &chunkSize )
+{
+	uint32_t end = data ? size : 0;
+	while( end >= 8 ) {
+		const uint32_t id = readChunkUint32( data + end - 8 );
+		const uint32_t length = readChunkUint32( data + end - 4 );
+		if( length > end - 8 ) {
+			return false;
+		}
+		end -= 8 + length;
+		if( id == chunkID ) {
+			chunk = data + end;
+			chunkSize = length;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Parses the values civimba knows from the chunk data of a frame, without allocating.  Returns false if none were
+// found.
+inline bool parseFrameMetadata( const VmbUchar_t *data, uint32_t size, FrameMetadata &metadata )
+{
+	metadata = FrameMetadata();
+	const VmbUchar_t *chunk = nullptr;
+	uint32_t chunkSize = 0;
+	if( ! findChunk( data, size, AVT_FRAME_INFO_CHUNK_ID, chunk, chunkSize )) {
+		return false;
+	}
+
+	if( chunkSize >= 4 ) {
+		metadata.acquisitionCount = readChunkUint32( chunk );
+		metadata.fields |= FRAME_METADATA_ACQUISITION_COUNT;
+	}
+	if( chunkSize >= 8 ) {
+		metadata.exposureTime = readChunkUint32( chunk + 4 );
+		metadata.fields |= FRAME_METADATA_EXPOSURE_TIME;
+	}
+	if( chunkSize >= 12 ) {
+		metadata.gain = readChunkUint32( chunk + 8 );
+		metadata.fields |= FRAME_METADATA_GAIN;
+	}
+	if( chunkSize >= 14 ) {
+		metadata.lineStatus = readChunkUint16( chunk + 12 );
+		metadata.fields |= FRAME_METADATA_LINE_STATUS;
+	}
+	if( chunkSize >= 16 ) {
+		metadata.syncOutLevels = readChunkUint16( chunk + 14 );
+		metadata.fields |= FRAME_METADATA_SYNC_OUT;
+	}
+	return 0 != metadata.fields;
+}
+
+} // namespace civimba
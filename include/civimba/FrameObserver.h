@@ -23,6 +23,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <queue>
 #include <string>
 #include <functional>
@@ -30,6 +31,7 @@
 
 #include "VimbaCPP/Include/VimbaCPP.h"
 
+#include "civimba/RawFrame.h"
 #include "civimba/Types.h"
 #include "cinder/Surface.h"
 
@@ -39,6 +41,7 @@ class FrameObserver : virtual public AVT::VmbAPI::IFrameObserver {
 public:
 
 	typedef std::function<void( cinder::Surface8uRef & )> FrameCallback;
+	typedef std::function<void( const RawFrame & )> RawFrameCallback;
 
 	// We pass the camera that will deliver the frames to the constructor
 	FrameObserver( AVT::VmbAPI::CameraPtr camera,
@@ -46,21 +49,38 @@ public:
 	               FrameLoggingInfo frameInfo,
 	               ColorProcessing colorProcessing );
 
+	// For frame sources that are not Vimba cameras, frames are pushed through frameReceived( RawFrame )
+	FrameObserver( const std::string &cameraID,
+	               FrameCallback callback,
+	               FrameLoggingInfo frameInfo,
+	               ColorProcessing colorProcessing );
+
 	// This is our callback routine that will be executed on every received frame
 	virtual void FrameReceived( const AVT::VmbAPI::FramePtr frame );
 
+	// Logs, transforms and delivers a frame.  The buffer only has to stay valid for the duration of the call.
+	void frameReceived( const RawFrame &frame );
+
 	void setColorProcessing( ColorProcessing cp ) { mColorProcessing = cp; }
 	void setFrameLogging( FrameLoggingInfo logging ) { mFrameLogging = logging; }
 
+	// called with every frame before it is transformed, set before acquisition starts
+	void setRawFrameCallback( RawFrameCallback callback ) { mRawFrameCallback = callback; }
+
+	// forgets the last frame ID and time, for a stream restarted with the same observer.  Not while frames arrive.
+	void restart();
+
+	FrameStatistics getStatistics() const;
+
 private:
 
 	double getTime();
 
-	void printFrameSizeFormat( const AVT::VmbAPI::FramePtr &pFrame, std::stringstream &ss );
+	void printFrameSizeFormat( const RawFrame &frame, std::stringstream &ss );
 
 	void printFrameStatus( VmbFrameStatusType eFrameStatus, std::stringstream &ss );
 
-	void logFrameInfos( const AVT::VmbAPI::FramePtr &pFrame );
+	void logFrameInfos( const RawFrame &frame );
 
 	template<typename T>
 	class ValueWithState {
@@ -104,6 +124,13 @@ private:
 	ValueWithState<VmbUint64_t> mFrameID;
 	std::string                 mCameraID;
 	FrameCallback               mFrameCallback;
+	RawFrameCallback            mRawFrameCallback;
+
+	std::atomic<uint64_t>       mFramesReceived;
+	std::atomic<uint64_t>       mFramesDelivered;
+	std::atomic<uint64_t>       mFramesIncomplete;
+	std::atomic<uint64_t>       mFramesMissing;
+	std::atomic<uint64_t>       mTransformErrors;
 };
 
 } // namespace civimba
\ No newline at end of file
@@ -0,0 +1,219 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "cinder/Signals.h"
+#include "cinder/Surface.h"
+
+#include "civimba/BaseException.h"
+#include "civimba/CameraController.h"
+#include "civimba/ClockMapper.h"
+
+namespace civimba {
+
+typedef std::shared_ptr<class FrameSetAssembler> FrameSetAssemblerRef;
+
+typedef enum {
+	FRAME_SET_MATCH_FRAME_ID,     // frames with the same frame ID belong together, for hardware triggered rigs
+	FRAME_SET_MATCH_TIMESTAMP     // frames whose host timestamps lie within Options::tolerance() belong together
+} FrameSetMatch;
+
+struct FrameSetEntry {
+	FrameSetEntry() : frameID( 0 ), frameIDValid( false ), timestamp( 0 ) { }
+
+	cinder::Surface8uRef    surface;        // null if the camera is missing from the set
+	uint64_t                frameID;
+	bool                    frameIDValid;
+	uint64_t                timestamp;      // host nanoseconds, see ClockMapper
+};
+
+struct FrameSet {
+	FrameSet() : key( 0 ), complete( false ) { }
+
+	uint64_t                    key;        // frame ID or host timestamp of the first frame, see FrameSetMatch
+	bool                        complete;
+	std::vector<FrameSetEntry>  frames;     // one per camera, in the order passed to the constructor
+};
+
+struct FrameSetStatistics {
+	uint64_t setsComplete;
+	uint64_t setsIncomplete;        // expired by Options::timeout() or Options::maxPending()
+	uint64_t setsDropped;           // not queued because the consumer fell behind
+	uint64_t framesLate;            // arrived after their set was emitted
+	uint64_t framesDuplicate;       // a second frame of a camera for the same set
+	uint64_t framesUnmatched;       // no valid frame ID in FRAME_SET_MATCH_FRAME_ID mode
+	uint64_t restarts;              // frame IDs that started over in FRAME_SET_MATCH_FRAME_ID mode
+};
+
+// Assembles the frames of several cameras into sets, e.g. for stereo or array rigs.  Each camera's frames are taken
+// from its new frame signal, with frame ID and timestamp from the raw frame signal of the same acquisition thread.
+// Frames are matched under a short lock; sets are handed to the consumer through a single producer, single consumer
+// ring, so tryPop() never blocks the acquisition threads.
+//
+// Frame IDs only match if the cameras started acquisition on the same trigger.  Timestamps are mapped to the host
+// clock per camera, so cameras without a common time base can still be matched by time.
+class FrameSetAssembler {
+  public:
+
+	class FrameSetAssemblerException : public BaseException
+	{
+	  public:
+		FrameSetAssemblerException( const char *const &fun, const char *const &msg,
+		                            VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		FrameSetAssemblerException( const char *const &fun, const std::string &msg,
+		                            VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~FrameSetAssemblerException() throw()
+		{ }
+	};
+
+	class Options {
+	  public:
+		Options()
+			: mMatch( FRAME_SET_MATCH_TIMESTAMP ), mTolerance( 0.002 ), mTimeout( 0.5 ), mMaxPending( 16 ),
+			  mQueueDepth( 8 ), mEmitIncomplete( true ), mClockWindow( 10.0 )
+		{ }
+
+		Options& match( FrameSetMatch match ) { mMatch = match; return *this; }
+		// seconds between frames of the same set in FRAME_SET_MATCH_TIMESTAMP mode
+		Options& tolerance( double seconds ) { mTolerance = seconds; return *this; }
+		// seconds a set waits for its missing frames
+		Options& timeout( double seconds ) { mTimeout = seconds; return *this; }
+		// sets waiting at the same time, the oldest expires beyond this
+		Options& maxPending( uint32_t sets ) { mMaxPending = sets; return *this; }
+		// sets queued for the consumer
+		Options& queueDepth( uint32_t sets ) { mQueueDepth = sets; return *this; }
+		// queue expired sets with their missing frames null, otherwise only count them
+		Options& emitIncomplete( bool emit ) { mEmitIncomplete = emit; return *this; }
+		// seconds over which the offset of a camera clock to the host clock is estimated
+		Options& clockWindow( double seconds ) { mClockWindow = seconds; return *this; }
+
+		FrameSetMatch   getMatch() const { return mMatch; }
+		double          getTolerance() const { return mTolerance; }
+		double          getTimeout() const { return mTimeout; }
+		uint32_t        getMaxPending() const { return mMaxPending; }
+		uint32_t        getQueueDepth() const { return mQueueDepth; }
+		bool            getEmitIncomplete() const { return mEmitIncomplete; }
+		double          getClockWindow() const { return mClockWindow; }
+
+	  private:
+		FrameSetMatch   mMatch;
+		double          mTolerance;
+		double          mTimeout;
+		uint32_t        mMaxPending;
+		uint32_t        mQueueDepth;
+		bool            mEmitIncomplete;
+		double          mClockWindow;
+	};
+
+	// one camera per timestamp frequency, frames are passed to addFrame().  A frequency of 0 matches by arrival time.
+	FrameSetAssembler( const Options &options, const std::vector<uint64_t> &timestampFrequencies );
+
+	// one camera per entry, attached to the cameras
+	FrameSetAssembler( const Options &options, const std::vector<CameraControllerRef> &cameras );
+
+	~FrameSetAssembler();
+
+	// assemble the frames of camera as its index until detach()
+	void attach( size_t index, CameraController &camera );
+	void detach();
+
+	// Adds a frame of camera index, timestamp in camera ticks and arrival in ClockMapper::getHostTime()
+	// nanoseconds.  Safe to call from one thread per camera.
+	void addFrame( size_t index, const cinder::Surface8uRef &surface, uint64_t frameID, bool frameIDValid,
+	               uint64_t timestamp, uint64_t arrival );
+
+	// Takes the next set off the queue, returns false if there is none.  Lock free, call from one consumer thread.
+	bool tryPop( FrameSet &set );
+
+	// Expires all pending sets and forgets the last key, call it when acquisition stopped or restarted.  Frame IDs
+	// that jump far back are taken as a restart as well.
+	void flush();
+
+	size_t getCameraCount() const { return mCameras.size(); }
+
+	FrameSetStatistics getStatistics() const;
+
+	const Options& getOptions() const { return mOptions; }
+
+  private:
+
+	FrameSetAssembler( const FrameSetAssembler & );
+	FrameSetAssembler &operator=( const FrameSetAssembler & );
+
+	struct Camera {
+		Camera() : frameID( 0 ), frameIDValid( false ), timestamp( 0 ), arrival( 0 ) { }
+
+		cinder::signals::Connection rawConnection;
+		cinder::signals::Connection frameConnection;
+		ClockMapper                 clock;
+		// raw frame of the surface that follows, only touched by the camera's acquisition thread
+		uint64_t                    frameID;
+		bool                        frameIDValid;
+		uint64_t                    timestamp;
+		uint64_t                    arrival;
+	};
+
+	struct PendingSet {
+		FrameSet    set;
+		uint64_t    created;
+		size_t      count;
+	};
+
+	void init( const std::vector<uint64_t> &timestampFrequencies );
+	void expire( uint64_t now );
+	void reset();
+	void finish( PendingSet &pending );
+	void push( FrameSet &set );
+
+	Options                     mOptions;
+	uint64_t                    mTolerance;
+	uint64_t                    mTimeout;
+	std::vector<Camera>         mCameras;
+
+	mutable std::mutex          mMutex;
+	std::deque<PendingSet>      mPending;
+	bool                        mEmitted;
+	uint64_t                    mLastKey;
+	FrameSetStatistics          mStats;
+
+	// single producer (under mMutex), single consumer ring
+	std::vector<FrameSet>       mQueue;
+	std::atomic<size_t>         mHead;
+	std::atomic<size_t>         mTail;
+};
+
+} // namespace civimba
@@ -0,0 +1,62 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "civimba/RawFrame.h"
+
+namespace civimba {
+
+typedef std::shared_ptr<class FrameSource> FrameSourceRef;
+
+// A producer of raw frames that can stand in for a Vimba camera inside CameraController.
+// Frames are pushed from the source's own thread, the same way Vimba calls FrameReceived.
+class FrameSource {
+  public:
+
+	typedef std::function<void( const RawFrame & )> RawFrameCallback;
+
+	virtual ~FrameSource() { }
+
+	// numberFrames is the number of buffers in flight, as with StartContinuousImageAcquisition
+	virtual void start( uint32_t numberFrames, RawFrameCallback callback ) = 0;
+
+	virtual void stop() = 0;
+
+	virtual bool isRunning() const = 0;
+
+	virtual std::string getID() const = 0;
+
+	virtual std::string getName() const = 0;
+
+	virtual std::string getModel() const = 0;
+
+	// ticks per second of RawFrame::timestamp
+	virtual uint64_t getTimestampFrequency() const = 0;
+};
+
+} // namespace civimba
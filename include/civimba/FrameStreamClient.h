@@ -0,0 +1,94 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "civimba/BaseException.h"
+#include "civimba/CaptureFile.h"
+#include "civimba/RawFrame.h"
+
+namespace civimba {
+
+typedef std::shared_ptr<class FrameStreamClient> FrameStreamClientRef;
+
+// Receives the frames of a FrameStreamServer in another process.  Frames arrive in full, the server skips the ones
+// that were replaced by a newer frame while the client was still reading, which shows as gaps in the frame IDs.
+// The client has no dependencies beyond the Vimba headers and can be used without Cinder.
+class FrameStreamClient {
+  public:
+
+	class FrameStreamClientException : public BaseException
+	{
+	  public:
+		FrameStreamClientException( const char *const &fun, const char *const &msg,
+		                            VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		FrameStreamClientException( const char *const &fun, const std::string &msg,
+		                            VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~FrameStreamClientException() throw()
+		{ }
+	};
+
+	// Connects to the server listening on path and reads the stream header, waiting up to timeout seconds for it.
+	// Throws FrameStreamClientException with VmbErrorNotFound if no server is listening.
+	FrameStreamClient( const std::string &path, double timeout = 1.0 );
+	~FrameStreamClient();
+
+	// camera ID and timestamp frequency of the streamed camera
+	const CaptureFileHeader& getStreamHeader() const { return mStreamHeader; }
+
+	// Waits up to timeout seconds for the next frame.  The view stays valid until the next call.  Returns false on
+	// timeout or once the server is gone, see isConnected().
+	bool readNext( RawFrame &frame, double timeout );
+
+	bool isConnected() const { return mSocket >= 0; }
+
+	uint64_t getFramesReceived() const { return mFramesReceived; }
+
+  private:
+
+	FrameStreamClient( const FrameStreamClient & );
+	FrameStreamClient &operator=( const FrameStreamClient & );
+
+	// reads until mReceived reaches size, false on timeout or disconnect
+	bool receive( VmbUchar_t *data, size_t size, double deadline );
+	void disconnect();
+
+	int                     mSocket;
+	CaptureFileHeader       mStreamHeader;
+	CaptureFrameHeader      mFrameHeader;
+	std::vector<VmbUchar_t> mData;
+	size_t                  mReceived;      // bytes of the current record received, a timeout resumes from here
+	uint64_t                mFramesReceived;
+};
+
+} // namespace civimba
@@ -0,0 +1,178 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cinder/Signals.h"
+
+#include "civimba/BaseException.h"
+#include "civimba/CameraController.h"
+#include "civimba/CaptureFile.h"
+
+namespace civimba {
+
+typedef std::shared_ptr<class FrameStreamServer> FrameStreamServerRef;
+
+// counters kept by FrameStreamServer since it was opened
+struct FrameStreamStatistics {
+	uint64_t framesPublished;       // frames copied for the clients
+	uint64_t framesDropped;         // frames that found no free buffer, every buffer was still being sent
+	uint64_t framesSent;            // frames completely sent, summed over the clients
+	uint64_t framesSkipped;         // frames a client never got because a newer one was ready when it was done
+	uint64_t clientsAccepted;
+	uint64_t clientsRejected;       // connections refused because maxClients were connected
+	uint64_t clientsDisconnected;
+};
+
+// Streams the raw frames of a camera to other processes on the same machine through a UNIX domain socket, read
+// with FrameStreamClient.  The stream uses the capture file format (see CaptureFile.h): a CaptureFileHeader when a
+// client connects, then one padded frame record per frame, without an index.
+//
+// write() copies the frame into a free buffer and returns, it never waits for a client.  An I/O thread sends the
+// buffers with non-blocking sendmsg() calls that gather header, image and padding without further copies.  Every
+// client gets the newest frame once it has received the previous one, so a slow client skips frames without
+// holding back the others.  Frames are only copied while a client is connected.
+class FrameStreamServer {
+  public:
+
+	class FrameStreamServerException : public BaseException
+	{
+	  public:
+		FrameStreamServerException( const char *const &fun, const char *const &msg,
+		                            VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		FrameStreamServerException( const char *const &fun, const std::string &msg,
+		                            VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~FrameStreamServerException() throw()
+		{ }
+	};
+
+	class Options {
+	  public:
+		Options( const std::string &path = "" )
+			: mPath( path ), mMaxClients( 8 ), mSendBufferSize( 0 )
+		{ }
+
+		// socket path, a stale socket at path is replaced
+		Options& path( const std::string &path ) { mPath = path; return *this; }
+		// further connections are closed right away
+		Options& maxClients( uint32_t count ) { mMaxClients = count; return *this; }
+		// SO_SNDBUF of the client sockets in bytes, 0 keeps the system default.  Larger buffers mean fewer
+		// wake ups of the I/O thread per frame.
+		Options& sendBufferSize( size_t bytes ) { mSendBufferSize = bytes; return *this; }
+
+		const std::string&  getPath() const { return mPath; }
+		uint32_t            getMaxClients() const { return mMaxClients; }
+		size_t              getSendBufferSize() const { return mSendBufferSize; }
+
+	  private:
+		std::string mPath;
+		uint32_t    mMaxClients;
+		size_t      mSendBufferSize;
+	};
+
+	FrameStreamServer( const Options &options, const std::string &cameraID, uint64_t timestampFrequency );
+
+	// takes the ID and timestamp frequency from camera and attaches to it
+	FrameStreamServer( const Options &options, CameraController &camera );
+
+	~FrameStreamServer();
+
+	// stream every raw frame of camera until detach() or close()
+	void attach( CameraController &camera );
+	void detach();
+
+	// returns false if the frame was dropped, true also when no client is connected
+	bool write( const RawFrame &frame );
+
+	// disconnects the clients, stops the I/O thread and removes the socket
+	void close();
+
+	const Options& getOptions() const { return mOptions; }
+
+	size_t getClientCount() const { return mClientCount; }
+
+	FrameStreamStatistics getStatistics() const;
+
+  private:
+
+	FrameStreamServer( const FrameStreamServer & );
+	FrameStreamServer &operator=( const FrameStreamServer & );
+
+	struct Frame {
+		uint64_t                sequence;
+		CaptureFrameHeader      header;
+		std::vector<VmbUchar_t> data;
+	};
+
+	struct Client {
+		int                     socket;
+		size_t                  helloSent;      // bytes of mHello sent
+		std::shared_ptr<Frame>  frame;          // frame being sent, null when idle
+		uint64_t                sent;           // bytes of the frame record sent
+		uint64_t                lastSequence;
+	};
+
+	void open( const std::string &cameraID, uint64_t timestampFrequency );
+	void release();
+	void wake();
+
+	void run();
+	void accept();
+	// sends as much as the socket takes, false if the client has to be disconnected
+	bool send( Client &client );
+
+	Options                     mOptions;
+	int                         mListenSocket;
+	int                         mWakePipe[2];
+	std::atomic<bool>           mWakePending;
+	std::atomic<bool>           mStop;
+	bool                        mClosed;
+	std::vector<VmbUchar_t>     mHello;         // capture file header sent to every new client
+
+	std::vector<Client>         mClients;       // only used by the I/O thread
+	std::atomic<size_t>         mClientCount;
+
+	mutable std::mutex          mMutex;
+	std::vector<std::shared_ptr<Frame>> mBuffers;
+	std::shared_ptr<Frame>      mLatest;
+	uint64_t                    mSequence;
+	FrameStreamStatistics       mStatistics;
+
+	std::thread                 mThread;
+	cinder::signals::Connection mConnection;
+};
+
+} // namespace civimba
@@ -0,0 +1,112 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "civimba/BaseException.h"
+#include "civimba/CaptureFile.h"
+#include "civimba/RawFrame.h"
+
+namespace civimba {
+
+typedef std::shared_ptr<class MappedCaptureReader> MappedCaptureReaderRef;
+
+// Random access reader for capture files.  The file is memory mapped and frames are returned as RawFrame views
+// into the mapping, nothing is copied.  Frames are looked up through the trailing index, or through an index built
+// by scanning the records when the file has none (a crashed recording, a ring file).
+//
+// Looking up a frame ID is O(1) while IDs increase without gaps and O(log n) otherwise, timestamps are O(log n).
+// RawFrames returned by getFrame() stay valid as long as the reader.
+class MappedCaptureReader {
+  public:
+
+	static const size_t npos;
+
+	MappedCaptureReader( const std::string &path );
+	~MappedCaptureReader();
+
+	const CaptureFileHeader& getFileHeader() const { return *reinterpret_cast<const CaptureFileHeader*>( mData ); }
+
+	bool isRing() const { return 0 != ( getFileHeader().flags & CAPTURE_FILE_FLAG_RING ); }
+
+	// true if the file had no valid index and it was rebuilt by scanning the records
+	bool wasIndexRebuilt() const { return mIndexRebuilt; }
+
+	size_t getFrameCount() const { return mEntryCount; }
+
+	const CaptureIndexEntry& getIndexEntry( size_t index ) const { return mEntries[index]; }
+
+	const CaptureFrameHeader& getFrameHeader( size_t index ) const;
+
+	// Throws CaptureException for compressed frames, which have no view into the mapping.
+	RawFrame getFrame( size_t index ) const;
+
+	bool isCompressed( size_t index ) const;
+
+	// Decodes a compressed frame into decoded, spreading the work over threads, and returns a view of it.
+	// Uncompressed frames are copied.  Valid until decoded changes.
+	RawFrame decodeFrame( size_t index, std::vector<VmbUchar_t> &decoded, unsigned threads = 1 ) const;
+
+	// index of the frame with frameID, npos if there is none
+	size_t findFrameID( uint64_t frameID ) const;
+
+	// index of the last frame with a timestamp at or before timestamp, npos if all frames are later
+	size_t findTimestamp( uint64_t timestamp ) const;
+
+	// the mapped file and the end of its records, for formats that store more in front of the index
+	const VmbUchar_t* getData() const { return mData; }
+	uint64_t getDataEnd() const { return mDataEnd; }
+
+	// Truncates a damaged last record and writes the index of a linear capture file that has none.  Returns the
+	// number of frames in the file.
+	static size_t rebuildIndex( const std::string &path );
+
+  private:
+
+	MappedCaptureReader( const MappedCaptureReader & );
+	MappedCaptureReader &operator=( const MappedCaptureReader & );
+
+	bool mapIndex();
+	void scanRecords();
+	void scanRing();
+
+	std::string                     mPath;
+	const VmbUchar_t                *mData;
+	uint64_t                        mSize;
+	uint64_t                        mDataEnd;       // end of the last complete record of a linear file
+
+	const CaptureIndexEntry         *mEntries;      // into the mapping or mRebuiltIndex
+	size_t                          mEntryCount;
+	bool                            mIndexRebuilt;
+	std::vector<CaptureIndexEntry>  mRebuiltIndex;
+
+	// entry positions sorted by frame ID / timestamp, only built when the file order is not sorted
+	std::vector<size_t>             mByFrameID;
+	std::vector<size_t>             mByTimestamp;
+};
+
+} // namespace civimba
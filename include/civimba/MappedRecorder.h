@@ -0,0 +1,158 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "cinder/Signals.h"
+
+#include "civimba/BaseException.h"
+#include "civimba/CameraController.h"
+#include "civimba/CaptureFile.h"
+
+namespace civimba {
+
+typedef std::shared_ptr<class MappedRecorder> MappedRecorderRef;
+
+// Records raw frames into a preallocated, memory mapped capture file.  Each frame is a pair of memcpy's into the
+// mapping, there are no system calls per frame and the kernel writes the pages back in the background.
+//
+// In linear mode frames are appended until the file is full, later frames are dropped, and the file is truncated
+// to the recorded size on close() so it is a regular capture file.  In ring mode the file is divided into fixed
+// size slots and the oldest frame is overwritten, which keeps the last capacity bytes of a stream on disk.  Both
+// can be read with CaptureReader and played back with ReplayCamera.
+//
+// write() is meant to be called from the acquisition thread, usually through attach().  Stop acquisition before
+// calling close() or destroying the recorder.
+class MappedRecorder {
+  public:
+
+	class MappedRecorderException : public BaseException
+	{
+	  public:
+		MappedRecorderException( const char *const &fun, const char *const &msg,
+		                         VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		MappedRecorderException( const char *const &fun, const std::string &msg,
+		                         VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~MappedRecorderException() throw()
+		{ }
+	};
+
+	class Options {
+	  public:
+		Options( const std::string &path = "" )
+			: mPath( path ), mCapacity( 1024ULL * 1024 * 1024 ), mRing( false ), mSlotSize( 0 ),
+			  mPopulate( false ), mSyncOnClose( false )
+		{ }
+
+		Options& path( const std::string &path ) { mPath = path; return *this; }
+		// size of the preallocated file in bytes
+		Options& capacity( uint64_t bytes ) { mCapacity = bytes; return *this; }
+		Options& ring( bool ring = true ) { mRing = ring; return *this; }
+		// bytes per ring slot, 0 sizes the slots for the first recorded frame.  Larger frames are dropped.
+		Options& slotSize( uint64_t bytes ) { mSlotSize = bytes; return *this; }
+		// fault in the whole mapping up front (Linux only) instead of on first write
+		Options& populate( bool populate = true ) { mPopulate = populate; return *this; }
+		// block in close() until the data is on disk
+		Options& syncOnClose( bool sync = true ) { mSyncOnClose = sync; return *this; }
+
+		const std::string&  getPath() const { return mPath; }
+		uint64_t            getCapacity() const { return mCapacity; }
+		bool                getRing() const { return mRing; }
+		uint64_t            getSlotSize() const { return mSlotSize; }
+		bool                getPopulate() const { return mPopulate; }
+		bool                getSyncOnClose() const { return mSyncOnClose; }
+
+	  private:
+		std::string mPath;
+		uint64_t    mCapacity;
+		bool        mRing;
+		uint64_t    mSlotSize;
+		bool        mPopulate;
+		bool        mSyncOnClose;
+	};
+
+	MappedRecorder( const Options &options, const std::string &cameraID, uint64_t timestampFrequency );
+
+	// takes the ID and timestamp frequency from camera and attaches to it
+	MappedRecorder( const Options &options, CameraController &camera );
+
+	~MappedRecorder();
+
+	// record every raw frame of camera until detach() or close()
+	void attach( CameraController &camera );
+	void detach();
+
+	// returns false if the frame was dropped because it does not fit
+	bool write( const RawFrame &frame );
+	// writes a prepared record, data holds header.imageSize bytes.  Used for records compressed by FrameCompressor,
+	// ring files then need an explicit Options::slotSize() as record sizes vary.
+	bool writeRecord( const CaptureFrameHeader &header, const VmbUchar_t *data );
+
+	void close();
+
+	const Options& getOptions() const { return mOptions; }
+
+	bool isOpen() const { return nullptr != mData; }
+
+	uint64_t getFramesWritten() const { return mFramesWritten; }
+	uint64_t getFramesDropped() const { return mFramesDropped; }
+	// bytes of frame records written, overwritten ring slots included
+	uint64_t getBytesWritten() const { return mBytesWritten; }
+	// 0 in linear mode and in ring mode until the slot size is known
+	uint64_t getSlotCount() const { return mSlotCount; }
+
+  private:
+
+	MappedRecorder( const MappedRecorder & );
+	MappedRecorder &operator=( const MappedRecorder & );
+
+	void open( const std::string &cameraID, uint64_t timestampFrequency );
+	void setupRing( uint64_t slotSize );
+
+	Options                     mOptions;
+	int                         mFile;
+	VmbUchar_t                  *mData;
+	uint64_t                    mHeaderSize;
+	uint64_t                    mOffset;
+	uint64_t                    mSlotSize;
+	std::atomic<uint64_t>       mSlotCount;
+	CaptureRingHeader           *mRingHeader;
+
+	std::atomic<uint64_t>       mFramesWritten;
+	std::atomic<uint64_t>       mFramesDropped;
+	std::atomic<uint64_t>       mBytesWritten;
+
+	cinder::signals::Connection mConnection;
+};
+
+} // namespace civimba
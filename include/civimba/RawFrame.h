@@ -0,0 +1,127 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "VimbaCPP/Include/VimbaCPP.h"
+
+#include "civimba/FrameMetadata.h"
+
+namespace civimba {
+
+// Lightweight, non-owning view of a raw frame as delivered by the sensor.  Lets the transform and
+// consumer paths run on buffers that did not come from a Vimba FramePtr (synthetic or replayed data).
+struct RawFrame {
+
+	RawFrame()
+		: buffer( nullptr ),
+		  imageSize( 0 ),
+		  width( 0 ),
+		  height( 0 ),
+		  pixelFormat( VmbPixelFormatMono8 ),
+		  frameID( 0 ),
+		  frameIDValid( false ),
+		  timestamp( 0 ),
+		  receiveStatus( VmbFrameStatusComplete ),
+		  ancillary( nullptr ),
+		  ancillarySize( 0 )
+	{ }
+
+	// fill from a Vimba frame, the buffer stays owned by the frame
+	static VmbErrorType fromFrame( const AVT::VmbAPI::FramePtr &frame, RawFrame &raw )
+	{
+		if( SP_ISNULL( frame )) {
+			return VmbErrorBadParameter;
+		}
+
+		VmbErrorType res;
+		VmbUchar_t *data = nullptr;
+		if( VmbErrorSuccess != ( res = frame->GetBuffer( data ))
+		    || VmbErrorSuccess != ( res = frame->GetImageSize( raw.imageSize ))
+		    || VmbErrorSuccess != ( res = frame->GetWidth( raw.width ))
+		    || VmbErrorSuccess != ( res = frame->GetHeight( raw.height ))
+		    || VmbErrorSuccess != ( res = frame->GetPixelFormat( raw.pixelFormat ))
+		    || VmbErrorSuccess != ( res = frame->GetReceiveStatus( raw.receiveStatus ))) {
+			return res;
+		}
+		raw.buffer = data;
+		raw.frameIDValid = ( VmbErrorSuccess == frame->GetFrameID( raw.frameID ));
+		if( VmbErrorSuccess != frame->GetTimestamp( raw.timestamp )) {
+			raw.timestamp = 0;
+		}
+
+		// chunk data follows the image in the same buffer.  Frame::GetAncillaryData() would allocate a wrapper
+		// for every frame, the size is all that is needed.
+		VmbUint32_t bufferSize = 0;
+		raw.ancillary = nullptr;
+		raw.ancillarySize = 0;
+		raw.metadata = FrameMetadata();
+		if( VmbErrorSuccess == frame->GetAncillarySize( raw.ancillarySize ) && raw.ancillarySize > 0
+		    && VmbErrorSuccess == frame->GetBufferSize( bufferSize )
+		    && static_cast<VmbUint64_t>( raw.imageSize ) + raw.ancillarySize <= bufferSize ) {
+			raw.ancillary = data + raw.imageSize;
+			parseFrameMetadata( raw.ancillary, raw.ancillarySize, raw.metadata );
+		} else {
+			raw.ancillarySize = 0;
+		}
+
+		return VmbErrorSuccess;
+	}
+
+	// bits per pixel as encoded in the pixel format (PFNC occupy field)
+	static VmbUint32_t getBitsPerPixel( VmbPixelFormatType format )
+	{
+		return ( static_cast<VmbUint32_t>( format ) >> 16 ) & 0xFF;
+	}
+
+	static VmbUint32_t getImageSize( VmbPixelFormatType format, VmbUint32_t width, VmbUint32_t height )
+	{
+		return static_cast<VmbUint32_t>(( static_cast<VmbUint64_t>( width ) * height * getBitsPerPixel( format ) + 7 ) / 8 );
+	}
+
+	// Whether buffer holds a whole image of width, height and pixelFormat, for frames read from files, sockets or
+	// shared memory.  Computed in floating point, damaged dimensions can overflow getImageSize().
+	bool holdsImage() const
+	{
+		const VmbUint32_t bits = getBitsPerPixel( pixelFormat );
+		return buffer && bits > 0
+		       && static_cast<double>( width ) * height * bits <= static_cast<double>( imageSize ) * 8.0;
+	}
+
+	const VmbUchar_t    *buffer;
+	VmbUint32_t         imageSize;
+	VmbUint32_t         width;
+	VmbUint32_t         height;
+	VmbPixelFormatType  pixelFormat;
+	VmbUint64_t         frameID;
+	bool                frameIDValid;
+	VmbUint64_t         timestamp;
+	VmbFrameStatusType  receiveStatus;
+
+	// chunk data sent with the frame, empty unless chunk mode is active (see CameraController::setChunkMode())
+	const VmbUchar_t    *ancillary;
+	VmbUint32_t         ancillarySize;
+	FrameMetadata       metadata;
+};
+
+} // namespace civimba
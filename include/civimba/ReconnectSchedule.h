@@ -0,0 +1,185 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+
+namespace civimba {
+
+// Task queue of CameraRegistry's auto reconnect thread.  A reconnect that failed, e.g. because the camera was still
+// booting, is queued again with a delay that doubles with every attempt up to Options::maxDelay(), until it succeeds,
+// the camera is removed or the schedule is stopped.
+class ReconnectSchedule {
+  public:
+
+	class Options {
+	  public:
+		Options()
+			: mInitialDelay( 0.5 ), mMaxDelay( 30.0 )
+		{ }
+
+		// seconds before the first retry
+		Options& initialDelay( double seconds ) { mInitialDelay = seconds; return *this; }
+		// longest wait between two attempts
+		Options& maxDelay( double seconds ) { mMaxDelay = seconds; return *this; }
+
+		double  getInitialDelay() const { return mInitialDelay; }
+		double  getMaxDelay() const { return mMaxDelay; }
+
+	  private:
+		double  mInitialDelay;
+		double  mMaxDelay;
+	};
+
+	struct Task {
+		Task() : reconnect( false ), attempt( 0 ) { }
+
+		std::string cameraID;
+		bool        reconnect;      // reopen and resume, otherwise stop after the camera was removed
+		uint32_t    attempt;        // reconnects of this camera that failed before
+	};
+
+	ReconnectSchedule( const Options &options = Options() )
+		: mOptions( options ), mStop( false )
+	{ }
+
+	// Queues a task that is due now.  Both kinds replace the pending reconnect of the camera, a new reconnect
+	// starts over with the first attempt and a removal ends the retries.
+	void schedule( const std::string &cameraID, bool reconnect )
+	{
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			cancelReconnect( cameraID );
+			Pending pending;
+			pending.task.cameraID = cameraID;
+			pending.task.reconnect = reconnect;
+			pending.due = Clock::now();
+			mPending.push_back( pending );
+		}
+		mCondition.notify_all();
+	}
+
+	// queues the failed reconnect task again after its back-off, returns the delay in seconds
+	double retry( const Task &task )
+	{
+		const double delay = getDelay( task.attempt );
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			cancelReconnect( task.cameraID );
+			Pending pending;
+			pending.task = task;
+			++pending.task.attempt;
+			pending.due = Clock::now() + std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( delay ));
+			mPending.push_back( pending );
+		}
+		mCondition.notify_all();
+		return delay;
+	}
+
+	// Waits for the next due task, tasks that are due at the same time in the order they were queued.  Returns
+	// false once stop() was called.
+	bool wait( Task &task )
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		for(;;) {
+			if( mStop ) {
+				return false;
+			}
+			auto next = mPending.end();
+			for( auto it = mPending.begin(); it != mPending.end(); ++it ) {
+				if( mPending.end() == next || it->due < next->due ) {
+					next = it;
+				}
+			}
+			if( mPending.end() == next ) {
+				mCondition.wait( lock );
+			} else if( next->due > Clock::now() ) {
+				mCondition.wait_until( lock, next->due );
+			} else {
+				task = next->task;
+				mPending.erase( next );
+				return true;
+			}
+		}
+	}
+
+	// wakes wait() for good, pending tasks are dropped
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			mStop = true;
+			mPending.clear();
+		}
+		mCondition.notify_all();
+	}
+
+	size_t getPendingCount() const
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		return mPending.size();
+	}
+
+	// seconds to wait after the failed attempt
+	double getDelay( uint32_t attempt ) const
+	{
+		double delay = mOptions.getInitialDelay();
+		for( uint32_t i = 0; i < attempt && delay < mOptions.getMaxDelay(); ++i ) {
+			delay *= 2.0;
+		}
+		return std::min( delay, mOptions.getMaxDelay() );
+	}
+
+	const Options& getOptions() const { return mOptions; }
+
+  private:
+
+	typedef std::chrono::steady_clock Clock;
+
+	struct Pending {
+		Task                task;
+		Clock::time_point   due;
+	};
+
+	// mMutex must be held
+	void cancelReconnect( const std::string &cameraID )
+	{
+		mPending.erase( std::remove_if( mPending.begin(), mPending.end(), [&cameraID]( const Pending &pending ) {
+			return pending.task.reconnect && pending.task.cameraID == cameraID;
+		} ), mPending.end() );
+	}
+
+	Options                     mOptions;
+	mutable std::mutex          mMutex;
+	std::condition_variable     mCondition;
+	std::deque<Pending>         mPending;
+	bool                        mStop;
+};
+
+} // namespace civimba
@@ -0,0 +1,137 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "civimba/BaseException.h"
+#include "civimba/CaptureFile.h"
+#include "civimba/FrameSource.h"
+
+namespace civimba {
+
+typedef std::shared_ptr<class ReplayCamera> ReplayCameraRef;
+
+// Frame source that plays back a capture file with the original pixel format, frame IDs and timestamps, either at
+// the recorded pace or as fast as the consumer accepts frames.  When looping, IDs and timestamps keep increasing
+// so the replay looks like one continuous stream.
+class ReplayCamera : public FrameSource {
+  public:
+
+	class ReplayCameraException : public BaseException
+	{
+	  public:
+		ReplayCameraException( const char *const &fun, const char *const &msg,
+		                       VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		ReplayCameraException( const char *const &fun, const std::string &msg,
+		                       VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~ReplayCameraException() throw()
+		{ }
+	};
+
+	class Options {
+	  public:
+		Options( const std::string &path = "" )
+			: mPath( path ), mRecordedPace( true ), mLoop( false ), mPreload( true )
+		{ }
+
+		Options& path( const std::string &path ) { mPath = path; return *this; }
+		// false delivers the next frame as soon as the previous callback returns
+		Options& recordedPace( bool pace ) { mRecordedPace = pace; return *this; }
+		Options& loop( bool loop ) { mLoop = loop; return *this; }
+		// read the whole capture into memory on start() so disk reads are not part of a benchmark
+		Options& preload( bool preload ) { mPreload = preload; return *this; }
+
+		const std::string&  getPath() const { return mPath; }
+		bool                getRecordedPace() const { return mRecordedPace; }
+		bool                getLoop() const { return mLoop; }
+		bool                getPreload() const { return mPreload; }
+
+	  private:
+		std::string mPath;
+		bool        mRecordedPace;
+		bool        mLoop;
+		bool        mPreload;
+	};
+
+	ReplayCamera( const Options &options );
+
+	~ReplayCamera();
+
+	void start( uint32_t numberFrames, RawFrameCallback callback ) override;
+
+	void stop() override;
+
+	bool isRunning() const override { return mRunning; }
+
+	std::string getID() const override;
+
+	std::string getName() const override { return "Replay Camera"; }
+
+	std::string getModel() const override { return "civimba replay"; }
+
+	uint64_t getTimestampFrequency() const override { return mReader->getFileHeader().timestampFrequency; }
+
+	const Options& getOptions() const { return mOptions; }
+
+	uint64_t getFramesReplayed() const { return mFramesReplayed; }
+
+  private:
+
+	struct Record {
+		CaptureFrameHeader      header;
+		std::vector<VmbUchar_t> data;
+	};
+
+	void run();
+
+	// next record either from memory or from the file, false at the end of the capture
+	bool nextRecord( size_t &preloadIndex, Record *scratch, const Record *&record );
+
+	Options                 mOptions;
+	CaptureReaderRef        mReader;
+	std::vector<Record>     mPreloaded;
+	std::vector<Record>     mBuffers;
+	RawFrameCallback        mCallback;
+
+	std::thread             mThread;
+	std::atomic<bool>       mRunning;
+	std::mutex              mStopMutex;
+	std::condition_variable mStopCondition;
+
+	std::atomic<uint64_t>   mFramesReplayed;
+};
+
+} // namespace civimba
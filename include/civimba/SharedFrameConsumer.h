@@ -0,0 +1,108 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "civimba/BaseException.h"
+#include "civimba/RawFrame.h"
+#include "civimba/SharedFrameRing.h"
+
+namespace civimba {
+
+typedef std::shared_ptr<class SharedFrameConsumer> SharedFrameConsumerRef;
+
+// Reads frames published by SharedFramePublisher in another process.  The ring is mapped read only and frames are
+// returned as RawFrame views into it, so reading costs no copies and no system calls.
+//
+// A view stays readable but may be overwritten once the publisher has written slotCount more frames.  Check
+// isValid( sequence ) after using a frame to know whether it changed while it was in use, and copy what has to
+// outlive that.  The consumer has no dependencies beyond the Vimba headers and can be used without Cinder.
+class SharedFrameConsumer {
+  public:
+
+	class SharedFrameConsumerException : public BaseException
+	{
+	  public:
+		SharedFrameConsumerException( const char *const &fun, const char *const &msg,
+		                              VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		SharedFrameConsumerException( const char *const &fun, const std::string &msg,
+		                              VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~SharedFrameConsumerException() throw()
+		{ }
+	};
+
+	// Maps the ring published under name.  Throws SharedFrameConsumerException with VmbErrorNotFound while it does
+	// not exist yet.  readNext() starts with the first frame published after this point.
+	SharedFrameConsumer( const std::string &name );
+	~SharedFrameConsumer();
+
+	const SharedFrameRingHeader& getRingHeader() const { return *mHeader; }
+
+	std::string getCameraID() const;
+
+	// the newest frame, false if none has been published yet
+	bool readLatest( RawFrame &frame, uint64_t &sequence );
+
+	// The frame after the one last returned by readNext(), false if it has not been published yet.  Frames that were
+	// overwritten before they were read are skipped and counted in getFramesMissed().
+	bool readNext( RawFrame &frame, uint64_t &sequence );
+
+	// polls readNext() for up to timeout seconds, sleeping briefly between attempts
+	bool waitNext( RawFrame &frame, uint64_t &sequence, double timeout );
+
+	// true while the frame with sequence has not been overwritten
+	bool isValid( uint64_t sequence ) const;
+
+	// true once the publisher has closed the ring, no further frames will arrive.  A publisher that restarts
+	// creates a new ring, which needs a new consumer.
+	bool isPublisherClosed() const;
+
+	uint64_t getFramesMissed() const { return mFramesMissed; }
+
+  private:
+
+	SharedFrameConsumer( const SharedFrameConsumer & );
+	SharedFrameConsumer &operator=( const SharedFrameConsumer & );
+
+	const SharedFrameSlotHeader& getSlot( uint64_t sequence ) const;
+	// view of frame sequence, false if the slot holds another frame
+	bool view( uint64_t sequence, RawFrame &frame ) const;
+
+	std::string                     mName;
+	const SharedFrameRingHeader     *mHeader;
+	const VmbUchar_t                *mSlots;
+	uint64_t                        mMappedSize;
+	uint64_t                        mNext;
+	uint64_t                        mFramesMissed;
+};
+
+} // namespace civimba
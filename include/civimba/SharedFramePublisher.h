@@ -0,0 +1,146 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "cinder/Signals.h"
+
+#include "civimba/BaseException.h"
+#include "civimba/CameraController.h"
+#include "civimba/SharedFrameRing.h"
+
+namespace civimba {
+
+typedef std::shared_ptr<class SharedFramePublisher> SharedFramePublisherRef;
+
+// Publishes raw frames to other processes through a POSIX shared memory ring (layout in SharedFrameRing.h), read
+// with SharedFrameConsumer.  Each frame is one memcpy into the next slot, there are no system calls per frame and the
+// publisher never waits for readers: a reader that falls more than slotCount frames behind misses frames.
+//
+// The ring is sized for Options::maxImageSize(), or for the first frame when that is 0, in which case the shared
+// memory object only appears once the first frame arrives.  Larger frames are dropped.  write() is meant to be
+// called from the acquisition thread, usually through attach().
+class SharedFramePublisher {
+  public:
+
+	class SharedFramePublisherException : public BaseException
+	{
+	  public:
+		SharedFramePublisherException( const char *const &fun, const char *const &msg,
+		                               VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		SharedFramePublisherException( const char *const &fun, const std::string &msg,
+		                               VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~SharedFramePublisherException() throw()
+		{ }
+	};
+
+	class Options {
+	  public:
+		Options( const std::string &name = "" )
+			: mName( name ), mSlotCount( 8 ), mMaxImageSize( 0 ), mUnlinkOnClose( true )
+		{ }
+
+		// shared memory object name, a leading '/' is added when missing
+		Options& name( const std::string &name ) { mName = name; return *this; }
+		// frames kept in the ring, which is how far a reader may fall behind
+		Options& slotCount( uint32_t count ) { mSlotCount = count; return *this; }
+		// largest image in bytes, 0 sizes the ring for the first frame
+		Options& maxImageSize( uint64_t bytes ) { mMaxImageSize = bytes; return *this; }
+		// remove the name on close(), readers keep their mapping either way
+		Options& unlinkOnClose( bool unlink = true ) { mUnlinkOnClose = unlink; return *this; }
+
+		const std::string&  getName() const { return mName; }
+		uint32_t            getSlotCount() const { return mSlotCount; }
+		uint64_t            getMaxImageSize() const { return mMaxImageSize; }
+		bool                getUnlinkOnClose() const { return mUnlinkOnClose; }
+
+	  private:
+		std::string mName;
+		uint32_t    mSlotCount;
+		uint64_t    mMaxImageSize;
+		bool        mUnlinkOnClose;
+	};
+
+	SharedFramePublisher( const Options &options, const std::string &cameraID, uint64_t timestampFrequency );
+
+	// takes the ID and timestamp frequency from camera and attaches to it
+	SharedFramePublisher( const Options &options, CameraController &camera );
+
+	~SharedFramePublisher();
+
+	// publish every raw frame of camera until detach() or close()
+	void attach( CameraController &camera );
+	void detach();
+
+	// returns false if the frame was dropped because it is larger than a slot
+	bool write( const RawFrame &frame );
+
+	// marks the ring closed for readers, unmaps it and removes the name unless Options::unlinkOnClose() is false
+	void close();
+
+	const Options& getOptions() const { return mOptions; }
+
+	// name as passed to shm_open()
+	const std::string& getName() const { return mName; }
+
+	bool isOpen() const { return nullptr != mHeader; }
+
+	uint64_t getFramesPublished() const { return mFramesPublished; }
+	uint64_t getFramesDropped() const { return mFramesDropped; }
+
+  private:
+
+	SharedFramePublisher( const SharedFramePublisher & );
+	SharedFramePublisher &operator=( const SharedFramePublisher & );
+
+	void open( uint64_t maxImageSize );
+
+	Options                 mOptions;
+	std::string             mName;
+	std::string             mCameraID;
+	uint64_t                mTimestampFrequency;
+	bool                    mClosed;
+
+	SharedFrameRingHeader   *mHeader;
+	VmbUchar_t              *mSlots;
+	uint64_t                mMappedSize;
+	uint64_t                mSlotSize;
+	uint64_t                mSlotCount;
+
+	std::atomic<uint64_t>   mFramesPublished;
+	std::atomic<uint64_t>   mFramesDropped;
+
+	cinder::signals::Connection mConnection;
+};
+
+} // namespace civimba
@@ -0,0 +1,99 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "VimbaCPP/Include/VimbaCPP.h"
+
+#include "civimba/RawFrame.h"
+
+namespace civimba {
+
+// Layout of the POSIX shared memory ring written by SharedFramePublisher and read by SharedFrameConsumer.  Both
+// sides must run on the same machine, so fields are in native byte order.
+//
+//   SharedFrameRingHeader                  192 bytes
+//   { SharedFrameSlotHeader, image data }  slotCount slots of slotSize bytes, 64 byte aligned
+//
+// Frames are numbered with a sequence starting at 1 and frame s lives in slot (s % slotCount).  The publisher
+// clears the slot sequence, writes the frame and then stores s into the slot and into published, both with release
+// semantics.  A reader that sees the expected sequence in a slot before and after it looked at the frame knows the
+// frame was not overwritten in between, without locks or system calls.
+
+static const char       SHARED_FRAME_MAGIC[8]   = { 'C', 'I', 'V', 'I', 'S', 'H', 'M', 0 };
+static const uint32_t   SHARED_FRAME_VERSION    = 1;
+
+static const uint32_t   SHARED_FRAME_FLAG_ID_VALID = 1 << 0;
+
+static_assert( ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+               "shared memory frames need lock free, address free atomics" );
+
+struct SharedFrameRingHeader {
+	char                    magic[8];
+	uint32_t                version;
+	uint32_t                headerSize;         // offset of the first slot
+	uint64_t                slotSize;           // bytes per slot including its header, a multiple of 64
+	uint64_t                slotCount;
+	uint64_t                timestampFrequency; // camera timestamp ticks per second, 0 if unknown
+	char                    cameraID[32];
+	uint8_t                 reserved0[56];
+
+	// written for every frame, kept on its own cache line
+	std::atomic<uint64_t>   published;          // sequence of the newest complete frame, 0 before the first
+	std::atomic<uint32_t>   closed;             // 1 once the publisher has closed the ring
+	uint32_t                reserved1;
+	uint8_t                 reserved2[48];
+};
+
+struct SharedFrameSlotHeader {
+	std::atomic<uint64_t>   sequence;           // sequence of the frame in the slot, 0 while it is written
+	uint64_t                frameID;
+	uint64_t                timestamp;
+	uint32_t                pixelFormat;
+	uint32_t                width;
+	uint32_t                height;
+	int32_t                 receiveStatus;
+	uint32_t                imageSize;          // bytes of image data following this header
+	uint32_t                flags;
+	uint8_t                 reserved[16];
+};
+
+static_assert( sizeof( SharedFrameRingHeader ) == 192, "SharedFrameRingHeader layout changed" );
+static_assert( sizeof( SharedFrameSlotHeader ) == 64, "SharedFrameSlotHeader layout changed" );
+
+// shm_open() names must start with a single '/'
+inline std::string getSharedFrameName( const std::string &name )
+{
+	return ( ! name.empty() && '/' == name[0] ) ? name : "/" + name;
+}
+
+// slot size needed for frames of up to imageSize bytes
+inline uint64_t getSharedFrameSlotSize( uint64_t imageSize )
+{
+	return ( sizeof( SharedFrameSlotHeader ) + imageSize + 63 ) & ~static_cast<uint64_t>( 63 );
+}
+
+} // namespace civimba
@@ -0,0 +1,161 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "VimbaCPP/Include/VimbaCPP.h"
+
+#include "civimba/BaseException.h"
+#include "civimba/FrameSource.h"
+
+namespace civimba {
+
+typedef std::shared_ptr<class SimulatedCamera> SimulatedCameraRef;
+
+// Frame source that produces synthetic frames at a configurable rate, resolution and pixel format, with optional
+// jitter, incomplete frames and frame ID gaps.  All random decisions come from a seeded generator so a run can be
+// repeated exactly.  Frames that would arrive while all numberFrames buffers are busy are dropped, like a camera
+// whose host queue has run dry.
+class SimulatedCamera : public FrameSource {
+  public:
+
+	class SimulatedCameraException : public BaseException
+	{
+	  public:
+		SimulatedCameraException( const char *const &fun, const char *const &msg,
+		                          VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		SimulatedCameraException( const char *const &fun, const std::string &msg,
+		                          VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~SimulatedCameraException() throw()
+		{ }
+	};
+
+	class Options {
+	  public:
+		Options()
+			: mID( "SIM-0" ), mWidth( 1280 ), mHeight( 1024 ), mPixelFormat( VmbPixelFormatBayerRG8 ),
+			  mFrameRate( 30.0 ), mJitter( 0.0 ), mIncompleteProbability( 0.0 ), mFrameIDGapProbability( 0.0 ),
+			  mMaxFrameIDGap( 1 ), mSeed( 1 ), mFrameLimit( 0 )
+		{ }
+
+		Options& id( const std::string &id ) { mID = id; return *this; }
+		Options& size( uint32_t width, uint32_t height ) { mWidth = width; mHeight = height; return *this; }
+		Options& pixelFormat( VmbPixelFormatType format ) { mPixelFormat = format; return *this; }
+		// frames per second, 0 runs as fast as the consumer allows
+		Options& frameRate( double fps ) { mFrameRate = fps; return *this; }
+		// uniform jitter on each frame's arrival, as a fraction of the frame period (0 - 1)
+		Options& jitter( double fraction ) { mJitter = fraction; return *this; }
+		Options& incompleteProbability( double p ) { mIncompleteProbability = p; return *this; }
+		// probability that the camera skips frame IDs, and the largest number skipped at once
+		Options& frameIDGapProbability( double p ) { mFrameIDGapProbability = p; return *this; }
+		Options& maxFrameIDGap( uint32_t gap ) { mMaxFrameIDGap = gap; return *this; }
+		Options& seed( uint32_t seed ) { mSeed = seed; return *this; }
+		// stop after this many frames, 0 runs until stop()
+		Options& frameLimit( uint64_t frames ) { mFrameLimit = frames; return *this; }
+
+		const std::string&  getID() const { return mID; }
+		uint32_t            getWidth() const { return mWidth; }
+		uint32_t            getHeight() const { return mHeight; }
+		VmbPixelFormatType  getPixelFormat() const { return mPixelFormat; }
+		double              getFrameRate() const { return mFrameRate; }
+		double              getJitter() const { return mJitter; }
+		double              getIncompleteProbability() const { return mIncompleteProbability; }
+		double              getFrameIDGapProbability() const { return mFrameIDGapProbability; }
+		uint32_t            getMaxFrameIDGap() const { return mMaxFrameIDGap; }
+		uint32_t            getSeed() const { return mSeed; }
+		uint64_t            getFrameLimit() const { return mFrameLimit; }
+
+	  private:
+		std::string         mID;
+		uint32_t            mWidth;
+		uint32_t            mHeight;
+		VmbPixelFormatType  mPixelFormat;
+		double              mFrameRate;
+		double              mJitter;
+		double              mIncompleteProbability;
+		double              mFrameIDGapProbability;
+		uint32_t            mMaxFrameIDGap;
+		uint32_t            mSeed;
+		uint64_t            mFrameLimit;
+	};
+
+	SimulatedCamera( const Options &options = Options() );
+
+	~SimulatedCamera();
+
+	void start( uint32_t numberFrames, RawFrameCallback callback ) override;
+
+	void stop() override;
+
+	bool isRunning() const override { return mRunning; }
+
+	std::string getID() const override { return mOptions.getID(); }
+
+	std::string getName() const override { return "Simulated Camera"; }
+
+	std::string getModel() const override { return "civimba simulator"; }
+
+	// timestamps are nanoseconds since start()
+	uint64_t getTimestampFrequency() const override { return 1000000000ULL; }
+
+	const Options& getOptions() const { return mOptions; }
+
+	// frames handed to the callback, and frames lost because every buffer was still in use
+	uint64_t getFramesGenerated() const { return mFramesGenerated; }
+
+	uint64_t getFramesDropped() const { return mFramesDropped; }
+
+	// deterministic test content that stays inside the valid bit depth of the format
+	static void fillTestPattern( std::vector<VmbUchar_t> &data, VmbPixelFormatType format, uint32_t seed );
+
+  private:
+
+	void run();
+
+	Options                             mOptions;
+	std::vector<std::vector<VmbUchar_t>> mBuffers;
+	RawFrameCallback                    mCallback;
+
+	std::thread                         mThread;
+	std::atomic<bool>                   mRunning;
+	std::mutex                          mStopMutex;
+	std::condition_variable             mStopCondition;
+
+	std::atomic<uint64_t>               mFramesGenerated;
+	std::atomic<uint64_t>               mFramesDropped;
+};
+
+} // namespace civimba
@@ -0,0 +1,171 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cinder/Surface.h"
+
+#include "civimba/BaseException.h"
+#include "civimba/RawFrame.h"
+#include "civimba/ThreadPlacement.h"
+
+namespace civimba {
+
+typedef std::shared_ptr<class SnapshotWriter> SnapshotWriterRef;
+
+typedef enum {
+	SNAPSHOT_DEPTH_8,           // the transformed RGB frame, as returned by CameraController::getCurrentFrame()
+	SNAPSHOT_DEPTH_16           // the raw sensor samples of a Mono or Bayer frame, scaled to 16 bits
+} SnapshotDepth;
+
+// Writes still images on a background thread so encoding never blocks the caller.  The image format follows the
+// extension of the path, .png or .tif / .tiff.
+//
+// 8 bit snapshots hold a reference to the surface, nothing is copied.  16 bit snapshots are taken from raw frames,
+// which only live during the raw frame signal, so their samples are copied into a buffer owned by the queue slot and
+// reused for later snapshots.  Bayer frames are written as a single channel mosaic.  16 bit TIFFs are written by
+// civimba itself and are exact on every platform, other combinations go through cinder::writeImage().
+//
+// At most Options::queueDepth() snapshots can be waiting or in progress, further requests are rejected, so a burst of
+// snapshots cannot exhaust memory.  Callbacks are invoked on the writer thread.
+class SnapshotWriter {
+  public:
+
+	class SnapshotWriterException : public BaseException
+	{
+	  public:
+		SnapshotWriterException( const char *const &fun, const char *const &msg,
+		                         VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		SnapshotWriterException( const char *const &fun, const std::string &msg,
+		                         VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~SnapshotWriterException() throw()
+		{ }
+	};
+
+	typedef std::function<void( const std::string &path, bool success )> SnapshotCallback;
+
+	class Options {
+	  public:
+		Options()
+			: mQueueDepth( 4 )
+		{ }
+
+		// snapshots that can be waiting or in progress before requests are rejected
+		Options& queueDepth( uint32_t depth ) { mQueueDepth = depth; return *this; }
+		// cpus and NUMA node of the writer thread
+		Options& placement( const ThreadPlacement &placement ) { mPlacement = placement; return *this; }
+
+		uint32_t                getQueueDepth() const { return mQueueDepth; }
+		const ThreadPlacement&  getPlacement() const { return mPlacement; }
+
+	  private:
+		uint32_t        mQueueDepth;
+		ThreadPlacement mPlacement;
+	};
+
+	SnapshotWriter( const Options &options = Options() );
+	~SnapshotWriter();
+
+	// Queues an 8 bit snapshot of surface.  Returns false if the queue is full.
+	bool write( const cinder::Surface8uRef &surface, const std::string &path,
+	            const SnapshotCallback &callback = SnapshotCallback() );
+
+	// Copies frame and queues a 16 bit snapshot of it.  Returns false if the queue is full or the pixel format has
+	// no 16 bit representation.
+	bool write( const RawFrame &frame, const std::string &path, const SnapshotCallback &callback = SnapshotCallback() );
+
+	// Reserves a queue slot for a 16 bit snapshot of the next frame passed to rawFrame().  Returns false if the queue
+	// is full.
+	bool writeNextRaw( const std::string &path, const SnapshotCallback &callback = SnapshotCallback() );
+
+	// Fills snapshots reserved by writeNextRaw(), cheap when none are waiting.  Called from the acquisition thread.
+	void rawFrame( const RawFrame &frame );
+
+	// true if the pixel format can be written as a 16 bit snapshot
+	static bool supportsRaw( VmbPixelFormatType pixelFormat );
+
+	// waits until every queued snapshot has been written.  Snapshots still waiting for a raw frame are not waited for.
+	void waitForSnapshots();
+
+	const Options& getOptions() const { return mOptions; }
+
+	uint64_t getSnapshotsWritten() const { return mSnapshotsWritten; }
+	uint64_t getSnapshotsRejected() const { return mSnapshotsRejected; }
+
+	// placement of the writer thread, empty until the first snapshot started it
+	ThreadPlacementReport getPlacementReport();
+
+  private:
+
+	SnapshotWriter( const SnapshotWriter & );
+	SnapshotWriter &operator=( const SnapshotWriter & );
+
+	struct Job {
+		std::string                 path;
+		SnapshotCallback            callback;
+		cinder::Surface8uRef        surface;
+		RawFrame                    frame;      // buffer points into raw
+		std::vector<VmbUchar_t>     raw;
+	};
+
+	Job* acquire();
+	void queue( Job *job );
+	void copyRaw( Job *job, const RawFrame &frame );
+	void run();
+	bool writeJob( Job &job );
+
+	Options                     mOptions;
+	std::vector<std::unique_ptr<Job>> mJobs;
+	std::vector<Job*>           mFree;
+	std::deque<Job*>            mWaitingForRaw;
+	std::deque<Job*>            mPending;
+	size_t                      mBusy;          // jobs taken from mPending and not yet returned
+	std::atomic<size_t>         mRawRequests;
+	std::atomic<uint64_t>       mSnapshotsWritten;
+	std::atomic<uint64_t>       mSnapshotsRejected;
+	bool                        mStop;
+	ThreadPlacementReport       mPlacementReport;
+
+	std::mutex                  mMutex;
+	std::condition_variable     mPendingCondition;
+	std::condition_variable     mDoneCondition;
+	std::thread                 mThread;
+};
+
+} // namespace civimba
@@ -0,0 +1,153 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "civimba/BaseException.h"
+#include "civimba/CameraController.h"
+
+namespace civimba {
+
+// stream parameters of one camera, 0 leaves a parameter as it is
+struct StreamSettings {
+	StreamSettings() : packetSize( 0 ), numberFrames( 0 ), streamBytesPerSecond( 0 ) { }
+
+	uint32_t    packetSize;             // GevSCPSPacketSize
+	uint32_t    numberFrames;           // CameraController::setNumberFrames()
+	uint64_t    streamBytesPerSecond;   // StreamBytesPerSecond
+};
+
+// what one acquisition trial of StreamTuner measured, after the warm up
+struct StreamTrialResult {
+	StreamTrialResult()
+		: error( VmbErrorSuccess ), seconds( 0.0 ), completeRate( 0.0 ), frameRate( 0.0 ), cpu( 0.0 ),
+		  latencyMean( 0.0 ), latencyMax( 0.0 )
+	{ }
+
+	StreamSettings  settings;
+	VmbErrorType    error;          // VmbErrorSuccess or why the trial could not run
+	std::string     message;
+	double          seconds;
+	FrameStatistics frames;
+	double          completeRate;   // delivered frames / (received + missing frames)
+	double          frameRate;      // delivered frames per second
+	double          cpu;            // process cpu time / trial time, 1.0 is one core
+	double          latencyMean;    // seconds from the camera timestamp to the frame callback, above the fastest frame
+	double          latencyMax;
+};
+
+struct StreamTuningResult {
+	StreamSettings                  best;
+	StreamTrialResult               bestTrial;
+	std::vector<StreamTrialResult>  trials;     // in the order they ran
+};
+
+// Finds stream settings that deliver every frame by running short acquisitions with different packet sizes, buffer
+// counts and throughput limits.  Each parameter is searched in turn, keeping the best value of the ones before: the
+// trial with the highest complete frame rate wins, then the higher frame rate, the lower cpu load and the lower
+// latency.  The camera must not be acquiring, it is left with the best settings applied.
+//
+// Results are saved per camera ID to a text file and applied to later installations with applySaved().
+class StreamTuner {
+  public:
+
+	class StreamTunerException : public BaseException
+	{
+	  public:
+		StreamTunerException( const char *const &fun, const char *const &msg,
+		                      VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		StreamTunerException( const char *const &fun, const std::string &msg,
+		                      VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~StreamTunerException() throw()
+		{ }
+	};
+
+	class Options {
+	  public:
+		Options()
+			: mTrialDuration( 2.0 ), mWarmup( 0.5 ), mNumberFrames( { 3, 5, 10, 20 } ),
+			  mThroughputs( { 1.0, 0.9, 0.75 } )
+		{ }
+
+		// seconds each trial is measured
+		Options& trialDuration( double seconds ) { mTrialDuration = seconds; return *this; }
+		// seconds of acquisition before the measurement starts
+		Options& warmup( double seconds ) { mWarmup = seconds; return *this; }
+		// packet sizes to try, by default the current one and the common smaller jumbo and standard sizes
+		Options& packetSizes( const std::vector<uint32_t> &sizes ) { mPacketSizes = sizes; return *this; }
+		Options& numberFrames( const std::vector<uint32_t> &counts ) { mNumberFrames = counts; return *this; }
+		// StreamBytesPerSecond to try as fractions of its maximum
+		Options& throughputs( const std::vector<double> &fractions ) { mThroughputs = fractions; return *this; }
+
+		double                          getTrialDuration() const { return mTrialDuration; }
+		double                          getWarmup() const { return mWarmup; }
+		const std::vector<uint32_t>&    getPacketSizes() const { return mPacketSizes; }
+		const std::vector<uint32_t>&    getNumberFrames() const { return mNumberFrames; }
+		const std::vector<double>&      getThroughputs() const { return mThroughputs; }
+
+	  private:
+		double                  mTrialDuration;
+		double                  mWarmup;
+		std::vector<uint32_t>   mPacketSizes;
+		std::vector<uint32_t>   mNumberFrames;
+		std::vector<double>     mThroughputs;
+	};
+
+	StreamTuner( const Options &options = Options() );
+
+	// searches the settings of camera, throws if the camera is acquiring
+	StreamTuningResult tune( const CameraControllerRef &camera );
+
+	// one acquisition with settings applied, does not throw
+	StreamTrialResult runTrial( const CameraControllerRef &camera, const StreamSettings &settings );
+
+	// true if a is the better trial
+	static bool isBetter( const StreamTrialResult &a, const StreamTrialResult &b );
+
+	// writes settings to camera, clamped to the ranges of its features.  Throws.
+	static void apply( CameraController &camera, const StreamSettings &settings );
+
+	// settings per camera ID in a text file of [cameraID] sections with one key=value per line
+	static void save( const std::string &path, const std::map<std::string, StreamSettings> &settings );
+	static std::map<std::string, StreamSettings> load( const std::string &path );
+
+	// applies the settings saved for camera in path, returns false if there are none
+	static bool applySaved( const std::string &path, CameraController &camera );
+
+	const Options& getOptions() const { return mOptions; }
+
+  private:
+	Options mOptions;
+};
+
+} // namespace civimba
@@ -0,0 +1,95 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "civimba/CaptureFile.h"
+#include "civimba/MappedCaptureReader.h"
+#include "civimba/RawFrame.h"
+
+namespace civimba {
+
+typedef std::shared_ptr<class SyncCaptureReader> SyncCaptureReaderRef;
+
+// Random access to a synchronized capture file written by SyncRecorder.  Frames are grouped by time, a group holds
+// at most one frame per camera.  The groups come from the group index of the file, or are rebuilt from the records
+// when the recording was not closed.
+class SyncCaptureReader {
+  public:
+
+	static const size_t npos;
+
+	// Throws CaptureException if path is not a synchronized capture file
+	SyncCaptureReader( const std::string &path );
+
+	// all frames of all cameras, timestamps are host nanoseconds
+	const MappedCaptureReader& getReader() const { return mReader; }
+
+	size_t getStreamCount() const { return mStreamCount; }
+
+	const CaptureStreamEntry& getStream( size_t stream ) const { return mStreamTable[stream]; }
+
+	// nanoseconds within which frames were grouped
+	uint64_t getWindow() const { return mWindow; }
+
+	// true if the file had no valid group index and the groups were rebuilt from the records
+	bool wasGroupIndexRebuilt() const { return mGroupsRebuilt; }
+
+	size_t getGroupCount() const { return mGroupCount; }
+
+	// host time of the earliest frame in group
+	uint64_t getGroupTimestamp( size_t group ) const;
+
+	// index of the frame of stream in group for getReader(), npos if that camera has no frame in the group
+	size_t getFrameIndex( size_t group, size_t stream ) const;
+
+	// view of the frame of stream in group, false if that camera has no frame in the group
+	bool getFrame( size_t group, size_t stream, RawFrame &frame ) const;
+
+	// last group that starts at or before timestamp, npos if all groups are later
+	size_t findGroup( uint64_t timestamp ) const;
+
+  private:
+
+	SyncCaptureReader( const SyncCaptureReader & );
+	SyncCaptureReader &operator=( const SyncCaptureReader & );
+
+	bool mapGroups();
+	void rebuildGroups();
+
+	MappedCaptureReader             mReader;
+	const CaptureStreamEntry        *mStreamTable;
+	size_t                          mStreamCount;
+	uint64_t                        mWindow;
+
+	const uint64_t                  *mGroups;       // ( 1 + mStreamCount ) values per group, into the mapping or mRebuiltGroups
+	size_t                          mGroupCount;
+	bool                            mGroupsRebuilt;
+	std::vector<uint64_t>           mRebuiltGroups;
+};
+
+} // namespace civimba
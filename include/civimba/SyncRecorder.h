@@ -0,0 +1,153 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "cinder/Signals.h"
+
+#include "civimba/BaseException.h"
+#include "civimba/CameraController.h"
+#include "civimba/CaptureFile.h"
+#include "civimba/ClockMapper.h"
+#include "civimba/DiskWriter.h"
+
+namespace civimba {
+
+typedef std::shared_ptr<class SyncRecorder> SyncRecorderRef;
+
+// Records the raw frames of several cameras into one synchronized capture file (see CaptureFile.h) through a
+// DiskWriter.  Camera timestamps are mapped to host nanoseconds by a ClockMapper per camera, which estimates the
+// clock offset over Options::clockWindow().
+//
+// close() groups the frames whose host timestamps lie within Options::window() of each other, one frame per camera,
+// and writes the groups in front of the index.  SyncCaptureReader finds the frames of all cameras for a time with
+// one lookup.
+class SyncRecorder {
+  public:
+
+	class SyncRecorderException : public BaseException
+	{
+	  public:
+		SyncRecorderException( const char *const &fun, const char *const &msg,
+		                       VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		SyncRecorderException( const char *const &fun, const std::string &msg,
+		                       VmbErrorType result = VmbErrorOther )
+			: BaseException( fun, msg, result )
+		{ }
+
+		~SyncRecorderException() throw()
+		{ }
+	};
+
+	class Options {
+	  public:
+		Options( const std::string &path = "" )
+			: mWriterOptions( path ), mWindow( 0.005 ), mClockWindow( 10.0 )
+		{ }
+
+		Options& path( const std::string &path ) { mWriterOptions.path( path ); return *this; }
+		// buffering and I/O of the file, see DiskWriter::Options
+		Options& writerOptions( const DiskWriter::Options &options ) { mWriterOptions = options; return *this; }
+		// seconds between frames of the same trigger, should be well below the frame period
+		Options& window( double seconds ) { mWindow = seconds; return *this; }
+		// seconds over which the offset of a camera clock to the host clock is estimated
+		Options& clockWindow( double seconds ) { mClockWindow = seconds; return *this; }
+
+		const std::string&          getPath() const { return mWriterOptions.getPath(); }
+		const DiskWriter::Options&  getWriterOptions() const { return mWriterOptions; }
+		double                      getWindow() const { return mWindow; }
+		double                      getClockWindow() const { return mClockWindow; }
+
+	  private:
+		DiskWriter::Options mWriterOptions;
+		double              mWindow;
+		double              mClockWindow;
+	};
+
+	// one stream per entry, frames are passed to write()
+	SyncRecorder( const Options &options, const std::vector<CaptureStreamEntry> &streams );
+
+	// one stream per camera in the same order, attached to the cameras
+	SyncRecorder( const Options &options, const std::vector<CameraControllerRef> &cameras );
+
+	~SyncRecorder();
+
+	// record every raw frame of camera as stream until detach() or close()
+	void attach( size_t stream, CameraController &camera );
+	void detach();
+
+	// Returns false if the frame was dropped by the writer.  Safe to call from one thread per stream.
+	bool write( size_t stream, const RawFrame &frame );
+	// arrival is the host time the frame was received, in getHostTime() nanoseconds
+	bool write( size_t stream, const RawFrame &frame, uint64_t arrival );
+
+	// groups the frames and writes the groups and the index
+	void close();
+
+	size_t getStreamCount() const { return mStreams.size(); }
+
+	uint64_t getFramesRecorded() const;
+
+	// number of groups written by close()
+	uint64_t getGroupCount() const { return mGroupCount; }
+
+	DiskWriterStatistics getWriterStatistics() const { return mWriter->getStatistics(); }
+
+	const Options& getOptions() const { return mOptions; }
+
+	// steady clock time in nanoseconds, the time base of the recorded timestamps
+	static uint64_t getHostTime();
+
+  private:
+
+	SyncRecorder( const SyncRecorder & );
+	SyncRecorder &operator=( const SyncRecorder & );
+
+	struct Stream {
+		CaptureStreamEntry          entry;
+		cinder::signals::Connection connection;
+		ClockMapper                 clock;
+	};
+
+	void open( const std::vector<CaptureStreamEntry> &streams );
+
+	Options                         mOptions;
+	uint64_t                        mWindow;
+	std::vector<Stream>             mStreams;
+	std::unique_ptr<DiskWriter>     mWriter;
+	uint64_t                        mGroupCount;
+	bool                            mClosed;
+
+	mutable std::mutex              mFramesMutex;
+	std::vector<CaptureSyncFrame>   mFrames;
+};
+
+} // namespace civimba
@@ -0,0 +1,106 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace civimba {
+
+// the placement of a thread as it was applied, see ThreadPlacement::apply()
+struct ThreadPlacementReport {
+	ThreadPlacementReport() : placed( false ), memoryPolicy( false ), cpu( -1 ), numaNode( -1 ) { }
+
+	std::string         name;
+	bool                placed;         // the requested affinity is set
+	bool                memoryPolicy;   // allocations of the thread prefer the requested NUMA node
+	std::vector<int>    cpus;           // affinity of the thread afterwards
+	int                 cpu;            // cpu the thread ran on, -1 if unknown
+	int                 numaNode;       // node of that cpu, -1 if unknown
+	std::string         error;
+
+	// one line for the log
+	std::string toString() const;
+};
+
+// CPU affinity and NUMA memory placement for a thread (Linux only, elsewhere threads stay where the OS puts them).
+// Without cpus the thread may run on every cpu of numaNode.  With a numaNode the memory the thread allocates and
+// first touches, e.g. transformed surfaces on the acquisition thread, comes from that node when it has free pages.
+// Reads the topology from /sys, so no libnuma is needed.
+class ThreadPlacement {
+  public:
+	ThreadPlacement()
+		: mNumaNode( -1 )
+	{ }
+
+	// cpus the thread may run on, empty for all
+	ThreadPlacement& cpus( const std::vector<int> &cpus ) { mCpus = cpus; return *this; }
+	// cpus as a Linux cpu list, e.g. "0-3,8"
+	ThreadPlacement& cpus( const std::string &list ) { mCpus = parseCpuList( list ); return *this; }
+	// node to allocate from, -1 for the default policy
+	ThreadPlacement& numaNode( int node ) { mNumaNode = node; return *this; }
+
+	const std::vector<int>& getCpus() const { return mCpus; }
+	int                     getNumaNode() const { return mNumaNode; }
+
+	bool isDefault() const { return mCpus.empty() && mNumaNode < 0; }
+
+	// cpus(), or all cpus of numaNode() if none were given
+	std::vector<int> getEffectiveCpus() const;
+
+	// Places the calling thread and reports where it ended up, logged unless nothing was requested.  Failures are
+	// reported, not thrown, since a thread that runs anywhere still works.
+	ThreadPlacementReport apply( const std::string &name ) const;
+
+	static std::vector<int> parseCpuList( const std::string &list );
+
+	// number of NUMA nodes, 1 where the topology is unknown
+	static int getNumaNodeCount();
+	static std::vector<int> getNumaNodeCpus( int node );
+	// node of cpu, -1 if unknown
+	static int getCpuNumaNode( int cpu );
+
+  private:
+	std::vector<int>    mCpus;
+	int                 mNumaNode;
+};
+
+// Makes the allocations of the calling thread prefer node until it goes out of scope, e.g. while a library allocates
+// frame buffers.  Does nothing for node -1 or where NUMA policies are not supported.
+class ScopedMemoryPolicy {
+  public:
+	explicit ScopedMemoryPolicy( int node );
+	~ScopedMemoryPolicy();
+
+	bool isActive() const { return mActive; }
+
+  private:
+	ScopedMemoryPolicy( const ScopedMemoryPolicy & );
+	ScopedMemoryPolicy &operator=( const ScopedMemoryPolicy & );
+
+	bool                        mActive;
+	int                         mMode;
+	std::vector<unsigned long>  mNodes;
+};
+
+} // namespace civimba
@@ -29,6 +29,8 @@
 #include "VimbaCPP/Include/VimbaCPP.h"
 #include "VmbTransform.h"
 
+#include "civimba/RawFrame.h"
+
 #include "cinder/Surface.h"
 
 namespace civimba {
@@ -44,5 +46,15 @@ class TransformImage {
                                   cinder::Surface8uRef &DestinationSurface,
                                   const std::string &DestinationFormat,
                                   const VmbFloat_t *Matrix);
+
+    // raw buffer variants, used for frames that do not originate from the Vimba SDK
+    static VmbErrorType transform(const RawFrame &SourceFrame,
+                                  cinder::Surface8uRef &DestinationSurface,
+                                  const std::string &DestinationFormat);
+
+    static VmbErrorType transform(const RawFrame &SourceFrame,
+                                  cinder::Surface8uRef &DestinationSurface,
+                                  const std::string &DestinationFormat,
+                                  const VmbFloat_t *Matrix);
 };
 } // namespace civimba
\ No newline at end of file
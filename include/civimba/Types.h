@@ -23,6 +23,8 @@
 
 #pragma once
 
+#include <cstdint>
+
 namespace civimba {
 
 typedef enum {
@@ -37,4 +39,17 @@ typedef enum {
 	COLOR_PROCESSING_MATRIX
 } ColorProcessing;
 
+// counters kept by FrameObserver since acquisition was started
+struct FrameStatistics {
+	FrameStatistics()
+		: framesReceived( 0 ), framesDelivered( 0 ), framesIncomplete( 0 ), framesMissing( 0 ), transformErrors( 0 )
+	{ }
+
+	uint64_t framesReceived;    // every frame handed to the observer
+	uint64_t framesDelivered;   // transformed and passed to the frame callback
+	uint64_t framesIncomplete;  // receive status other than complete
+	uint64_t framesMissing;     // gaps in the frame ID sequence
+	uint64_t transformErrors;
+};
+
 } // namespace civimba
\ No newline at end of file
@@ -0,0 +1,304 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Headless stress test of the acquisition path.  N simulated cameras run through the real CameraController,
+// FrameObserver, TransformImage and frame handoff code while the frame rate is ramped step by step.  The ramp stops
+// at the first step where any camera drops or misses frames, and the last clean step is reported as the maximum
+// sustainable aggregate pixel rate.  One JSON object is printed per step, then a summary object.
+//
+//  AcquisitionStress [--cameras N] [--size WxH] [--format mono8|bayer8|bayer12|bayer12packed]
+//                    [--start-fps F] [--step-fps F] [--max-fps F] [--step-seconds S] [--buffers N]
+//
+//  latency     raw frame arrival at the observer until the transformed surface is handed off, in microseconds
+//  cpuPercent  CPU time of each camera's acquisition thread over the step, as a percentage of one core
+
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "civimba/CiVimba.h"
+
+using namespace civimba;
+
+namespace {
+
+double threadCpuSeconds()
+{
+	timespec ts;
+	clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// per camera measurements, only touched from that camera's acquisition thread while it runs
+struct CameraProbe {
+	CameraProbe()
+		: cpuFirst( -1.0 ), cpuLast( 0.0 )
+	{ }
+
+	void reset( size_t expectedFrames )
+	{
+		latencies.clear();
+		latencies.reserve( expectedFrames );
+		cpuFirst = -1.0;
+		cpuLast = 0.0;
+	}
+
+	std::chrono::steady_clock::time_point   arrival;
+	std::vector<double>                     latencies;
+	double                                  cpuFirst;
+	double                                  cpuLast;
+	cinder::signals::Connection             rawConnection;
+	cinder::signals::Connection             newFrameConnection;
+};
+
+struct StepResult {
+	double      fps;
+	uint64_t    delivered;
+	uint64_t    missing;
+	uint64_t    incomplete;
+	uint64_t    dropped;
+	double      aggregateMegapixelsPerSec;
+	double      cpuPercentMean;
+	double      cpuPercentMax;
+	double      latencyP50;
+	double      latencyP90;
+	double      latencyP99;
+	double      latencyMax;
+	bool        clean;
+};
+
+double percentile( std::vector<double> &values, double p )
+{
+	if( values.empty() ) {
+		return 0.0;
+	}
+	size_t index = std::min( values.size() - 1, static_cast<size_t>( p * ( values.size() - 1 ) + 0.5 ));
+	std::nth_element( values.begin(), values.begin() + index, values.end() );
+	return values[index];
+}
+
+VmbPixelFormatType parseFormat( const std::string &name )
+{
+	if( "mono8" == name ) {
+		return VmbPixelFormatMono8;
+	} else if( "bayer12" == name ) {
+		return VmbPixelFormatBayerRG12;
+	} else if( "bayer12packed" == name ) {
+		return VmbPixelFormatBayerRG12Packed;
+	}
+	return VmbPixelFormatBayerRG8;
+}
+
+StepResult runStep( ApiController &api, unsigned cameraCount, const SimulatedCamera::Options &baseOptions,
+                    double fps, double stepSeconds, uint32_t buffers )
+{
+	StepResult result = {};
+	result.fps = fps;
+
+	std::vector<CameraControllerRef> cameras;
+	std::vector<CameraProbe> probes( cameraCount );
+	size_t expectedFrames = static_cast<size_t>( fps * stepSeconds * 1.5 ) + 16;
+
+	for( unsigned i = 0; i < cameraCount; ++i ) {
+		std::stringstream id;
+		id << "SIM-" << i;
+		SimulatedCamera::Options options = baseOptions;
+		options.id( id.str() ).frameRate( fps ).seed( i + 1 );
+
+		CameraControllerRef cam = api.getSimulatedCamera( options, buffers );
+		cam->setFrameLogging( FRAME_INFO_OFF );
+
+		CameraProbe *probe = &probes[i];
+		probe->reset( expectedFrames );
+		probe->rawConnection = cam->getSignalRawFrame().connect( [probe]( const RawFrame & ) {
+			probe->arrival = std::chrono::steady_clock::now();
+		} );
+		probe->newFrameConnection = cam->getSignalNewFrame().connect( [probe]( const cinder::Surface8uRef & ) {
+			auto now = std::chrono::steady_clock::now();
+			probe->latencies.push_back( std::chrono::duration<double, std::micro>( now - probe->arrival ).count() );
+			double cpu = threadCpuSeconds();
+			if( probe->cpuFirst < 0.0 ) {
+				probe->cpuFirst = cpu;
+			}
+			probe->cpuLast = cpu;
+		} );
+		cameras.push_back( cam );
+	}
+
+	// stands in for an application update loop pulling frames at 60 Hz
+	std::atomic<bool> consuming( true );
+	std::thread consumer( [&]() {
+		while( consuming ) {
+			for( auto &cam : cameras ) {
+				if( cam->checkNewFrame() ) {
+					cam->getCurrentFrame();
+				}
+			}
+			std::this_thread::sleep_for( std::chrono::milliseconds( 16 ));
+		}
+	} );
+
+	auto start = std::chrono::steady_clock::now();
+	for( auto &cam : cameras ) {
+		cam->startContinuousImageAcquisition();
+	}
+	std::this_thread::sleep_for( std::chrono::duration<double>( stepSeconds ));
+	for( auto &cam : cameras ) {
+		cam->stopContinuousImageAcquisition();
+	}
+	double elapsed = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+	consuming = false;
+	consumer.join();
+
+	std::vector<double> latencies;
+	double cpuSum = 0.0;
+	for( unsigned i = 0; i < cameraCount; ++i ) {
+		FrameStatistics stats = cameras[i]->getFrameStatistics();
+		result.delivered += stats.framesDelivered;
+		result.missing += stats.framesMissing;
+		result.incomplete += stats.framesIncomplete;
+
+		SimulatedCameraRef sim = std::dynamic_pointer_cast<SimulatedCamera>( cameras[i]->getFrameSource() );
+		if( sim ) {
+			result.dropped += sim->getFramesDropped();
+		}
+
+		double cpuPercent = probes[i].cpuFirst < 0.0 ? 0.0 : 100.0 * ( probes[i].cpuLast - probes[i].cpuFirst ) / elapsed;
+		cpuSum += cpuPercent;
+		result.cpuPercentMax = std::max( result.cpuPercentMax, cpuPercent );
+
+		latencies.insert( latencies.end(), probes[i].latencies.begin(), probes[i].latencies.end() );
+		probes[i].rawConnection.disconnect();
+		probes[i].newFrameConnection.disconnect();
+	}
+
+	result.cpuPercentMean = cpuSum / cameraCount;
+	result.aggregateMegapixelsPerSec = static_cast<double>( result.delivered ) * baseOptions.getWidth()
+	                                   * baseOptions.getHeight() / elapsed / 1e6;
+	result.latencyP50 = percentile( latencies, 0.50 );
+	result.latencyP90 = percentile( latencies, 0.90 );
+	result.latencyP99 = percentile( latencies, 0.99 );
+	result.latencyMax = latencies.empty() ? 0.0 : *std::max_element( latencies.begin(), latencies.end() );
+	result.clean = ( 0 == result.missing && 0 == result.dropped && result.delivered > 0 );
+	return result;
+}
+
+void printStep( const StepResult &r, unsigned cameraCount )
+{
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision( 2 );
+	ss << "{\"step\":true,\"cameras\":" << cameraCount << ",\"fps\":" << r.fps
+	   << ",\"delivered\":" << r.delivered << ",\"missing\":" << r.missing << ",\"dropped\":" << r.dropped
+	   << ",\"incomplete\":" << r.incomplete
+	   << ",\"aggregateMegapixelsPerSec\":" << r.aggregateMegapixelsPerSec
+	   << ",\"cpuPercentMean\":" << r.cpuPercentMean << ",\"cpuPercentMax\":" << r.cpuPercentMax
+	   << ",\"latencyUsP50\":" << r.latencyP50 << ",\"latencyUsP90\":" << r.latencyP90
+	   << ",\"latencyUsP99\":" << r.latencyP99 << ",\"latencyUsMax\":" << r.latencyMax
+	   << ",\"clean\":" << ( r.clean ? "true" : "false" ) << "}";
+	std::cout << ss.str() << std::endl;
+}
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+	unsigned cameraCount = 12;
+	uint32_t width = 2448, height = 2048;
+	std::string format = "bayer8";
+	double startFps = 5.0, stepFps = 5.0, maxFps = 200.0, stepSeconds = 3.0;
+	uint32_t buffers = 5;
+
+	for( int i = 1; i < argc; ++i ) {
+		std::string arg( argv[i] );
+		bool hasValue = i + 1 < argc;
+		if( "--cameras" == arg && hasValue ) {
+			cameraCount = std::max( 1, std::atoi( argv[++i] ));
+		} else if( "--size" == arg && hasValue ) {
+			std::string size( argv[++i] );
+			size_t x = size.find( 'x' );
+			if( std::string::npos != x ) {
+				width = std::atoi( size.substr( 0, x ).c_str() );
+				height = std::atoi( size.substr( x + 1 ).c_str() );
+			}
+		} else if( "--format" == arg && hasValue ) {
+			format = argv[++i];
+		} else if( "--start-fps" == arg && hasValue ) {
+			startFps = std::atof( argv[++i] );
+		} else if( "--step-fps" == arg && hasValue ) {
+			stepFps = std::atof( argv[++i] );
+		} else if( "--max-fps" == arg && hasValue ) {
+			maxFps = std::atof( argv[++i] );
+		} else if( "--step-seconds" == arg && hasValue ) {
+			stepSeconds = std::atof( argv[++i] );
+		} else if( "--buffers" == arg && hasValue ) {
+			buffers = std::max( 1, std::atoi( argv[++i] ));
+		} else {
+			std::cerr << "usage: " << argv[0] << " [--cameras N] [--size WxH] [--format mono8|bayer8|bayer12|bayer12packed]"
+			          << " [--start-fps F] [--step-fps F] [--max-fps F] [--step-seconds S] [--buffers N]" << std::endl;
+			return 1;
+		}
+	}
+
+	if( 0 == width || 0 == height || startFps <= 0.0 || stepFps <= 0.0 || stepSeconds <= 0.0 ) {
+		std::cerr << "invalid size, frame rate or step length" << std::endl;
+		return 1;
+	}
+
+	ApiController api;
+	SimulatedCamera::Options options;
+	options.size( width, height ).pixelFormat( parseFormat( format ));
+
+	StepResult best = {};
+	bool haveBest = false;
+	for( double fps = startFps; fps <= maxFps; fps += stepFps ) {
+		StepResult step = runStep( api, cameraCount, options, fps, stepSeconds, buffers );
+		printStep( step, cameraCount );
+		if( ! step.clean ) {
+			break;
+		}
+		best = step;
+		haveBest = true;
+	}
+
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision( 2 );
+	ss << "{\"summary\":true,\"cameras\":" << cameraCount << ",\"width\":" << width << ",\"height\":" << height
+	   << ",\"format\":\"" << format << "\",\"maxSustainableFps\":" << ( haveBest ? best.fps : 0.0 )
+	   << ",\"maxSustainableMegapixelsPerSec\":" << ( haveBest ? best.aggregateMegapixelsPerSec : 0.0 )
+	   << ",\"cpuPercentPerCamera\":" << ( haveBest ? best.cpuPercentMean : 0.0 )
+	   << ",\"latencyUsP99\":" << ( haveBest ? best.latencyP99 : 0.0 ) << "}";
+	std::cout << ss.str() << std::endl;
+
+	return haveBest ? 0 : 2;
+}
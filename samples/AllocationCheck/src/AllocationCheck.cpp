@@ -0,0 +1,178 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Allocation budget check for the frame hot path.  Built with CIVIMBA_COUNT_ALLOCATIONS, it runs a simulated camera
+// through CameraController, skips the warm up frames, then counts heap allocations per delivered frame on the
+// acquisition thread (from raw frame arrival to handoff) and across all threads.  Exits with 1 when either count
+// exceeds the budget, so it can run in CI next to the build.
+//
+//  AllocationCheck [--frames N] [--warmup N] [--fps F] [--size WxH] [--matrix]
+//                  [--budget-allocs N] [--budget-bytes N] [--budget-total-allocs N]
+//
+// The default budget of 4 allocations per frame covers the output Surface8u and its shared_ptr, which the current
+// handoff design creates for every frame.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "civimba/AllocationCounter.h"
+#include "civimba/CiVimba.h"
+
+using namespace civimba;
+
+namespace {
+
+struct Accounting {
+	Accounting()
+		: frameIndex( 0 ), measuredFrames( 0 ), done( false )
+	{ }
+
+	allocation::Counts  frameStart;
+	allocation::Counts  callback;
+	allocation::Counts  totalStart;
+	allocation::Counts  totalEnd;
+	uint64_t            frameIndex;
+	uint64_t            measuredFrames;
+	std::atomic<bool>   done;
+};
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+	uint64_t frames = 500, warmup = 50;
+	double fps = 0.0;
+	uint32_t width = 1280, height = 1024;
+	bool matrix = false;
+	double budgetAllocs = 4.0, budgetBytes = 0.0, budgetTotalAllocs = 4.0;
+
+	for( int i = 1; i < argc; ++i ) {
+		std::string arg( argv[i] );
+		bool hasValue = i + 1 < argc;
+		if( "--frames" == arg && hasValue ) {
+			frames = std::max( 1, std::atoi( argv[++i] ));
+		} else if( "--warmup" == arg && hasValue ) {
+			warmup = std::max( 0, std::atoi( argv[++i] ));
+		} else if( "--fps" == arg && hasValue ) {
+			fps = std::atof( argv[++i] );
+		} else if( "--size" == arg && hasValue ) {
+			std::string size( argv[++i] );
+			size_t x = size.find( 'x' );
+			if( std::string::npos != x ) {
+				width = std::atoi( size.substr( 0, x ).c_str() );
+				height = std::atoi( size.substr( x + 1 ).c_str() );
+			}
+		} else if( "--matrix" == arg ) {
+			matrix = true;
+		} else if( "--budget-allocs" == arg && hasValue ) {
+			budgetAllocs = std::atof( argv[++i] );
+		} else if( "--budget-bytes" == arg && hasValue ) {
+			budgetBytes = std::atof( argv[++i] );
+		} else if( "--budget-total-allocs" == arg && hasValue ) {
+			budgetTotalAllocs = std::atof( argv[++i] );
+		} else {
+			std::cerr << "usage: " << argv[0] << " [--frames N] [--warmup N] [--fps F] [--size WxH] [--matrix]"
+			          << " [--budget-allocs N] [--budget-bytes N] [--budget-total-allocs N]" << std::endl;
+			return 1;
+		}
+	}
+
+	if( ! allocation::isEnabled() ) {
+		std::cerr << "AllocationCheck must be built with CIVIMBA_COUNT_ALLOCATIONS" << std::endl;
+		return 3;
+	}
+
+	ApiController api;
+	CameraControllerRef cam = api.getSimulatedCamera( SimulatedCamera::Options()
+	                                                  .size( width, height )
+	                                                  .frameRate( fps )
+	                                                  .frameLimit( warmup + frames ));
+	cam->setFrameLogging( FRAME_INFO_OFF );
+	cam->setColorProcessing( matrix ? COLOR_PROCESSING_MATRIX : COLOR_PROCESSING_OFF );
+
+	Accounting acc;
+	const uint64_t lastFrame = warmup + frames;
+
+	cinder::signals::Connection rawConnection = cam->getSignalRawFrame().connect( [&]( const RawFrame & ) {
+		if( acc.frameIndex == warmup ) {
+			acc.totalStart = allocation::getTotalCounts();
+		}
+		acc.frameStart = allocation::getThreadCounts();
+	} );
+	cinder::signals::Connection frameConnection = cam->getSignalNewFrame().connect( [&]( const cinder::Surface8uRef & ) {
+		allocation::Counts used = allocation::getThreadCounts() - acc.frameStart;
+		if( acc.frameIndex >= warmup ) {
+			acc.callback.allocations += used.allocations;
+			acc.callback.bytes += used.bytes;
+			++acc.measuredFrames;
+		}
+		if( ++acc.frameIndex == lastFrame ) {
+			acc.totalEnd = allocation::getTotalCounts();
+			acc.done = true;
+		}
+	} );
+
+	cam->startContinuousImageAcquisition();
+	while( ! acc.done && cam->getFrameSource()->isRunning() ) {
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10 ));
+	}
+	cam->stopContinuousImageAcquisition();
+	rawConnection.disconnect();
+	frameConnection.disconnect();
+
+	if( 0 == acc.measuredFrames || ! acc.done ) {
+		std::cerr << "no frames were delivered after warm up" << std::endl;
+		return 1;
+	}
+
+	allocation::Counts total = acc.totalEnd - acc.totalStart;
+	double n = static_cast<double>( acc.measuredFrames );
+	double callbackAllocs = acc.callback.allocations / n;
+	double callbackBytes = acc.callback.bytes / n;
+	double totalAllocs = total.allocations / n;
+	double totalBytes = total.bytes / n;
+
+	bool pass = callbackAllocs <= budgetAllocs
+	            && totalAllocs <= budgetTotalAllocs
+	            && ( budgetBytes <= 0.0 || callbackBytes <= budgetBytes );
+
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision( 2 );
+	ss << "{\"frames\":" << acc.measuredFrames << ",\"width\":" << width << ",\"height\":" << height
+	   << ",\"matrix\":" << ( matrix ? "true" : "false" )
+	   << ",\"callbackAllocsPerFrame\":" << callbackAllocs << ",\"callbackBytesPerFrame\":" << callbackBytes
+	   << ",\"totalAllocsPerFrame\":" << totalAllocs << ",\"totalBytesPerFrame\":" << totalBytes
+	   << ",\"budgetAllocs\":" << budgetAllocs << ",\"budgetTotalAllocs\":" << budgetTotalAllocs
+	   << ",\"budgetBytes\":" << budgetBytes
+	   << ",\"pass\":" << ( pass ? "true" : "false" ) << "}";
+	std::cout << ss.str() << std::endl;
+
+	return pass ? 0 : 1;
+}
@@ -91,11 +91,23 @@ void AsyncGrab::setup()
 {
 	mController.startup();
 	auto cameras = mController.getCameraList();
+	std::vector<std::string> ids;
 	for( auto &cam : cameras ) {
 		std::string id;
 		cam->GetID( id );
-		mCameras.push_back( mController.getCamera( id ));
+		ids.push_back( id );
+	}
+	// open all cameras at once instead of one after the other
+	for( auto &result : mController.getCameras( ids )) {
+		if( ! result.camera ) {
+			console() << "Unable to open " << result.cameraID << ": " << result.message << std::endl;
+			continue;
+		}
+		console() << "Opened " << result.cameraID << " in " << result.openTime + result.prepareTime << "s" << std::endl;
+		mCameras.push_back( result.camera );
 		mCameras.back()->setFrameLogging( civimba::FRAME_INFO_ERRORS );
+		// resume streaming by itself when the cable is plugged back in
+		mController.getCameraRegistry().setAutoReconnect( result.camera );
 	}
 	mTextures.resize( mCameras.size());
 	for( auto &cam : mCameras ) {
@@ -0,0 +1,318 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Headless round trip check and benchmark for FrameCodec and FrameCompressor.  Synthetic sensor-like frames (a
+// smooth scene with a Bayer color pattern and read noise) are encoded and decoded for every supported layout, for
+// odd sizes and for formats that are stored, and every decoded frame is compared byte for byte with the original.
+// A sequence of frames is then recorded through FrameCompressor into a capture file and read back with
+// CaptureReader and MappedCaptureReader.  One JSON object is written per case, the exit code is 1 if any frame did
+// not survive the round trip.
+//
+//  CompressionCheck [--threads N] [--file PATH] [--quick]
+//
+//  ratio                   raw bytes / encoded bytes
+//  encodeMBPerSec          raw bytes encoded per second on one thread
+//  decodeMBPerSec          raw bytes decoded per second on one thread
+//  parallelDecodeMBPerSec  raw bytes decoded per second with --threads threads
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "civimba/CaptureFile.h"
+#include "civimba/FrameCodec.h"
+#include "civimba/FrameCompressor.h"
+#include "civimba/MappedCaptureReader.h"
+#include "civimba/RawFrame.h"
+
+namespace {
+
+using namespace civimba;
+
+struct SizeCase {
+	const char  *name;
+	VmbUint32_t width;
+	VmbUint32_t height;
+	bool        quick;
+};
+
+struct FormatCase {
+	const char          *name;
+	VmbPixelFormatType  format;
+};
+
+const SizeCase sSizes[] = {
+	{ "1x1", 1, 1, true },
+	{ "odd", 101, 37, true },
+	{ "0.3MP", 640, 480, true },
+	{ "5MP", 2592, 1944, true },
+	{ "12MP", 4096, 3000, false },
+};
+
+const FormatCase sFormats[] = {
+	{ "Mono8", VmbPixelFormatMono8 },
+	{ "Mono12", VmbPixelFormatMono12 },
+	{ "Mono16", VmbPixelFormatMono16 },
+	{ "Mono12Packed", VmbPixelFormatMono12Packed },
+	{ "BayerRG8", VmbPixelFormatBayerRG8 },
+	{ "BayerGB12", VmbPixelFormatBayerGB12 },
+	{ "BayerRG12Packed", VmbPixelFormatBayerRG12Packed },
+	{ "RGB8", VmbPixelFormatRgb8 },
+};
+
+// deterministic 12 bit scene with a different gain per Bayer site and gaussian read noise, packed into format.
+// Formats other than 8, 16 and 12 bit packed get random bytes.
+std::vector<VmbUchar_t> makeSyntheticFrame( VmbPixelFormatType format, VmbUint32_t width, VmbUint32_t height,
+                                            uint32_t seed )
+{
+	std::vector<VmbUchar_t> data( RawFrame::getImageSize( format, width, height ));
+	std::mt19937 rng( seed );
+	const VmbUint32_t bits = RawFrame::getBitsPerPixel( format );
+	if( 8 != bits && 16 != bits && 12 != bits ) {
+		for( auto &byte : data ) {
+			byte = static_cast<VmbUchar_t>( rng() );
+		}
+		return data;
+	}
+
+	static const double sGain[4] = { 1.3, 1.0, 1.0, 0.7 };
+	std::normal_distribution<double> noise( 0.0, 6.0 );
+	const double phase = seed * 0.1;
+	std::vector<uint16_t> values( static_cast<size_t>( width ) * height );
+	for( VmbUint32_t y = 0; y < height; ++y ) {
+		for( VmbUint32_t x = 0; x < width; ++x ) {
+			double scene = 1000.0 + 800.0 * std::sin( x * 0.01 + phase ) * std::cos( y * 0.013 );
+			double value = scene * sGain[( x & 1 ) + ( y & 1 ) * 2] + noise( rng );
+			values[static_cast<size_t>( y ) * width + x] = static_cast<uint16_t>( std::min( 4095.0, std::max( 0.0, value )));
+		}
+	}
+
+	for( size_t i = 0; i < values.size(); ++i ) {
+		if( 8 == bits ) {
+			data[i] = static_cast<VmbUchar_t>( values[i] >> 4 );
+		} else if( 16 == bits ) {
+			data[2 * i] = static_cast<VmbUchar_t>( values[i] );
+			data[2 * i + 1] = static_cast<VmbUchar_t>( values[i] >> 8 );
+		} else if( 0 == i % 2 ) {
+			// GigE 12 bit packed: high bits of the first pixel, the low nibbles of both, high bits of the second
+			uint16_t second = i + 1 < values.size() ? values[i + 1] : 0;
+			VmbUchar_t *out = data.data() + i / 2 * 3;
+			out[0] = static_cast<VmbUchar_t>( values[i] >> 4 );
+			out[1] = static_cast<VmbUchar_t>(( values[i] & 0x0F ) | (( second & 0x0F ) << 4 ));
+			if( i + 1 < values.size() ) {
+				out[2] = static_cast<VmbUchar_t>( second >> 4 );
+			}
+		}
+	}
+	return data;
+}
+
+RawFrame makeFrame( const std::vector<VmbUchar_t> &data, VmbPixelFormatType format, VmbUint32_t width,
+                    VmbUint32_t height, VmbUint64_t frameID )
+{
+	RawFrame frame;
+	frame.buffer = data.data();
+	frame.imageSize = static_cast<VmbUint32_t>( data.size() );
+	frame.width = width;
+	frame.height = height;
+	frame.pixelFormat = format;
+	frame.frameID = frameID;
+	frame.frameIDValid = true;
+	frame.timestamp = frameID * 1000;
+	return frame;
+}
+
+// seconds per call of fn, repeated until about 0.2 seconds have passed
+template<typename Fn>
+double timeCall( Fn fn )
+{
+	auto start = std::chrono::steady_clock::now();
+	int calls = 0;
+	double seconds = 0.0;
+	do {
+		fn();
+		++calls;
+		seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	} while( seconds < 0.2 );
+	return seconds / calls;
+}
+
+bool checkCodec( const SizeCase &size, const FormatCase &format, unsigned threads )
+{
+	std::vector<VmbUchar_t> data = makeSyntheticFrame( format.format, size.width, size.height, 1 );
+	// a few trailing bytes beyond the image, as some cameras deliver, must survive as well
+	data.resize( data.size() + 3, 0xA5 );
+	RawFrame frame = makeFrame( data, format.format, size.width, size.height, 0 );
+
+	std::vector<VmbUchar_t> encoded, decoded, decodedParallel;
+	const double encodeSeconds = timeCall( [&] { FrameCodec::encode( frame, encoded ); } );
+	const double decodeSeconds = timeCall( [&] { FrameCodec::decode( encoded.data(), encoded.size(), decoded ); } );
+	const double parallelSeconds = timeCall( [&] {
+		FrameCodec::decode( encoded.data(), encoded.size(), decodedParallel, threads );
+	} );
+
+	// the parallel encoder has to produce the same data
+	std::vector<VmbUchar_t> encodedParallel;
+	FrameCodec::encode( frame, encodedParallel, threads );
+
+	bool truncatedRejected = false;
+	try {
+		std::vector<VmbUchar_t> scratch;
+		FrameCodec::decode( encoded.data(), encoded.size() - 1, scratch );
+	}
+	catch( const FrameCodec::FrameCodecException & ) {
+		truncatedRejected = true;
+	}
+
+	const bool ok = decoded == data && decodedParallel == data && encodedParallel == encoded && truncatedRejected;
+	const double megabytes = data.size() / ( 1024.0 * 1024.0 );
+
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision( 3 );
+	ss << "{\"size\":\"" << size.name << "\",\"width\":" << size.width << ",\"height\":" << size.height
+	   << ",\"format\":\"" << format.name << "\",\"threads\":" << threads
+	   << ",\"bytes\":" << data.size()
+	   << ",\"encodedBytes\":" << encoded.size()
+	   << ",\"ratio\":" << static_cast<double>( data.size() ) / encoded.size()
+	   << ",\"stored\":" << ( FrameCodec::isStored( encoded.data(), encoded.size() ) ? "true" : "false" )
+	   << ",\"encodeMBPerSec\":" << megabytes / encodeSeconds
+	   << ",\"decodeMBPerSec\":" << megabytes / decodeSeconds
+	   << ",\"parallelDecodeMBPerSec\":" << megabytes / parallelSeconds
+	   << ",\"result\":\"" << ( ok ? "ok" : "mismatch" ) << "\"}";
+	std::cout << ss.str() << std::endl;
+	return ok;
+}
+
+// FrameCompressor -> CaptureWriter -> CaptureReader / MappedCaptureReader
+bool checkRecording( const std::string &path, unsigned threads )
+{
+	const VmbUint32_t width = 1280, height = 1024;
+	const size_t frameCount = 24;
+	const VmbPixelFormatType formats[] = { VmbPixelFormatBayerRG12, VmbPixelFormatMono8, VmbPixelFormatRgb8 };
+
+	std::vector<std::vector<VmbUchar_t>> frames;
+	for( size_t i = 0; i < frameCount; ++i ) {
+		frames.push_back( makeSyntheticFrame( formats[i % 3], width, height, static_cast<uint32_t>( i + 1 )));
+	}
+
+	FrameCompressorStatistics statistics;
+	auto start = std::chrono::steady_clock::now();
+	{
+		CaptureWriter writer( path, "CompressionCheck", 1000000 );
+		FrameCompressor compressor( FrameCompressor::Options().threads( threads ).queueDepth( frameCount ),
+		                            [&writer]( const CaptureFrameHeader &header, const VmbUchar_t *data ) {
+			writer.writeRecord( header, data );
+		} );
+		for( size_t i = 0; i < frameCount; ++i ) {
+			compressor.write( makeFrame( frames[i], formats[i % 3], width, height, i ));
+		}
+		compressor.flush();
+		statistics = compressor.getStatistics();
+		writer.close();
+	}
+	const double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+	bool ok = frameCount == statistics.framesCompressed + statistics.framesStored && 0 == statistics.framesDropped;
+
+	CaptureReader reader( path );
+	CaptureFrameHeader header;
+	std::vector<VmbUchar_t> data;
+	size_t framesRead = 0;
+	while( reader.readNext( header, data )) {
+		ok = ok && framesRead < frameCount && header.frameID == framesRead && data == frames[framesRead]
+		     && 0 == ( header.flags & CAPTURE_FRAME_FLAG_COMPRESSED );
+		++framesRead;
+	}
+	ok = ok && frameCount == framesRead;
+
+	MappedCaptureReader mapped( path );
+	ok = ok && frameCount == mapped.getFrameCount() && ! mapped.wasIndexRebuilt();
+	std::vector<VmbUchar_t> decoded;
+	for( size_t i = 0; ok && i < mapped.getFrameCount(); ++i ) {
+		RawFrame frame = mapped.decodeFrame( mapped.findFrameID( i ), decoded, threads );
+		ok = frame.imageSize == frames[i].size() && std::equal( frames[i].begin(), frames[i].end(), frame.buffer );
+	}
+	std::remove( path.c_str() );
+
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision( 3 );
+	ss << "{\"case\":\"recording\",\"frames\":" << frameCount << ",\"threads\":" << threads
+	   << ",\"framesCompressed\":" << statistics.framesCompressed
+	   << ",\"framesStored\":" << statistics.framesStored
+	   << ",\"ratio\":" << static_cast<double>( statistics.bytesIn ) / std::max<uint64_t>( 1, statistics.bytesOut )
+	   << ",\"recordMBPerSec\":" << statistics.bytesIn / ( 1024.0 * 1024.0 ) / seconds
+	   << ",\"result\":\"" << ( ok ? "ok" : "mismatch" ) << "\"}";
+	std::cout << ss.str() << std::endl;
+	return ok;
+}
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+	unsigned threads = std::max( 1u, std::min( 4u, std::thread::hardware_concurrency() ));
+	std::string path = "CompressionCheck.capture";
+	bool quick = false;
+
+	for( int i = 1; i < argc; ++i ) {
+		std::string arg( argv[i] );
+		if( "--threads" == arg && i + 1 < argc ) {
+			threads = std::max( 1, std::atoi( argv[++i] ));
+		} else if( "--file" == arg && i + 1 < argc ) {
+			path = argv[++i];
+		} else if( "--quick" == arg ) {
+			quick = true;
+		} else {
+			std::cerr << "usage: " << argv[0] << " [--threads N] [--file PATH] [--quick]" << std::endl;
+			return 1;
+		}
+	}
+
+	bool ok = true;
+	try {
+		for( const auto &size : sSizes ) {
+			if( quick && ! size.quick ) {
+				continue;
+			}
+			for( const auto &format : sFormats ) {
+				ok = checkCodec( size, format, threads ) && ok;
+			}
+		}
+		ok = checkRecording( path, threads ) && ok;
+	}
+	catch( const BaseException &exc ) {
+		std::cerr << exc.Function() << ": " << exc.Message() << std::endl;
+		return 1;
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Headless checks of the camera controller paths that need no camera.  One JSON object is written per case, the exit
+// code is 1 if any case failed.
+//
+//  ControllerCheck
+//
+//  reconnectRetry  a reconnect that fails once is retried after the back-off and succeeds, removing the camera ends
+//                  the retries and stopping the schedule wakes its thread
+//  frameAccounting a forward gap in the frame IDs is counted as missing frames, a wrapped or restarted ID sequence is
+//                  not
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "civimba/CiVimba.h"
+
+namespace {
+
+using namespace civimba;
+
+bool report( const std::string &fields, bool ok )
+{
+	std::cout << "{" << fields << ",\"result\":\"" << ( ok ? "ok" : "mismatch" ) << "\"}" << std::endl;
+	return ok;
+}
+
+// the reconnect loop of CameraRegistry with a reopen that fails on its first attempt, like a camera still booting
+bool checkReconnectRetry()
+{
+	ReconnectSchedule schedule( ReconnectSchedule::Options().initialDelay( 0.05 ).maxDelay( 0.2 ));
+	std::atomic<int> attempts( 0 ), reconnects( 0 ), removals( 0 );
+	std::vector<double> delays;
+
+	std::thread worker( [&] {
+		ReconnectSchedule::Task task;
+		while( schedule.wait( task )) {
+			if( ! task.reconnect ) {
+				++removals;
+				continue;
+			}
+			if( "booting" == task.cameraID && 0 == attempts++ ) {
+				delays.push_back( schedule.retry( task ));
+			} else if( "gone" == task.cameraID ) {
+				delays.push_back( schedule.retry( task ));
+			} else {
+				++reconnects;
+			}
+		}
+	} );
+
+	const auto start = std::chrono::steady_clock::now();
+	schedule.schedule( "booting", true );
+	while( 0 == reconnects && std::chrono::steady_clock::now() - start < std::chrono::seconds( 2 )) {
+		std::this_thread::sleep_for( std::chrono::milliseconds( 5 ));
+	}
+	const double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	bool ok = 2 == attempts && 1 == reconnects && seconds >= 0.05;
+
+	// a camera that never comes back is retried until it is removed
+	schedule.schedule( "gone", true );
+	std::this_thread::sleep_for( std::chrono::milliseconds( 400 ));
+	schedule.schedule( "gone", false );
+	std::this_thread::sleep_for( std::chrono::milliseconds( 300 ));
+	ok = ok && 1 == removals && 0 == schedule.getPendingCount();
+
+	schedule.stop();
+	worker.join();
+
+	// the back-off doubles up to the maximum
+	ok = ok && delays.size() >= 3 && 0.05 == schedule.getDelay( 0 ) && 0.1 == schedule.getDelay( 1 )
+	     && 0.2 == schedule.getDelay( 2 ) && 0.2 == schedule.getDelay( 10 );
+
+	std::stringstream ss;
+	ss << "\"case\":\"reconnectRetry\",\"attempts\":" << attempts << ",\"reconnectSeconds\":" << seconds
+	   << ",\"retries\":" << delays.size();
+	return report( ss.str(), ok );
+}
+
+// the missing frame count of a FrameObserver fed the ID sequence, starting from fresh statistics
+VmbUint64_t countMissing( const std::vector<VmbUint64_t> &frameIDs )
+{
+	FrameObserver observer( "accounting", []( cinder::Surface8uRef & ) { }, FRAME_INFO_OFF, COLOR_PROCESSING_OFF );
+	for( VmbUint64_t frameID : frameIDs ) {
+		// incomplete frames are accounted without being transformed, so no image is needed
+		RawFrame frame;
+		frame.frameID = frameID;
+		frame.frameIDValid = true;
+		frame.receiveStatus = VmbFrameStatusIncomplete;
+		observer.frameReceived( frame );
+	}
+	return observer.getStatistics().framesMissing;
+}
+
+bool checkFrameAccounting()
+{
+	const VmbUint64_t gap = countMissing( { 1, 2, 5, 6 } );
+	// GigE block IDs are 16 bit and skip 0 when they wrap
+	const VmbUint64_t wrapped = countMissing( { 65533, 65534, 65535, 1, 2 } );
+	const VmbUint64_t restarted = countMissing( { 100, 101, 1, 2, 4 } );
+	const VmbUint64_t repeated = countMissing( { 7, 7, 8 } );
+
+	bool ok = 2 == gap && 0 == wrapped && 1 == restarted && 0 == repeated;
+
+	std::stringstream ss;
+	ss << "\"case\":\"frameAccounting\",\"gap\":" << gap << ",\"wrapped\":" << wrapped << ",\"restarted\":"
+	   << restarted << ",\"repeated\":" << repeated;
+	return report( ss.str(), ok );
+}
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+	if( argc > 1 ) {
+		std::cerr << "usage: " << argv[0] << std::endl;
+		return 1;
+	}
+
+	bool ok = true;
+	try {
+		ok = checkReconnectRetry() && ok;
+		ok = checkFrameAccounting() && ok;
+	}
+	catch( const BaseException &exc ) {
+		std::cerr << exc.Function() << ": " << exc.Message() << std::endl;
+		return 1;
+	}
+
+	return ok ? 0 : 1;
+}
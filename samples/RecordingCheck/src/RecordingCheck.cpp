@@ -0,0 +1,421 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Headless round trip check of the recording, streaming and multi camera modules.  Stamped synthetic frames are
+// recorded through DiskWriter (each backend), MappedRecorder (linear, ring and an empty ring), FrameHistory and
+// SyncRecorder and read back with CaptureReader and SyncCaptureReader, streamed through FrameStreamServer to a
+// FrameStreamClient and assembled by FrameSetAssembler, and StreamTuner settings are saved and loaded again.  Every
+// frame is compared byte for byte with what was written.  One JSON object is written per case, the exit code is 1 if
+// any case failed.
+//
+//  RecordingCheck [--dir PATH] [--frames N]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "civimba/CiVimba.h"
+
+namespace {
+
+using namespace civimba;
+
+const VmbUint32_t kWidth = 320;
+const VmbUint32_t kHeight = 240;
+
+// every byte depends on the frame ID, so a frame read back from the wrong record or a torn copy is detected
+std::vector<VmbUchar_t> makeStampedImage( VmbUint32_t width, VmbUint32_t height, uint64_t frameID )
+{
+	std::vector<VmbUchar_t> data( RawFrame::getImageSize( VmbPixelFormatMono8, width, height ));
+	for( size_t i = 0; i < data.size(); ++i ) {
+		data[i] = static_cast<VmbUchar_t>( frameID * 31 + i * 7 );
+	}
+	return data;
+}
+
+bool checkStamp( const RawFrame &frame )
+{
+	if( nullptr == frame.buffer || frame.imageSize != RawFrame::getImageSize( VmbPixelFormatMono8, frame.width, frame.height )) {
+		return false;
+	}
+	for( size_t i = 0; i < frame.imageSize; ++i ) {
+		if( frame.buffer[i] != static_cast<VmbUchar_t>( frame.frameID * 31 + i * 7 )) {
+			return false;
+		}
+	}
+	return true;
+}
+
+RawFrame makeFrame( const std::vector<VmbUchar_t> &data, VmbUint32_t width, VmbUint32_t height, uint64_t frameID )
+{
+	RawFrame frame;
+	frame.buffer = data.data();
+	frame.imageSize = static_cast<VmbUint32_t>( data.size() );
+	frame.width = width;
+	frame.height = height;
+	frame.pixelFormat = VmbPixelFormatMono8;
+	frame.frameID = frameID;
+	frame.frameIDValid = true;
+	frame.timestamp = frameID * 1000;
+	frame.receiveStatus = VmbFrameStatusComplete;
+	return frame;
+}
+
+// the width changes from frame to frame, except in ring files whose slots have one size
+VmbUint32_t getWidth( uint64_t frameID, bool varying )
+{
+	static const VmbUint32_t sWidths[] = { kWidth, 101, 640 };
+	return varying ? sWidths[frameID % 3] : kWidth;
+}
+
+// reads path and checks that it holds the frames firstID, firstID + 1, ... intact, returns the number of frames
+size_t readCapture( const std::string &path, uint64_t firstID, bool &ok )
+{
+	CaptureReader reader( path );
+	CaptureFrameHeader header;
+	std::vector<VmbUchar_t> data;
+	size_t frames = 0;
+	while( reader.readNext( header, data )) {
+		RawFrame frame = makeRawFrame( header, data.data() );
+		ok = ok && frame.frameID == firstID + frames && checkStamp( frame );
+		++frames;
+	}
+	return frames;
+}
+
+bool report( const std::string &fields, bool ok )
+{
+	std::cout << "{" << fields << ",\"result\":\"" << ( ok ? "ok" : "mismatch" ) << "\"}" << std::endl;
+	return ok;
+}
+
+bool checkDiskWriter( const std::string &path, DiskWriterBackend backend, size_t frameCount )
+{
+	DiskWriterBackend used = backend;
+	DiskWriterStatistics statistics;
+	bool ok = true;
+	{
+		DiskWriter writer( DiskWriter::Options( path ).backend( backend ).maxWait( 1.0 ), "RecordingCheck", 1000000 );
+		used = writer.getBackend();
+		for( size_t i = 0; i < frameCount; ++i ) {
+			const VmbUint32_t width = getWidth( i, true );
+			std::vector<VmbUchar_t> data = makeStampedImage( width, kHeight, i );
+			ok = writer.write( makeFrame( data, width, kHeight, i )) && ok;
+		}
+		writer.close();
+		statistics = writer.getStatistics();
+		ok = ok && ! writer.hasFailed() && 0 == statistics.framesDropped;
+	}
+	const size_t framesRead = readCapture( path, 0, ok );
+	ok = ok && frameCount == framesRead;
+	std::remove( path.c_str() );
+
+	std::stringstream ss;
+	ss << "\"case\":\"diskWriter\",\"backend\":\"" << ( DISK_WRITER_IO_URING == used ? "io_uring" : "thread" ) << "\""
+	   << ",\"frames\":" << frameCount << ",\"framesRead\":" << framesRead
+	   << ",\"submissions\":" << statistics.submissions << ",\"maxBuffersQueued\":" << statistics.maxBuffersQueued;
+	return report( ss.str(), ok );
+}
+
+bool checkMappedRecorder( const std::string &path, bool ring, size_t frameCount )
+{
+	const size_t recordBytes = sizeof( CaptureFrameHeader ) + RawFrame::getImageSize( VmbPixelFormatMono8, 640, kHeight );
+	// a ring of a few slots wraps several times, a linear file holds every frame
+	const uint64_t capacity = ring ? 4096 + 8 * recordBytes : 4096 + 2 * frameCount * recordBytes;
+
+	uint64_t slots = 0;
+	bool ok = true;
+	{
+		MappedRecorder recorder( MappedRecorder::Options( path ).capacity( capacity ).ring( ring ), "RecordingCheck", 1000000 );
+		for( size_t i = 0; i < frameCount; ++i ) {
+			const VmbUint32_t width = getWidth( i, ! ring );
+			std::vector<VmbUchar_t> data = makeStampedImage( width, kHeight, i );
+			ok = recorder.write( makeFrame( data, width, kHeight, i )) && ok;
+		}
+		slots = recorder.getSlotCount();
+		ok = ok && frameCount == recorder.getFramesWritten() && 0 == recorder.getFramesDropped();
+		recorder.close();
+	}
+	// a ring keeps the newest frames, one closed before its first frame reads back empty
+	const size_t expected = ring ? static_cast<size_t>( std::min<uint64_t>( slots, frameCount )) : frameCount;
+	const size_t framesRead = readCapture( path, frameCount - expected, ok );
+	ok = ok && expected == framesRead && ( ! ring || slots > 0 || 0 == frameCount );
+	std::remove( path.c_str() );
+
+	std::stringstream ss;
+	ss << "\"case\":\"mappedRecorder\",\"ring\":" << ( ring ? "true" : "false" ) << ",\"frames\":" << frameCount
+	   << ",\"slots\":" << slots << ",\"framesRead\":" << framesRead;
+	return report( ss.str(), ok );
+}
+
+bool checkFrameHistory( const std::string &path, size_t frameCount )
+{
+	const size_t keep = std::min<size_t>( 10, frameCount );
+	std::atomic<bool> dumped( false );
+	size_t dumpedFrames = 0;
+	bool ok = true;
+	{
+		FrameHistory history( FrameHistory::Options().maxFrames( keep )
+		                      .frameSize( RawFrame::getImageSize( VmbPixelFormatMono8, kWidth, kHeight )),
+		                      "RecordingCheck", 1000000 );
+		for( size_t i = 0; i < frameCount; ++i ) {
+			std::vector<VmbUchar_t> data = makeStampedImage( kWidth, kHeight, i );
+			ok = history.write( makeFrame( data, kWidth, kHeight, i )) && ok;
+		}
+		ok = ok && keep == history.getFrameCount();
+		ok = history.trigger( path, [&]( const std::string &, size_t frames, bool success ) {
+			dumpedFrames = frames;
+			dumped = success;
+		} ) && ok;
+		history.waitForDumps();
+		ok = ok && dumped && 0 == history.getFrameCount() && 0 == history.getFramesDropped();
+	}
+	const size_t framesRead = readCapture( path, frameCount - keep, ok );
+	ok = ok && keep == framesRead && keep == dumpedFrames;
+	std::remove( path.c_str() );
+
+	std::stringstream ss;
+	ss << "\"case\":\"frameHistory\",\"frames\":" << frameCount << ",\"kept\":" << keep << ",\"framesRead\":" << framesRead;
+	return report( ss.str(), ok );
+}
+
+// three cameras on a common trigger with different clocks and delivery latencies, the second one misses a frame
+bool checkSyncRecorder( const std::string &path, size_t frameCount )
+{
+	const uint64_t frequencies[] = { 1000000, 0, 1000000000 };
+	const uint64_t period = 33000000, start = 1000000000;
+	const size_t missing = frameCount / 2;
+	auto trigger = [&]( size_t i ) { return start + i * period; };
+
+	std::vector<CaptureStreamEntry> streams;
+	for( size_t s = 0; s < 3; ++s ) {
+		streams.push_back( makeCaptureStreamEntry( "RecordingCheck-" + std::to_string( s ), frequencies[s] ));
+	}
+
+	bool ok = true;
+	uint64_t groups = 0;
+	{
+		SyncRecorder recorder( SyncRecorder::Options( path ).window( 0.002 ), streams );
+		std::vector<VmbUchar_t> data;
+		for( size_t i = 0; i < frameCount; ++i ) {
+			data = makeStampedImage( kWidth, kHeight, i );
+			for( size_t s = 0; s < 3; ++s ) {
+				if( 1 == s && missing == i ) {
+					continue;
+				}
+				RawFrame frame = makeFrame( data, kWidth, kHeight, i );
+				// camera clocks with their own offsets, the frequency 0 camera is timed by arrival
+				frame.timestamp = 0 == s ? ( trigger( i ) + 123456789000ULL ) / 1000 : 2 == s ? trigger( i ) + 5000000000ULL : 0;
+				ok = recorder.write( s, frame, trigger( i ) + 3000000 + (( i * 7 + s * 3 ) % 5 ) * 100000 ) && ok;
+			}
+		}
+		recorder.close();
+		groups = recorder.getGroupCount();
+	}
+
+	SyncCaptureReader reader( path );
+	size_t complete = 0;
+	for( size_t g = 0; g < reader.getGroupCount(); ++g ) {
+		size_t frames = 0;
+		for( size_t s = 0; s < reader.getStreamCount(); ++s ) {
+			RawFrame frame;
+			if( reader.getFrame( g, s, frame )) {
+				ok = ok && frame.frameID == g && checkStamp( frame );
+				++frames;
+			}
+		}
+		complete += 3 == frames;
+	}
+	const size_t found = reader.findGroup( trigger( missing ) + 3500000 );
+	RawFrame frame;
+	ok = ok && frameCount == groups && frameCount == reader.getGroupCount() && frameCount - 1 == complete
+	     && ! reader.wasGroupIndexRebuilt() && missing == found && ! reader.getFrame( found, 1, frame )
+	     && SyncCaptureReader::npos == reader.findGroup( 0 );
+	std::remove( path.c_str() );
+
+	std::stringstream ss;
+	ss << "\"case\":\"syncRecorder\",\"frames\":" << frameCount << ",\"groups\":" << groups << ",\"completeGroups\":" << complete;
+	return report( ss.str(), ok );
+}
+
+bool checkFrameStream( const std::string &path, size_t frameCount )
+{
+	FrameStreamServer server( FrameStreamServer::Options( path ), "RecordingCheck", 1000000 );
+	FrameStreamClient client( path );
+
+	std::atomic<bool> done( false );
+	uint64_t received = 0, lastID = 0;
+	bool clientOk = std::string( client.getStreamHeader().cameraID ) == "RecordingCheck";
+	std::thread reader( [&] {
+		RawFrame frame;
+		while( ! done || client.readNext( frame, 0.2 )) {
+			if( 0 == frame.imageSize && ! client.readNext( frame, 0.05 )) {
+				continue;
+			}
+			// frames may be skipped, never reordered or torn
+			clientOk = clientOk && ( 0 == received || frame.frameID > lastID ) && checkStamp( frame );
+			lastID = frame.frameID;
+			++received;
+			frame.imageSize = 0;
+		}
+	} );
+
+	bool ok = true;
+	for( size_t i = 1; i <= frameCount; ++i ) {
+		std::vector<VmbUchar_t> data = makeStampedImage( kWidth, kHeight, i );
+		ok = server.write( makeFrame( data, kWidth, kHeight, i )) && ok;
+		std::this_thread::sleep_for( std::chrono::milliseconds( 2 ));
+	}
+	std::this_thread::sleep_for( std::chrono::milliseconds( 200 ));
+	done = true;
+	reader.join();
+	FrameStreamStatistics statistics = server.getStatistics();
+	server.close();
+
+	RawFrame frame;
+	ok = ok && clientOk && received > 0 && lastID == frameCount && ! client.readNext( frame, 0.5 ) && ! client.isConnected();
+
+	std::stringstream ss;
+	ss << "\"case\":\"frameStream\",\"frames\":" << frameCount << ",\"received\":" << received
+	   << ",\"framesSkipped\":" << statistics.framesSkipped << ",\"framesDropped\":" << statistics.framesDropped;
+	return report( ss.str(), ok );
+}
+
+// two cameras matched by frame ID, the second misses a frame, then both restart their frame IDs
+bool checkFrameSetAssembler( size_t frameCount )
+{
+	const size_t restartFrames = 10, missing = frameCount / 2;
+	FrameSetAssembler assembler( FrameSetAssembler::Options().match( FRAME_SET_MATCH_FRAME_ID )
+	                             .queueDepth( static_cast<uint32_t>( frameCount + restartFrames )),
+	                             std::vector<uint64_t>( 2, 0 ));
+	cinder::Surface8uRef surface = cinder::Surface8u::create( 4, 4, false );
+
+	uint64_t arrival = 1000000000;
+	for( size_t i = 0; i < frameCount + restartFrames; ++i, arrival += 33000000 ) {
+		const uint64_t frameID = i < frameCount ? 5000 + i : i - frameCount;
+		assembler.addFrame( 0, surface, frameID, true, 0, arrival );
+		if( missing != i ) {
+			assembler.addFrame( 1, surface, frameID, true, 0, arrival + 1000 );
+		}
+	}
+	assembler.flush();
+
+	bool ok = true;
+	size_t complete = 0, incomplete = 0;
+	FrameSet set;
+	while( assembler.tryPop( set )) {
+		ok = ok && 2 == set.frames.size() && ( ! set.complete || ( set.frames[0].surface && set.frames[1].surface ));
+		set.complete ? ++complete : ++incomplete;
+	}
+	FrameSetStatistics statistics = assembler.getStatistics();
+	ok = ok && frameCount + restartFrames - 1 == complete && 1 == incomplete && 0 == statistics.framesLate
+	     && 1 == statistics.restarts && 0 == statistics.setsDropped;
+
+	std::stringstream ss;
+	ss << "\"case\":\"frameSetAssembler\",\"frames\":" << frameCount + restartFrames << ",\"setsComplete\":" << complete
+	   << ",\"setsIncomplete\":" << incomplete << ",\"restarts\":" << statistics.restarts;
+	return report( ss.str(), ok );
+}
+
+bool checkStreamTuner( const std::string &path )
+{
+	std::map<std::string, StreamSettings> settings;
+	settings["RecordingCheck-0"].packetSize = 8228;
+	settings["RecordingCheck-0"].numberFrames = 12;
+	settings["RecordingCheck-1"].packetSize = 1500;
+	settings["RecordingCheck-1"].numberFrames = 3;
+	settings["RecordingCheck-1"].streamBytesPerSecond = 62500000;
+	StreamTuner::save( path, settings );
+	std::map<std::string, StreamSettings> loaded = StreamTuner::load( path );
+	std::remove( path.c_str() );
+
+	bool ok = settings.size() == loaded.size();
+	for( const auto &entry : settings ) {
+		const StreamSettings &other = loaded[entry.first];
+		ok = ok && entry.second.packetSize == other.packetSize && entry.second.numberFrames == other.numberFrames
+		     && entry.second.streamBytesPerSecond == other.streamBytesPerSecond;
+	}
+
+	// every frame beats a higher frame rate, a failed trial never wins
+	StreamTrialResult complete, fast, failed;
+	complete.completeRate = 1.0;
+	complete.frameRate = 30.0;
+	fast.completeRate = 0.9;
+	fast.frameRate = 60.0;
+	failed.error = VmbErrorTimeout;
+	ok = ok && StreamTuner::isBetter( complete, fast ) && ! StreamTuner::isBetter( fast, complete )
+	     && StreamTuner::isBetter( fast, failed ) && ! StreamTuner::isBetter( failed, fast );
+
+	std::stringstream ss;
+	ss << "\"case\":\"streamTuner\",\"cameras\":" << settings.size();
+	return report( ss.str(), ok );
+}
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+	std::string dir = ".";
+	size_t frameCount = 60;
+
+	for( int i = 1; i < argc; ++i ) {
+		std::string arg( argv[i] );
+		if( "--dir" == arg && i + 1 < argc ) {
+			dir = argv[++i];
+		} else if( "--frames" == arg && i + 1 < argc ) {
+			frameCount = static_cast<size_t>( std::max( 2, std::atoi( argv[++i] )));
+		} else {
+			std::cerr << "usage: " << argv[0] << " [--dir PATH] [--frames N]" << std::endl;
+			return 1;
+		}
+	}
+	const std::string base = dir + "/RecordingCheck";
+
+	bool ok = true;
+	try {
+		ok = checkDiskWriter( base + ".capture", DISK_WRITER_THREAD, frameCount ) && ok;
+		ok = checkDiskWriter( base + ".capture", DISK_WRITER_AUTO, frameCount ) && ok;
+		ok = checkMappedRecorder( base + ".capture", false, frameCount ) && ok;
+		ok = checkMappedRecorder( base + ".capture", true, frameCount ) && ok;
+		ok = checkMappedRecorder( base + ".capture", true, 0 ) && ok;
+		ok = checkFrameHistory( base + ".capture", frameCount ) && ok;
+		ok = checkSyncRecorder( base + ".capture", frameCount ) && ok;
+		ok = checkFrameStream( base + ".sock", frameCount ) && ok;
+		ok = checkFrameSetAssembler( frameCount ) && ok;
+		ok = checkStreamTuner( base + ".txt" ) && ok;
+	}
+	catch( const BaseException &exc ) {
+		std::cerr << exc.Function() << ": " << exc.Message() << std::endl;
+		return 1;
+	}
+
+	return ok ? 0 : 1;
+}
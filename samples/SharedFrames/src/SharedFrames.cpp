@@ -0,0 +1,293 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Shared memory frame publishing between processes.
+//
+//  SharedFrames publish [--name NAME] [--size WxH] [--fps F] [--seconds S] [--slots N]
+//      streams a simulated camera into the shared memory ring NAME through SharedFramePublisher
+//
+//  SharedFrames consume [--name NAME] [--seconds S]
+//      reads the ring with SharedFrameConsumer and prints one JSON object per second
+//
+//  SharedFrames check [--size WxH] [--fps F] [--frames N] [--slots N]
+//      forks a consumer, publishes stamped synthetic frames and verifies every frame the consumer read.  Exits with
+//      1 if a frame that passed SharedFrameConsumer::isValid() did not hold what was published.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "civimba/CiVimba.h"
+
+using namespace civimba;
+
+namespace {
+
+struct Settings {
+	Settings()
+		: name( "civimba-frames" ), width( 1280 ), height( 1024 ), fps( 100.0 ), seconds( 10.0 ), frames( 1000 ),
+		  slots( 8 )
+	{ }
+
+	std::string name;
+	uint32_t    width;
+	uint32_t    height;
+	double      fps;
+	double      seconds;
+	uint64_t    frames;
+	uint32_t    slots;
+};
+
+struct ConsumerCounts {
+	uint64_t frames;
+	uint64_t bytes;
+	uint64_t overwritten;   // views that were overwritten while they were checked
+	uint64_t torn;          // views that passed isValid() with the wrong content
+};
+
+const size_t sStampStride = 4096;
+
+// frame content is derived from the frame ID, so the consumer can check it without knowing the publisher state
+void stampFrame( std::vector<VmbUchar_t> &data, uint64_t frameID )
+{
+	for( size_t i = 0; i < data.size(); i += sStampStride ) {
+		data[i] = static_cast<VmbUchar_t>( frameID + i / sStampStride );
+	}
+	std::memcpy( data.data(), &frameID, std::min( sizeof( frameID ), data.size() ));
+}
+
+bool checkStamp( const RawFrame &frame )
+{
+	uint64_t frameID = 0;
+	if( frame.imageSize < sizeof( frameID )) {
+		return false;
+	}
+	std::memcpy( &frameID, frame.buffer, sizeof( frameID ));
+	for( size_t i = sStampStride; i < frame.imageSize; i += sStampStride ) {
+		if( frame.buffer[i] != static_cast<VmbUchar_t>( frameID + i / sStampStride )) {
+			return false;
+		}
+	}
+	return frameID == frame.frameID;
+}
+
+std::string toJson( const SharedFrameConsumer &consumer, const ConsumerCounts &counts, double seconds )
+{
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision( 2 );
+	ss << "{\"camera\":\"" << consumer.getCameraID() << "\",\"frames\":" << counts.frames
+	   << ",\"fps\":" << counts.frames / seconds
+	   << ",\"mbPerSec\":" << counts.bytes / ( 1024.0 * 1024.0 ) / seconds
+	   << ",\"missed\":" << consumer.getFramesMissed()
+	   << ",\"overwritten\":" << counts.overwritten
+	   << ",\"torn\":" << counts.torn << "}";
+	return ss.str();
+}
+
+SharedFrameConsumerRef openConsumer( const std::string &name, double timeout )
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>( timeout );
+	for( ;; ) {
+		try {
+			return SharedFrameConsumerRef( new SharedFrameConsumer( name ));
+		}
+		catch( const SharedFrameConsumer::SharedFrameConsumerException & ) {
+			if( std::chrono::steady_clock::now() >= deadline ) {
+				throw;
+			}
+			std::this_thread::sleep_for( std::chrono::milliseconds( 10 ));
+		}
+	}
+}
+
+int runPublish( const Settings &settings )
+{
+	ApiController api;
+	CameraControllerRef cam = api.getSimulatedCamera( SimulatedCamera::Options()
+	                                                  .size( settings.width, settings.height )
+	                                                  .frameRate( settings.fps ));
+	cam->setFrameLogging( FRAME_INFO_OFF );
+
+	SharedFramePublisher publisher( SharedFramePublisher::Options( settings.name )
+	                                .slotCount( settings.slots )
+	                                .maxImageSize( RawFrame::getImageSize( VmbPixelFormatMono8, settings.width, settings.height )),
+	                                *cam );
+	std::cerr << "publishing to " << publisher.getName() << std::endl;
+
+	cam->startContinuousImageAcquisition();
+	std::this_thread::sleep_for( std::chrono::duration<double>( settings.seconds ));
+	cam->stopContinuousImageAcquisition();
+	publisher.close();
+
+	std::cout << "{\"published\":" << publisher.getFramesPublished() << ",\"dropped\":" << publisher.getFramesDropped()
+	          << "}" << std::endl;
+	return 0;
+}
+
+int runConsume( const Settings &settings )
+{
+	SharedFrameConsumerRef consumer = openConsumer( settings.name, settings.seconds );
+	ConsumerCounts counts = { 0, 0, 0, 0 };
+	const auto end = std::chrono::steady_clock::now() + std::chrono::duration<double>( settings.seconds );
+	auto reportStart = std::chrono::steady_clock::now();
+
+	RawFrame frame;
+	uint64_t sequence = 0;
+	while( std::chrono::steady_clock::now() < end && ! consumer->isPublisherClosed() ) {
+		if( consumer->waitNext( frame, sequence, 0.1 )) {
+			++counts.frames;
+			counts.bytes += frame.imageSize;
+		}
+		auto now = std::chrono::steady_clock::now();
+		double elapsed = std::chrono::duration<double>( now - reportStart ).count();
+		if( elapsed >= 1.0 ) {
+			std::cout << toJson( *consumer, counts, elapsed ) << std::endl;
+			counts = ConsumerCounts();
+			reportStart = now;
+		}
+	}
+	return 0;
+}
+
+int runCheck( const Settings &settings )
+{
+	const std::string name = settings.name + "-check-" + std::to_string( ::getpid() );
+	std::vector<VmbUchar_t> data( RawFrame::getImageSize( VmbPixelFormatMono8, settings.width, settings.height ));
+	SharedFramePublisher publisher( SharedFramePublisher::Options( name )
+	                                .slotCount( settings.slots )
+	                                .maxImageSize( data.size() ), "SharedFrames", 1000000 );
+
+	pid_t child = ::fork();
+	if( child < 0 ) {
+		std::cerr << "fork failed" << std::endl;
+		return 1;
+	}
+	if( 0 == child ) {
+		SharedFrameConsumerRef consumer = openConsumer( name, 5.0 );
+		ConsumerCounts counts = { 0, 0, 0, 0 };
+		auto start = std::chrono::steady_clock::now();
+		RawFrame frame;
+		uint64_t sequence = 0;
+		while( consumer->waitNext( frame, sequence, 5.0 ) || ! consumer->isPublisherClosed() ) {
+			if( 0 == frame.imageSize ) {
+				continue;
+			}
+			const bool stampOk = checkStamp( frame );
+			if( ! consumer->isValid( sequence )) {
+				++counts.overwritten;
+			} else if( ! stampOk ) {
+				++counts.torn;
+			}
+			++counts.frames;
+			counts.bytes += frame.imageSize;
+			frame.imageSize = 0;
+		}
+		double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+		std::cout << toJson( *consumer, counts, seconds ) << std::endl;
+		::_exit( counts.torn > 0 || 0 == counts.frames ? 1 : 0 );
+	}
+
+	// give the consumer time to map the ring so it sees the first frames
+	std::this_thread::sleep_for( std::chrono::milliseconds( 200 ));
+	const auto interval = std::chrono::duration<double>( settings.fps > 0.0 ? 1.0 / settings.fps : 0.0 );
+	auto next = std::chrono::steady_clock::now();
+	for( uint64_t i = 1; i <= settings.frames; ++i ) {
+		stampFrame( data, i );
+		RawFrame frame;
+		frame.buffer = data.data();
+		frame.imageSize = static_cast<VmbUint32_t>( data.size() );
+		frame.width = settings.width;
+		frame.height = settings.height;
+		frame.frameID = i;
+		frame.frameIDValid = true;
+		publisher.write( frame );
+		if( settings.fps > 0.0 ) {
+			next += std::chrono::duration_cast<std::chrono::steady_clock::duration>( interval );
+			std::this_thread::sleep_until( next );
+		}
+	}
+	publisher.close();
+
+	int status = 0;
+	::waitpid( child, &status, 0 );
+	return WIFEXITED( status ) ? WEXITSTATUS( status ) : 1;
+}
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+	Settings settings;
+	std::string mode = argc > 1 ? argv[1] : "";
+	bool valid = "publish" == mode || "consume" == mode || "check" == mode;
+
+	for( int i = 2; valid && i < argc; ++i ) {
+		std::string arg( argv[i] );
+		bool hasValue = i + 1 < argc;
+		if( "--name" == arg && hasValue ) {
+			settings.name = argv[++i];
+		} else if( "--size" == arg && hasValue ) {
+			valid = 2 == std::sscanf( argv[++i], "%ux%u", &settings.width, &settings.height );
+		} else if( "--fps" == arg && hasValue ) {
+			settings.fps = std::max( 0.0, std::atof( argv[++i] ));
+		} else if( "--seconds" == arg && hasValue ) {
+			settings.seconds = std::max( 0.1, std::atof( argv[++i] ));
+		} else if( "--frames" == arg && hasValue ) {
+			settings.frames = std::max( 1, std::atoi( argv[++i] ));
+		} else if( "--slots" == arg && hasValue ) {
+			settings.slots = std::max( 1, std::atoi( argv[++i] ));
+		} else {
+			valid = false;
+		}
+	}
+	if( ! valid ) {
+		std::cerr << "usage: " << argv[0] << " publish|consume|check [--name NAME] [--size WxH] [--fps F]"
+		          << " [--seconds S] [--frames N] [--slots N]" << std::endl;
+		return 1;
+	}
+
+	try {
+		if( "publish" == mode ) {
+			return runPublish( settings );
+		} else if( "consume" == mode ) {
+			return runConsume( settings );
+		}
+		return runCheck( settings );
+	}
+	catch( const BaseException &exc ) {
+		std::cerr << exc.Function() << ": " << exc.Message() << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,283 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Headless benchmark for TransformImage.  Synthetic Mono/Bayer/YUV/packed frames from 0.3 to 20 MP are run
+// through every transform path used by FrameObserver, single and multi-threaded.  One JSON object is written
+// per case to stdout so results can be diffed or tracked between Vimba versions and code changes.
+//
+//  TransformBenchmark [--threads N] [--budget MEGAPIXELS] [--quick]
+//
+//  mbPerSec        raw input bytes converted per second, all threads combined
+//  nsPerPixel      wall time per pixel for a single thread (elapsed * threads / pixels)
+//  allocsPerFrame  C++ heap allocations per converted frame (VmbImageTransform's own C allocations are not seen)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "civimba/AllocationCounter.h"
+#include "civimba/RawFrame.h"
+#include "civimba/TransformImage.h"
+#include "civimba/ErrorCodeToMessage.h"
+
+namespace {
+
+using namespace civimba;
+
+struct SizeCase {
+	const char  *name;
+	VmbUint32_t width;
+	VmbUint32_t height;
+};
+
+struct FormatCase {
+	const char          *name;
+	VmbPixelFormatType  format;
+};
+
+struct PathCase {
+	const char  *name;
+	const char  *destination;
+	bool        matrix;
+};
+
+const SizeCase sSizes[] = {
+	{ "0.3MP", 640, 480 },
+	{ "1.3MP", 1280, 1024 },
+	{ "5MP", 2592, 1944 },
+	{ "12MP", 4096, 3000 },
+	{ "20MP", 5472, 3648 },
+};
+
+const FormatCase sFormats[] = {
+	{ "Mono8", VmbPixelFormatMono8 },
+	{ "Mono12", VmbPixelFormatMono12 },
+	{ "Mono12Packed", VmbPixelFormatMono12Packed },
+	{ "BayerRG8", VmbPixelFormatBayerRG8 },
+	{ "BayerRG12", VmbPixelFormatBayerRG12 },
+	{ "BayerRG12Packed", VmbPixelFormatBayerRG12Packed },
+	{ "YUV411", VmbPixelFormatYuv411 },
+	{ "YUV422", VmbPixelFormatYuv422 },
+};
+
+// the same paths FrameObserver takes for COLOR_PROCESSING_OFF and COLOR_PROCESSING_MATRIX
+const PathCase sPaths[] = {
+	{ "RGB24", "RGB24", false },
+	{ "BGR24", "BGR24", false },
+	{ "BGR24_matrix", "BGR24", true },
+};
+
+const VmbFloat_t sMatrix[] = { 0.6f, 0.3f, 0.1f,
+                               0.6f, 0.3f, 0.1f,
+                               0.6f, 0.3f, 0.1f };
+
+struct Result {
+	uint64_t        frames;
+	double          seconds;
+	uint64_t        allocs;
+	uint64_t        allocBytes;
+	VmbErrorType    error;
+};
+
+// deterministic content so runs are comparable, unpacked high bit formats stay within 12 bits
+std::vector<VmbUchar_t> makeSyntheticFrame( VmbPixelFormatType format, VmbUint32_t width, VmbUint32_t height )
+{
+	std::vector<VmbUchar_t> data( RawFrame::getImageSize( format, width, height ));
+	std::mt19937 rng( 0x5eed );
+	for( auto &byte : data ) {
+		byte = static_cast<VmbUchar_t>( rng() );
+	}
+
+	if( 16 == RawFrame::getBitsPerPixel( format ) && VmbPixelFormatYuv422 != format ) {
+		for( size_t i = 1; i < data.size(); i += 2 ) {
+			data[i] &= 0x0F;
+		}
+	}
+	return data;
+}
+
+VmbErrorType runTransform( const RawFrame &frame, cinder::Surface8uRef &surface, const PathCase &path )
+{
+	static const std::string sRGB24( "RGB24" ), sBGR24( "BGR24" );
+	const std::string &destination = ( 0 == std::strcmp( path.destination, "RGB24" )) ? sRGB24 : sBGR24;
+	if( path.matrix ) {
+		return TransformImage::transform( frame, surface, destination, sMatrix );
+	}
+	return TransformImage::transform( frame, surface, destination );
+}
+
+Result runCase( const RawFrame &frame, const PathCase &path, unsigned threads, uint64_t framesPerThread )
+{
+	Result result = { 0, 0.0, 0, 0, VmbErrorSuccess };
+
+	std::vector<cinder::Surface8uRef> surfaces;
+	for( unsigned i = 0; i < threads; ++i ) {
+		surfaces.push_back( cinder::Surface8u::create( frame.width, frame.height, false, cinder::SurfaceChannelOrder::RGB ));
+		// warm up caches and any lazy state inside the transform library
+		VmbErrorType res = runTransform( frame, surfaces.back(), path );
+		if( VmbErrorSuccess != res ) {
+			result.error = res;
+			return result;
+		}
+	}
+
+	std::vector<VmbErrorType> errors( threads, VmbErrorSuccess );
+	std::vector<std::thread> workers;
+	workers.reserve( threads );
+	std::atomic<bool> go( false );
+	std::atomic<unsigned> ready( 0 );
+
+	for( unsigned i = 0; i < threads; ++i ) {
+		workers.push_back( std::thread( [&, i]() {
+			++ready;
+			while( ! go ) {
+				std::this_thread::yield();
+			}
+			for( uint64_t n = 0; n < framesPerThread; ++n ) {
+				VmbErrorType res = runTransform( frame, surfaces[i], path );
+				if( VmbErrorSuccess != res ) {
+					errors[i] = res;
+					break;
+				}
+			}
+		} ));
+	}
+
+	while( ready < threads ) {
+		std::this_thread::yield();
+	}
+
+	allocation::Counts before = allocation::getTotalCounts();
+	auto start = std::chrono::steady_clock::now();
+	go = true;
+	for( auto &worker : workers ) {
+		worker.join();
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	allocation::Counts allocated = allocation::getTotalCounts() - before;
+	result.allocs = allocated.allocations;
+	result.allocBytes = allocated.bytes;
+	result.seconds = std::chrono::duration<double>( end - start ).count();
+	result.frames = framesPerThread * threads;
+	for( auto err : errors ) {
+		if( VmbErrorSuccess != err ) {
+			result.error = err;
+		}
+	}
+	return result;
+}
+
+void printResult( const SizeCase &size, const FormatCase &format, const PathCase &path, unsigned threads,
+                  const RawFrame &frame, const Result &result )
+{
+	std::stringstream ss;
+	ss << std::fixed << std::setprecision( 3 );
+	ss << "{\"size\":\"" << size.name << "\",\"width\":" << size.width << ",\"height\":" << size.height
+	   << ",\"format\":\"" << format.name << "\",\"path\":\"" << path.name << "\",\"threads\":" << threads;
+
+	if( VmbErrorSuccess != result.error ) {
+		ss << ",\"result\":\"" << AVT::VmbAPI::ErrorCodeToMessage( result.error ) << "\"}";
+		std::cout << ss.str() << std::endl;
+		return;
+	}
+
+	double pixels = static_cast<double>( frame.width ) * frame.height * result.frames;
+	double bytes = static_cast<double>( frame.imageSize ) * result.frames;
+	ss << ",\"frames\":" << result.frames
+	   << ",\"seconds\":" << result.seconds
+	   << ",\"mbPerSec\":" << bytes / ( 1024.0 * 1024.0 ) / result.seconds
+	   << ",\"megapixelsPerSec\":" << pixels / 1e6 / result.seconds
+	   << ",\"nsPerPixel\":" << result.seconds * 1e9 * threads / pixels
+	   << ",\"allocsPerFrame\":" << static_cast<double>( result.allocs ) / result.frames
+	   << ",\"bytesAllocatedPerFrame\":" << static_cast<double>( result.allocBytes ) / result.frames
+	   << ",\"allocationsCounted\":" << ( allocation::isEnabled() ? "true" : "false" )
+	   << ",\"result\":\"ok\"}";
+	std::cout << ss.str() << std::endl;
+}
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+	unsigned maxThreads = std::max( 1u, std::min( 4u, std::thread::hardware_concurrency() ));
+	double budgetMegapixels = 200.0;
+	bool quick = false;
+
+	for( int i = 1; i < argc; ++i ) {
+		std::string arg( argv[i] );
+		if( "--threads" == arg && i + 1 < argc ) {
+			maxThreads = std::max( 1, std::atoi( argv[++i] ));
+		} else if( "--budget" == arg && i + 1 < argc ) {
+			budgetMegapixels = std::max( 1.0, std::atof( argv[++i] ));
+		} else if( "--quick" == arg ) {
+			quick = true;
+		} else {
+			std::cerr << "usage: " << argv[0] << " [--threads N] [--budget MEGAPIXELS] [--quick]" << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<unsigned> threadCounts( 1, 1 );
+	if( maxThreads > 1 ) {
+		threadCounts.push_back( maxThreads );
+	}
+
+	for( const auto &size : sSizes ) {
+		if( quick && size.width != 640 && size.width != 2592 ) {
+			continue;
+		}
+		for( const auto &format : sFormats ) {
+			std::vector<VmbUchar_t> data = makeSyntheticFrame( format.format, size.width, size.height );
+
+			RawFrame frame;
+			frame.buffer = data.data();
+			frame.imageSize = static_cast<VmbUint32_t>( data.size() );
+			frame.width = size.width;
+			frame.height = size.height;
+			frame.pixelFormat = format.format;
+
+			// every case converts roughly the same number of pixels per thread
+			uint64_t framesPerThread = std::max<uint64_t>( 3, static_cast<uint64_t>(
+					budgetMegapixels * 1e6 / ( static_cast<double>( size.width ) * size.height )));
+
+			for( const auto &path : sPaths ) {
+				for( unsigned threads : threadCounts ) {
+					Result result = runCase( frame, path, threads, framesPerThread );
+					printResult( size, format, path, threads, frame, result );
+				}
+			}
+		}
+	}
+
+	return 0;
+}
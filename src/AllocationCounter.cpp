@@ -0,0 +1,151 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "civimba/AllocationCounter.h"
+
+#if defined( CIVIMBA_COUNT_ALLOCATIONS )
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#endif
+
+namespace civimba {
+namespace allocation {
+
+#if defined( CIVIMBA_COUNT_ALLOCATIONS )
+
+namespace {
+thread_local uint64_t       tAllocations = 0;
+thread_local uint64_t       tBytes = 0;
+std::atomic<uint64_t>       sAllocations( 0 );
+std::atomic<uint64_t>       sBytes( 0 );
+}
+
+void* countedAllocate( std::size_t size )
+{
+	++tAllocations;
+	tBytes += size;
+	sAllocations.fetch_add( 1, std::memory_order_relaxed );
+	sBytes.fetch_add( size, std::memory_order_relaxed );
+
+	void *p = std::malloc( size ? size : 1 );
+	if( ! p ) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+bool isEnabled()
+{
+	return true;
+}
+
+Counts getThreadCounts()
+{
+	Counts counts;
+	counts.allocations = tAllocations;
+	counts.bytes = tBytes;
+	return counts;
+}
+
+Counts getTotalCounts()
+{
+	Counts counts;
+	counts.allocations = sAllocations.load( std::memory_order_relaxed );
+	counts.bytes = sBytes.load( std::memory_order_relaxed );
+	return counts;
+}
+
+#else
+
+bool isEnabled()
+{
+	return false;
+}
+
+Counts getThreadCounts()
+{
+	return Counts();
+}
+
+Counts getTotalCounts()
+{
+	return Counts();
+}
+
+#endif
+
+} // namespace allocation
+} // namespace civimba
+
+#if defined( CIVIMBA_COUNT_ALLOCATIONS )
+
+void* operator new( std::size_t size )
+{
+	return civimba::allocation::countedAllocate( size );
+}
+
+void* operator new[]( std::size_t size )
+{
+	return civimba::allocation::countedAllocate( size );
+}
+
+void* operator new( std::size_t size, const std::nothrow_t & ) noexcept
+{
+	try {
+		return civimba::allocation::countedAllocate( size );
+	} catch( ... ) {
+		return nullptr;
+	}
+}
+
+void* operator new[]( std::size_t size, const std::nothrow_t & ) noexcept
+{
+	try {
+		return civimba::allocation::countedAllocate( size );
+	} catch( ... ) {
+		return nullptr;
+	}
+}
+
+void operator delete( void *p ) noexcept
+{
+	std::free( p );
+}
+
+void operator delete[]( void *p ) noexcept
+{
+	std::free( p );
+}
+
+void operator delete( void *p, std::size_t ) noexcept
+{
+	std::free( p );
+}
+
+void operator delete[]( void *p, std::size_t ) noexcept
+{
+	std::free( p );
+}
+
+#endif
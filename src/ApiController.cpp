@@ -21,25 +21,62 @@
  POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <sstream>
 #include <iostream>
+#include <thread>
 
 #include "civimba/ApiController.h"
+#include "civimba/CommandRunner.h"
 #include "civimba/ErrorCodeToMessage.h"
 
 #include "VimbaCPP/Include/Camera.h"
 
+#include "cinder/Log.h"
+
 namespace civimba {
 
 using namespace AVT::VmbAPI;
 
+namespace {
+
+// runs task( i ) for i < count on up to maxConcurrent threads, the calling thread being one of them
+void runParallel( size_t count, uint32_t maxConcurrent, const std::function<void( size_t )> &task )
+{
+	std::atomic<size_t> next( 0 );
+	auto worker = [&task, &next, count] {
+		for( size_t i = next++; i < count; i = next++ ) {
+			task( i );
+		}
+	};
+
+	const size_t threadCount = std::min<size_t>( std::max<uint32_t>( maxConcurrent, 1 ), count );
+	std::vector<std::thread> threads;
+	for( size_t i = 1; i < threadCount; ++i ) {
+		threads.push_back( std::thread( worker ));
+	}
+	if( threadCount > 0 ) {
+		worker();
+	}
+	for( auto &thread : threads ) {
+		thread.join();
+	}
+}
+
+} // anonymous namespace
+
 ApiController::ApiController()
 // Get a reference to the Vimba singleton
-		: mSystem( VimbaSystem::GetInstance())
+		: mSystem( VimbaSystem::GetInstance()),
+		  mCommandTimeout( 5.0 )
 { }
 
 ApiController::~ApiController()
 {
+	mRegistry.reset();
 	mSystem.Shutdown();
 }
 
@@ -53,14 +90,73 @@ void ApiController::startup()
 
 void ApiController::shutdown()
 {
+	mRegistry.reset();
 	mSystem.Shutdown();
 }
 
+CameraRegistry& ApiController::getCameraRegistry()
+{
+	if( ! mRegistry ) {
+		mRegistry.reset( new CameraRegistry( *this, mSystem ));
+	}
+	return *mRegistry;
+}
+
+void ApiController::reopenCamera( const CameraControllerRef &camera )
+{
+	if( ! camera || ! camera->mCamera ) {
+		throw ApiControllerException( __FUNCTION__, "Only Vimba cameras can be reopened", VmbErrorBadParameter );
+	}
+
+	// the application may use the controller meanwhile
+	std::lock_guard<std::recursive_mutex> lock( camera->mStateMutex );
+	CameraOpenResult result;
+	result.cameraID = camera->getID();
+	result.adjustPacketSizeTime = 0.0;
+	if( camera->isAcquiring() ) {
+		camera->stopContinuousImageAcquisition();
+	}
+
+	// The stale handle is closed first, its control channel would keep the new open from getting full access.  Errors
+	// are ignored, the camera is usually gone.  The new camera moves into the existing controller, so the
+	// application's references stay valid.  If it can't be opened yet, the controller keeps the closed handle and
+	// reopening can be tried again.
+	camera->mCamera->Close();
+	CameraPtr reopened;
+	openVimbaCamera( result, reopened );
+	camera->mCamera = reopened;
+
+	// after a power cycle the camera has its startup settings, and its user sets may have been saved elsewhere
+	camera->mFeatureSnapshot = CameraProfile();
+	camera->mUserSetSnapshots.clear();
+}
+
 CameraControllerRef ApiController::getCamera( const std::string &cameraID )
 {
+	CameraOpenResult result;
+	result.cameraID = cameraID;
+	result.adjustPacketSizeTime = 0.0;
+	openCamera( result );
+	return result.camera;
+}
+
+void ApiController::openCamera( CameraOpenResult &result )
+{
+	CameraPtr camera;
+	openVimbaCamera( result, camera );
+
 	CameraControllerRef cam = std::make_shared<CameraController>();
+	cam->mCamera = camera;
+	result.camera = cam;
+}
+
+void ApiController::openVimbaCamera( CameraOpenResult &result, CameraPtr &camera )
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::time_point start = Clock::now();
 
-	VmbErrorType res = mSystem.OpenCameraByID( cameraID.c_str(), VmbAccessModeFull, cam->mCamera );
+	VmbErrorType res = mSystem.OpenCameraByID( result.cameraID.c_str(), VmbAccessModeFull, camera );
+	result.openTime = std::chrono::duration<double>( Clock::now() - start ).count();
 	if( VmbErrorSuccess != res ) {
 		throw ApiControllerException( __FUNCTION__, ErrorCodeToMessage( res ), res );
 	}
@@ -68,31 +164,79 @@ CameraControllerRef ApiController::getCamera( const std::string &cameraID )
 	// Set the GeV packet size to the highest possible value
 	// We assume GigE camera
 	FeaturePtr pCommandFeature;
-	if( VmbErrorSuccess == cam->mCamera->GetFeatureByName( "GVSPAdjustPacketSize", pCommandFeature )) {
-		if( VmbErrorSuccess == pCommandFeature->RunCommand()) {
-			bool bIsCommandDone = false;
-			do {
-				if( VmbErrorSuccess != pCommandFeature->IsCommandDone( bIsCommandDone )) {
-					break;
-				}
-			} while( false == bIsCommandDone );
+	if( VmbErrorSuccess == camera->GetFeatureByName( "GVSPAdjustPacketSize", pCommandFeature )) {
+		CommandResult command = CommandRunner::run( pCommandFeature, CommandRunner::Options().timeout( mCommandTimeout ));
+		result.adjustPacketSizeTime = command.seconds;
+		if( VmbErrorSuccess != command.error ) {
+			// the camera keeps its previous packet size, which still works, just less efficiently
+			CI_LOG_W( "GVSPAdjustPacketSize failed for " << result.cameraID << ": " << ErrorCodeToMessage( command.error ));
 		}
 	}
 
-	prepareCamera( cam );
+	try {
+		prepareCamera( camera );
+	}
+	catch( ... ) {
+		camera->Close();
+		SP_RESET( camera );
+		throw;
+	}
+	result.prepareTime = std::chrono::duration<double>( Clock::now() - start ).count() - result.openTime;
+}
+
+std::vector<CameraOpenResult> ApiController::getCameras( const std::vector<std::string> &cameraIDs, uint32_t maxConcurrent )
+{
+	std::vector<CameraOpenResult> results( cameraIDs.size() );
+	for( size_t i = 0; i < cameraIDs.size(); ++i ) {
+		results[i].cameraID = cameraIDs[i];
+		results[i].error = VmbErrorSuccess;
+		results[i].openTime = results[i].prepareTime = results[i].adjustPacketSizeTime = 0.0;
+	}
+
+	// each worker takes the next camera until all are done, so at most maxConcurrent are in progress
+	runParallel( results.size(), maxConcurrent, [this, &results]( size_t i ) {
+		CameraOpenResult &result = results[i];
+		try {
+			openCamera( result );
+		}
+		catch( const BaseException &exc ) {
+			result.error = exc.Result();
+			result.message = exc.Message();
+		}
+		catch( const std::exception &exc ) {
+			result.error = VmbErrorOther;
+			result.message = exc.what();
+		}
+	} );
+
+	return results;
+}
+
+CameraControllerRef ApiController::getSimulatedCamera( const SimulatedCamera::Options &options, uint32_t numberFrames )
+{
+	CameraControllerRef cam = std::make_shared<CameraController>( numberFrames );
+	cam->mFrameSource = std::make_shared<SimulatedCamera>( options );
+
+	return cam;
+}
+
+CameraControllerRef ApiController::getReplayCamera( const ReplayCamera::Options &options, uint32_t numberFrames )
+{
+	CameraControllerRef cam = std::make_shared<CameraController>( numberFrames );
+	cam->mFrameSource = std::make_shared<ReplayCamera>( options );
 
 	return cam;
 }
 
 /**setting a feature to maximum value that is a multiple of 2*/
-VmbErrorType ApiController::setIntFeatureValueModulo2( CameraControllerRef &cam, const char *const &Name )
+VmbErrorType ApiController::setIntFeatureValueModulo2( const CameraPtr &camera, const char *const &Name )
 {
 	VmbErrorType result;
 	FeaturePtr feature;
 	VmbInt64_t value_min;
 	VmbInt64_t value_max;
 
-	result = SP_ACCESS( cam->mCamera )->GetFeatureByName( Name, feature );
+	result = SP_ACCESS( camera )->GetFeatureByName( Name, feature );
 	if( VmbErrorSuccess != result ) {
 		return result;
 	}
@@ -106,21 +250,193 @@ VmbErrorType ApiController::setIntFeatureValueModulo2( CameraControllerRef &cam,
 }
 
 // prepare camera so that the delivered image will not fail in image transform
-void ApiController::prepareCamera( CameraControllerRef &cam )
+void ApiController::prepareCamera( const CameraPtr &camera )
 {
 	VmbErrorType result;
-	result = setIntFeatureValueModulo2( cam, "Width" );
+	result = setIntFeatureValueModulo2( camera, "Width" );
 	if( VmbErrorSuccess != result ) {
 		throw ApiControllerException( __FUNCTION__, ErrorCodeToMessage( result ), result );
 	}
-	result = setIntFeatureValueModulo2( cam, "Height" );
+	result = setIntFeatureValueModulo2( camera, "Height" );
 	if( VmbErrorSuccess != result ) {
 		throw ApiControllerException( __FUNCTION__, ErrorCodeToMessage( result ), result );
 	}
 }
 
+CameraProfileReport ApiController::applyProfile( const std::vector<CameraControllerRef> &cameras,
+                                                const CameraProfile &profile, uint32_t maxConcurrent )
+{
+	const auto start = std::chrono::steady_clock::now();
+	CameraProfileReport report;
+	report.cameras.resize( cameras.size() );
+
+	// the round trips of one camera are sequential, different cameras are on different links or at least
+	// different control channels
+	runParallel( cameras.size(), maxConcurrent, [&cameras, &profile, &report]( size_t i ) {
+		CameraProfileResult &result = report.cameras[i];
+		if( ! cameras[i] ) {
+			CameraProfileError error = { "", VmbErrorBadParameter, "Camera is null" };
+			result.errors.push_back( error );
+			return;
+		}
+		result = cameras[i]->applyProfile( profile );
+	} );
+
+	report.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+	uint32_t written = 0;
+	uint32_t skipped = 0;
+	for( const auto &result : report.cameras ) {
+		written += result.written;
+		skipped += result.skipped;
+		for( const auto &error : result.errors ) {
+			CI_LOG_W( result.cameraID << ": " << error.message );
+		}
+	}
+	CI_LOG_I( "Profile applied to " << cameras.size() << " cameras in " << report.seconds << " s, " << written
+	          << " features written, " << skipped << " already set" );
+	return report;
+}
+
+BandwidthDemand ApiController::getBandwidthDemand( const CameraControllerRef &camera )
+{
+	if( ! camera || ! camera->mCamera ) {
+		throw ApiControllerException( __FUNCTION__, "Bandwidth planning needs a Vimba camera", VmbErrorBadParameter );
+	}
+
+	const CameraPtr &vmbCamera = camera->mCamera;
+	BandwidthDemand demand;
+	VmbErrorType result = vmbCamera->GetID( demand.cameraID );
+	if( VmbErrorSuccess == result ) {
+		result = vmbCamera->GetInterfaceID( demand.interfaceID );
+	}
+
+	FeaturePtr feature;
+	VmbInt64_t packetSize = 0;
+	if( VmbErrorSuccess != result
+	    || VmbErrorSuccess != vmbCamera->GetFeatureByName( "GevSCPSPacketSize", feature )
+	    || VmbErrorSuccess != feature->GetValue( packetSize )) {
+		throw ApiControllerException( __FUNCTION__, demand.cameraID + " is not a GigE camera", VmbErrorNotSupported );
+	}
+	demand.packetSize = static_cast<uint32_t>( packetSize );
+
+	VmbInt64_t payloadSize = 0;
+	if( VmbErrorSuccess != ( result = vmbCamera->GetFeatureByName( "PayloadSize", feature ))
+	    || VmbErrorSuccess != ( result = feature->GetValue( payloadSize ))) {
+		throw ApiControllerException( __FUNCTION__, ErrorCodeToMessage( result ), result );
+	}
+	demand.payloadSize = static_cast<uint64_t>( payloadSize );
+
+	// AVT cameras name it AcquisitionFrameRateAbs, SFNC AcquisitionFrameRate
+	if( ( VmbErrorSuccess != vmbCamera->GetFeatureByName( "AcquisitionFrameRateAbs", feature )
+	      || VmbErrorSuccess != feature->GetValue( demand.frameRate ))
+	    && ( VmbErrorSuccess != ( result = vmbCamera->GetFeatureByName( "AcquisitionFrameRate", feature ))
+	         || VmbErrorSuccess != ( result = feature->GetValue( demand.frameRate )))) {
+		throw ApiControllerException( __FUNCTION__, ErrorCodeToMessage( result ), result );
+	}
+
+	demand.timestampFrequency = camera->getTimestampFrequency();
+	return demand;
+}
+
+BandwidthPlan ApiController::planBandwidth( const std::vector<CameraControllerRef> &cameras,
+                                            const BandwidthPlanner::Options &options )
+{
+	std::vector<BandwidthDemand> demands;
+	for( const auto &camera : cameras ) {
+		demands.push_back( getBandwidthDemand( camera ));
+	}
+
+	BandwidthPlan plan = BandwidthPlanner::plan( demands, options );
+	for( size_t i = 0; i < cameras.size(); ++i ) {
+		plan.cameras[i].camera = cameras[i];
+	}
+	if( plan.oversubscribed ) {
+		for( const auto &camera : plan.cameras ) {
+			if( camera.limited ) {
+				CI_LOG_W( camera.demand.cameraID << " limited to " << camera.maxFrameRate << " of "
+				          << camera.demand.frameRate << " fps on " << camera.demand.interfaceID );
+			}
+		}
+	}
+	return plan;
+}
+
+void ApiController::applyBandwidthPlan( BandwidthPlan &plan )
+{
+	for( auto &allocation : plan.cameras ) {
+		if( ! allocation.camera || ! allocation.camera->mCamera ) {
+			throw ApiControllerException( __FUNCTION__, "Plan has no camera for " + allocation.demand.cameraID,
+			                              VmbErrorBadParameter );
+		}
+		const CameraPtr &camera = allocation.camera->mCamera;
+
+		// GevSCPD only for cameras that can't pace themselves, both together would slow the camera down twice
+		FeaturePtr feature;
+		VmbInt64_t value = static_cast<VmbInt64_t>( allocation.allocated );
+		const char *name = "StreamBytesPerSecond";
+		if( VmbErrorSuccess != camera->GetFeatureByName( name, feature )) {
+			name = "GevSCPD";
+			value = static_cast<VmbInt64_t>( allocation.packetDelay );
+			if( VmbErrorSuccess != camera->GetFeatureByName( name, feature )) {
+				throw ApiControllerException( __FUNCTION__, allocation.demand.cameraID + " can't limit its bandwidth",
+				                              VmbErrorNotSupported );
+			}
+		}
+
+		VmbInt64_t minimum = 0;
+		VmbInt64_t maximum = 0;
+		VmbErrorType result = feature->GetRange( minimum, maximum );
+		if( VmbErrorSuccess == result ) {
+			result = feature->SetValue( std::min( std::max( value, minimum ), maximum ));
+		}
+		if( VmbErrorSuccess != result ) {
+			throw ApiControllerException( __FUNCTION__, allocation.demand.cameraID + ": " + name + ": "
+			                              + ErrorCodeToMessage( result ), result );
+		}
+
+		allocation.baseline = allocation.camera->getFrameStatistics();
+		allocation.observed = FrameStatistics();
+		allocation.incompleteRate = 0.0;
+	}
+}
+
+bool ApiController::verifyBandwidthPlan( BandwidthPlan &plan, double maxIncompleteRate )
+{
+	bool ok = true;
+	for( auto &allocation : plan.cameras ) {
+		if( ! allocation.camera ) {
+			continue;
+		}
+		const FrameStatistics stats = allocation.camera->getFrameStatistics();
+		// counters start over with every acquisition
+		const FrameStatistics &baseline = stats.framesReceived >= allocation.baseline.framesReceived
+		                                  ? allocation.baseline : FrameStatistics();
+		allocation.observed.framesReceived = stats.framesReceived - baseline.framesReceived;
+		allocation.observed.framesDelivered = stats.framesDelivered - baseline.framesDelivered;
+		allocation.observed.framesIncomplete = stats.framesIncomplete - baseline.framesIncomplete;
+		allocation.observed.framesMissing = stats.framesMissing - baseline.framesMissing;
+		allocation.observed.transformErrors = stats.transformErrors - baseline.transformErrors;
+		allocation.incompleteRate = allocation.observed.framesReceived
+		                            ? static_cast<double>( allocation.observed.framesIncomplete )
+		                              / static_cast<double>( allocation.observed.framesReceived ) : 0.0;
+
+		if( allocation.incompleteRate > maxIncompleteRate ) {
+			CI_LOG_W( allocation.demand.cameraID << ": " << allocation.observed.framesIncomplete << " of "
+			          << allocation.observed.framesReceived << " frames incomplete at "
+			          << allocation.allocated << " bytes/s" );
+			ok = false;
+		}
+	}
+	return ok;
+}
+
 std::vector<AVT::VmbAPI::CameraPtr> ApiController::getCameraList() const
 {
+	if( mRegistry ) {
+		return mRegistry->getCameras();
+	}
+
 	AVT::VmbAPI::CameraPtrVector cameras;
 	// Get all known cameras
 	if( VmbErrorSuccess == mSystem.GetCameras( cameras )) {
@@ -0,0 +1,106 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/BandwidthPlanner.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace civimba {
+
+namespace {
+
+// IP, UDP and GVSP headers, counted in GevSCPSPacketSize
+const uint32_t kPacketHeaders = 20 + 8 + 8;
+// Ethernet header, FCS, preamble and inter-frame gap, outside of GevSCPSPacketSize
+const uint32_t kFraming = 14 + 4 + 8 + 12;
+// GVSP leader and trailer packets of every frame, with their headers
+const uint32_t kLeaderTrailer = 2 * ( kPacketHeaders + 48 + kFraming );
+
+} // anonymous namespace
+
+double BandwidthPlanner::Options::getLinkCapacity( const std::string &interfaceID ) const
+{
+	auto it = mInterfaceCapacity.find( interfaceID );
+	return it != mInterfaceCapacity.end() ? it->second : mLinkCapacity;
+}
+
+double BandwidthPlanner::getFrameWireSize( uint64_t payloadSize, uint32_t packetSize )
+{
+	const uint32_t packetPayload = packetSize > kPacketHeaders ? packetSize - kPacketHeaders : 1;
+	const uint64_t packets = ( payloadSize + packetPayload - 1 ) / packetPayload;
+	return static_cast<double>( payloadSize + packets * ( kPacketHeaders + kFraming ) + kLeaderTrailer );
+}
+
+BandwidthPlan BandwidthPlanner::plan( const std::vector<BandwidthDemand> &demands, const Options &options )
+{
+	BandwidthPlan plan;
+	plan.cameras.resize( demands.size() );
+
+	std::map<std::string, double> required;
+	for( size_t i = 0; i < demands.size(); ++i ) {
+		BandwidthAllocation &camera = plan.cameras[i];
+		camera.demand = demands[i];
+		camera.required = getFrameWireSize( camera.demand.payloadSize, camera.demand.packetSize )
+		                  * std::max( camera.demand.frameRate, 0.0 );
+		required[camera.demand.interfaceID] += camera.required;
+	}
+
+	for( const auto &link : required ) {
+		const double capacity = options.getLinkCapacity( link.first );
+		const double budget = capacity * options.getHeadroom();
+		const bool withMargin = link.second * options.getMargin() <= budget;
+		const bool fits = link.second <= budget;
+		plan.oversubscribed |= ! fits;
+
+		double allocated = 0.0;
+		for( auto &camera : plan.cameras ) {
+			if( camera.demand.interfaceID != link.first ) {
+				continue;
+			}
+			if( withMargin ) {
+				camera.allocated = camera.required * options.getMargin();
+			} else if( link.second > 0.0 ) {
+				// the budget in proportion to the demands: what is left after the demands, or less than they need
+				camera.allocated = budget * camera.required / link.second;
+			}
+			camera.limited = ! fits && camera.required > 0.0;
+
+			const double frameWireSize = getFrameWireSize( camera.demand.payloadSize, camera.demand.packetSize );
+			camera.maxFrameRate = camera.allocated / frameWireSize;
+
+			// the pause after each packet that spreads the frame at the allocated rate instead of a burst at line rate
+			if( camera.demand.timestampFrequency > 0 && camera.allocated > 0.0 ) {
+				const double packetWireSize = camera.demand.packetSize + kFraming;
+				const double delay = packetWireSize / camera.allocated - packetWireSize / capacity;
+				camera.packetDelay = static_cast<uint64_t>( std::max( 0.0, std::floor(
+						delay * static_cast<double>( camera.demand.timestampFrequency ))));
+			}
+			allocated += camera.allocated;
+		}
+		plan.linkLoad[link.first] = capacity > 0.0 ? allocated / capacity : 0.0;
+	}
+
+	return plan;
+}
+
+} // namespace civimba
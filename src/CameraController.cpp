@@ -23,9 +23,13 @@
 
 #include "civimba/CameraController.h"
 #include "civimba/ErrorCodeToMessage.h"
+#include "civimba/FeatureAccessor.h"
 
+#include <chrono>
 #include <thread>
 
+#include "cinder/Log.h"
+
 namespace civimba {
 
 using namespace AVT::VmbAPI;
@@ -35,6 +39,7 @@ CameraController::CameraController( uint32_t numberFrames )
 		  mFrameLoggingInfo( FRAME_INFO_WARNINGS ),
 		  mNewFrame( false ),
 		  mFrameObserver( nullptr ),
+		  mSnapshotWriter( new SnapshotWriter() ),
 		  mNumberFrames( numberFrames )
 {
 	if( mNumberFrames == 0 ) {
@@ -45,13 +50,36 @@ CameraController::CameraController( uint32_t numberFrames )
 
 CameraController::~CameraController()
 {
+	if( mFrameSource ) {
+		mFrameSource->stop();
+	}
 	if( mCamera ) {
+		// our frames hold the observer, which calls back into this controller
+		if( ! mFrames.empty() ) {
+			stopStream();
+			releaseFrames();
+		}
 		mCamera->Close();
 	}
 }
 
+void CameraController::setNumberFrames( uint32_t numberFrames )
+{
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	if( 0 == numberFrames ) {
+		throw CameraControllerException( __FUNCTION__, "CameraController needs at least one frame.",
+		                                 VmbErrorBadParameter );
+	}
+	if( mFrameObserver ) {
+		throw CameraControllerException( __FUNCTION__, "Frame count can't change during acquisition.",
+		                                 VmbErrorInvalidAccess );
+	}
+	mNumberFrames = numberFrames;
+}
+
 void CameraController::setFrameLogging( FrameLoggingInfo info )
 {
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
 	if( mFrameObserver ) {
 		mFrameObserver->setFrameLogging( info );
 	}
@@ -61,6 +89,7 @@ void CameraController::setFrameLogging( FrameLoggingInfo info )
 
 void CameraController::setColorProcessing( ColorProcessing cp )
 {
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
 	if( mFrameObserver ) {
 		mFrameObserver->setColorProcessing( cp );
 	}
@@ -68,14 +97,22 @@ void CameraController::setColorProcessing( ColorProcessing cp )
 
 std::vector<AVT::VmbAPI::FeaturePtr> CameraController::getFeatures()
 {
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
 	AVT::VmbAPI::FeaturePtrVector ret;
-	mCamera->GetFeatures( ret );
+	if( mCamera ) {
+		mCamera->GetFeatures( ret );
+	}
 
 	return ret;
 }
 
 AVT::VmbAPI::FeaturePtr CameraController::getFeatureByName( const char *name )
 {
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	if( ! mCamera ) {
+		throw CameraControllerException( __FUNCTION__, "Frame source has no camera features.", VmbErrorNotSupported );
+	}
+
 	FeaturePtr feature;
 	VmbErrorType err = mCamera->GetFeatureByName( name, feature );
 	if( VmbErrorSuccess != err ) {
@@ -92,6 +129,11 @@ AVT::VmbAPI::FeaturePtr CameraController::getFeatureByName( const std::string &n
 
 std::string CameraController::CameraController::getID()
 {
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	if( mFrameSource ) {
+		return mFrameSource->getID();
+	}
+
 	std::string ret;
 	mCamera->GetID( ret );
 	return ret;
@@ -99,6 +141,11 @@ std::string CameraController::CameraController::getID()
 
 std::string CameraController::CameraController::getName()
 {
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	if( mFrameSource ) {
+		return mFrameSource->getName();
+	}
+
 	std::string ret;
 	mCamera->GetName( ret );
 	return ret;
@@ -106,6 +153,11 @@ std::string CameraController::CameraController::getName()
 
 std::string CameraController::CameraController::getModel()
 {
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	if( mFrameSource ) {
+		return mFrameSource->getModel();
+	}
+
 	std::string ret;
 	mCamera->GetModel( ret );
 	return ret;
@@ -118,6 +170,180 @@ cinder::Surface8uRef CameraController::getCurrentFrame()
 	return mCurrentFrame;
 }
 
+FrameMetadata CameraController::getCurrentFrameMetadata()
+{
+	std::lock_guard<std::mutex> lock( mFrameMutex );
+	return mCurrentMetadata;
+}
+
+void CameraController::setChunkMode( bool enable )
+{
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	if( mFrameSource ) {
+		throw CameraControllerException( __FUNCTION__, "Chunk mode needs a Vimba camera.", VmbErrorNotSupported );
+	}
+	if( mFrameObserver ) {
+		throw CameraControllerException( __FUNCTION__, "Chunk mode can't change during acquisition.",
+		                                 VmbErrorInvalidAccess );
+	}
+
+	FeatureAccessor::setBool( getFeatureByName( "ChunkModeActive" ), enable );
+	if( ! mFeatureSnapshot.empty() ) {
+		mFeatureSnapshot.update( CameraProfile().set( "ChunkModeActive", enable ? "true" : "false" ));
+	}
+}
+
+bool CameraController::getChunkMode()
+{
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	if( mFrameSource ) {
+		return false;
+	}
+
+	FeaturePtr feature;
+	bool active = false;
+	if( VmbErrorSuccess == mCamera->GetFeatureByName( "ChunkModeActive", feature )
+	    && VmbErrorSuccess == feature->GetValue( active )) {
+		return active;
+	}
+	return false;
+}
+
+CameraProfileResult CameraController::applyProfile( const CameraProfile &profile )
+{
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	CameraProfileResult result = profile.apply( *this );
+	if( ! mFeatureSnapshot.empty() ) {
+		if( result.ok() ) {
+			mFeatureSnapshot.update( profile, CameraProfile::getSelects( mCamera ));
+		} else {
+			mFeatureSnapshot = CameraProfile();
+		}
+	}
+	return result;
+}
+
+const CameraProfile& CameraController::captureFeatureSnapshot()
+{
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	mFeatureSnapshot = CameraProfile::capture( *this );
+	return mFeatureSnapshot;
+}
+
+CameraSwitchResult CameraController::reconfigure( const CameraProfile &changes )
+{
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	const auto start = std::chrono::steady_clock::now();
+
+	if( ! mCamera ) {
+		// reports that profiles need a Vimba camera
+		CameraSwitchResult result;
+		result.profile = changes.apply( *this );
+		return result;
+	}
+
+	const CameraProfile::SelectsFunction selects = CameraProfile::getSelects( mCamera );
+	const bool known = ! mFeatureSnapshot.empty();
+	const CameraProfile writes = known ? changes.diff( mFeatureSnapshot, selects ) : changes;
+
+	// features like PixelFormat or Width are locked while the camera streams
+	bool locked = false;
+	for( const auto &entry : writes.getEntries() ) {
+		FeaturePtr feature;
+		bool writable = true;
+		if( mFrameObserver && VmbErrorSuccess == mCamera->GetFeatureByName( entry.name.c_str(), feature )
+		    && VmbErrorSuccess == feature->IsWritable( writable ) && ! writable ) {
+			locked = true;
+			break;
+		}
+	}
+
+	auto write = [&]( CameraSwitchResult &result ) {
+		result.profile = writes.apply( *this, ! known );
+	};
+	CameraSwitchResult result;
+	if( writes.empty() ) {
+		result.profile.cameraID = getID();
+	} else if( locked ) {
+		result = restartStream( write );
+	} else {
+		write( result );
+		result.applySeconds = result.profile.seconds;
+	}
+
+	if( known && result.profile.ok() ) {
+		mFeatureSnapshot.update( writes, selects );
+	} else if( known ) {
+		// some features kept values that are unknown now
+		mFeatureSnapshot = CameraProfile();
+	}
+	result.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	return result;
+}
+
+CameraSwitchResult CameraController::reconfigureRoi( int64_t offsetX, int64_t offsetY, int64_t width, int64_t height )
+{
+	CameraProfile roi;
+	roi.set( "Width", std::to_string( width ))
+	   .set( "Height", std::to_string( height ))
+	   .set( "OffsetX", std::to_string( offsetX ))
+	   .set( "OffsetY", std::to_string( offsetY ));
+	return reconfigure( roi );
+}
+
+CameraSwitchResult CameraController::switchProfile( const CameraProfile &target )
+{
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	if( mCamera && mFeatureSnapshot.empty() ) {
+		captureFeatureSnapshot();
+	}
+	return reconfigure( target );
+}
+
+void CameraController::saveUserSet( const std::string &userSet )
+{
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	if( mFrameSource ) {
+		throw CameraControllerException( __FUNCTION__, "User sets need a Vimba camera.", VmbErrorNotSupported );
+	}
+
+	FeatureAccessor::setStr( getFeatureByName( "UserSetSelector" ), userSet );
+	FeatureAccessor::runCommand( getFeatureByName( "UserSetSave" ));
+	mUserSetSnapshots[userSet] = captureFeatureSnapshot();
+}
+
+CameraSwitchResult CameraController::loadUserSet( const std::string &userSet )
+{
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	if( mFrameSource ) {
+		throw CameraControllerException( __FUNCTION__, "User sets need a Vimba camera.", VmbErrorNotSupported );
+	}
+
+	// whatever the load did, the camera is not in the known state any more
+	mFeatureSnapshot = CameraProfile();
+	CameraSwitchResult result = restartStream( [&]( CameraSwitchResult &load ) {
+		load.profile.cameraID = getID();
+		FeatureAccessor::setStr( getFeatureByName( "UserSetSelector" ), userSet );
+		FeatureAccessor::runCommand( getFeatureByName( "UserSetLoad" ));
+	} );
+
+	auto bound = mUserSetSnapshots.find( userSet );
+	if( bound != mUserSetSnapshots.end() ) {
+		mFeatureSnapshot = bound->second;
+	}
+	return result;
+}
+
+bool CameraController::saveSnapshot( const std::string &path, SnapshotDepth depth,
+                                     const SnapshotWriter::SnapshotCallback &callback )
+{
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	if( SNAPSHOT_DEPTH_16 == depth ) {
+		return mSnapshotWriter->writeNextRaw( path, callback );
+	}
+	return mSnapshotWriter->write( getCurrentFrame(), path, callback );
+}
+
 bool CameraController::checkNewFrame()
 {
 	std::lock_guard<std::mutex> lock( mCheckFrameMutex );
@@ -126,41 +352,301 @@ bool CameraController::checkNewFrame()
 	return status;
 }
 
+uint64_t CameraController::getTimestampFrequency()
+{
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	if( mFrameSource ) {
+		return mFrameSource->getTimestampFrequency();
+	}
+
+	FeaturePtr feature;
+	VmbInt64_t frequency = 0;
+	if( VmbErrorSuccess == mCamera->GetFeatureByName( "GevTimestampTickFrequency", feature )
+	    && VmbErrorSuccess == feature->GetValue( frequency )) {
+		return static_cast<uint64_t>( frequency );
+	}
+	return 0;
+}
+
+FrameStatistics CameraController::getFrameStatistics()
+{
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	if( mFrameObserver ) {
+		return mFrameObserver->getStatistics();
+	}
+	return mLastStatistics;
+}
+
 void CameraController::frameObservedCallback( cinder::Surface8uRef &frame )
 {
-	// lock and swap surfaces
+	{
+		// lock and swap surfaces
+		std::lock_guard<std::mutex> lock( mFrameMutex );
+		mCurrentFrame = frame;
+		mCurrentMetadata = mPendingMetadata;
+		mNewFrame = true;
+	}
+	mSignalNewFrame.emit( frame );
+}
+
+void CameraController::setThreadPlacement( const ThreadPlacement &acquisition, const ThreadPlacement &workers )
+{
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	if( mFrameObserver ) {
+		throw CameraControllerException( __FUNCTION__, "Thread placement can't change during acquisition.",
+		                                 VmbErrorInvalidAccess );
+	}
+
+	mAcquisitionPlacement = acquisition;
+	// the writer thread is placed when it starts, so replace the idle writer
+	mSnapshotWriter->waitForSnapshots();
+	SnapshotWriter::Options options = mSnapshotWriter->getOptions();
+	mSnapshotWriter.reset( new SnapshotWriter( options.placement( workers )));
+}
+
+std::vector<ThreadPlacementReport> CameraController::getPlacementReport()
+{
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
+	std::vector<ThreadPlacementReport> reports;
+	{
+		std::lock_guard<std::mutex> lock( mFrameMutex );
+		if( ! mAcquisitionReport.name.empty() ) {
+			reports.push_back( mAcquisitionReport );
+		}
+	}
+	ThreadPlacementReport snapshot = mSnapshotWriter->getPlacementReport();
+	if( ! snapshot.name.empty() ) {
+		reports.push_back( snapshot );
+	}
+	return reports;
+}
+
+void CameraController::placeAcquisitionThread()
+{
+	mAcquisitionThread = std::this_thread::get_id();
+	ThreadPlacementReport report = mAcquisitionPlacement.apply( mAcquisitionName );
+
 	std::lock_guard<std::mutex> lock( mFrameMutex );
-	mCurrentFrame = frame;
-	mNewFrame = true;
+	mAcquisitionReport = report;
+}
+
+void CameraController::rawFrameObservedCallback( const RawFrame &frame )
+{
+	// the raw frame comes first, so the transform already runs and allocates on the placed thread
+	if( std::this_thread::get_id() != mAcquisitionThread ) {
+		placeAcquisitionThread();
+	}
+
+	mPendingMetadata = frame.metadata;
+	mSnapshotWriter->rawFrame( frame );
+	mSignalRawFrame.emit( frame );
 }
 
 void CameraController::startContinuousImageAcquisition()
 {
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
 	using namespace std::placeholders;
 
 	if( mFrameObserver ) {
 		// TODO log that we ignored this
 		return;
 	}
+
+	// frame buffers are allocated and first touched while starting
+	ScopedMemoryPolicy memoryPolicy( mAcquisitionPlacement.getNumaNode() );
+	mAcquisitionThread = std::thread::id();
+	// the acquisition thread must not take mStateMutex, stopping holds it while frames drain
+	mAcquisitionName = getID() + " acquisition";
+
+	if( mFrameSource ) {
+		mFrameObserver = new FrameObserver( mFrameSource->getID(),
+		                                    std::bind( &CameraController::frameObservedCallback, this, _1 ),
+		                                    mFrameLoggingInfo, mColorProcessing );
+		mFrameObserverPtr = IFrameObserverPtr( mFrameObserver );
+		mFrameObserver->setRawFrameCallback( std::bind( &CameraController::rawFrameObservedCallback, this, _1 ));
+		mFrameSource->start( mNumberFrames, std::bind( &FrameObserver::frameReceived, mFrameObserver, _1 ));
+		return;
+	}
+
 	// Create a frame observer for this camera (This will be wrapped in a shared_ptr so we don't delete it)
 	mFrameObserver = new FrameObserver( mCamera, std::bind( &CameraController::frameObservedCallback, this, _1 ),
 										mFrameLoggingInfo, mColorProcessing );
+	mFrameObserverPtr = IFrameObserverPtr( mFrameObserver );
+	mFrameObserver->setRawFrameCallback( std::bind( &CameraController::rawFrameObservedCallback, this, _1 ));
 
-	// Start streaming.  FrameObserver* gets managed elsewhere
-	VmbErrorType res = mCamera->StartContinuousImageAcquisition( mNumberFrames,
-																 IFrameObserverPtr( mFrameObserver ));
-
-	if( res != VmbErrorSuccess ) {
-		throw CameraControllerException( __FUNCTION__, ErrorCodeToMessage( res ), VmbErrorOther );
+	// Start streaming.  The frames are ours rather than those of Camera::StartContinuousImageAcquisition(), so
+	// reconfigure() can restart the stream without announcing them again
+	try {
+		prepareFrames( getPayloadSize() );
+		startStream();
+	}
+	catch( ... ) {
+		releaseFrames();
+		mFrameObserver = nullptr;
+		mFrameObserverPtr = IFrameObserverPtr();
+		throw;
 	}
 }
 
 
 void CameraController::stopContinuousImageAcquisition()
 {
+	std::lock_guard<std::recursive_mutex> lock( mStateMutex );
 	// Stop streaming
-	mCamera->StopContinuousImageAcquisition();
+	if( mFrameSource ) {
+		mFrameSource->stop();
+	} else if( ! mFrames.empty() ) {
+		stopStream();
+		releaseFrames();
+	}
+	if( mFrameObserver ) {
+		mLastStatistics = mFrameObserver->getStatistics();
+	}
 	mFrameObserver = nullptr;
+	mFrameObserverPtr = IFrameObserverPtr();
+}
+
+
+// ----------------------------------------------------------------------------------------------------
+// MARK: - Stream
+// ----------------------------------------------------------------------------------------------------
+
+VmbInt64_t CameraController::getPayloadSize()
+{
+	return FeatureAccessor::getValue<VmbInt64_t>( getFeatureByName( "PayloadSize" ));
+}
+
+uint32_t CameraController::prepareFrames( VmbInt64_t payloadSize )
+{
+	// frame buffers are allocated and first touched here
+	ScopedMemoryPolicy memoryPolicy( mAcquisitionPlacement.getNumaNode() );
+
+	uint32_t allocated = 0;
+	mFrames.resize( mNumberFrames );
+	for( auto &frame : mFrames ) {
+		VmbUint32_t bufferSize = 0;
+		if( ! SP_ISNULL( frame ) && VmbErrorSuccess == frame->GetBufferSize( bufferSize )
+		    && static_cast<VmbInt64_t>( bufferSize ) >= payloadSize ) {
+			continue;
+		}
+		if( ! SP_ISNULL( frame )) {
+			mCamera->RevokeFrame( frame );
+			frame->UnregisterObserver();
+		}
+
+		SP_SET( frame, new Frame( payloadSize ));
+		VmbErrorType res = frame->RegisterObserver( mFrameObserverPtr );
+		if( VmbErrorSuccess == res ) {
+			res = mCamera->AnnounceFrame( frame );
+		}
+		if( VmbErrorSuccess != res ) {
+			// leave no half announced set behind
+			frame->UnregisterObserver();
+			releaseFrames();
+			throw CameraControllerException( __FUNCTION__, ErrorCodeToMessage( res ), res );
+		}
+		++allocated;
+	}
+	return allocated;
+}
+
+void CameraController::startStream()
+{
+	VmbErrorType res = mCamera->StartCapture();
+	for( size_t i = 0; VmbErrorSuccess == res && i < mFrames.size(); ++i ) {
+		res = mCamera->QueueFrame( mFrames[i] );
+	}
+	FeaturePtr feature;
+	if( VmbErrorSuccess == res ) {
+		res = mCamera->GetFeatureByName( "AcquisitionStart", feature );
+	}
+	if( VmbErrorSuccess == res ) {
+		res = feature->RunCommand();
+	}
+
+	if( VmbErrorSuccess != res ) {
+		mCamera->EndCapture();
+		mCamera->FlushQueue();
+		throw CameraControllerException( __FUNCTION__, ErrorCodeToMessage( res ), res );
+	}
+}
+
+void CameraController::stopStream()
+{
+	// errors are ignored, the camera may be gone
+	FeaturePtr feature;
+	if( VmbErrorSuccess == mCamera->GetFeatureByName( "AcquisitionStop", feature )) {
+		feature->RunCommand();
+	}
+	mCamera->EndCapture();
+	mCamera->FlushQueue();
+}
+
+void CameraController::releaseFrames()
+{
+	mCamera->RevokeAllFrames();
+	for( auto &frame : mFrames ) {
+		if( ! SP_ISNULL( frame )) {
+			frame->UnregisterObserver();
+		}
+	}
+	mFrames.clear();
+}
+
+CameraSwitchResult CameraController::restartStream( const std::function<void( CameraSwitchResult & )> &write )
+{
+	const auto start = std::chrono::steady_clock::now();
+	auto elapsed = [start] {
+		return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	};
+
+	CameraSwitchResult result;
+	if( ! mFrameObserver ) {
+		write( result );
+		result.applySeconds = result.seconds = elapsed();
+		return result;
+	}
+
+	// the payload after the writes decides which buffers still fit
+	auto resume = [this] {
+		const uint32_t allocated = prepareFrames( getPayloadSize() );
+		mFrameObserver->restart();
+		startStream();
+		return allocated;
+	};
+
+	result.restarted = true;
+	stopStream();
+	result.stopSeconds = elapsed();
+	try {
+		write( result );
+	}
+	catch( ... ) {
+		// stream again with whatever the camera was left with, or end acquisition cleanly
+		try {
+			resume();
+		}
+		catch( ... ) {
+			CI_LOG_E( "Could not restart the stream of " << getID() );
+			stopContinuousImageAcquisition();
+		}
+		throw;
+	}
+	result.applySeconds = elapsed() - result.stopSeconds;
+
+	try {
+		result.framesAllocated = resume();
+	}
+	catch( ... ) {
+		// isAcquiring() must not report a stream that is gone
+		stopContinuousImageAcquisition();
+		throw;
+	}
+	result.restartSeconds = result.seconds = elapsed();
+
+	CI_LOG_V( "Restarted the stream of " << getID() << " in " << result.restartSeconds * 1000.0 << " ms ("
+	          << result.framesAllocated << " frames allocated)" );
+	return result;
 }
 
 } // namespace civimba
\ No newline at end of file
@@ -0,0 +1,751 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/CameraProfile.h"
+#include "civimba/CameraController.h"
+#include "civimba/CommandRunner.h"
+#include "civimba/ErrorCodeToMessage.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+
+#include "cinder/Json.h"
+#include "cinder/Xml.h"
+
+namespace civimba {
+
+using namespace AVT::VmbAPI;
+
+namespace {
+
+bool startsWith( const std::string &s, const std::string &prefix )
+{
+	return 0 == s.compare( 0, prefix.size(), prefix );
+}
+
+bool endsWith( const std::string &s, const std::string &suffix )
+{
+	return s.size() >= suffix.size() && 0 == s.compare( s.size() - suffix.size(), suffix.size(), suffix );
+}
+
+std::string toLower( std::string s )
+{
+	std::transform( s.begin(), s.end(), s.begin(), []( unsigned char c ) { return std::tolower( c ); } );
+	return s;
+}
+
+std::string trim( const std::string &s )
+{
+	const size_t first = s.find_first_not_of( " \t\r\n" );
+	if( std::string::npos == first ) {
+		return std::string();
+	}
+	return s.substr( first, s.find_last_not_of( " \t\r\n" ) - first + 1 );
+}
+
+bool isSelector( const std::string &name )
+{
+	return endsWith( name, "Selector" );
+}
+
+// features are written stage by stage, each stage changes the ranges of the ones after it
+int getStage( const std::string &name )
+{
+	if( startsWith( name, "Binning" ) || startsWith( name, "Decimation" )) {
+		return 0;
+	}
+	if( "PixelFormat" == name ) {
+		return 1;
+	}
+	if( "Width" == name || "Height" == name ) {
+		return 2;
+	}
+	if( "OffsetX" == name || "OffsetY" == name ) {
+		return 3;
+	}
+	// an auto mode would overwrite the value written after it
+	if( endsWith( name, "Auto" )) {
+		return 4;
+	}
+	// the frame rate is limited by everything else, exposure in particular
+	if( "AcquisitionFrameRateEnable" == name ) {
+		return 6;
+	}
+	if( startsWith( name, "AcquisitionFrameRate" )) {
+		return 7;
+	}
+	return 5;
+}
+
+bool parseInt( const std::string &value, VmbInt64_t &result )
+{
+	char *end = nullptr;
+	result = std::strtoll( value.c_str(), &end, 10 );
+	if( ! value.empty() && '\0' == *end ) {
+		return true;
+	}
+	// JSON numbers may come as 5000.0
+	const double number = std::strtod( value.c_str(), &end );
+	result = static_cast<VmbInt64_t>( number );
+	return ! value.empty() && '\0' == *end && static_cast<double>( result ) == number;
+}
+
+bool parseBool( const std::string &value, bool &result )
+{
+	const std::string lower = toLower( value );
+	if( "true" == lower || "1" == lower || "on" == lower ) {
+		result = true;
+		return true;
+	}
+	if( "false" == lower || "0" == lower || "off" == lower ) {
+		result = false;
+		return true;
+	}
+	return false;
+}
+
+// Writes value unless compare finds that the feature already has it.  Reads are answered from the camera
+// description or a single register read, a write may make the camera reevaluate other features, so skipping
+// writes saves the most.
+VmbErrorType writeFeature( const FeaturePtr &feature, const std::string &value, bool compare, bool &skipped )
+{
+	skipped = false;
+	VmbFeatureDataType type = VmbFeatureDataUnknown;
+	VmbErrorType result = feature->GetDataType( type );
+	if( VmbErrorSuccess != result ) {
+		return result;
+	}
+
+	switch( type ) {
+		case VmbFeatureDataInt: {
+			VmbInt64_t target = 0;
+			VmbInt64_t current = 0;
+			if( ! parseInt( value, target )) {
+				return VmbErrorBadParameter;
+			}
+			if( compare && VmbErrorSuccess == feature->GetValue( current ) && current == target ) {
+				skipped = true;
+				return VmbErrorSuccess;
+			}
+			return feature->SetValue( target );
+		}
+		case VmbFeatureDataFloat: {
+			char *end = nullptr;
+			const double target = std::strtod( value.c_str(), &end );
+			if( value.empty() || '\0' != *end ) {
+				return VmbErrorBadParameter;
+			}
+			// cameras round to their resolution, so the value read back rarely equals the one written
+			double current = 0.0;
+			double increment = 0.0;
+			VmbBool_t hasIncrement = VmbBoolFalse;
+			double tolerance = 1e-6 * std::max( 1.0, std::fabs( target ));
+			if( compare && VmbErrorSuccess == feature->HasIncrement( hasIncrement ) && hasIncrement
+			    && VmbErrorSuccess == feature->GetIncrement( increment )) {
+				tolerance = std::max( tolerance, increment / 2.0 );
+			}
+			if( compare && VmbErrorSuccess == feature->GetValue( current ) && std::fabs( current - target ) <= tolerance ) {
+				skipped = true;
+				return VmbErrorSuccess;
+			}
+			return feature->SetValue( target );
+		}
+		case VmbFeatureDataEnum:
+		case VmbFeatureDataString: {
+			std::string current;
+			if( compare && VmbErrorSuccess == feature->GetValue( current ) && current == value ) {
+				skipped = true;
+				return VmbErrorSuccess;
+			}
+			return feature->SetValue( value.c_str() );
+		}
+		case VmbFeatureDataBool: {
+			bool target = false;
+			bool current = false;
+			if( ! parseBool( value, target )) {
+				return VmbErrorBadParameter;
+			}
+			if( compare && VmbErrorSuccess == feature->GetValue( current ) && current == target ) {
+				skipped = true;
+				return VmbErrorSuccess;
+			}
+			return feature->SetValue( target );
+		}
+		case VmbFeatureDataCommand: {
+			bool run = false;
+			if( ! parseBool( value, run )) {
+				return VmbErrorBadParameter;
+			}
+			if( ! run ) {
+				skipped = true;
+				return VmbErrorSuccess;
+			}
+			return CommandRunner::run( feature ).error;
+		}
+		default:
+			return VmbErrorWrongType;
+	}
+}
+
+// reads the value of a feature as text in the form writeFeature() takes, false for types a profile can't hold
+bool readFeature( const FeaturePtr &feature, std::string &value )
+{
+	VmbFeatureDataType type = VmbFeatureDataUnknown;
+	if( VmbErrorSuccess != feature->GetDataType( type )) {
+		return false;
+	}
+
+	switch( type ) {
+		case VmbFeatureDataInt: {
+			VmbInt64_t current = 0;
+			if( VmbErrorSuccess != feature->GetValue( current )) {
+				return false;
+			}
+			value = std::to_string( current );
+			return true;
+		}
+		case VmbFeatureDataFloat: {
+			double current = 0.0;
+			if( VmbErrorSuccess != feature->GetValue( current )) {
+				return false;
+			}
+			std::ostringstream ss;
+			ss << std::setprecision( std::numeric_limits<double>::max_digits10 ) << current;
+			value = ss.str();
+			return true;
+		}
+		case VmbFeatureDataEnum:
+		case VmbFeatureDataString:
+			return VmbErrorSuccess == feature->GetValue( value );
+		case VmbFeatureDataBool: {
+			bool current = false;
+			if( VmbErrorSuccess != feature->GetValue( current )) {
+				return false;
+			}
+			value = current ? "true" : "false";
+			return true;
+		}
+		default:
+			return false;
+	}
+}
+
+bool sameValue( const std::string &a, const std::string &b )
+{
+	if( a == b ) {
+		return true;
+	}
+	char *endA = nullptr;
+	char *endB = nullptr;
+	const double numberA = std::strtod( a.c_str(), &endA );
+	const double numberB = std::strtod( b.c_str(), &endB );
+	if( ! a.empty() && ! b.empty() && '\0' == *endA && '\0' == *endB ) {
+		return std::fabs( numberA - numberB ) <= 1e-9 * std::max( 1.0, std::fabs( numberA ));
+	}
+	bool boolA = false;
+	bool boolB = false;
+	return parseBool( a, boolA ) && parseBool( b, boolB ) && boolA == boolB;
+}
+
+// Names the value of every entry by the feature and the selector value it is written under, e.g.
+// "TriggerSelector=FrameStart/TriggerMode", the same grouping getOrderedEntries() uses.  Selectors get no key,
+// their values only give the features after them a context.
+std::vector<std::string> getKeys( const std::vector<CameraProfileEntry> &entries,
+                                  const CameraProfile::SelectsFunction &selects )
+{
+	std::vector<std::string> keys;
+	keys.reserve( entries.size() );
+	const CameraProfileEntry *selector = nullptr;
+	for( const auto &entry : entries ) {
+		if( isSelector( entry.name )) {
+			selector = &entry;
+			keys.push_back( std::string() );
+		} else if( selector && selects( selector->name, entry.name )) {
+			keys.push_back( selector->name + "=" + selector->value + "/" + entry.name );
+		} else {
+			selector = nullptr;
+			keys.push_back( entry.name );
+		}
+	}
+	return keys;
+}
+
+void addXmlFeatures( const ci::XmlTree &node, CameraProfile &profile )
+{
+	for( auto it = node.begin(); it != node.end(); ++it ) {
+		const ci::XmlTree &child = *it;
+		if( ! child.isElement() ) {
+			continue;
+		}
+		if( "feature" != toLower( child.getTag() )) {
+			addXmlFeatures( child, profile );
+			continue;
+		}
+		const char *attribute = child.hasAttribute( "name" ) ? "name" : "Name";
+		if( ! child.hasAttribute( attribute )) {
+			throw CameraProfile::CameraProfileException( __FUNCTION__, "Feature element without a name",
+			                                             VmbErrorBadParameter );
+		}
+		profile.set( child.getAttributeValue<std::string>( attribute ), trim( child.getValue() ));
+	}
+}
+
+ci::JsonTree parseJson( const std::string &json )
+{
+	try {
+		return ci::JsonTree( json );
+	}
+	catch( const std::exception &exc ) {
+		throw CameraProfile::CameraProfileException( __FUNCTION__, std::string( "Invalid JSON: " ) + exc.what(),
+		                                             VmbErrorBadParameter );
+	}
+}
+
+ci::XmlTree parseXml( const std::string &xml )
+{
+	try {
+		return ci::XmlTree( xml );
+	}
+	catch( const std::exception &exc ) {
+		throw CameraProfile::CameraProfileException( __FUNCTION__, std::string( "Invalid XML: " ) + exc.what(),
+		                                             VmbErrorBadParameter );
+	}
+}
+
+} // anonymous namespace
+
+bool CameraProfileReport::ok() const
+{
+	for( const auto &camera : cameras ) {
+		if( ! camera.ok() ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// MARK: - Loading
+// ----------------------------------------------------------------------------------------------------
+
+CameraProfile& CameraProfile::set( const std::string &name, const std::string &value )
+{
+	CameraProfileEntry entry;
+	entry.name = name;
+	entry.value = value;
+	mEntries.push_back( entry );
+	return *this;
+}
+
+CameraProfile CameraProfile::load( const std::string &path )
+{
+	std::ifstream file( path.c_str(), std::ios::binary );
+	if( ! file ) {
+		throw CameraProfileException( __FUNCTION__, "Can't read " + path, VmbErrorBadParameter );
+	}
+	std::stringstream ss;
+	ss << file.rdbuf();
+	const std::string text = ss.str();
+
+	const size_t first = text.find_first_not_of( " \t\r\n" );
+	if( std::string::npos != first && '<' == text[first] ) {
+		return fromXml( text );
+	}
+	return fromJson( text );
+}
+
+CameraProfile CameraProfile::fromJson( const std::string &json )
+{
+	const ci::JsonTree tree = parseJson( json );
+	const ci::JsonTree &features = tree.hasChild( "features" ) ? tree.getChild( "features" ) : tree;
+
+	CameraProfile profile;
+	for( const auto &child : features.getChildren() ) {
+		if( ci::JsonTree::NODE_VALUE == child.getNodeType() ) {
+			// "features": { "name": value }
+			profile.set( child.getKey(), child.getValue() );
+		} else if( child.hasChild( "name" ) && child.hasChild( "value" )) {
+			profile.set( child.getChild( "name" ).getValue(), child.getChild( "value" ).getValue() );
+		} else {
+			throw CameraProfileException( __FUNCTION__, "Features need a name and a value", VmbErrorBadParameter );
+		}
+	}
+	return profile;
+}
+
+CameraProfile CameraProfile::fromXml( const std::string &xml )
+{
+	CameraProfile profile;
+	addXmlFeatures( parseXml( xml ), profile );
+	return profile;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// MARK: - Applying
+// ----------------------------------------------------------------------------------------------------
+
+bool CameraProfile::selectsByName( const std::string &selector, const std::string &feature )
+{
+	const std::string prefix = selector.substr( 0, selector.size() - std::string( "Selector" ).size() );
+	return isSelector( selector ) && feature != selector && startsWith( feature, prefix );
+}
+
+std::vector<CameraProfileEntry> CameraProfile::getOrderedEntries( const SelectsFunction &selects ) const
+{
+	// a selector and the features it selects right after it are moved as one block
+	struct Block {
+		int     stage;
+		size_t  first;
+		size_t  count;
+	};
+	std::vector<Block> blocks;
+	std::string selector;
+	for( size_t i = 0; i < mEntries.size(); ++i ) {
+		const std::string &name = mEntries[i].name;
+		if( ! selector.empty() && ! isSelector( name ) && selects( selector, name )) {
+			Block &block = blocks.back();
+			block.stage = std::min( block.stage, getStage( name ));
+			++block.count;
+			continue;
+		}
+		selector = isSelector( name ) ? name : std::string();
+		Block block = { getStage( name ), i, 1 };
+		blocks.push_back( block );
+	}
+
+	std::stable_sort( blocks.begin(), blocks.end(), []( const Block &a, const Block &b ) {
+		return a.stage < b.stage;
+	} );
+
+	std::vector<CameraProfileEntry> entries;
+	entries.reserve( mEntries.size() );
+	for( const auto &block : blocks ) {
+		entries.insert( entries.end(), mEntries.begin() + block.first, mEntries.begin() + block.first + block.count );
+	}
+	return entries;
+}
+
+CameraProfile::SelectsFunction CameraProfile::getSelects( const CameraPtr &camera )
+{
+	// which features a selector selects is part of the camera description, so asking costs no round trip
+	auto selected = std::make_shared<std::map<std::string, std::set<std::string>>>();
+	return [camera, selected]( const std::string &selector, const std::string &feature ) {
+		auto it = selected->find( selector );
+		if( it == selected->end() ) {
+			std::set<std::string> names;
+			FeaturePtr selectorFeature;
+			FeaturePtrVector features;
+			if( camera && VmbErrorSuccess == camera->GetFeatureByName( selector.c_str(), selectorFeature )
+			    && VmbErrorSuccess == selectorFeature->GetSelectedFeatures( features )) {
+				for( const auto &selectedFeature : features ) {
+					std::string name;
+					if( VmbErrorSuccess == selectedFeature->GetName( name )) {
+						names.insert( name );
+					}
+				}
+			}
+			it = selected->insert( std::make_pair( selector, names )).first;
+		}
+		return it->second.empty() ? selectsByName( selector, feature ) : it->second.count( feature ) > 0;
+	};
+}
+
+CameraProfileResult CameraProfile::apply( CameraController &camera, bool compare ) const
+{
+	const auto start = std::chrono::steady_clock::now();
+	CameraProfileResult result;
+	result.cameraID = camera.getID();
+
+	CameraPtr vmbCamera = camera.getCamera();
+	if( ! vmbCamera ) {
+		CameraProfileError error = { "", VmbErrorNotSupported, "Profiles need a Vimba camera" };
+		result.errors.push_back( error );
+		return result;
+	}
+
+	const std::vector<CameraProfileEntry> entries = getOrderedEntries( getSelects( vmbCamera ));
+	auto hasEntry = [&entries]( const std::string &name ) {
+		return entries.end() != std::find_if( entries.begin(), entries.end(), [&name]( const CameraProfileEntry &entry ) {
+			return entry.name == name;
+		} );
+	};
+
+	for( const auto &entry : entries ) {
+		FeaturePtr feature;
+		bool skipped = false;
+		VmbErrorType error = vmbCamera->GetFeatureByName( entry.name.c_str(), feature );
+		if( VmbErrorSuccess == error ) {
+			error = writeFeature( feature, entry.value, compare, skipped );
+		}
+
+		// a larger size may not fit next to the current offset, which the profile sets afterwards anyway
+		const char *offset = "Width" == entry.name ? "OffsetX" : "Height" == entry.name ? "OffsetY" : nullptr;
+		FeaturePtr offsetFeature;
+		if( VmbErrorSuccess != error && feature && offset && hasEntry( offset )
+		    && VmbErrorSuccess == vmbCamera->GetFeatureByName( offset, offsetFeature )) {
+			VmbInt64_t minimum = 0;
+			VmbInt64_t maximum = 0;
+			if( VmbErrorSuccess == offsetFeature->GetRange( minimum, maximum )
+			    && VmbErrorSuccess == offsetFeature->SetValue( minimum )) {
+				error = writeFeature( feature, entry.value, compare, skipped );
+			}
+		}
+
+		if( VmbErrorSuccess != error ) {
+			CameraProfileError profileError = { entry.name, error, entry.name + " = " + entry.value + ": "
+			                                    + ErrorCodeToMessage( error ) };
+			result.errors.push_back( profileError );
+		} else if( skipped ) {
+			++result.skipped;
+		} else {
+			++result.written;
+		}
+	}
+
+	result.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	return result;
+}
+
+
+// ----------------------------------------------------------------------------------------------------
+// MARK: - Capturing and Comparing
+// ----------------------------------------------------------------------------------------------------
+
+CameraProfile CameraProfile::capture( CameraController &camera )
+{
+	CameraPtr vmbCamera = camera.getCamera();
+	if( ! vmbCamera ) {
+		throw CameraProfileException( __FUNCTION__, "Profiles need a Vimba camera", VmbErrorNotSupported );
+	}
+
+	FeaturePtrVector features;
+	VmbErrorType error = vmbCamera->GetFeatures( features );
+	if( VmbErrorSuccess != error ) {
+		throw CameraProfileException( __FUNCTION__, ErrorCodeToMessage( error ), error );
+	}
+
+	// streamable features are the ones saved with the camera settings, whether or not they are locked right now
+	auto isSetting = []( const FeaturePtr &feature, std::string &name ) {
+		bool readable = false;
+		bool streamable = false;
+		bool writable = false;
+		return VmbErrorSuccess == feature->GetName( name ) && ! startsWith( name, "UserSet" )
+		       && VmbErrorSuccess == feature->IsReadable( readable ) && readable
+		       && (( VmbErrorSuccess == feature->IsStreamable( streamable ) && streamable )
+		           || ( VmbErrorSuccess == feature->IsWritable( writable ) && writable ));
+	};
+
+	// features under a selector are read for every selector value instead of on their own
+	std::set<std::string> selected;
+	for( const auto &feature : features ) {
+		std::string name;
+		FeaturePtrVector selectedFeatures;
+		if( VmbErrorSuccess == feature->GetName( name ) && isSelector( name )
+		    && VmbErrorSuccess == feature->GetSelectedFeatures( selectedFeatures )) {
+			for( const auto &selectedFeature : selectedFeatures ) {
+				std::string selectedName;
+				if( VmbErrorSuccess == selectedFeature->GetName( selectedName ) && ! isSelector( selectedName )) {
+					selected.insert( selectedName );
+				}
+			}
+		}
+	}
+
+	CameraProfile profile;
+	std::vector<CameraProfileEntry> selectorValues;
+	for( const auto &feature : features ) {
+		std::string name;
+		std::string value;
+		if( ! isSetting( feature, name ) || selected.count( name ) || ! readFeature( feature, value )) {
+			continue;
+		}
+		if( ! isSelector( name )) {
+			profile.set( name, value );
+			continue;
+		}
+
+		std::vector<std::string> values;
+		EnumEntryVector entries;
+		if( VmbErrorSuccess == feature->GetEntries( entries )) {
+			for( const auto &entry : entries ) {
+				std::string entryName;
+				bool available = false;
+				if( VmbErrorSuccess == entry.GetName( entryName )
+				    && VmbErrorSuccess == feature->IsValueAvailable( entryName.c_str(), available ) && available ) {
+					values.push_back( entryName );
+				}
+			}
+		}
+		if( values.empty() ) {
+			values.push_back( value );
+		}
+
+		FeaturePtrVector selectedFeatures;
+		feature->GetSelectedFeatures( selectedFeatures );
+		std::string current = value;
+		for( const auto &selectorValue : values ) {
+			if( selectorValue != current && VmbErrorSuccess != feature->SetValue( selectorValue.c_str() )) {
+				continue;
+			}
+			current = selectorValue;
+			profile.set( name, selectorValue );
+			for( const auto &selectedFeature : selectedFeatures ) {
+				std::string selectedName;
+				std::string selectedValue;
+				if( isSetting( selectedFeature, selectedName ) && ! isSelector( selectedName )
+				    && readFeature( selectedFeature, selectedValue )) {
+					profile.set( selectedName, selectedValue );
+				}
+			}
+		}
+		if( current != value ) {
+			feature->SetValue( value.c_str() );
+		}
+
+		CameraProfileEntry entry = { name, value };
+		selectorValues.push_back( entry );
+	}
+
+	// the values the selectors were found at, last so they are the state the profile leaves
+	for( const auto &entry : selectorValues ) {
+		profile.set( entry.name, entry.value );
+	}
+	return profile;
+}
+
+CameraProfile CameraProfile::diff( const CameraProfile &current, const SelectsFunction &selects ) const
+{
+	std::map<std::string, std::string> currentValues;
+	std::map<std::string, std::string> currentSelectors;
+	const std::vector<std::string> currentKeys = getKeys( current.mEntries, selects );
+	for( size_t i = 0; i < currentKeys.size(); ++i ) {
+		const CameraProfileEntry &entry = current.mEntries[i];
+		if( currentKeys[i].empty() ) {
+			currentSelectors[entry.name] = entry.value;
+		} else {
+			currentValues[currentKeys[i]] = entry.value;
+		}
+	}
+
+	CameraProfile changes;
+	std::map<std::string, std::string> finalSelectors;
+	std::vector<std::string> selectorOrder;
+	std::map<std::string, std::string> writtenSelectors;
+	const CameraProfileEntry *selector = nullptr;
+	const CameraProfileEntry *changesSelector = nullptr;    // context of the last entry in changes
+	const std::vector<std::string> keys = getKeys( mEntries, selects );
+	for( size_t i = 0; i < keys.size(); ++i ) {
+		const CameraProfileEntry &entry = mEntries[i];
+		if( keys[i].empty() ) {
+			selector = &entry;
+			if( ! finalSelectors.count( entry.name )) {
+				selectorOrder.push_back( entry.name );
+			}
+			finalSelectors[entry.name] = entry.value;
+			continue;
+		}
+
+		auto it = currentValues.find( keys[i] );
+		if( it != currentValues.end() && sameValue( it->second, entry.value )) {
+			continue;
+		}
+		if( keys[i] == entry.name ) {
+			changesSelector = nullptr;
+		} else if( changesSelector != selector ) {
+			changes.set( selector->name, selector->value );
+			writtenSelectors[selector->name] = selector->value;
+			changesSelector = selector;
+		}
+		changes.set( entry.name, entry.value );
+	}
+
+	// leave the selectors where this profile leaves them
+	for( const auto &name : selectorOrder ) {
+		auto written = writtenSelectors.find( name );
+		auto known = currentSelectors.find( name );
+		const std::string *left = written != writtenSelectors.end() ? &written->second
+		                          : known != currentSelectors.end() ? &known->second : nullptr;
+		if( ! left || ! sameValue( *left, finalSelectors[name] )) {
+			changes.set( name, finalSelectors[name] );
+		}
+	}
+	return changes;
+}
+
+CameraProfile& CameraProfile::update( const CameraProfile &changes, const SelectsFunction &selects )
+{
+	// features by key, selectors by the entries that hold their final value rather than a context
+	std::map<std::string, size_t> index;
+	const std::vector<std::string> keys = getKeys( mEntries, selects );
+	for( size_t i = 0; i < keys.size(); ++i ) {
+		const std::string &name = mEntries[i].name;
+		if( ! keys[i].empty() ) {
+			index[keys[i]] = i;
+		} else if( i + 1 == keys.size() || ! startsWith( keys[i + 1], name + "=" )) {
+			index[name] = i;
+		}
+	}
+
+	std::set<std::string> contexts;
+	std::map<std::string, std::string> finalSelectors;
+	const CameraProfileEntry *selector = nullptr;
+	const std::vector<std::string> changeKeys = getKeys( changes.mEntries, selects );
+	for( size_t i = 0; i < changeKeys.size(); ++i ) {
+		const CameraProfileEntry &entry = changes.mEntries[i];
+		if( changeKeys[i].empty() ) {
+			selector = &entry;
+			finalSelectors[entry.name] = entry.value;
+		}
+		auto it = index.find( changeKeys[i].empty() ? entry.name : changeKeys[i] );
+		if( it != index.end() ) {
+			mEntries[it->second].value = entry.value;
+		} else if( changeKeys[i] != entry.name && ! changeKeys[i].empty() ) {
+			set( selector->name, selector->value );
+			set( entry.name, entry.value );
+			contexts.insert( selector->name );
+		} else if( changeKeys[i].empty() ) {
+			index[entry.name] = mEntries.size();
+			set( entry.name, entry.value );
+		} else {
+			set( entry.name, entry.value );
+		}
+	}
+
+	// a selector written as a context above no longer ends at its final value
+	for( const auto &name : contexts ) {
+		auto it = index.find( name );
+		set( name, it != index.end() ? mEntries[it->second].value : finalSelectors[name] );
+	}
+	return *this;
+}
+
+} // namespace civimba
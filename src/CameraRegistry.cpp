@@ -0,0 +1,333 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/CameraRegistry.h"
+#include "civimba/ApiController.h"
+#include "civimba/ErrorCodeToMessage.h"
+
+#include <set>
+
+#include "cinder/Log.h"
+
+namespace civimba {
+
+using namespace AVT::VmbAPI;
+
+// Forwards the camera list notifications of Vimba, which arrive on a Vimba thread
+class CameraRegistry::Observer : public ICameraListObserver {
+  public:
+	Observer( CameraRegistry &registry )
+		: mRegistry( registry )
+	{ }
+
+	void CameraListChanged( CameraPtr pCam, UpdateTriggerType reason ) override
+	{
+		mRegistry.cameraListChanged( pCam, reason );
+	}
+
+  private:
+	CameraRegistry &mRegistry;
+};
+
+CameraRegistry::CameraRegistry( ApiController &api, VimbaSystem &system, const ReconnectSchedule::Options &reconnectOptions )
+		: mApi( api ), mSystem( system ), mReconnects( 0 ), mSchedule( reconnectOptions )
+{
+	// register first so no change between enumeration and registration is lost, update() ignores duplicates
+	mObserver = ICameraListObserverPtr( new Observer( *this ));
+	VmbErrorType res = mSystem.RegisterCameraListObserver( mObserver );
+	if( VmbErrorSuccess != res ) {
+		throw CameraRegistryException( __FUNCTION__, ErrorCodeToMessage( res ), res );
+	}
+
+	CameraPtrVector cameras;
+	if( VmbErrorSuccess == mSystem.GetCameras( cameras )) {
+		std::lock_guard<std::mutex> lock( mMutex );
+		CameraEvent event;
+		for( const auto &camera : cameras ) {
+			update( camera, true, event );
+		}
+	}
+
+	mThread = std::thread( &CameraRegistry::runReconnect, this );
+}
+
+CameraRegistry::~CameraRegistry()
+{
+	mSystem.UnregisterCameraListObserver( mObserver );
+	mSchedule.stop();
+	if( mThread.joinable() ) {
+		mThread.join();
+	}
+}
+
+std::vector<CameraInfo> CameraRegistry::getCameraInfos() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	std::vector<CameraInfo> infos;
+	for( const auto &entry : mCameras ) {
+		infos.push_back( entry.second );
+	}
+	return infos;
+}
+
+std::vector<CameraPtr> CameraRegistry::getCameras() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	std::vector<CameraPtr> cameras;
+	for( const auto &entry : mCameras ) {
+		if( entry.second.reachable ) {
+			cameras.push_back( entry.second.camera );
+		}
+	}
+	return cameras;
+}
+
+bool CameraRegistry::isReachable( const std::string &cameraID ) const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	auto it = mCameras.find( cameraID );
+	return mCameras.end() != it && it->second.reachable;
+}
+
+uint64_t CameraRegistry::getReconnects() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mReconnects;
+}
+
+bool CameraRegistry::update( const CameraPtr &camera, bool reachable, CameraEvent &event )
+{
+	std::string id;
+	if( SP_ISNULL( camera ) || VmbErrorSuccess != camera->GetID( id )) {
+		return false;
+	}
+	event.cameraID = id;
+
+	auto it = mCameras.find( id );
+	if( ! reachable ) {
+		if( mCameras.end() == it || ! it->second.reachable ) {
+			return false;
+		}
+		it->second.reachable = false;
+		event.type = CAMERA_EVENT_REMOVED;
+		return true;
+	}
+
+	if( mCameras.end() != it ) {
+		it->second.camera = camera;
+		if( it->second.reachable ) {
+			return false;
+		}
+		it->second.reachable = true;
+		event.type = CAMERA_EVENT_REACHABLE;
+		return true;
+	}
+
+	CameraInfo info;
+	info.cameraID = id;
+	camera->GetName( info.name );
+	camera->GetModel( info.model );
+	camera->GetSerialNumber( info.serialNumber );
+	camera->GetInterfaceID( info.interfaceID );
+	info.reachable = true;
+	info.camera = camera;
+	mCameras[id] = info;
+	event.type = CAMERA_EVENT_ADDED;
+	return true;
+}
+
+void CameraRegistry::cameraListChanged( const CameraPtr &camera, UpdateTriggerType reason )
+{
+	CameraEvent event;
+	bool changed = false;
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		if( UpdateTriggerOpenStateChanged == reason ) {
+			changed = ! SP_ISNULL( camera ) && VmbErrorSuccess == camera->GetID( event.cameraID );
+			event.type = CAMERA_EVENT_OPEN_STATE_CHANGED;
+		} else {
+			changed = update( camera, UpdateTriggerPluggedIn == reason, event );
+		}
+	}
+	if( ! changed ) {
+		return;
+	}
+
+	emit( event );
+	if( CAMERA_EVENT_REMOVED == event.type || CAMERA_EVENT_REACHABLE == event.type ) {
+		schedule( event.cameraID, CAMERA_EVENT_REACHABLE == event.type );
+	}
+}
+
+void CameraRegistry::refresh()
+{
+	CameraPtrVector cameras;
+	VmbErrorType res = mSystem.GetCameras( cameras );
+	if( VmbErrorSuccess != res ) {
+		throw CameraRegistryException( __FUNCTION__, ErrorCodeToMessage( res ), res );
+	}
+
+	std::vector<CameraEvent> events;
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		std::set<std::string> present;
+		CameraEvent event;
+		for( const auto &camera : cameras ) {
+			std::string id;
+			if( VmbErrorSuccess == camera->GetID( id )) {
+				present.insert( id );
+			}
+			if( update( camera, true, event )) {
+				events.push_back( event );
+			}
+		}
+		for( auto &entry : mCameras ) {
+			if( entry.second.reachable && ! present.count( entry.first ) && update( entry.second.camera, false, event )) {
+				events.push_back( event );
+			}
+		}
+	}
+
+	for( const auto &event : events ) {
+		emit( event );
+		if( CAMERA_EVENT_REMOVED == event.type || CAMERA_EVENT_REACHABLE == event.type ) {
+			schedule( event.cameraID, CAMERA_EVENT_REACHABLE == event.type );
+		}
+	}
+}
+
+void CameraRegistry::emit( const CameraEvent &event )
+{
+	mSignalCameraEvent.emit( event );
+}
+
+// MARK: - Auto reconnect
+
+void CameraRegistry::setAutoReconnect( const CameraControllerRef &camera, bool enable )
+{
+	if( ! camera || ! camera->getCamera() ) {
+		throw CameraRegistryException( __FUNCTION__, "Auto reconnect needs a Vimba camera", VmbErrorBadParameter );
+	}
+
+	const std::string id = camera->getID();
+	std::lock_guard<std::mutex> lock( mMutex );
+	if( enable ) {
+		Watched watched;
+		watched.camera = camera;
+		watched.wasAcquiring = false;
+		mWatched[id] = watched;
+	} else {
+		mWatched.erase( id );
+	}
+}
+
+void CameraRegistry::schedule( const std::string &cameraID, bool reconnect )
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		if( ! mWatched.count( cameraID )) {
+			return;
+		}
+	}
+	mSchedule.schedule( cameraID, reconnect );
+}
+
+void CameraRegistry::runReconnect()
+{
+	ReconnectSchedule::Task task;
+	while( mSchedule.wait( task )) {
+		CameraControllerRef camera;
+		bool wasAcquiring = false;
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			auto it = mWatched.find( task.cameraID );
+			if( mWatched.end() == it ) {
+				continue;
+			}
+			camera = it->second.camera.lock();
+			if( ! camera ) {
+				mWatched.erase( it );
+				continue;
+			}
+			wasAcquiring = it->second.wasAcquiring;
+		}
+
+		if( ! task.reconnect ) {
+			// release the frames of the lost camera, acquisition resumes once it is back
+			bool acquiring = false;
+			{
+				std::lock_guard<std::recursive_mutex> cameraLock( camera->mStateMutex );
+				acquiring = camera->isAcquiring();
+				if( acquiring ) {
+					camera->stopContinuousImageAcquisition();
+				}
+			}
+			std::lock_guard<std::mutex> lock( mMutex );
+			auto it = mWatched.find( task.cameraID );
+			if( mWatched.end() != it ) {
+				it->second.wasAcquiring = it->second.wasAcquiring || acquiring;
+			}
+			continue;
+		}
+
+		CameraEvent event;
+		event.cameraID = task.cameraID;
+		try {
+			{
+				std::lock_guard<std::recursive_mutex> cameraLock( camera->mStateMutex );
+				mApi.reopenCamera( camera );
+				if( wasAcquiring ) {
+					camera->startContinuousImageAcquisition();
+				}
+			}
+			event.type = CAMERA_EVENT_RECONNECTED;
+			CI_LOG_I( "Reconnected camera " << task.cameraID );
+
+			std::lock_guard<std::mutex> lock( mMutex );
+			++mReconnects;
+			auto it = mWatched.find( task.cameraID );
+			if( mWatched.end() != it ) {
+				it->second.wasAcquiring = false;
+			}
+		}
+		catch( const BaseException &exc ) {
+			event.type = CAMERA_EVENT_RECONNECT_FAILED;
+			// no further list event arrives for a camera that is still plugged in, so it is tried again
+			bool retry = false;
+			{
+				std::lock_guard<std::mutex> lock( mMutex );
+				auto it = mCameras.find( task.cameraID );
+				retry = mCameras.end() != it && it->second.reachable && mWatched.count( task.cameraID );
+			}
+			if( retry ) {
+				const double delay = mSchedule.retry( task );
+				CI_LOG_E( "Unable to reconnect camera " << task.cameraID << ": " << exc.Message()
+				          << ", trying again in " << delay << " s" );
+			} else {
+				CI_LOG_E( "Unable to reconnect camera " << task.cameraID << ": " << exc.Message() );
+			}
+		}
+		emit( event );
+	}
+}
+
+} // namespace civimba
@@ -0,0 +1,291 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "civimba/CaptureFile.h"
+#include "civimba/FrameCodec.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace civimba {
+
+std::vector<VmbUchar_t> makeCaptureIndex( const std::vector<CaptureIndexEntry> &entries, uint64_t indexOffset )
+{
+	CaptureIndexHeader header;
+	header.magic = CAPTURE_INDEX_MAGIC;
+	header.headerSize = sizeof( CaptureIndexHeader );
+	header.entryCount = entries.size();
+
+	CaptureIndexFooter footer;
+	footer.indexOffset = indexOffset;
+	footer.magic = CAPTURE_INDEX_MAGIC;
+	footer.reserved = 0;
+
+	const size_t entriesSize = entries.size() * sizeof( CaptureIndexEntry );
+	std::vector<VmbUchar_t> index( sizeof( header ) + entriesSize + sizeof( footer ));
+	std::memcpy( index.data(), &header, sizeof( header ));
+	if( ! entries.empty() ) {
+		std::memcpy( index.data() + sizeof( header ), entries.data(), entriesSize );
+	}
+	std::memcpy( index.data() + sizeof( header ) + entriesSize, &footer, sizeof( footer ));
+	return index;
+}
+
+std::vector<VmbUchar_t> makeCaptureSyncFileHeader( const std::vector<CaptureStreamEntry> &streams, uint64_t window )
+{
+	CaptureFileHeader fileHeader = makeCaptureFileHeader( "", 1000000000, CAPTURE_FILE_FLAG_SYNC );
+	const size_t tableSize = streams.size() * sizeof( CaptureStreamEntry );
+	fileHeader.headerSize = static_cast<uint32_t>( sizeof( CaptureFileHeader ) + sizeof( CaptureSyncHeader ) + tableSize );
+
+	CaptureSyncHeader syncHeader;
+	syncHeader.streamCount = static_cast<uint32_t>( streams.size() );
+	syncHeader.reserved = 0;
+	syncHeader.window = window;
+
+	std::vector<VmbUchar_t> header( fileHeader.headerSize );
+	std::memcpy( header.data(), &fileHeader, sizeof( fileHeader ));
+	std::memcpy( header.data() + sizeof( fileHeader ), &syncHeader, sizeof( syncHeader ));
+	if( ! streams.empty() ) {
+		std::memcpy( header.data() + sizeof( fileHeader ) + sizeof( syncHeader ), streams.data(), tableSize );
+	}
+	return header;
+}
+
+std::vector<uint64_t> makeCaptureSyncGroups( std::vector<CaptureSyncFrame> &frames, uint32_t streamCount, uint64_t window )
+{
+	std::stable_sort( frames.begin(), frames.end(), []( const CaptureSyncFrame &a, const CaptureSyncFrame &b ) {
+		return a.timestamp < b.timestamp;
+	} );
+
+	const size_t stride = 1 + streamCount;
+	std::vector<uint64_t> groups;
+	size_t group = 0;
+	for( const CaptureSyncFrame &frame : frames ) {
+		if( frame.stream >= streamCount ) {
+			continue;
+		}
+		if( groups.empty() || frame.timestamp - groups[group] > window || CAPTURE_SYNC_NO_FRAME != groups[group + 1 + frame.stream] ) {
+			group = groups.size();
+			groups.resize( group + stride, CAPTURE_SYNC_NO_FRAME );
+			groups[group] = frame.timestamp;
+		}
+		groups[group + 1 + frame.stream] = frame.frame;
+	}
+	return groups;
+}
+
+std::vector<VmbUchar_t> makeCaptureSyncIndex( const std::vector<uint64_t> &groups, uint32_t streamCount )
+{
+	CaptureSyncIndexHeader header;
+	header.magic = CAPTURE_SYNC_MAGIC;
+	header.headerSize = sizeof( CaptureSyncIndexHeader );
+	header.groupCount = groups.size() / ( 1 + streamCount );
+	header.streamCount = streamCount;
+	header.reserved = 0;
+
+	const size_t groupsSize = groups.size() * sizeof( uint64_t );
+	CaptureSyncIndexFooter footer;
+	footer.size = sizeof( header ) + groupsSize + sizeof( footer );
+	footer.magic = CAPTURE_SYNC_MAGIC;
+	footer.reserved = 0;
+
+	std::vector<VmbUchar_t> index( static_cast<size_t>( footer.size ));
+	std::memcpy( index.data(), &header, sizeof( header ));
+	if( ! groups.empty() ) {
+		std::memcpy( index.data() + sizeof( header ), groups.data(), groupsSize );
+	}
+	std::memcpy( index.data() + sizeof( header ) + groupsSize, &footer, sizeof( footer ));
+	return index;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// MARK: - CaptureWriter
+// ----------------------------------------------------------------------------------------------------
+CaptureWriter::CaptureWriter( const std::string &path, const std::string &cameraID, uint64_t timestampFrequency )
+		: mFile( nullptr ), mFramesWritten( 0 ), mBytesWritten( 0 )
+{
+	mFile = std::fopen( path.c_str(), "wb" );
+	if( ! mFile ) {
+		throw CaptureException( __FUNCTION__, "Unable to open capture file " + path, VmbErrorResources );
+	}
+	// large buffer so most frames turn into a handful of write calls
+	std::setvbuf( mFile, nullptr, _IOFBF, 4 * 1024 * 1024 );
+
+	CaptureFileHeader header = makeCaptureFileHeader( cameraID, timestampFrequency );
+
+	if( 1 != std::fwrite( &header, sizeof( header ), 1, mFile )) {
+		close();
+		throw CaptureException( __FUNCTION__, "Unable to write capture file header", VmbErrorResources );
+	}
+	mBytesWritten = sizeof( header );
+}
+
+CaptureWriter::~CaptureWriter()
+{
+	close();
+}
+
+void CaptureWriter::write( const RawFrame &frame )
+{
+	writeRecord( makeCaptureFrameHeader( frame ), frame.buffer );
+}
+
+void CaptureWriter::writeRecord( const CaptureFrameHeader &header, const VmbUchar_t *data )
+{
+	if( ! mFile ) {
+		throw CaptureException( __FUNCTION__, "Capture file is closed", VmbErrorInvalidCall );
+	}
+
+	static const VmbUchar_t padding[8] = { 0 };
+	size_t paddingSize = static_cast<size_t>( getCaptureRecordSize( header.imageSize ) - sizeof( header ) - header.imageSize );
+
+	if( 1 != std::fwrite( &header, sizeof( header ), 1, mFile )
+	    || header.imageSize != std::fwrite( data, 1, header.imageSize, mFile )
+	    || paddingSize != std::fwrite( padding, 1, paddingSize, mFile )) {
+		throw CaptureException( __FUNCTION__, "Error writing capture file", VmbErrorResources );
+	}
+
+	mIndex.push_back( makeCaptureIndexEntry( header, mBytesWritten ));
+	++mFramesWritten;
+	mBytesWritten += getCaptureRecordSize( header.imageSize );
+}
+
+void CaptureWriter::close()
+{
+	if( mFile ) {
+		std::vector<VmbUchar_t> index = makeCaptureIndex( mIndex, mBytesWritten );
+		std::fwrite( index.data(), 1, index.size(), mFile );
+		std::fclose( mFile );
+		mFile = nullptr;
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------
+// MARK: - CaptureReader
+// ----------------------------------------------------------------------------------------------------
+CaptureReader::CaptureReader( const std::string &path )
+		: mFile( nullptr ), mRingIndex( 0 )
+{
+	std::memset( &mRingHeader, 0, sizeof( mRingHeader ));
+
+	mFile = std::fopen( path.c_str(), "rb" );
+	if( ! mFile ) {
+		throw CaptureException( __FUNCTION__, "Unable to open capture file " + path, VmbErrorNotFound );
+	}
+
+	if( 1 != std::fread( &mFileHeader, sizeof( mFileHeader ), 1, mFile )
+	    || 0 != std::memcmp( mFileHeader.magic, CAPTURE_FILE_MAGIC, sizeof( mFileHeader.magic ))) {
+		std::fclose( mFile );
+		throw CaptureException( __FUNCTION__, path + " is not a civimba capture file", VmbErrorInvalidValue );
+	}
+	if( mFileHeader.version > CAPTURE_FILE_VERSION ) {
+		std::fclose( mFile );
+		throw CaptureException( __FUNCTION__, path + " was written by a newer version of civimba", VmbErrorNotSupported );
+	}
+	if( isRing()
+	    && ( mFileHeader.headerSize < sizeof( CaptureFileHeader ) + sizeof( CaptureRingHeader )
+	         || 1 != std::fread( &mRingHeader, sizeof( mRingHeader ), 1, mFile ))) {
+		std::fclose( mFile );
+		throw CaptureException( __FUNCTION__, path + " has a damaged ring header", VmbErrorInvalidValue );
+	}
+	// a ring closed before its first frame, without an explicit slot size, never got its slots and is empty
+	if( isRing() && ! ( 0 == mRingHeader.slotCount && 0 == mRingHeader.framesWritten )) {
+		// the slots are preallocated, so they all have to be inside the file
+		std::fseek( mFile, 0, SEEK_END );
+		const long fileSize = std::ftell( mFile );
+		const uint64_t slotsSize = fileSize > 0 && mFileHeader.headerSize < static_cast<uint64_t>( fileSize )
+		                           ? static_cast<uint64_t>( fileSize ) - mFileHeader.headerSize : 0;
+		if( 0 == mRingHeader.slotCount || mRingHeader.slotSize < sizeof( CaptureFrameHeader )
+		    || mRingHeader.slotSize > slotsSize / mRingHeader.slotCount ) {
+			std::fclose( mFile );
+			throw CaptureException( __FUNCTION__, path + " has a damaged ring header", VmbErrorInvalidValue );
+		}
+	}
+	rewind();
+}
+
+CaptureReader::~CaptureReader()
+{
+	if( mFile ) {
+		std::fclose( mFile );
+	}
+}
+
+bool CaptureReader::readNext( CaptureFrameHeader &header, std::vector<VmbUchar_t> &data )
+{
+	if( ! isRing() ) {
+		return readRecord( header, data );
+	}
+
+	const uint64_t count = std::min( mRingHeader.framesWritten, mRingHeader.slotCount );
+	const uint64_t oldest = mRingHeader.framesWritten > mRingHeader.slotCount ? mRingHeader.framesWritten % mRingHeader.slotCount : 0;
+	while( mRingIndex < count ) {
+		uint64_t slot = ( oldest + mRingIndex++ ) % mRingHeader.slotCount;
+		std::fseek( mFile, static_cast<long>( mFileHeader.headerSize + slot * mRingHeader.slotSize ), SEEK_SET );
+		if( readRecord( header, data )) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool CaptureReader::readRecord( CaptureFrameHeader &header, std::vector<VmbUchar_t> &data )
+{
+	if( 1 != std::fread( &header, sizeof( header ), 1, mFile ) || CAPTURE_FRAME_MAGIC != header.magic ) {
+		return false;
+	}
+	if( isRing() && getCaptureRecordSize( header.imageSize ) > mRingHeader.slotSize ) {
+		return false;
+	}
+
+	const bool compressed = 0 != ( header.flags & CAPTURE_FRAME_FLAG_COMPRESSED );
+	std::vector<VmbUchar_t> &target = compressed ? mEncoded : data;
+	target.resize( header.imageSize );
+	if( header.imageSize != std::fread( target.data(), 1, header.imageSize, mFile )) {
+		return false;
+	}
+
+	long paddingSize = static_cast<long>( getCaptureRecordSize( header.imageSize ) - sizeof( header ) - header.imageSize );
+	if( paddingSize > 0 ) {
+		std::fseek( mFile, paddingSize, SEEK_CUR );
+	}
+
+	if( compressed ) {
+		try {
+			header.imageSize = static_cast<uint32_t>( FrameCodec::decode( mEncoded.data(), mEncoded.size(), data ));
+		}
+		catch( const FrameCodec::FrameCodecException &exc ) {
+			throw CaptureException( __FUNCTION__, "Damaged compressed frame: " + exc.Message(), VmbErrorInvalidValue );
+		}
+		header.flags &= ~CAPTURE_FRAME_FLAG_COMPRESSED;
+	}
+	return true;
+}
+
+void CaptureReader::rewind()
+{
+	std::fseek( mFile, static_cast<long>( mFileHeader.headerSize ), SEEK_SET );
+	mRingIndex = 0;
+}
+
+} // namespace civimba
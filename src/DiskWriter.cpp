@@ -0,0 +1,685 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/DiskWriter.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined( __linux__ ) && ! defined( CIVIMBA_NO_IO_URING )
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#define CIVIMBA_IO_URING 1
+#endif
+
+#include "cinder/Log.h"
+
+namespace civimba {
+
+namespace {
+
+// O_DIRECT needs the buffer address, file offset and length aligned to the logical block size of the device,
+// 4096 covers all current disks
+const size_t kAlignment = 4096;
+
+size_t alignUp( size_t size )
+{
+	return ( size + kAlignment - 1 ) & ~( kAlignment - 1 );
+}
+
+// entries per index chunk, 192 KB
+const uint64_t kIndexChunkEntries = 8192;
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------------------------------
+// MARK: - IoUring
+// ----------------------------------------------------------------------------------------------------
+
+// Minimal io_uring submission / completion queue on top of the raw system calls, enough for batched writes
+// without depending on liburing.
+struct DiskWriter::IoUring {
+#if defined( CIVIMBA_IO_URING )
+	IoUring()
+		: mFd( -1 ), mSqRing( MAP_FAILED ), mCqRing( MAP_FAILED ), mSqes( MAP_FAILED ), mSqRingSize( 0 ),
+		  mCqRingSize( 0 ), mSqesSize( 0 ), mPending( 0 )
+	{ }
+
+	~IoUring()
+	{
+		if( MAP_FAILED != mSqes ) {
+			::munmap( mSqes, mSqesSize );
+		}
+		if( MAP_FAILED != mCqRing && mCqRing != mSqRing ) {
+			::munmap( mCqRing, mCqRingSize );
+		}
+		if( MAP_FAILED != mSqRing ) {
+			::munmap( mSqRing, mSqRingSize );
+		}
+		if( mFd >= 0 ) {
+			::close( mFd );
+		}
+	}
+
+	// returns 0 or an errno value
+	int setup( unsigned entries )
+	{
+		io_uring_params params;
+		std::memset( &params, 0, sizeof( params ));
+		mFd = static_cast<int>( ::syscall( __NR_io_uring_setup, entries, &params ));
+		if( mFd < 0 ) {
+			return errno;
+		}
+
+		mSqRingSize = params.sq_off.array + params.sq_entries * sizeof( unsigned );
+		mCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof( io_uring_cqe );
+		const bool singleMap = 0 != ( params.features & IORING_FEAT_SINGLE_MMAP );
+		if( singleMap ) {
+			mSqRingSize = mCqRingSize = std::max( mSqRingSize, mCqRingSize );
+		}
+		mSqRing = ::mmap( nullptr, mSqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mFd, IORING_OFF_SQ_RING );
+		if( MAP_FAILED == mSqRing ) {
+			return errno;
+		}
+		mCqRing = singleMap ? mSqRing
+		                    : ::mmap( nullptr, mCqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mFd, IORING_OFF_CQ_RING );
+		if( MAP_FAILED == mCqRing ) {
+			return errno;
+		}
+		mSqesSize = params.sq_entries * sizeof( io_uring_sqe );
+		mSqes = ::mmap( nullptr, mSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mFd, IORING_OFF_SQES );
+		if( MAP_FAILED == mSqes ) {
+			return errno;
+		}
+
+		char *sq = static_cast<char*>( mSqRing );
+		mSqTail = reinterpret_cast<unsigned*>( sq + params.sq_off.tail );
+		mSqMask = *reinterpret_cast<unsigned*>( sq + params.sq_off.ring_mask );
+		mSqArray = reinterpret_cast<unsigned*>( sq + params.sq_off.array );
+		char *cq = static_cast<char*>( mCqRing );
+		mCqHead = reinterpret_cast<unsigned*>( cq + params.cq_off.head );
+		mCqTail = reinterpret_cast<unsigned*>( cq + params.cq_off.tail );
+		mCqMask = *reinterpret_cast<unsigned*>( cq + params.cq_off.ring_mask );
+		mCqes = reinterpret_cast<io_uring_cqe*>( cq + params.cq_off.cqes );
+		mIovecs.resize( entries );
+		return 0;
+	}
+
+	// queue a write, index identifies the buffer in the completion and must be below the number of entries
+	void prepareWrite( int file, void *data, size_t size, uint64_t offset, size_t index )
+	{
+		mIovecs[index].iov_base = data;
+		mIovecs[index].iov_len = size;
+
+		unsigned tail = *mSqTail;
+		unsigned slot = tail & mSqMask;
+		io_uring_sqe &sqe = static_cast<io_uring_sqe*>( mSqes )[slot];
+		std::memset( &sqe, 0, sizeof( sqe ));
+		sqe.opcode = IORING_OP_WRITEV;
+		sqe.fd = file;
+		sqe.addr = reinterpret_cast<uint64_t>( &mIovecs[index] );
+		sqe.len = 1;
+		sqe.off = offset;
+		sqe.user_data = index;
+		mSqArray[slot] = slot;
+		__atomic_store_n( mSqTail, tail + 1, __ATOMIC_RELEASE );
+		++mPending;
+	}
+
+	// submits the queued writes and waits for at least minComplete completions, returns 0 or an errno value
+	int enter( unsigned minComplete )
+	{
+		long result = ::syscall( __NR_io_uring_enter, mFd, mPending, minComplete,
+		                         minComplete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0 );
+		if( result < 0 ) {
+			return ( EINTR == errno || EAGAIN == errno || EBUSY == errno ) ? 0 : errno;
+		}
+		mPending -= static_cast<unsigned>( result );
+		return 0;
+	}
+
+	// takes back the writes the last enter() did not submit, their indices are appended to indices
+	void cancelPending( std::vector<size_t> &indices )
+	{
+		unsigned tail = *mSqTail;
+		for( ; mPending > 0; --mPending ) {
+			--tail;
+			indices.push_back( static_cast<size_t>( static_cast<io_uring_sqe*>( mSqes )[tail & mSqMask].user_data ));
+		}
+		__atomic_store_n( mSqTail, tail, __ATOMIC_RELEASE );
+	}
+
+	bool peek( size_t &index, int &result )
+	{
+		unsigned head = *mCqHead;
+		if( head == __atomic_load_n( mCqTail, __ATOMIC_ACQUIRE )) {
+			return false;
+		}
+		const io_uring_cqe &cqe = mCqes[head & mCqMask];
+		index = static_cast<size_t>( cqe.user_data );
+		result = cqe.res;
+		__atomic_store_n( mCqHead, head + 1, __ATOMIC_RELEASE );
+		return true;
+	}
+
+	int                 mFd;
+	void                *mSqRing;
+	void                *mCqRing;
+	void                *mSqes;
+	size_t              mSqRingSize;
+	size_t              mCqRingSize;
+	size_t              mSqesSize;
+	unsigned            *mSqTail;
+	unsigned            mSqMask;
+	unsigned            *mSqArray;
+	unsigned            *mCqHead;
+	unsigned            *mCqTail;
+	unsigned            mCqMask;
+	io_uring_cqe        *mCqes;
+	unsigned            mPending;
+	std::vector<iovec>  mIovecs;
+#else
+	int setup( unsigned ) { return ENOSYS; }
+	void prepareWrite( int, void *, size_t, uint64_t, size_t ) { }
+	int enter( unsigned ) { return ENOSYS; }
+	void cancelPending( std::vector<size_t> & ) { }
+	bool peek( size_t &, int & ) { return false; }
+#endif
+};
+
+// ----------------------------------------------------------------------------------------------------
+// MARK: - DiskWriter
+// ----------------------------------------------------------------------------------------------------
+DiskWriter::DiskWriter( const Options &options, const std::string &cameraID, uint64_t timestampFrequency )
+		: mOptions( options ), mBackend( DISK_WRITER_THREAD ), mFile( -1 ), mDirectWrites( false ), mBufferSize( 0 ),
+		  mIndexCount( 0 ), mCurrent( -1 ), mNextOffset( 0 ), mSize( 0 ), mBuffersQueued( 0 ), mStop( false ),
+		  mFailed( false )
+{
+	CaptureFileHeader header = makeCaptureFileHeader( cameraID, timestampFrequency );
+	open( reinterpret_cast<const VmbUchar_t*>( &header ), sizeof( header ));
+}
+
+DiskWriter::DiskWriter( const Options &options, CameraController &camera )
+		: mOptions( options ), mBackend( DISK_WRITER_THREAD ), mFile( -1 ), mDirectWrites( false ), mBufferSize( 0 ),
+		  mIndexCount( 0 ), mCurrent( -1 ), mNextOffset( 0 ), mSize( 0 ), mBuffersQueued( 0 ), mStop( false ),
+		  mFailed( false )
+{
+	CaptureFileHeader header = makeCaptureFileHeader( camera.getID(), camera.getTimestampFrequency() );
+	open( reinterpret_cast<const VmbUchar_t*>( &header ), sizeof( header ));
+	attach( camera );
+}
+
+DiskWriter::DiskWriter( const Options &options, const std::vector<VmbUchar_t> &fileHeader )
+		: mOptions( options ), mBackend( DISK_WRITER_THREAD ), mFile( -1 ), mDirectWrites( false ), mBufferSize( 0 ),
+		  mIndexCount( 0 ), mCurrent( -1 ), mNextOffset( 0 ), mSize( 0 ), mBuffersQueued( 0 ), mStop( false ),
+		  mFailed( false )
+{
+	if( fileHeader.size() < sizeof( CaptureFileHeader ) || 0 != fileHeader.size() % 8 ) {
+		throw DiskWriterException( __FUNCTION__, "Invalid capture file header", VmbErrorBadParameter );
+	}
+	open( fileHeader.data(), fileHeader.size() );
+}
+
+DiskWriter::~DiskWriter()
+{
+	close();
+}
+
+void DiskWriter::open( const VmbUchar_t *header, size_t headerSize )
+{
+	std::memset( &mStatistics, 0, sizeof( mStatistics ));
+	if( 0 == mOptions.getQueueDepth() ) {
+		throw DiskWriterException( __FUNCTION__, "Queue depth must be at least 1", VmbErrorBadParameter );
+	}
+	mBufferSize = alignUp( std::max<size_t>( mOptions.getBufferSize(), 1 ));
+
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#if defined( O_DIRECT )
+	if( mOptions.getDirect() ) {
+		flags |= O_DIRECT;
+	}
+#endif
+	mFile = ::open( mOptions.getPath().c_str(), flags, 0644 );
+#if defined( O_DIRECT )
+	if( mFile < 0 && EINVAL == errno && 0 != ( flags & O_DIRECT )) {
+		CI_LOG_W( "O_DIRECT is not supported for " << mOptions.getPath() << ", using buffered writes" );
+		mFile = ::open( mOptions.getPath().c_str(), flags & ~O_DIRECT, 0644 );
+		flags &= ~O_DIRECT;
+	}
+	mDirectWrites = 0 != ( flags & O_DIRECT );
+#endif
+	if( mFile < 0 ) {
+		throw DiskWriterException( __FUNCTION__, "Unable to open " + mOptions.getPath() + ": " + std::strerror( errno ),
+		                           VmbErrorResources );
+	}
+#if defined( __APPLE__ )
+	if( mOptions.getDirect() ) {
+		::fcntl( mFile, F_NOCACHE, 1 );
+	}
+#endif
+
+	const uint32_t count = mOptions.getQueueDepth();
+	mBuffers.reserve( count );
+	for( uint32_t i = 0; i < count; ++i ) {
+		void *data = nullptr;
+		if( 0 != ::posix_memalign( &data, kAlignment, mBufferSize )) {
+			release();
+			throw DiskWriterException( __FUNCTION__, "Unable to allocate staging buffers", VmbErrorResources );
+		}
+		Buffer buffer = { static_cast<VmbUchar_t*>( data ), 0, 0 };
+		mBuffers.push_back( buffer );
+		mFree.push_back( count - 1 - i );
+	}
+	mReady.reserve( count );
+	mIndexChunks.reserve( 1024 );
+	reserveIndex( std::max( mOptions.getExpectedFrames(), kIndexChunkEntries ));
+
+	if( DISK_WRITER_THREAD != mOptions.getBackend() ) {
+		mIoUring.reset( new IoUring );
+		int error = mIoUring->setup( count );
+		if( 0 == error ) {
+			mBackend = DISK_WRITER_IO_URING;
+		} else {
+			mIoUring.reset();
+			if( DISK_WRITER_IO_URING == mOptions.getBackend() ) {
+				release();
+				throw DiskWriterException( __FUNCTION__, std::string( "io_uring is not available: " ) + std::strerror( error ),
+				                           VmbErrorNotSupported );
+			}
+			CI_LOG_I( "io_uring is not available (" << std::strerror( error ) << "), writing from a pwrite thread" );
+		}
+	}
+
+	if( headerSize > mBuffers.size() * mBufferSize ) {
+		release();
+		throw DiskWriterException( __FUNCTION__, "Capture file header does not fit into the staging buffers", VmbErrorBadParameter );
+	}
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		append( header, headerSize );
+	}
+
+	mThread = std::thread( DISK_WRITER_IO_URING == mBackend ? &DiskWriter::runIoUring : &DiskWriter::runThread, this );
+}
+
+void DiskWriter::release()
+{
+	mIoUring.reset();
+	if( mFile >= 0 ) {
+		::close( mFile );
+		mFile = -1;
+	}
+	for( auto &buffer : mBuffers ) {
+		std::free( buffer.data );
+	}
+	mBuffers.clear();
+	mFree.clear();
+	mReady.clear();
+}
+
+void DiskWriter::attach( CameraController &camera )
+{
+	detach();
+	mConnection = camera.getSignalRawFrame().connect( [this]( const RawFrame &frame ) { write( frame ); } );
+}
+
+void DiskWriter::detach()
+{
+	mConnection.disconnect();
+}
+
+size_t DiskWriter::getFreeBytes() const
+{
+	size_t freeBytes = mFree.size() * mBufferSize;
+	if( mCurrent >= 0 ) {
+		freeBytes += mBufferSize - mBuffers[mCurrent].size;
+	}
+	return freeBytes;
+}
+
+void DiskWriter::reserveIndex( uint64_t entries )
+{
+	while( mIndexChunks.size() * kIndexChunkEntries < entries ) {
+		mIndexChunks.emplace_back( new CaptureIndexEntry[kIndexChunkEntries] );
+	}
+}
+
+void DiskWriter::append( const void *data, size_t size )
+{
+	const VmbUchar_t *source = static_cast<const VmbUchar_t*>( data );
+	while( size > 0 ) {
+		if( mCurrent < 0 ) {
+			mCurrent = static_cast<int>( mFree.back() );
+			mFree.pop_back();
+			mBuffers[mCurrent].offset = mNextOffset;
+			mBuffers[mCurrent].size = 0;
+			mNextOffset += mBufferSize;
+		}
+
+		Buffer &buffer = mBuffers[mCurrent];
+		size_t count = std::min( size, mBufferSize - buffer.size );
+		std::memcpy( buffer.data + buffer.size, source, count );
+		buffer.size += count;
+		source += count;
+		size -= count;
+		mSize += count;
+
+		if( mBufferSize == buffer.size ) {
+			mReady.push_back( static_cast<size_t>( mCurrent ));
+			mCurrent = -1;
+			mStatistics.maxBuffersQueued = std::max( mStatistics.maxBuffersQueued, ++mBuffersQueued );
+			mReadyCondition.notify_one();
+		}
+	}
+}
+
+bool DiskWriter::write( const RawFrame &frame )
+{
+	return writeRecord( makeCaptureFrameHeader( frame ), frame.buffer );
+}
+
+bool DiskWriter::writeRecord( const CaptureFrameHeader &header, const VmbUchar_t *data, uint64_t *frame )
+{
+	static const VmbUchar_t padding[8] = { 0 };
+	const uint64_t recordSize = getCaptureRecordSize( header.imageSize );
+
+	std::unique_lock<std::mutex> lock( mMutex );
+	if( mStop || mFile < 0 ) {
+		throw DiskWriterException( __FUNCTION__, "Writer is closed", VmbErrorInvalidCall );
+	}
+
+	if( ! mFailed && recordSize > getFreeBytes() && mOptions.getMaxWait() > 0.0 ) {
+		++mStatistics.backPressureWaits;
+		mFreeCondition.wait_for( lock, std::chrono::duration<double>( mOptions.getMaxWait() ), [this, recordSize] {
+			return mFailed || mStop || recordSize <= getFreeBytes();
+		} );
+	}
+	if( mFailed || mStop || recordSize > getFreeBytes() ) {
+		++mStatistics.framesDropped;
+		return false;
+	}
+
+	if( frame ) {
+		*frame = mIndexCount;
+	}
+	// only allocates if the I/O thread has not kept a spare chunk, e.g. for tiny frames that rarely fill a buffer
+	reserveIndex( mIndexCount + 1 );
+	mIndexChunks[mIndexCount / kIndexChunkEntries][mIndexCount % kIndexChunkEntries] = makeCaptureIndexEntry( header, mSize );
+	++mIndexCount;
+	append( &header, sizeof( header ));
+	append( data, header.imageSize );
+	append( padding, static_cast<size_t>( recordSize - sizeof( header ) - header.imageSize ));
+	++mStatistics.framesQueued;
+	return true;
+}
+
+void DiskWriter::close()
+{
+	close( std::vector<VmbUchar_t>() );
+}
+
+void DiskWriter::close( const std::vector<VmbUchar_t> &beforeIndex )
+{
+	if( 0 != beforeIndex.size() % 8 ) {
+		throw DiskWriterException( __FUNCTION__, "Data in front of the index must be a multiple of 8 bytes", VmbErrorBadParameter );
+	}
+
+	detach();
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		if( mStop || mFile < 0 ) {
+			return;
+		}
+
+		// the index goes through the staging buffers like the frames, so O_DIRECT alignment is kept
+		std::vector<VmbUchar_t> index( beforeIndex );
+		std::vector<CaptureIndexEntry> entries;
+		entries.reserve( static_cast<size_t>( mIndexCount ));
+		for( uint64_t i = 0; i < mIndexCount; ++i ) {
+			entries.push_back( mIndexChunks[i / kIndexChunkEntries][i % kIndexChunkEntries] );
+		}
+		std::vector<VmbUchar_t> captureIndex = makeCaptureIndex( entries, mSize + beforeIndex.size() );
+		index.insert( index.end(), captureIndex.begin(), captureIndex.end() );
+		for( size_t done = 0; done < index.size() && ! mFailed; ) {
+			mFreeCondition.wait( lock, [this] { return mFailed || getFreeBytes() > 0; } );
+			size_t count = std::min( index.size() - done, getFreeBytes() );
+			append( index.data() + done, count );
+			done += count;
+		}
+
+		// the last buffer is padded to the alignment, the padding is cut off again below
+		if( mCurrent >= 0 ) {
+			Buffer &buffer = mBuffers[mCurrent];
+			size_t aligned = alignUp( buffer.size );
+			std::memset( buffer.data + buffer.size, 0, aligned - buffer.size );
+			buffer.size = aligned;
+			mReady.push_back( static_cast<size_t>( mCurrent ));
+			mCurrent = -1;
+			++mBuffersQueued;
+		}
+		mStop = true;
+	}
+	mReadyCondition.notify_all();
+	mFreeCondition.notify_all();
+	if( mThread.joinable() ) {
+		mThread.join();
+	}
+
+	if( 0 != ::ftruncate( mFile, static_cast<off_t>( mSize ))) {
+		CI_LOG_W( "Unable to truncate " << mOptions.getPath() << ": " << std::strerror( errno ));
+	}
+	::fsync( mFile );
+	release();
+}
+
+DiskWriterStatistics DiskWriter::getStatistics() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mStatistics;
+}
+
+void DiskWriter::fail( const std::string &message )
+{
+	if( ! mFailed.exchange( true )) {
+		CI_LOG_E( "Writing " << mOptions.getPath() << " failed: " << message );
+	}
+	mFreeCondition.notify_all();
+}
+
+bool DiskWriter::writeBuffer( const Buffer &buffer, size_t written )
+{
+	while( written < buffer.size ) {
+		// O_DIRECT refuses unaligned offsets and lengths, so a short write is continued from its last aligned byte.
+		// Buffers start and end aligned, the bytes written again are the same.
+		const size_t start = mDirectWrites ? written & ~( kAlignment - 1 ) : written;
+		ssize_t result = ::pwrite( mFile, buffer.data + start, buffer.size - start, static_cast<off_t>( buffer.offset + start ));
+		if( result < 0 ) {
+			if( EINTR == errno ) {
+				continue;
+			}
+			fail( std::strerror( errno ));
+			return false;
+		}
+		if( start + static_cast<size_t>( result ) <= written ) {
+			// pwrite returning 0, or an O_DIRECT write short of the next aligned byte, would be retried forever
+			fail( "No progress writing " + std::to_string( buffer.size - written ) + " bytes at offset "
+			      + std::to_string( buffer.offset + written ));
+			return false;
+		}
+		written = start + static_cast<size_t>( result );
+	}
+	return true;
+}
+
+void DiskWriter::completed( size_t index, bool success )
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		if( success ) {
+			mStatistics.bytesWritten += mBuffers[index].size;
+			++mStatistics.buffersWritten;
+		}
+		--mBuffersQueued;
+		mFree.push_back( index );
+	}
+	mFreeCondition.notify_all();
+}
+
+void DiskWriter::runThread()
+{
+	mOptions.getPlacement().apply( "DiskWriter" );
+
+	std::vector<size_t> batch;
+	batch.reserve( mBuffers.size() );
+	std::vector<iovec> iovecs( std::min<size_t>( mBuffers.size(), IOV_MAX ));
+
+	for(;;) {
+		{
+			std::unique_lock<std::mutex> lock( mMutex );
+			mReadyCondition.wait( lock, [this] { return ! mReady.empty() || mStop; } );
+			if( mReady.empty() ) {
+				break;
+			}
+			batch.swap( mReady );
+			++mStatistics.submissions;
+			// keep a spare index chunk, so write() does not allocate
+			reserveIndex( mIndexCount + kIndexChunkEntries );
+		}
+
+		// buffers with consecutive offsets go out in a single pwritev
+		std::sort( batch.begin(), batch.end(), [this]( size_t a, size_t b ) { return mBuffers[a].offset < mBuffers[b].offset; } );
+		for( size_t first = 0; first < batch.size(); ) {
+			size_t last = first;
+			size_t total = mBuffers[batch[first]].size;
+			iovecs[0].iov_base = mBuffers[batch[first]].data;
+			iovecs[0].iov_len = mBuffers[batch[first]].size;
+			while( last + 1 < batch.size() && last + 1 - first < iovecs.size()
+			       && mBuffers[batch[last + 1]].offset == mBuffers[batch[last]].offset + mBuffers[batch[last]].size ) {
+				++last;
+				iovecs[last - first].iov_base = mBuffers[batch[last]].data;
+				iovecs[last - first].iov_len = mBuffers[batch[last]].size;
+				total += mBuffers[batch[last]].size;
+			}
+
+			ssize_t result = mFailed ? -1 : ::pwritev( mFile, iovecs.data(), static_cast<int>( last - first + 1 ),
+			                                           static_cast<off_t>( mBuffers[batch[first]].offset ));
+			size_t written = result > 0 ? static_cast<size_t>( result ) : 0;
+			for( size_t i = first; i <= last; ++i ) {
+				const Buffer &buffer = mBuffers[batch[i]];
+				bool success = false;
+				if( ! mFailed ) {
+					// a short or interrupted write is finished buffer by buffer
+					success = writeBuffer( buffer, std::min( written, buffer.size ));
+				}
+				written -= std::min( written, buffer.size );
+				completed( batch[i], success );
+			}
+			first = last + 1;
+		}
+		batch.clear();
+	}
+}
+
+void DiskWriter::runIoUring()
+{
+	mOptions.getPlacement().apply( "DiskWriter" );
+
+	std::vector<size_t> batch;
+	batch.reserve( mBuffers.size() );
+	unsigned inFlight = 0;
+
+	size_t index = 0;
+	int result = 0;
+	auto reap = [&]() {
+		bool reaped = false;
+		while( mIoUring->peek( index, result )) {
+			--inFlight;
+			bool success = false;
+			if( result < 0 ) {
+				fail( std::strerror( -result ));
+			} else if( ! mFailed ) {
+				success = writeBuffer( mBuffers[index], static_cast<size_t>( result ));
+			}
+			completed( index, success );
+			reaped = true;
+		}
+		return reaped;
+	};
+
+	for(;;) {
+		{
+			std::unique_lock<std::mutex> lock( mMutex );
+			if( 0 == inFlight ) {
+				mReadyCondition.wait( lock, [this] { return ! mReady.empty() || mStop; } );
+				if( mReady.empty() ) {
+					break;
+				}
+			}
+			batch.swap( mReady );
+			if( ! batch.empty() ) {
+				++mStatistics.submissions;
+			}
+			reserveIndex( mIndexCount + kIndexChunkEntries );
+		}
+
+		for( size_t index : batch ) {
+			const Buffer &buffer = mBuffers[index];
+			mIoUring->prepareWrite( mFile, buffer.data, buffer.size, buffer.offset, index );
+		}
+		inFlight += static_cast<unsigned>( batch.size() );
+
+		// submit without waiting when there is something new, otherwise sleep until a write completes
+		int error = mIoUring->enter( batch.empty() ? 1 : 0 );
+		batch.clear();
+		if( 0 != error ) {
+			fail( std::string( "io_uring_enter: " ) + std::strerror( error ));
+			break;
+		}
+		reap();
+	}
+
+	// after a failed enter the kernel may still write from submitted buffers, they are only released once completed
+	std::vector<size_t> unsubmitted;
+	mIoUring->cancelPending( unsubmitted );
+	for( size_t cancelled : unsubmitted ) {
+		--inFlight;
+		completed( cancelled, false );
+	}
+	while( inFlight > 0 ) {
+		if( ! reap() && 0 != mIoUring->enter( 1 )) {
+			// completions still arrive without enter
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ));
+		}
+	}
+}
+
+} // namespace civimba
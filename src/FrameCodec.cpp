@@ -0,0 +1,573 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/FrameCodec.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+namespace civimba {
+
+namespace {
+
+const uint32_t  kMagic          = 0x5A435643; // "CVCZ"
+const uint16_t  kVersion        = 1;
+const uint16_t  kMethodStored   = 0;
+const uint16_t  kMethodPredict  = 1;
+const size_t    kBlock          = 32;
+// width byte plus up to 16 bits per sample
+const size_t    kMaxBlockBytes  = 1 + kBlock * 2;
+
+// precedes the encoded data, followed by bandCount + 1 uint32_t band offsets relative to the end of the table, the
+// bands, and the image bytes beyond the samples (if any) verbatim
+struct EncodedHeader {
+	uint32_t    magic;
+	uint16_t    version;
+	uint16_t    method;
+	uint32_t    rawSize;
+	uint32_t    width;
+	uint32_t    height;
+	uint32_t    pixelFormat;
+	uint32_t    bandCount;
+	uint32_t    bandRows;
+};
+
+static_assert( sizeof( EncodedHeader ) == 32, "EncodedHeader layout changed" );
+
+typedef enum {
+	LAYOUT_8,
+	LAYOUT_16,
+	LAYOUT_12_PACKED,               // GigE Vision Mono12Packed, two samples in three bytes
+} SampleLayout;
+
+struct Geometry {
+	SampleLayout    layout;
+	uint32_t        width;
+	uint32_t        height;
+	uint32_t        distance;       // distance to the nearest sample of the same color
+	size_t          rowBytes;
+	size_t          imageBytes;
+};
+
+bool getGeometry( VmbPixelFormatType pixelFormat, uint32_t width, uint32_t height, size_t imageSize, Geometry &geometry )
+{
+	switch( pixelFormat ) {
+		case VmbPixelFormatMono8:
+			geometry.layout = LAYOUT_8;
+			geometry.distance = 1;
+			break;
+		case VmbPixelFormatBayerGR8:
+		case VmbPixelFormatBayerRG8:
+		case VmbPixelFormatBayerGB8:
+		case VmbPixelFormatBayerBG8:
+			geometry.layout = LAYOUT_8;
+			geometry.distance = 2;
+			break;
+		case VmbPixelFormatMono10:
+		case VmbPixelFormatMono12:
+		case VmbPixelFormatMono14:
+		case VmbPixelFormatMono16:
+			geometry.layout = LAYOUT_16;
+			geometry.distance = 1;
+			break;
+		case VmbPixelFormatBayerGR10:
+		case VmbPixelFormatBayerRG10:
+		case VmbPixelFormatBayerGB10:
+		case VmbPixelFormatBayerBG10:
+		case VmbPixelFormatBayerGR12:
+		case VmbPixelFormatBayerRG12:
+		case VmbPixelFormatBayerGB12:
+		case VmbPixelFormatBayerBG12:
+		case VmbPixelFormatBayerGR16:
+		case VmbPixelFormatBayerRG16:
+		case VmbPixelFormatBayerGB16:
+		case VmbPixelFormatBayerBG16:
+			geometry.layout = LAYOUT_16;
+			geometry.distance = 2;
+			break;
+		case VmbPixelFormatMono12Packed:
+			geometry.layout = LAYOUT_12_PACKED;
+			geometry.distance = 1;
+			break;
+		case VmbPixelFormatBayerGR12Packed:
+		case VmbPixelFormatBayerRG12Packed:
+		case VmbPixelFormatBayerGB12Packed:
+		case VmbPixelFormatBayerBG12Packed:
+			geometry.layout = LAYOUT_12_PACKED;
+			geometry.distance = 2;
+			break;
+		default:
+			return false;
+	}
+
+	if( 0 == width || 0 == height || ( LAYOUT_12_PACKED == geometry.layout && 0 != width % 2 )) {
+		return false;
+	}
+	geometry.width = width;
+	geometry.height = height;
+	switch( geometry.layout ) {
+		case LAYOUT_8:          geometry.rowBytes = width; break;
+		case LAYOUT_16:         geometry.rowBytes = width * 2; break;
+		case LAYOUT_12_PACKED:  geometry.rowBytes = width / 2 * 3; break;
+	}
+	geometry.imageBytes = geometry.rowBytes * height;
+	return imageSize >= geometry.imageBytes;
+}
+
+// zigzag maps a residual modulo the sample size so small magnitudes become small codes
+template<typename T>
+inline uint16_t zigzag( int residual )
+{
+	const T value = static_cast<T>( residual );
+	return static_cast<T>(( value << 1 ) ^ static_cast<T>( 0 - ( value >> ( sizeof( T ) * 8 - 1 ))));
+}
+
+template<typename T>
+inline T unzigzag( uint16_t code )
+{
+	const T value = static_cast<T>( code );
+	return static_cast<T>(( value >> 1 ) ^ static_cast<T>( 0 - ( value & 1 )));
+}
+
+// Samples are predicted from the nearest sample of the same color above, the first rows of a band from the left.
+// On noisy sensor data this compresses about as well as gradient predictors, and because the vertical prediction
+// does not depend on the sample decoded just before, the loops vectorize.
+template<typename T>
+void computeResiduals( const T *samples, uint32_t width, uint32_t rows, uint32_t distance, uint16_t *codes )
+{
+	const uint32_t edge = std::min( distance, width );
+	for( uint32_t y = 0; y < rows; ++y ) {
+		const T *row = samples + static_cast<size_t>( y ) * width;
+		uint16_t *out = codes + static_cast<size_t>( y ) * width;
+		if( y < distance ) {
+			for( uint32_t x = 0; x < edge; ++x ) {
+				out[x] = zigzag<T>( row[x] );
+			}
+			for( uint32_t x = edge; x < width; ++x ) {
+				out[x] = zigzag<T>( row[x] - row[x - distance] );
+			}
+		} else {
+			const T *up = row - static_cast<size_t>( distance ) * width;
+			for( uint32_t x = 0; x < width; ++x ) {
+				out[x] = zigzag<T>( row[x] - up[x] );
+			}
+		}
+	}
+}
+
+template<typename T>
+void reconstruct( const uint16_t *codes, uint32_t width, uint32_t rows, uint32_t distance, T *samples )
+{
+	const uint32_t edge = std::min( distance, width );
+	for( uint32_t y = 0; y < rows; ++y ) {
+		T *row = samples + static_cast<size_t>( y ) * width;
+		const uint16_t *in = codes + static_cast<size_t>( y ) * width;
+		if( y < distance ) {
+			for( uint32_t x = 0; x < edge; ++x ) {
+				row[x] = unzigzag<T>( in[x] );
+			}
+			for( uint32_t x = edge; x < width; ++x ) {
+				row[x] = static_cast<T>( row[x - distance] + unzigzag<T>( in[x] ));
+			}
+		} else {
+			const T *up = row - static_cast<size_t>( distance ) * width;
+			for( uint32_t x = 0; x < width; ++x ) {
+				row[x] = static_cast<T>( up[x] + unzigzag<T>( in[x] ));
+			}
+		}
+	}
+}
+
+void unpack12( const VmbUchar_t *packed, size_t count, uint16_t *samples )
+{
+	for( size_t i = 0; i < count; i += 2, packed += 3 ) {
+		samples[i] = static_cast<uint16_t>(( packed[0] << 4 ) | ( packed[1] & 0x0F ));
+		samples[i + 1] = static_cast<uint16_t>(( packed[2] << 4 ) | ( packed[1] >> 4 ));
+	}
+}
+
+void pack12( const uint16_t *samples, size_t count, VmbUchar_t *packed )
+{
+	for( size_t i = 0; i < count; i += 2, packed += 3 ) {
+		packed[0] = static_cast<VmbUchar_t>( samples[i] >> 4 );
+		packed[1] = static_cast<VmbUchar_t>(( samples[i] & 0x0F ) | (( samples[i + 1] & 0x0F ) << 4 ));
+		packed[2] = static_cast<VmbUchar_t>( samples[i + 1] >> 4 );
+	}
+}
+
+// Eight codes of W bits fill exactly W bytes, so a block of 32 codes is packed as four groups of eight with all
+// shifts known at compile time.
+template<unsigned W>
+VmbUchar_t* packBlock( const uint16_t *codes, VmbUchar_t *out )
+{
+	const unsigned shift = 4 * W;
+	for( size_t group = 0; group < kBlock; group += 8, codes += 8, out += W ) {
+		uint64_t low = 0, high = 0;
+		for( unsigned j = 0; j < 4; ++j ) {
+			low |= static_cast<uint64_t>( codes[j] ) << ( j * W );
+			high |= static_cast<uint64_t>( codes[j + 4] ) << ( j * W );
+		}
+		uint64_t words[2];
+		if( 64 == shift ) {
+			words[0] = low;
+			words[1] = high;
+		} else {
+			words[0] = low | ( high << ( shift % 64 ));
+			words[1] = high >> (( 64 - shift ) % 64 );
+		}
+		std::memcpy( out, words, W );
+	}
+	return out;
+}
+
+template<unsigned W>
+const VmbUchar_t* unpackBlock( const VmbUchar_t *in, uint16_t *codes )
+{
+	const unsigned shift = 4 * W;
+	const uint64_t mask = ( 1u << W ) - 1;
+	for( size_t group = 0; group < kBlock; group += 8, codes += 8, in += W ) {
+		uint64_t words[2] = { 0, 0 };
+		std::memcpy( words, in, W );
+		const uint64_t low = words[0];
+		const uint64_t high = 64 == shift ? words[1] : ( words[0] >> ( shift % 64 )) | ( words[1] << (( 64 - shift ) % 64 ));
+		for( unsigned j = 0; j < 4; ++j ) {
+			codes[j] = static_cast<uint16_t>(( low >> ( j * W )) & mask );
+			codes[j + 4] = static_cast<uint16_t>(( high >> ( j * W )) & mask );
+		}
+	}
+	return in;
+}
+
+typedef VmbUchar_t* ( *PackBlockFn )( const uint16_t *, VmbUchar_t * );
+typedef const VmbUchar_t* ( *UnpackBlockFn )( const VmbUchar_t *, uint16_t * );
+
+const PackBlockFn kPackBlock[17] = {
+	nullptr, packBlock<1>, packBlock<2>, packBlock<3>, packBlock<4>, packBlock<5>, packBlock<6>, packBlock<7>,
+	packBlock<8>, packBlock<9>, packBlock<10>, packBlock<11>, packBlock<12>, packBlock<13>, packBlock<14>,
+	packBlock<15>, packBlock<16>
+};
+
+const UnpackBlockFn kUnpackBlock[17] = {
+	nullptr, unpackBlock<1>, unpackBlock<2>, unpackBlock<3>, unpackBlock<4>, unpackBlock<5>, unpackBlock<6>,
+	unpackBlock<7>, unpackBlock<8>, unpackBlock<9>, unpackBlock<10>, unpackBlock<11>, unpackBlock<12>,
+	unpackBlock<13>, unpackBlock<14>, unpackBlock<15>, unpackBlock<16>
+};
+
+// one width byte per block of 32 codes, followed by 32 * width bits
+size_t packBlocks( const uint16_t *codes, size_t count, VmbUchar_t *out )
+{
+	VmbUchar_t *start = out;
+	uint16_t last[kBlock];
+	for( size_t i = 0; i < count; i += kBlock ) {
+		const uint16_t *block = codes + i;
+		if( count - i < kBlock ) {
+			std::fill( std::copy( block, codes + count, last ), last + kBlock, 0 );
+			block = last;
+		}
+
+		uint32_t all = 0;
+		for( size_t j = 0; j < kBlock; ++j ) {
+			all |= block[j];
+		}
+		uint32_t width = 0;
+		while( all >> width ) {
+			++width;
+		}
+		*out++ = static_cast<VmbUchar_t>( width );
+		if( width > 0 ) {
+			out = kPackBlock[width]( block, out );
+		}
+	}
+	return static_cast<size_t>( out - start );
+}
+
+bool unpackBlocks( const VmbUchar_t *in, size_t size, size_t count, uint16_t *codes )
+{
+	const VmbUchar_t *end = in + size;
+	uint16_t last[kBlock];
+	for( size_t i = 0; i < count; i += kBlock ) {
+		if( in >= end ) {
+			return false;
+		}
+		const uint32_t width = *in++;
+		if( width > 16 || static_cast<size_t>( end - in ) < width * 4 ) {
+			return false;
+		}
+
+		uint16_t *block = count - i < kBlock ? last : codes + i;
+		if( 0 == width ) {
+			std::fill( block, block + kBlock, 0 );
+		} else {
+			in = kUnpackBlock[width]( in, block );
+		}
+		if( block == last ) {
+			std::copy( last, last + ( count - i ), codes + i );
+		}
+	}
+	return in == end;
+}
+
+size_t getMaxBandSize( const Geometry &geometry, uint32_t rows )
+{
+	return ( static_cast<size_t>( rows ) * geometry.width + kBlock - 1 ) / kBlock * kMaxBlockBytes;
+}
+
+size_t encodeBand( const Geometry &geometry, const VmbUchar_t *image, uint32_t firstRow, uint32_t rows, VmbUchar_t *out )
+{
+	// per thread scratch, sized once for the largest band
+	static thread_local std::vector<uint16_t> codes, samples;
+
+	const size_t count = static_cast<size_t>( rows ) * geometry.width;
+	const VmbUchar_t *band = image + firstRow * geometry.rowBytes;
+	codes.resize( std::max( codes.size(), count ));
+	switch( geometry.layout ) {
+		case LAYOUT_8:
+			computeResiduals( band, geometry.width, rows, geometry.distance, codes.data() );
+			break;
+		case LAYOUT_16:
+			if( 0 == reinterpret_cast<uintptr_t>( band ) % 2 ) {
+				computeResiduals( reinterpret_cast<const uint16_t*>( band ), geometry.width, rows, geometry.distance, codes.data() );
+				break;
+			}
+			samples.resize( std::max( samples.size(), count ));
+			std::memcpy( samples.data(), band, count * 2 );
+			computeResiduals( samples.data(), geometry.width, rows, geometry.distance, codes.data() );
+			break;
+		case LAYOUT_12_PACKED:
+			samples.resize( std::max( samples.size(), count ));
+			unpack12( band, count, samples.data() );
+			computeResiduals( samples.data(), geometry.width, rows, geometry.distance, codes.data() );
+			break;
+	}
+	return packBlocks( codes.data(), count, out );
+}
+
+bool decodeBand( const Geometry &geometry, const VmbUchar_t *in, size_t size, uint32_t firstRow, uint32_t rows, VmbUchar_t *image )
+{
+	static thread_local std::vector<uint16_t> codes, samples;
+
+	const size_t count = static_cast<size_t>( rows ) * geometry.width;
+	VmbUchar_t *band = image + firstRow * geometry.rowBytes;
+	codes.resize( std::max( codes.size(), count ));
+	if( ! unpackBlocks( in, size, count, codes.data() )) {
+		return false;
+	}
+	switch( geometry.layout ) {
+		case LAYOUT_8:
+			reconstruct( codes.data(), geometry.width, rows, geometry.distance, band );
+			break;
+		case LAYOUT_16:
+			if( 0 == reinterpret_cast<uintptr_t>( band ) % 2 ) {
+				reconstruct( codes.data(), geometry.width, rows, geometry.distance, reinterpret_cast<uint16_t*>( band ));
+				break;
+			}
+			samples.resize( std::max( samples.size(), count ));
+			reconstruct( codes.data(), geometry.width, rows, geometry.distance, samples.data() );
+			std::memcpy( band, samples.data(), count * 2 );
+			break;
+		case LAYOUT_12_PACKED:
+			samples.resize( std::max( samples.size(), count ));
+			reconstruct( codes.data(), geometry.width, rows, geometry.distance, samples.data() );
+			pack12( samples.data(), count, band );
+			break;
+	}
+	return true;
+}
+
+// runs fn( index ) for every index below count, spread over up to threads threads including the caller
+template<typename Fn>
+void parallelFor( size_t count, unsigned threads, Fn fn )
+{
+	threads = static_cast<unsigned>( std::min<size_t>( std::max( threads, 1u ), count ));
+	if( threads <= 1 ) {
+		for( size_t i = 0; i < count; ++i ) {
+			fn( i );
+		}
+		return;
+	}
+
+	std::atomic<size_t> next( 0 );
+	auto work = [&] {
+		for( size_t i = next++; i < count; i = next++ ) {
+			fn( i );
+		}
+	};
+	std::vector<std::thread> workers;
+	for( unsigned i = 1; i < threads; ++i ) {
+		workers.push_back( std::thread( work ));
+	}
+	work();
+	for( auto &worker : workers ) {
+		worker.join();
+	}
+}
+
+size_t store( const RawFrame &frame, std::vector<VmbUchar_t> &encoded )
+{
+	EncodedHeader header = { kMagic, kVersion, kMethodStored, frame.imageSize, frame.width, frame.height,
+	                         static_cast<uint32_t>( frame.pixelFormat ), 0, 0 };
+	encoded.resize( sizeof( header ) + frame.imageSize );
+	std::memcpy( encoded.data(), &header, sizeof( header ));
+	if( frame.imageSize > 0 ) {
+		std::memcpy( encoded.data() + sizeof( header ), frame.buffer, frame.imageSize );
+	}
+	return encoded.size();
+}
+
+} // anonymous namespace
+
+bool FrameCodec::isSupported( VmbPixelFormatType pixelFormat )
+{
+	Geometry geometry;
+	return getGeometry( pixelFormat, 2, 1, 3 * 2, geometry );
+}
+
+size_t FrameCodec::encode( const RawFrame &frame, std::vector<VmbUchar_t> &encoded, unsigned threads, uint32_t bands )
+{
+	Geometry geometry;
+	if( ! getGeometry( frame.pixelFormat, frame.width, frame.height, frame.imageSize, geometry )) {
+		return store( frame, encoded );
+	}
+
+	// bands start on an even row so every band begins with the same Bayer phase
+	uint32_t bandRows = ( geometry.height + std::max( bands, 1u ) - 1 ) / std::max( bands, 1u );
+	bandRows += ( bandRows > 1 && 0 != bandRows % 2 ) ? 1 : 0;
+	const uint32_t bandCount = ( geometry.height + bandRows - 1 ) / bandRows;
+
+	const size_t tableSize = ( bandCount + 1 ) * sizeof( uint32_t );
+	const size_t dataStart = sizeof( EncodedHeader ) + tableSize;
+	const size_t maxBandSize = getMaxBandSize( geometry, bandRows );
+	const size_t tailSize = frame.imageSize - geometry.imageBytes;
+	encoded.resize( dataStart + bandCount * maxBandSize + tailSize );
+
+	std::vector<size_t> bandSizes( bandCount );
+	VmbUchar_t *data = encoded.data() + dataStart;
+	parallelFor( bandCount, threads, [&]( size_t band ) {
+		const uint32_t firstRow = static_cast<uint32_t>( band ) * bandRows;
+		const uint32_t rows = std::min( bandRows, geometry.height - firstRow );
+		bandSizes[band] = encodeBand( geometry, frame.buffer, firstRow, rows, data + band * maxBandSize );
+	} );
+
+	// close the gaps between the bands
+	uint32_t *table = reinterpret_cast<uint32_t*>( encoded.data() + sizeof( EncodedHeader ));
+	size_t offset = 0;
+	for( uint32_t band = 0; band < bandCount; ++band ) {
+		std::memmove( data + offset, data + band * maxBandSize, bandSizes[band] );
+		table[band] = static_cast<uint32_t>( offset );
+		offset += bandSizes[band];
+	}
+	table[bandCount] = static_cast<uint32_t>( offset );
+
+	if( dataStart + offset + tailSize >= sizeof( EncodedHeader ) + frame.imageSize ) {
+		return store( frame, encoded );
+	}
+	if( tailSize > 0 ) {
+		std::memcpy( data + offset, frame.buffer + geometry.imageBytes, tailSize );
+	}
+
+	EncodedHeader header = { kMagic, kVersion, kMethodPredict, frame.imageSize, frame.width, frame.height,
+	                         static_cast<uint32_t>( frame.pixelFormat ), bandCount, bandRows };
+	std::memcpy( encoded.data(), &header, sizeof( header ));
+	encoded.resize( dataStart + offset + tailSize );
+	return encoded.size();
+}
+
+size_t FrameCodec::decode( const VmbUchar_t *data, size_t size, std::vector<VmbUchar_t> &decoded, unsigned threads )
+{
+	EncodedHeader header;
+	if( size < sizeof( header )) {
+		throw FrameCodecException( __FUNCTION__, "Encoded frame is truncated", VmbErrorInvalidValue );
+	}
+	std::memcpy( &header, data, sizeof( header ));
+	if( kMagic != header.magic ) {
+		throw FrameCodecException( __FUNCTION__, "Not an encoded frame", VmbErrorInvalidValue );
+	}
+	if( header.version > kVersion ) {
+		throw FrameCodecException( __FUNCTION__, "Frame was encoded by a newer version of civimba", VmbErrorNotSupported );
+	}
+
+	decoded.resize( header.rawSize );
+	if( kMethodStored == header.method ) {
+		if( size != sizeof( header ) + header.rawSize ) {
+			throw FrameCodecException( __FUNCTION__, "Stored frame has the wrong size", VmbErrorInvalidValue );
+		}
+		if( header.rawSize > 0 ) {
+			std::memcpy( decoded.data(), data + sizeof( header ), header.rawSize );
+		}
+		return header.rawSize;
+	}
+
+	Geometry geometry;
+	if( kMethodPredict != header.method
+	    || ! getGeometry( static_cast<VmbPixelFormatType>( header.pixelFormat ), header.width, header.height, header.rawSize, geometry )
+	    || 0 == header.bandRows || 0 == header.bandCount
+	    || header.bandCount != ( geometry.height + header.bandRows - 1 ) / header.bandRows ) {
+		throw FrameCodecException( __FUNCTION__, "Encoded frame header is damaged", VmbErrorInvalidValue );
+	}
+
+	const size_t tableSize = ( header.bandCount + 1 ) * sizeof( uint32_t );
+	const size_t dataStart = sizeof( header ) + tableSize;
+	const size_t tailSize = header.rawSize - geometry.imageBytes;
+	if( size < dataStart ) {
+		throw FrameCodecException( __FUNCTION__, "Encoded frame is truncated", VmbErrorInvalidValue );
+	}
+	std::vector<uint32_t> table( header.bandCount + 1 );
+	std::memcpy( table.data(), data + sizeof( header ), tableSize );
+	bool valid = 0 == table[0] && dataStart + table[header.bandCount] + tailSize == size;
+	for( uint32_t band = 0; valid && band < header.bandCount; ++band ) {
+		valid = table[band] <= table[band + 1];
+	}
+	if( ! valid ) {
+		throw FrameCodecException( __FUNCTION__, "Encoded frame band table is damaged", VmbErrorInvalidValue );
+	}
+
+	const VmbUchar_t *bands = data + dataStart;
+	std::atomic<bool> damaged( false );
+	parallelFor( header.bandCount, threads, [&]( size_t band ) {
+		const uint32_t firstRow = static_cast<uint32_t>( band ) * header.bandRows;
+		const uint32_t rows = std::min( header.bandRows, geometry.height - firstRow );
+		if( ! decodeBand( geometry, bands + table[band], table[band + 1] - table[band], firstRow, rows, decoded.data() )) {
+			damaged = true;
+		}
+	} );
+	if( damaged ) {
+		throw FrameCodecException( __FUNCTION__, "Encoded frame data is damaged", VmbErrorInvalidValue );
+	}
+	if( tailSize > 0 ) {
+		std::memcpy( decoded.data() + geometry.imageBytes, bands + table[header.bandCount], tailSize );
+	}
+	return header.rawSize;
+}
+
+bool FrameCodec::isStored( const VmbUchar_t *data, size_t size )
+{
+	EncodedHeader header;
+	if( size < sizeof( header )) {
+		return false;
+	}
+	std::memcpy( &header, data, sizeof( header ));
+	return kMagic == header.magic && kMethodStored == header.method;
+}
+
+} // namespace civimba
@@ -0,0 +1,201 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/FrameCompressor.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "cinder/Log.h"
+
+namespace civimba {
+
+FrameCompressor::FrameCompressor( const Options &options, const RecordCallback &callback )
+		: mOptions( options ), mCallback( callback ), mStop( false )
+{
+	std::memset( &mStatistics, 0, sizeof( mStatistics ));
+	if( ! mCallback ) {
+		throw FrameCompressorException( __FUNCTION__, "A record callback is required", VmbErrorBadParameter );
+	}
+	if( 0 == mOptions.getThreads() || 0 == mOptions.getQueueDepth() ) {
+		throw FrameCompressorException( __FUNCTION__, "Threads and queue depth must be at least 1", VmbErrorBadParameter );
+	}
+
+	// frame buffers are sized by the first frames and reused after that
+	for( uint32_t i = 0; i < mOptions.getQueueDepth(); ++i ) {
+		mJobs.push_back( std::unique_ptr<Job>( new Job() ));
+		mFree.push_back( mJobs.back().get() );
+	}
+	for( unsigned i = 0; i < mOptions.getThreads(); ++i ) {
+		mThreads.push_back( std::thread( &FrameCompressor::run, this ));
+	}
+}
+
+FrameCompressor::~FrameCompressor()
+{
+	detach();
+	flush();
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mStop = true;
+	}
+	mPendingCondition.notify_all();
+	for( auto &thread : mThreads ) {
+		thread.join();
+	}
+}
+
+void FrameCompressor::attach( CameraController &camera )
+{
+	detach();
+	mConnection = camera.getSignalRawFrame().connect( [this]( const RawFrame &frame ) { write( frame ); } );
+}
+
+void FrameCompressor::detach()
+{
+	mConnection.disconnect();
+}
+
+bool FrameCompressor::write( const RawFrame &frame )
+{
+	Job *job = nullptr;
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		if( mFree.empty() ) {
+			++mStatistics.framesDropped;
+			return false;
+		}
+		job = mFree.back();
+		mFree.pop_back();
+	}
+
+	// the job belongs to this thread until it is queued
+	job->header = makeCaptureFrameHeader( frame );
+	job->raw.assign( frame.buffer, frame.buffer + frame.imageSize );
+	job->done = false;
+
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mPending.push_back( job );
+		mInFlight.push_back( job );
+		++mStatistics.framesQueued;
+	}
+	mPendingCondition.notify_one();
+	return true;
+}
+
+void FrameCompressor::flush()
+{
+	std::unique_lock<std::mutex> lock( mMutex );
+	mFreeCondition.wait( lock, [this] { return mInFlight.empty(); } );
+}
+
+FrameCompressorStatistics FrameCompressor::getStatistics() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mStatistics;
+}
+
+void FrameCompressor::run()
+{
+	mOptions.getPlacement().apply( "FrameCompressor" );
+
+	for( ;; ) {
+		Job *job = nullptr;
+		{
+			std::unique_lock<std::mutex> lock( mMutex );
+			mPendingCondition.wait( lock, [this] { return mStop || ! mPending.empty(); } );
+			if( mPending.empty() ) {
+				return;
+			}
+			job = mPending.front();
+			mPending.pop_front();
+		}
+
+		FrameCodec::encode( makeRawFrame( job->header, job->raw.data() ), job->encoded, 1, mOptions.getBands() );
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			job->done = true;
+		}
+		deliver();
+	}
+}
+
+void FrameCompressor::deliver()
+{
+	// One thread delivers at a time, so records leave in arrival order even when a later frame finished first.  A
+	// worker that finds the delivery busy returns to compressing, the holder delivers its job.
+	for( ;; ) {
+		std::unique_lock<std::mutex> delivery( mDeliveryMutex, std::try_to_lock );
+		if( ! delivery.owns_lock() ) {
+			return;
+		}
+		while( deliverNext() ) { }
+		delivery.unlock();
+
+		// a job finished after the last check, its worker found the delivery busy
+		std::lock_guard<std::mutex> lock( mMutex );
+		if( mInFlight.empty() || ! mInFlight.front()->done ) {
+			return;
+		}
+	}
+}
+
+bool FrameCompressor::deliverNext()
+{
+	Job *job = nullptr;
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		if( mInFlight.empty() || ! mInFlight.front()->done ) {
+			return false;
+		}
+		job = mInFlight.front();
+	}
+
+	const bool stored = FrameCodec::isStored( job->encoded.data(), job->encoded.size() );
+	CaptureFrameHeader header = job->header;
+	const VmbUchar_t *data = job->raw.data();
+	if( ! stored ) {
+		header.imageSize = static_cast<uint32_t>( job->encoded.size() );
+		header.flags |= CAPTURE_FRAME_FLAG_COMPRESSED;
+		data = job->encoded.data();
+	}
+	try {
+		mCallback( header, data );
+	}
+	catch( const BaseException &exc ) {
+		CI_LOG_E( "Unable to deliver compressed frame " << header.frameID << ": " << exc.Message() );
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mInFlight.pop_front();
+		mFree.push_back( job );
+		++( stored ? mStatistics.framesStored : mStatistics.framesCompressed );
+		mStatistics.bytesIn += job->header.imageSize;
+		mStatistics.bytesOut += header.imageSize;
+	}
+	mFreeCondition.notify_all();
+	return true;
+}
+
+} // namespace civimba
@@ -0,0 +1,255 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/FrameHistory.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "cinder/Log.h"
+
+#include "civimba/FeatureAccessor.h"
+
+namespace civimba {
+
+FrameHistory::FrameHistory( const Options &options, const std::string &cameraID, uint64_t timestampFrequency )
+		: mOptions( options ), mCameraID( cameraID ), mTimestampFrequency( timestampFrequency ), mCapacity( 0 ),
+		  mSlotCount( 0 ), mActive( nullptr ), mFramesDropped( 0 ), mTriggersRejected( 0 ), mStop( false )
+{
+	setup();
+}
+
+FrameHistory::FrameHistory( const Options &options, CameraController &camera )
+		: mOptions( options ), mCameraID( camera.getID() ), mTimestampFrequency( camera.getTimestampFrequency() ),
+		  mCapacity( 0 ), mSlotCount( 0 ), mActive( nullptr ), mFramesDropped( 0 ), mTriggersRejected( 0 ), mStop( false )
+{
+	setup();
+	attach( camera );
+}
+
+FrameHistory::~FrameHistory()
+{
+	detach();
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mStop = true;
+	}
+	mPendingCondition.notify_all();
+	if( mThread.joinable() ) {
+		mThread.join();
+	}
+}
+
+void FrameHistory::setup()
+{
+	if( 0 == mOptions.getMaxFrames() && 0 == mOptions.getMaxBytes() ) {
+		throw FrameHistoryException( __FUNCTION__, "History needs a frame or byte limit", VmbErrorBadParameter );
+	}
+	if( 0 == mOptions.getSpares() ) {
+		throw FrameHistoryException( __FUNCTION__, "History needs at least one spare ring", VmbErrorBadParameter );
+	}
+
+	for( uint32_t i = 0; i <= mOptions.getSpares(); ++i ) {
+		mRings.push_back( std::unique_ptr<Ring>( new Ring ));
+		mSpares.push_back( mRings.back().get() );
+	}
+	mActive = mSpares.back();
+	mSpares.pop_back();
+	mPending.reserve( mRings.size() );
+	if( mOptions.getFrameSize() > 0 ) {
+		reserve( mOptions.getFrameSize() );
+	}
+
+	mThread = std::thread( &FrameHistory::run, this );
+}
+
+void FrameHistory::reserve( size_t frameSize )
+{
+	frameSize = std::max<size_t>( frameSize, 1 );
+	mCapacity = mOptions.getMaxBytes() > 0 ? static_cast<size_t>( mOptions.getMaxBytes() )
+	                                       : mOptions.getMaxFrames() * frameSize;
+	mSlotCount = mOptions.getMaxFrames() > 0 ? mOptions.getMaxFrames() : mCapacity / frameSize + 1;
+	// rings being dumped are sized once they are returned, see write()
+	allocate( *mActive );
+	for( auto ring : mSpares ) {
+		allocate( *ring );
+	}
+}
+
+void FrameHistory::allocate( Ring &ring ) const
+{
+	ring.data.resize( mCapacity );
+	ring.slots.resize( mSlotCount );
+	ring.clear();
+}
+
+void FrameHistory::attach( CameraController &camera )
+{
+	detach();
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		if( 0 == mCapacity ) {
+			VmbInt64_t payloadSize = FeatureAccessor::getValue<VmbInt64_t>( camera.getFeatureByName( "PayloadSize" ));
+			reserve( static_cast<size_t>( std::max<VmbInt64_t>( payloadSize, 0 )));
+		}
+	}
+	mConnection = camera.getSignalRawFrame().connect( [this]( const RawFrame &frame ) { write( frame ); } );
+}
+
+void FrameHistory::detach()
+{
+	mConnection.disconnect();
+}
+
+bool FrameHistory::write( const RawFrame &frame )
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+
+	if( 0 == mCapacity ) {
+		// neither a frame size nor a camera was given
+		reserve( frame.imageSize );
+	}
+
+	Ring &ring = *mActive;
+	if( ring.data.size() != mCapacity ) {
+		// a ring that was being dumped when the history was sized
+		allocate( ring );
+	}
+	const size_t size = frame.imageSize;
+	if( size > ring.data.size() ) {
+		++mFramesDropped;
+		return false;
+	}
+
+	size_t start = ring.head;
+	if( start + size > ring.data.size() ) {
+		// wrap around, everything behind the head is older than everything in front of it
+		while( ring.count > 0 && ring.front().offset >= ring.head ) {
+			ring.popFront();
+		}
+		start = 0;
+	}
+	while( ring.count > 0
+	       && ( ring.count == ring.slots.size()
+	            || ( ring.front().offset < start + size && ring.front().offset + ring.front().header.imageSize > start ))) {
+		ring.popFront();
+	}
+
+	Slot &slot = ring.slots[( ring.first + ring.count ) % ring.slots.size()];
+	slot.header = makeCaptureFrameHeader( frame );
+	slot.offset = start;
+	std::memcpy( ring.data.data() + start, frame.buffer, size );
+	ring.head = start + size;
+	++ring.count;
+	return true;
+}
+
+bool FrameHistory::trigger( const std::string &path, DumpCallback callback )
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		if( mSpares.empty() ) {
+			++mTriggersRejected;
+			return false;
+		}
+
+		Ring *frozen = mActive;
+		frozen->path = path;
+		frozen->callback = callback;
+		mPending.push_back( frozen );
+
+		mActive = mSpares.back();
+		mSpares.pop_back();
+		mActive->clear();
+	}
+	mPendingCondition.notify_one();
+	return true;
+}
+
+void FrameHistory::waitForDumps()
+{
+	std::unique_lock<std::mutex> lock( mMutex );
+	mDoneCondition.wait( lock, [this] { return mPending.empty(); } );
+}
+
+size_t FrameHistory::getFrameCount() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mActive->count;
+}
+
+uint64_t FrameHistory::getFramesDropped() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mFramesDropped;
+}
+
+uint64_t FrameHistory::getTriggersRejected() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mTriggersRejected;
+}
+
+void FrameHistory::run()
+{
+	for(;;) {
+		Ring *ring = nullptr;
+		{
+			std::unique_lock<std::mutex> lock( mMutex );
+			mPendingCondition.wait( lock, [this] { return ! mPending.empty() || mStop; } );
+			if( mPending.empty() ) {
+				break;
+			}
+			ring = mPending.front();
+		}
+
+		// the ring belongs to this thread until it is returned to the spares
+		bool success = true;
+		try {
+			CaptureWriter writer( ring->path, mCameraID, mTimestampFrequency );
+			for( size_t i = 0; i < ring->count; ++i ) {
+				const Slot &slot = ring->slots[( ring->first + i ) % ring->slots.size()];
+				writer.write( makeRawFrame( slot.header, ring->data.data() + slot.offset ));
+			}
+			writer.close();
+		}
+		catch( const CaptureException &exc ) {
+			CI_LOG_E( "Unable to write history to " << ring->path << ": " << exc.Message() );
+			success = false;
+		}
+		if( ring->callback ) {
+			ring->callback( ring->path, ring->count, success );
+		}
+
+		ring->callback = DumpCallback();
+		ring->clear();
+
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			mPending.erase( mPending.begin() );
+			mSpares.push_back( ring );
+		}
+		mDoneCondition.notify_all();
+	}
+}
+
+} // namespace civimba
@@ -46,13 +46,53 @@ FrameObserver::FrameObserver( CameraPtr camera,
                               FrameLoggingInfo frameLogging,
                               ColorProcessing colorProcessing )
 		: IFrameObserver( camera ),
-		  mFrameCallback( callback ),
 		  mFrameLogging( frameLogging ),
-		  mColorProcessing( colorProcessing )
+		  mColorProcessing( colorProcessing ),
+		  mFrameCallback( callback ),
+		  mFramesReceived( 0 ),
+		  mFramesDelivered( 0 ),
+		  mFramesIncomplete( 0 ),
+		  mFramesMissing( 0 ),
+		  mTransformErrors( 0 )
 {
 	camera->GetID( mCameraID );
 }
 
+FrameObserver::FrameObserver( const std::string &cameraID,
+                              FrameCallback callback,
+                              FrameLoggingInfo frameLogging,
+                              ColorProcessing colorProcessing )
+		: IFrameObserver( CameraPtr()),
+		  mFrameLogging( frameLogging ),
+		  mColorProcessing( colorProcessing ),
+		  mCameraID( cameraID ),
+		  mFrameCallback( callback ),
+		  mFramesReceived( 0 ),
+		  mFramesDelivered( 0 ),
+		  mFramesIncomplete( 0 ),
+		  mFramesMissing( 0 ),
+		  mTransformErrors( 0 )
+{
+}
+
+FrameStatistics FrameObserver::getStatistics() const
+{
+	FrameStatistics stats;
+	stats.framesReceived = mFramesReceived;
+	stats.framesDelivered = mFramesDelivered;
+	stats.framesIncomplete = mFramesIncomplete;
+	stats.framesMissing = mFramesMissing;
+	stats.transformErrors = mTransformErrors;
+	return stats;
+}
+
+void FrameObserver::restart()
+{
+	// frame IDs start over with the stream, they would be counted as missing frames
+	mFrameID.Invalidate();
+	mFrameTime.Invalidate();
+}
+
 double FrameObserver::getTime()
 {
 	auto t1 = high_resolution_clock::now();
@@ -60,37 +100,13 @@ double FrameObserver::getTime()
 	return dTime / 1000;
 }
 
-void FrameObserver::printFrameSizeFormat( const FramePtr &pFrame, stringstream &ss )
+void FrameObserver::printFrameSizeFormat( const RawFrame &frame, stringstream &ss )
 {
-	ss << " Size:";
-	VmbUint32_t nWidth = 0;
-	VmbErrorType res;
-	res = pFrame->GetWidth( nWidth );
-	if( VmbErrorSuccess == res ) {
-		ss << nWidth;
-	} else {
-		ss << "?";
-	}
-
-	ss << "x";
-	VmbUint32_t nHeight = 0;
-	res = pFrame->GetHeight( nHeight );
-	if( VmbErrorSuccess == res ) {
-		ss << nHeight;
-	} else {
-		ss << "?";
-	}
-
+	ss << " Size:" << frame.width << "x" << frame.height;
 	ss << " Format:";
-	VmbPixelFormatType ePixelFormat = VmbPixelFormatMono8;
-	res = pFrame->GetPixelFormat( ePixelFormat );
-	if( VmbErrorSuccess == res ) {
-		ss << std::hex;
-		ss << "0x" << ePixelFormat;
-		ss << std::dec;
-	} else {
-		ss << "?";
-	}
+	ss << std::hex;
+	ss << "0x" << frame.pixelFormat;
+	ss << std::dec;
 }
 
 void FrameObserver::printFrameStatus( VmbFrameStatusType eFrameStatus, stringstream &ss )
@@ -124,23 +140,31 @@ void printFrameInfos( const FramePtr &pFrame, VmbFrameStatusType eFrameStatus, s
 }
 
 
-void FrameObserver::logFrameInfos( const FramePtr &frame )
+void FrameObserver::logFrameInfos( const RawFrame &frame )
 {
-	VmbUint64_t frameID = 0;
-	bool frameIDValid = false;
-	VmbFrameStatusType frameStatus = VmbFrameStatusComplete;
-	VmbErrorType res = VmbErrorSuccess;
+	VmbUint64_t frameID = frame.frameID;
+	bool frameIDValid = frame.frameIDValid;
+	VmbFrameStatusType frameStatus = frame.receiveStatus;
 	double fps = 0.0;
 	bool fpsValid = false;
 	VmbUint64_t framesMissing = 0;
+	bool idRestarted = false;
 
-	res = frame->GetFrameID( frameID );
-	if( VmbErrorSuccess == res ) {
-		frameIDValid = true;
+	if( frameIDValid ) {
 
 		if( mFrameID.IsValid()) {
-			if( frameID != (mFrameID() + 1)) {
+			// IDs that don't move forward wrapped (GigE block IDs are 16 bit) or the stream restarted,
+			// the gap can't be told so nothing is counted
+			if( frameID <= mFrameID()) {
+				idRestarted = true;
+
+				if( mFrameLogging >= FRAME_INFO_WARNINGS ) {
+					CI_LOG_W( "Frame ID went from " << mFrameID() << " to " << frameID << ", not counting missing frames" );
+				}
+			}
+			else if( frameID != (mFrameID() + 1)) {
 				framesMissing = frameID - mFrameID() - 1;
+				mFramesMissing += framesMissing;
 
 				if( mFrameLogging >= FRAME_INFO_WARNINGS ) {
 					if( 1 == framesMissing ) {
@@ -154,7 +178,7 @@ void FrameObserver::logFrameInfos( const FramePtr &frame )
 		mFrameID( frameID );
 
 		double frameTime = getTime();
-		if( mFrameTime.IsValid() && 0 == framesMissing ) {
+		if( mFrameTime.IsValid() && 0 == framesMissing && ! idRestarted ) {
 			double timeDiff = frameTime - mFrameTime();
 			if( timeDiff > 0.0 ) {
 				fps = 1.0 / timeDiff;
@@ -171,111 +195,119 @@ void FrameObserver::logFrameInfos( const FramePtr &frame )
 
 	stringstream ss;
 
-	res = frame->GetReceiveStatus( frameStatus );
-	if( VmbErrorSuccess == res ) {
-
-		if( VmbFrameStatusComplete == frameStatus ) {
-
-			// only print if we're printing all frames
-			if( FRAME_INFO_SHOW <= mFrameLogging ) {
-				ss << "Camera ID:" << mCameraID << " Frame ID: ";
-				frameIDValid ? ss << frameID << " " : ss << "? ";
-
-				printFrameStatus( frameStatus, ss );
-				printFrameSizeFormat( frame, ss );
-				ss << " FPS:";
-				if( fpsValid ) {
-					std::streamsize s = ss.precision();
-					ss << std::fixed << std::setprecision( 2 ) << fps << std::setprecision( s );
-				} else {
-					ss << "?";
-				}
-				CI_LOG_I( ss.str());
+	if( VmbFrameStatusComplete == frameStatus ) {
+
+		// only print if we're printing all frames
+		if( FRAME_INFO_SHOW <= mFrameLogging ) {
+			ss << "Camera ID:" << mCameraID << " Frame ID: ";
+			frameIDValid ? ss << frameID << " " : ss << "? ";
+
+			printFrameStatus( frameStatus, ss );
+			printFrameSizeFormat( frame, ss );
+			ss << " FPS:";
+			if( fpsValid ) {
+				std::streamsize s = ss.precision();
+				ss << std::fixed << std::setprecision( 2 ) << fps << std::setprecision( s );
+			} else {
+				ss << "?";
 			}
-		} else {
-			// print warnings
-			if( FRAME_INFO_WARNINGS <= mFrameLogging ) {
-				ss << "Camera ID:" << mCameraID << " Frame ID: ";
-				frameIDValid ? ss << frameID << " " : ss << "? ";
-
-				printFrameStatus( frameStatus, ss );
-				printFrameSizeFormat( frame, ss );
-				ss << " FPS:";
-				if( fpsValid ) {
-					std::streamsize s = ss.precision();
-					ss << std::fixed << std::setprecision( 2 ) << fps << std::setprecision( s );
-				} else {
-					ss << "?";
-				}
-				CI_LOG_W( ss.str());
+			CI_LOG_I( ss.str());
+		}
+	} else {
+		// print warnings
+		if( FRAME_INFO_WARNINGS <= mFrameLogging ) {
+			ss << "Camera ID:" << mCameraID << " Frame ID: ";
+			frameIDValid ? ss << frameID << " " : ss << "? ";
+
+			printFrameStatus( frameStatus, ss );
+			printFrameSizeFormat( frame, ss );
+			ss << " FPS:";
+			if( fpsValid ) {
+				std::streamsize s = ss.precision();
+				ss << std::fixed << std::setprecision( 2 ) << fps << std::setprecision( s );
+			} else {
+				ss << "?";
 			}
+			CI_LOG_W( ss.str());
 		}
+	}
+}
 
-	} else {
-		// print error
+void FrameObserver::FrameReceived( const FramePtr pFrame )
+{
+	RawFrame frame;
+	if( ! SP_ISNULL( pFrame ) && VmbErrorSuccess == RawFrame::fromFrame( pFrame, frame )) {
+		frameReceived( frame );
+	}
+	else {
 		if( FRAME_INFO_ERRORS <= mFrameLogging ) {
 			CI_LOG_E( "Error receiving frame status." );
 		}
 	}
+
+	m_pCamera->QueueFrame( pFrame );
 }
 
-void FrameObserver::FrameReceived( const FramePtr pFrame )
+void FrameObserver::frameReceived( const RawFrame &frame )
 {
-	if( ! SP_ISNULL( pFrame )) {
-
-		logFrameInfos( pFrame );
-
-		VmbFrameStatusType status;
-		VmbErrorType Result;
-		Result = SP_ACCESS( pFrame )->GetReceiveStatus( status );
-
-		if( VmbErrorSuccess == Result && VmbFrameStatusComplete == status ) {
-
-			//TODO this is specific to image format, needs to be generalized via templating
-			cinder::Surface8uRef newFrame;
-
-			VmbUint32_t frameWidth, frameHeight;
-			pFrame->GetWidth( frameWidth );
-			pFrame->GetHeight( frameHeight );
-
-			switch( mColorProcessing ) {
-				default:
-					Result = VmbErrorBadParameter;
-					std::cout << "unknown color processing parameter\n";
-					break;
-				case COLOR_PROCESSING_OFF:
-					newFrame = std::shared_ptr<cinder::Surface8u>(
-							new cinder::Surface8u( frameWidth, frameHeight, false,
-							                       cinder::SurfaceChannelOrder::RGB ));
-					Result = TransformImage::transform( pFrame, newFrame, "RGB24" );
-					break;
-				case COLOR_PROCESSING_MATRIX: {
-					std::cout << "Color Transform\n";
-					const VmbFloat_t Matrix[] = {0.6f, 0.3f, 0.1f,
-					                             0.6f, 0.3f, 0.1f,
-					                             0.6f, 0.3f, 0.1f};
-					newFrame = std::shared_ptr<cinder::Surface8u>(
-							new cinder::Surface8u( frameWidth, frameHeight, false,
-							                       cinder::SurfaceChannelOrder::BGR ));
-					Result = TransformImage::transform( pFrame, newFrame, "BGR24", Matrix );
-				}
-					break;
+	++mFramesReceived;
 
-			}
+	if( mRawFrameCallback ) {
+		mRawFrameCallback( frame );
+	}
 
-			// TODO probably don't need this unless we're displaying frame info
-			if( VmbErrorSuccess == Result ) {
-				mFrameCallback( newFrame );
-			}
+	logFrameInfos( frame );
+
+	if( VmbFrameStatusComplete != frame.receiveStatus ) {
+		++mFramesIncomplete;
+		return;
+	}
+
+	// a damaged record must not size the surface or be read past its end
+	if( ! frame.holdsImage() ) {
+		++mTransformErrors;
+		if( FRAME_INFO_ERRORS <= mFrameLogging ) {
+			CI_LOG_E( "Frame of " << frame.imageSize << " bytes is too small for " << frame.width << "x" << frame.height );
 		}
+		return;
 	}
-	else {
-		if( FRAME_INFO_ERRORS >= mFrameLogging ) {
-			CI_LOG_E( "Error receiving frame status." );
+
+	//TODO this is specific to image format, needs to be generalized via templating
+	cinder::Surface8uRef newFrame;
+	VmbErrorType Result;
+
+	switch( mColorProcessing ) {
+		default:
+			Result = VmbErrorBadParameter;
+			std::cout << "unknown color processing parameter\n";
+			break;
+		case COLOR_PROCESSING_OFF:
+			newFrame = std::shared_ptr<cinder::Surface8u>(
+					new cinder::Surface8u( frame.width, frame.height, false,
+					                       cinder::SurfaceChannelOrder::RGB ));
+			Result = TransformImage::transform( frame, newFrame, "RGB24" );
+			break;
+		case COLOR_PROCESSING_MATRIX: {
+			std::cout << "Color Transform\n";
+			const VmbFloat_t Matrix[] = {0.6f, 0.3f, 0.1f,
+			                             0.6f, 0.3f, 0.1f,
+			                             0.6f, 0.3f, 0.1f};
+			newFrame = std::shared_ptr<cinder::Surface8u>(
+					new cinder::Surface8u( frame.width, frame.height, false,
+					                       cinder::SurfaceChannelOrder::BGR ));
+			Result = TransformImage::transform( frame, newFrame, "BGR24", Matrix );
 		}
+			break;
+
 	}
 
-	m_pCamera->QueueFrame( pFrame );
+	// TODO probably don't need this unless we're displaying frame info
+	if( VmbErrorSuccess == Result ) {
+		++mFramesDelivered;
+		mFrameCallback( newFrame );
+	} else {
+		++mTransformErrors;
+	}
 }
 
 } // namespace civimba
\ No newline at end of file
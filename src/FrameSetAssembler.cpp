@@ -0,0 +1,285 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/FrameSetAssembler.h"
+
+#include <algorithm>
+
+namespace civimba {
+
+namespace {
+
+// frame IDs this far behind the last set, or further behind than pending sets reach, start a new acquisition
+const uint64_t kFrameIDRestart = 1024;
+
+} // anonymous namespace
+
+FrameSetAssembler::FrameSetAssembler( const Options &options, const std::vector<uint64_t> &timestampFrequencies )
+		: mOptions( options ), mTolerance( 0 ), mTimeout( 0 ), mEmitted( false ), mLastKey( 0 ), mStats(),
+		  mHead( 0 ), mTail( 0 )
+{
+	init( timestampFrequencies );
+}
+
+FrameSetAssembler::FrameSetAssembler( const Options &options, const std::vector<CameraControllerRef> &cameras )
+		: mOptions( options ), mTolerance( 0 ), mTimeout( 0 ), mEmitted( false ), mLastKey( 0 ), mStats(),
+		  mHead( 0 ), mTail( 0 )
+{
+	std::vector<uint64_t> frequencies;
+	for( const auto &camera : cameras ) {
+		if( ! camera ) {
+			throw FrameSetAssemblerException( __FUNCTION__, "Camera is null", VmbErrorBadParameter );
+		}
+		frequencies.push_back( camera->getTimestampFrequency() );
+	}
+	init( frequencies );
+	for( size_t i = 0; i < cameras.size(); ++i ) {
+		attach( i, *cameras[i] );
+	}
+}
+
+FrameSetAssembler::~FrameSetAssembler()
+{
+	detach();
+}
+
+void FrameSetAssembler::init( const std::vector<uint64_t> &timestampFrequencies )
+{
+	if( timestampFrequencies.empty() ) {
+		throw FrameSetAssemblerException( __FUNCTION__, "No cameras", VmbErrorBadParameter );
+	}
+	if( mOptions.getTolerance() < 0.0 || mOptions.getTimeout() <= 0.0 || mOptions.getClockWindow() <= 0.0 ) {
+		throw FrameSetAssemblerException( __FUNCTION__, "Invalid tolerance or timeout", VmbErrorBadParameter );
+	}
+	if( 0 == mOptions.getMaxPending() || 0 == mOptions.getQueueDepth() ) {
+		throw FrameSetAssemblerException( __FUNCTION__, "Pending sets and queue depth must be at least 1",
+		                                  VmbErrorBadParameter );
+	}
+	mTolerance = static_cast<uint64_t>( mOptions.getTolerance() * 1e9 );
+	mTimeout = static_cast<uint64_t>( mOptions.getTimeout() * 1e9 );
+
+	mCameras.resize( timestampFrequencies.size() );
+	for( size_t i = 0; i < mCameras.size(); ++i ) {
+		mCameras[i].clock = ClockMapper( timestampFrequencies[i], mOptions.getClockWindow() );
+	}
+	// one slot stays empty to tell a full ring from an empty one
+	mQueue.resize( mOptions.getQueueDepth() + 1 );
+}
+
+void FrameSetAssembler::attach( size_t index, CameraController &camera )
+{
+	if( index >= mCameras.size() ) {
+		throw FrameSetAssemblerException( __FUNCTION__, "Camera index out of range", VmbErrorBadParameter );
+	}
+	Camera &entry = mCameras[index];
+	entry.rawConnection.disconnect();
+	entry.frameConnection.disconnect();
+	entry.clock = ClockMapper( camera.getTimestampFrequency(), mOptions.getClockWindow() );
+
+	// both signals are emitted on the acquisition thread, the raw frame first
+	entry.rawConnection = camera.getSignalRawFrame().connect( [this, index]( const RawFrame &frame ) {
+		Camera &entry = mCameras[index];
+		entry.frameID = frame.frameID;
+		entry.frameIDValid = frame.frameIDValid;
+		entry.timestamp = frame.timestamp;
+		entry.arrival = ClockMapper::getHostTime();
+	} );
+	entry.frameConnection = camera.getSignalNewFrame().connect( [this, index]( const cinder::Surface8uRef &surface ) {
+		const Camera &entry = mCameras[index];
+		addFrame( index, surface, entry.frameID, entry.frameIDValid, entry.timestamp, entry.arrival );
+	} );
+}
+
+void FrameSetAssembler::detach()
+{
+	for( auto &camera : mCameras ) {
+		camera.rawConnection.disconnect();
+		camera.frameConnection.disconnect();
+	}
+}
+
+void FrameSetAssembler::addFrame( size_t index, const cinder::Surface8uRef &surface, uint64_t frameID,
+                                  bool frameIDValid, uint64_t timestamp, uint64_t arrival )
+{
+	if( index >= mCameras.size() ) {
+		throw FrameSetAssemblerException( __FUNCTION__, "Camera index out of range", VmbErrorBadParameter );
+	}
+
+	FrameSetEntry frame;
+	frame.surface = surface;
+	frame.frameID = frameID;
+	frame.frameIDValid = frameIDValid;
+	// the clock of a camera is only used by its own thread
+	frame.timestamp = mCameras[index].clock.map( timestamp, arrival );
+
+	const bool byFrameID = FRAME_SET_MATCH_FRAME_ID == mOptions.getMatch();
+	const uint64_t key = byFrameID ? frameID : frame.timestamp;
+
+	std::lock_guard<std::mutex> lock( mMutex );
+	expire( arrival );
+
+	if( byFrameID && ! frameIDValid ) {
+		++mStats.framesUnmatched;
+		return;
+	}
+
+	// find the set of the frame, by timestamp the closest one still missing this camera
+	size_t match = mPending.size();
+	uint64_t bestDistance = 0;
+	for( size_t i = 0; i < mPending.size(); ++i ) {
+		const PendingSet &pending = mPending[i];
+		if( byFrameID ) {
+			if( pending.set.key == key ) {
+				match = i;
+				break;
+			}
+			continue;
+		}
+		if( pending.set.frames[index].surface ) {
+			continue;
+		}
+		const uint64_t distance = key > pending.set.key ? key - pending.set.key : pending.set.key - key;
+		if( distance <= mTolerance && ( match == mPending.size() || distance < bestDistance )) {
+			match = i;
+			bestDistance = distance;
+		}
+	}
+
+	if( match == mPending.size() && byFrameID && mEmitted && key < mLastKey
+	    && mLastKey - key > std::max<uint64_t>( kFrameIDRestart, 2 * uint64_t( mOptions.getMaxPending() ))) {
+		// the cameras were restarted, e.g. by a stream restart or reconnect, and count from the start again
+		++mStats.restarts;
+		reset();
+	}
+
+	if( match == mPending.size() ) {
+		const bool late = byFrameID ? key <= mLastKey : key + mTolerance < mLastKey;
+		if( mEmitted && late ) {
+			++mStats.framesLate;
+			return;
+		}
+
+		PendingSet pending;
+		pending.set.key = key;
+		pending.set.frames.resize( mCameras.size() );
+		pending.created = arrival;
+		pending.count = 0;
+		mPending.push_back( std::move( pending ));
+	} else if( mPending[match].set.frames[index].surface ) {
+		++mStats.framesDuplicate;
+		return;
+	}
+
+	PendingSet &pending = mPending[match];
+	pending.set.frames[index] = std::move( frame );
+	if( ++pending.count == mCameras.size() ) {
+		finish( pending );
+		mPending.erase( mPending.begin() + match );
+	}
+
+	while( mPending.size() > mOptions.getMaxPending() ) {
+		finish( mPending.front() );
+		mPending.pop_front();
+	}
+}
+
+void FrameSetAssembler::expire( uint64_t now )
+{
+	for( size_t i = 0; i < mPending.size(); ) {
+		if( now > mPending[i].created && now - mPending[i].created >= mTimeout ) {
+			finish( mPending[i] );
+			mPending.erase( mPending.begin() + i );
+		} else {
+			++i;
+		}
+	}
+}
+
+void FrameSetAssembler::flush()
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	reset();
+}
+
+void FrameSetAssembler::reset()
+{
+	for( auto &pending : mPending ) {
+		finish( pending );
+	}
+	mPending.clear();
+	// keys of the next acquisition are not compared against the last one
+	mEmitted = false;
+	mLastKey = 0;
+}
+
+void FrameSetAssembler::finish( PendingSet &pending )
+{
+	FrameSet &set = pending.set;
+	set.complete = pending.count == mCameras.size();
+	if( ! mEmitted || set.key > mLastKey ) {
+		mLastKey = set.key;
+	}
+	mEmitted = true;
+
+	if( set.complete ) {
+		++mStats.setsComplete;
+	} else {
+		++mStats.setsIncomplete;
+		if( ! mOptions.getEmitIncomplete() ) {
+			return;
+		}
+	}
+	push( set );
+}
+
+void FrameSetAssembler::push( FrameSet &set )
+{
+	const size_t tail = mTail.load( std::memory_order_relaxed );
+	const size_t next = ( tail + 1 ) % mQueue.size();
+	if( next == mHead.load( std::memory_order_acquire )) {
+		++mStats.setsDropped;
+		return;
+	}
+	mQueue[tail] = std::move( set );
+	mTail.store( next, std::memory_order_release );
+}
+
+bool FrameSetAssembler::tryPop( FrameSet &set )
+{
+	const size_t head = mHead.load( std::memory_order_relaxed );
+	if( head == mTail.load( std::memory_order_acquire )) {
+		return false;
+	}
+	set = std::move( mQueue[head] );
+	// release the surfaces now rather than when the slot is reused
+	mQueue[head] = FrameSet();
+	mHead.store(( head + 1 ) % mQueue.size(), std::memory_order_release );
+	return true;
+}
+
+FrameSetStatistics FrameSetAssembler::getStatistics() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mStats;
+}
+
+} // namespace civimba
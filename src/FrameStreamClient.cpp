@@ -0,0 +1,144 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/FrameStreamClient.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace civimba {
+
+namespace {
+
+// larger records are taken for a damaged stream
+const uint64_t kMaxImageSize = 1ull << 31;
+
+double now()
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+} // anonymous namespace
+
+FrameStreamClient::FrameStreamClient( const std::string &path, double timeout )
+		: mSocket( -1 ), mReceived( 0 ), mFramesReceived( 0 )
+{
+	sockaddr_un address;
+	std::memset( &address, 0, sizeof( address ));
+	address.sun_family = AF_UNIX;
+	if( path.empty() || path.size() >= sizeof( address.sun_path )) {
+		throw FrameStreamClientException( __FUNCTION__, "Invalid socket path " + path, VmbErrorBadParameter );
+	}
+	std::strncpy( address.sun_path, path.c_str(), sizeof( address.sun_path ) - 1 );
+
+	mSocket = ::socket( AF_UNIX, SOCK_STREAM, 0 );
+	if( mSocket < 0 ) {
+		throw FrameStreamClientException( __FUNCTION__, std::string( "Unable to create socket: " ) + std::strerror( errno ),
+		                                  VmbErrorResources );
+	}
+	if( 0 != ::connect( mSocket, reinterpret_cast<sockaddr*>( &address ), sizeof( address ))) {
+		const int error = errno;
+		disconnect();
+		throw FrameStreamClientException( __FUNCTION__, "No frame stream at " + path + ": " + std::strerror( error ),
+		                                  VmbErrorNotFound );
+	}
+
+	if( ! receive( reinterpret_cast<VmbUchar_t*>( &mStreamHeader ), sizeof( mStreamHeader ), now() + timeout )
+	    || 0 != std::memcmp( mStreamHeader.magic, CAPTURE_FILE_MAGIC, sizeof( mStreamHeader.magic ))) {
+		disconnect();
+		throw FrameStreamClientException( __FUNCTION__, path + " did not send a frame stream header", VmbErrorInvalidValue );
+	}
+	mReceived = 0;
+}
+
+FrameStreamClient::~FrameStreamClient()
+{
+	disconnect();
+}
+
+void FrameStreamClient::disconnect()
+{
+	if( mSocket >= 0 ) {
+		::close( mSocket );
+		mSocket = -1;
+	}
+}
+
+bool FrameStreamClient::receive( VmbUchar_t *data, size_t size, double deadline )
+{
+	while( mSocket >= 0 && mReceived < size ) {
+		ssize_t result = ::recv( mSocket, data + mReceived, size - mReceived, MSG_DONTWAIT );
+		if( result > 0 ) {
+			mReceived += static_cast<size_t>( result );
+			continue;
+		}
+		if( 0 == result || ( EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno )) {
+			disconnect();
+			return false;
+		}
+
+		const double remaining = deadline - now();
+		if( remaining <= 0.0 ) {
+			return false;
+		}
+		pollfd fd = { mSocket, POLLIN, 0 };
+		::poll( &fd, 1, static_cast<int>( remaining * 1000.0 ) + 1 );
+	}
+	return mReceived >= size;
+}
+
+bool FrameStreamClient::readNext( RawFrame &frame, double timeout )
+{
+	const double deadline = now() + timeout;
+
+	// mReceived counts header and data together, a read that timed out continues where it stopped
+	if( mReceived < sizeof( mFrameHeader )) {
+		if( ! receive( reinterpret_cast<VmbUchar_t*>( &mFrameHeader ), sizeof( mFrameHeader ), deadline )) {
+			return false;
+		}
+		if( CAPTURE_FRAME_MAGIC != mFrameHeader.magic || mFrameHeader.imageSize > kMaxImageSize ) {
+			disconnect();
+			return false;
+		}
+		mData.resize( static_cast<size_t>( getCaptureRecordSize( mFrameHeader.imageSize ) - sizeof( mFrameHeader )));
+	}
+
+	mReceived -= sizeof( mFrameHeader );
+	const bool complete = receive( mData.data(), mData.size(), deadline );
+	mReceived += sizeof( mFrameHeader );
+	if( ! complete ) {
+		return false;
+	}
+
+	mReceived = 0;
+	++mFramesReceived;
+	frame = makeRawFrame( mFrameHeader, mData.data() );
+	return true;
+}
+
+} // namespace civimba
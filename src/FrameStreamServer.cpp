@@ -0,0 +1,409 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/FrameStreamServer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "cinder/Log.h"
+
+namespace civimba {
+
+namespace {
+
+#if defined( MSG_NOSIGNAL )
+const int kSendFlags = MSG_NOSIGNAL | MSG_DONTWAIT;
+#else
+const int kSendFlags = MSG_DONTWAIT;
+#endif
+
+bool setNonBlocking( int socket )
+{
+	int flags = ::fcntl( socket, F_GETFL, 0 );
+	return flags >= 0 && 0 == ::fcntl( socket, F_SETFL, flags | O_NONBLOCK );
+}
+
+} // anonymous namespace
+
+FrameStreamServer::FrameStreamServer( const Options &options, const std::string &cameraID, uint64_t timestampFrequency )
+		: mOptions( options ), mListenSocket( -1 ), mWakePending( false ), mStop( false ), mClosed( false ),
+		  mClientCount( 0 ), mSequence( 0 )
+{
+	open( cameraID, timestampFrequency );
+}
+
+FrameStreamServer::FrameStreamServer( const Options &options, CameraController &camera )
+		: mOptions( options ), mListenSocket( -1 ), mWakePending( false ), mStop( false ), mClosed( false ),
+		  mClientCount( 0 ), mSequence( 0 )
+{
+	open( camera.getID(), camera.getTimestampFrequency() );
+	attach( camera );
+}
+
+FrameStreamServer::~FrameStreamServer()
+{
+	close();
+}
+
+void FrameStreamServer::open( const std::string &cameraID, uint64_t timestampFrequency )
+{
+	std::memset( &mStatistics, 0, sizeof( mStatistics ));
+	mWakePipe[0] = mWakePipe[1] = -1;
+
+	sockaddr_un address;
+	std::memset( &address, 0, sizeof( address ));
+	address.sun_family = AF_UNIX;
+	if( mOptions.getPath().empty() || mOptions.getPath().size() >= sizeof( address.sun_path )) {
+		throw FrameStreamServerException( __FUNCTION__, "Invalid socket path " + mOptions.getPath(), VmbErrorBadParameter );
+	}
+	std::strncpy( address.sun_path, mOptions.getPath().c_str(), sizeof( address.sun_path ) - 1 );
+
+	// a socket left behind by a server that did not close is replaced, anything else at path is an error
+	struct stat status;
+	if( 0 == ::lstat( address.sun_path, &status ) && S_ISSOCK( status.st_mode )) {
+		::unlink( address.sun_path );
+	}
+
+	mListenSocket = ::socket( AF_UNIX, SOCK_STREAM, 0 );
+	if( mListenSocket < 0 || ! setNonBlocking( mListenSocket )
+	    || 0 != ::bind( mListenSocket, reinterpret_cast<sockaddr*>( &address ), sizeof( address ))
+	    || 0 != ::listen( mListenSocket, 8 )
+	    || 0 != ::pipe( mWakePipe ) || ! setNonBlocking( mWakePipe[0] ) || ! setNonBlocking( mWakePipe[1] )) {
+		const std::string error = std::strerror( errno );
+		release();
+		throw FrameStreamServerException( __FUNCTION__, "Unable to listen on " + mOptions.getPath() + ": " + error,
+		                                  VmbErrorResources );
+	}
+
+	CaptureFileHeader header = makeCaptureFileHeader( cameraID, timestampFrequency );
+	mHello.assign( reinterpret_cast<const VmbUchar_t*>( &header ), reinterpret_cast<const VmbUchar_t*>( &header ) + sizeof( header ));
+
+	// every client holds at most one buffer, one more is the latest frame and one is being filled
+	mBuffers.reserve( mOptions.getMaxClients() + 2 );
+	mClients.reserve( mOptions.getMaxClients() );
+
+	mThread = std::thread( &FrameStreamServer::run, this );
+}
+
+void FrameStreamServer::release()
+{
+	for( auto &client : mClients ) {
+		::close( client.socket );
+	}
+	mClients.clear();
+	mClientCount = 0;
+	if( mListenSocket >= 0 ) {
+		::close( mListenSocket );
+		::unlink( mOptions.getPath().c_str() );
+		mListenSocket = -1;
+	}
+	for( int &fd : mWakePipe ) {
+		if( fd >= 0 ) {
+			::close( fd );
+			fd = -1;
+		}
+	}
+}
+
+void FrameStreamServer::attach( CameraController &camera )
+{
+	detach();
+	mConnection = camera.getSignalRawFrame().connect( [this]( const RawFrame &frame ) { write( frame ); } );
+}
+
+void FrameStreamServer::detach()
+{
+	mConnection.disconnect();
+}
+
+void FrameStreamServer::close()
+{
+	detach();
+	if( mClosed ) {
+		return;
+	}
+	mClosed = true;
+
+	mStop = true;
+	wake();
+	if( mThread.joinable() ) {
+		mThread.join();
+	}
+	release();
+
+	std::lock_guard<std::mutex> lock( mMutex );
+	mLatest.reset();
+	mBuffers.clear();
+}
+
+FrameStreamStatistics FrameStreamServer::getStatistics() const
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mStatistics;
+}
+
+void FrameStreamServer::wake()
+{
+	// one byte per poll() round is enough, the I/O thread resets the flag after draining the pipe
+	if( ! mWakePending.exchange( true )) {
+		const char byte = 1;
+		if( ::write( mWakePipe[1], &byte, 1 ) < 0 && EAGAIN != errno ) {
+			mWakePending = false;
+		}
+	}
+}
+
+bool FrameStreamServer::write( const RawFrame &frame )
+{
+	if( 0 == mClientCount || mStop ) {
+		return true;
+	}
+
+	// A buffer only referenced by mBuffers is neither the latest frame nor being sent.  The I/O thread copies
+	// references only under mMutex, so such a buffer stays free while it is filled below.
+	std::shared_ptr<Frame> buffer;
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		for( const auto &candidate : mBuffers ) {
+			if( 1 == candidate.use_count() ) {
+				buffer = candidate;
+				break;
+			}
+		}
+		if( ! buffer ) {
+			if( mBuffers.size() >= mOptions.getMaxClients() + 2 ) {
+				++mStatistics.framesDropped;
+				return false;
+			}
+			buffer = std::make_shared<Frame>();
+			mBuffers.push_back( buffer );
+		}
+	}
+
+	buffer->header = makeCaptureFrameHeader( frame );
+	// the padding of the record is sent from the buffer as well, so it is zeroed once here
+	buffer->data.resize( static_cast<size_t>( getCaptureRecordSize( frame.imageSize ) - sizeof( CaptureFrameHeader )));
+	std::memcpy( buffer->data.data(), frame.buffer, frame.imageSize );
+	std::memset( buffer->data.data() + frame.imageSize, 0, buffer->data.size() - frame.imageSize );
+
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		buffer->sequence = ++mSequence;
+		mLatest = buffer;
+		++mStatistics.framesPublished;
+	}
+	wake();
+	return true;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// MARK: - I/O thread
+// ----------------------------------------------------------------------------------------------------
+
+void FrameStreamServer::run()
+{
+	std::vector<pollfd> fds;
+	for(;;) {
+		fds.clear();
+		pollfd wakeFd = { mWakePipe[0], POLLIN, 0 };
+		pollfd listenFd = { mListenSocket, POLLIN, 0 };
+		fds.push_back( wakeFd );
+		fds.push_back( listenFd );
+
+		uint64_t latest = 0;
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			latest = mLatest ? mLatest->sequence : 0;
+		}
+		for( const auto &client : mClients ) {
+			// clients never send, POLLIN reports the hang up
+			const bool pending = client.helloSent < mHello.size() || client.frame || client.lastSequence < latest;
+			pollfd clientFd = { client.socket, static_cast<short>( POLLIN | ( pending ? POLLOUT : 0 )), 0 };
+			fds.push_back( clientFd );
+		}
+
+		if( ::poll( fds.data(), static_cast<nfds_t>( fds.size() ), -1 ) < 0 && EINTR != errno ) {
+			CI_LOG_E( "poll failed on " << mOptions.getPath() << ": " << std::strerror( errno ));
+			break;
+		}
+		if( fds[0].revents & POLLIN ) {
+			char drain[64];
+			while( ::read( mWakePipe[0], drain, sizeof( drain )) > 0 ) { }
+			mWakePending = false;
+		}
+		if( mStop ) {
+			break;
+		}
+
+		// clients are matched to their pollfd by position, new ones are appended after this pass
+		size_t kept = 0;
+		for( size_t i = 0; i < mClients.size(); ++i ) {
+			const short events = fds[2 + i].revents;
+			bool connected = true;
+			if( events & ( POLLERR | POLLHUP | POLLNVAL )) {
+				connected = false;
+			} else if( events & POLLIN ) {
+				char discard[256];
+				ssize_t result = ::recv( mClients[i].socket, discard, sizeof( discard ), MSG_DONTWAIT );
+				connected = result > 0 || ( result < 0 && ( EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno ));
+			}
+			if( connected && ( events & POLLOUT )) {
+				connected = send( mClients[i] );
+			}
+
+			if( connected ) {
+				if( kept != i ) {
+					mClients[kept] = std::move( mClients[i] );
+				}
+				++kept;
+			} else {
+				::close( mClients[i].socket );
+				std::lock_guard<std::mutex> lock( mMutex );
+				mClients[i].frame.reset();
+				++mStatistics.clientsDisconnected;
+			}
+		}
+		mClients.resize( kept );
+		mClientCount = mClients.size();
+
+		if( fds[1].revents & POLLIN ) {
+			accept();
+		}
+	}
+}
+
+void FrameStreamServer::accept()
+{
+	for(;;) {
+		int socket = ::accept( mListenSocket, nullptr, nullptr );
+		if( socket < 0 ) {
+			return;
+		}
+
+		if( mClients.size() >= mOptions.getMaxClients() || ! setNonBlocking( socket )) {
+			::close( socket );
+			std::lock_guard<std::mutex> lock( mMutex );
+			++mStatistics.clientsRejected;
+			continue;
+		}
+#if defined( SO_NOSIGPIPE )
+		int noSigPipe = 1;
+		::setsockopt( socket, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof( noSigPipe ));
+#endif
+		if( mOptions.getSendBufferSize() > 0 ) {
+			int size = static_cast<int>( mOptions.getSendBufferSize() );
+			::setsockopt( socket, SOL_SOCKET, SO_SNDBUF, &size, sizeof( size ));
+		}
+
+		Client client;
+		client.socket = socket;
+		client.helloSent = 0;
+		client.sent = 0;
+		{
+			// a new client starts with the next frame, not with the one that may be half a frame period old
+			std::lock_guard<std::mutex> lock( mMutex );
+			client.lastSequence = mSequence;
+			++mStatistics.clientsAccepted;
+		}
+		mClients.push_back( client );
+		mClientCount = mClients.size();
+	}
+}
+
+bool FrameStreamServer::send( Client &client )
+{
+	for(;;) {
+		iovec iovecs[3];
+		int count = 0;
+
+		if( client.helloSent < mHello.size() ) {
+			iovecs[count].iov_base = mHello.data() + client.helloSent;
+			iovecs[count++].iov_len = mHello.size() - client.helloSent;
+		} else if( ! client.frame ) {
+			std::lock_guard<std::mutex> lock( mMutex );
+			if( ! mLatest || mLatest->sequence <= client.lastSequence ) {
+				return true;
+			}
+			mStatistics.framesSkipped += mLatest->sequence - client.lastSequence - 1;
+			client.frame = mLatest;
+			client.sent = 0;
+		}
+
+		if( client.frame ) {
+			Frame &frame = *client.frame;
+			uint64_t offset = client.sent;
+			if( offset < sizeof( CaptureFrameHeader )) {
+				iovecs[count].iov_base = reinterpret_cast<VmbUchar_t*>( &frame.header ) + offset;
+				iovecs[count++].iov_len = static_cast<size_t>( sizeof( CaptureFrameHeader ) - offset );
+				offset = 0;
+			} else {
+				offset -= sizeof( CaptureFrameHeader );
+			}
+			iovecs[count].iov_base = frame.data.data() + offset;
+			iovecs[count++].iov_len = static_cast<size_t>( frame.data.size() - offset );
+		}
+
+		msghdr message;
+		std::memset( &message, 0, sizeof( message ));
+		message.msg_iov = iovecs;
+		message.msg_iovlen = count;
+		ssize_t result = ::sendmsg( client.socket, &message, kSendFlags );
+		if( result < 0 ) {
+			return EAGAIN == errno || EWOULDBLOCK == errno || EINTR == errno;
+		}
+
+		size_t written = static_cast<size_t>( result );
+		if( client.helloSent < mHello.size() ) {
+			size_t hello = std::min( written, mHello.size() - client.helloSent );
+			client.helloSent += hello;
+			written -= hello;
+		}
+		if( client.frame ) {
+			client.sent += written;
+			if( client.sent == sizeof( CaptureFrameHeader ) + client.frame->data.size() ) {
+				// released under the lock, which orders the sends before write() refills the buffer
+				std::lock_guard<std::mutex> lock( mMutex );
+				client.lastSequence = client.frame->sequence;
+				client.frame.reset();
+				++mStatistics.framesSent;
+			} else {
+				// the socket buffer is full, wait for POLLOUT
+				return true;
+			}
+		} else if( client.helloSent < mHello.size() ) {
+			return true;
+		}
+	}
+}
+
+} // namespace civimba
@@ -0,0 +1,312 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/MappedCaptureReader.h"
+#include "civimba/FrameCodec.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <numeric>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace civimba {
+
+const size_t MappedCaptureReader::npos = static_cast<size_t>( -1 );
+
+MappedCaptureReader::MappedCaptureReader( const std::string &path )
+		: mPath( path ), mData( nullptr ), mSize( 0 ), mDataEnd( 0 ), mEntries( nullptr ), mEntryCount( 0 ),
+		  mIndexRebuilt( false )
+{
+	int file = ::open( path.c_str(), O_RDONLY );
+	if( file < 0 ) {
+		throw CaptureException( __FUNCTION__, "Unable to open capture file " + path, VmbErrorNotFound );
+	}
+	struct stat status;
+	if( 0 != ::fstat( file, &status ) || static_cast<uint64_t>( status.st_size ) < sizeof( CaptureFileHeader )) {
+		::close( file );
+		throw CaptureException( __FUNCTION__, path + " is not a civimba capture file", VmbErrorInvalidValue );
+	}
+	mSize = static_cast<uint64_t>( status.st_size );
+	void *data = ::mmap( nullptr, static_cast<size_t>( mSize ), PROT_READ, MAP_SHARED, file, 0 );
+	::close( file );
+	if( MAP_FAILED == data ) {
+		throw CaptureException( __FUNCTION__, "Unable to map capture file " + path, VmbErrorResources );
+	}
+	mData = static_cast<const VmbUchar_t*>( data );
+
+	try {
+		const CaptureFileHeader &header = getFileHeader();
+		if( 0 != std::memcmp( header.magic, CAPTURE_FILE_MAGIC, sizeof( header.magic ))
+		    || header.headerSize < sizeof( CaptureFileHeader ) || header.headerSize > mSize || 0 != header.headerSize % 8 ) {
+			throw CaptureException( __FUNCTION__, path + " is not a civimba capture file", VmbErrorInvalidValue );
+		}
+		if( header.version > CAPTURE_FILE_VERSION ) {
+			throw CaptureException( __FUNCTION__, path + " was written by a newer version of civimba", VmbErrorNotSupported );
+		}
+
+		if( isRing() ) {
+			scanRing();
+		} else if( ! mapIndex() ) {
+			scanRecords();
+		}
+	}
+	catch( ... ) {
+		::munmap( const_cast<VmbUchar_t*>( mData ), static_cast<size_t>( mSize ));
+		throw;
+	}
+
+	// lookups binary search the entries directly unless the file order is not sorted, e.g. after a camera reset
+	bool frameIDSorted = true, timestampSorted = true;
+	for( size_t i = 1; i < mEntryCount; ++i ) {
+		frameIDSorted = frameIDSorted && mEntries[i - 1].frameID <= mEntries[i].frameID;
+		timestampSorted = timestampSorted && mEntries[i - 1].timestamp <= mEntries[i].timestamp;
+	}
+	if( ! frameIDSorted ) {
+		mByFrameID.resize( mEntryCount );
+		std::iota( mByFrameID.begin(), mByFrameID.end(), 0 );
+		std::stable_sort( mByFrameID.begin(), mByFrameID.end(), [this]( size_t a, size_t b ) {
+			return mEntries[a].frameID < mEntries[b].frameID;
+		} );
+	}
+	if( ! timestampSorted ) {
+		mByTimestamp.resize( mEntryCount );
+		std::iota( mByTimestamp.begin(), mByTimestamp.end(), 0 );
+		std::stable_sort( mByTimestamp.begin(), mByTimestamp.end(), [this]( size_t a, size_t b ) {
+			return mEntries[a].timestamp < mEntries[b].timestamp;
+		} );
+	}
+}
+
+MappedCaptureReader::~MappedCaptureReader()
+{
+	::munmap( const_cast<VmbUchar_t*>( mData ), static_cast<size_t>( mSize ));
+}
+
+bool MappedCaptureReader::mapIndex()
+{
+	const uint64_t headerSize = getFileHeader().headerSize;
+	if( mSize < headerSize + sizeof( CaptureIndexHeader ) + sizeof( CaptureIndexFooter )) {
+		return false;
+	}
+
+	CaptureIndexFooter footer;
+	std::memcpy( &footer, mData + mSize - sizeof( footer ), sizeof( footer ));
+	if( CAPTURE_INDEX_MAGIC != footer.magic || footer.indexOffset < headerSize || 0 != footer.indexOffset % 8
+	    || footer.indexOffset > mSize - sizeof( CaptureIndexHeader ) - sizeof( footer )) {
+		return false;
+	}
+
+	CaptureIndexHeader index;
+	std::memcpy( &index, mData + footer.indexOffset, sizeof( index ));
+	const uint64_t available = mSize - footer.indexOffset - sizeof( footer );
+	if( CAPTURE_INDEX_MAGIC != index.magic || index.headerSize < sizeof( index ) || 0 != index.headerSize % 8
+	    || index.headerSize > available
+	    || index.entryCount != ( available - index.headerSize ) / sizeof( CaptureIndexEntry )
+	    || 0 != ( available - index.headerSize ) % sizeof( CaptureIndexEntry )) {
+		return false;
+	}
+
+	mEntries = reinterpret_cast<const CaptureIndexEntry*>( mData + footer.indexOffset + index.headerSize );
+	mEntryCount = static_cast<size_t>( index.entryCount );
+	mDataEnd = footer.indexOffset;
+	return true;
+}
+
+void MappedCaptureReader::scanRecords()
+{
+	uint64_t offset = getFileHeader().headerSize;
+	while( offset + sizeof( CaptureFrameHeader ) <= mSize ) {
+		const CaptureFrameHeader &header = *reinterpret_cast<const CaptureFrameHeader*>( mData + offset );
+		const uint64_t recordSize = getCaptureRecordSize( header.imageSize );
+		if( CAPTURE_FRAME_MAGIC != header.magic || recordSize > mSize - offset ) {
+			break;
+		}
+		mRebuiltIndex.push_back( makeCaptureIndexEntry( header, offset ));
+		offset += recordSize;
+	}
+
+	mEntries = mRebuiltIndex.data();
+	mEntryCount = mRebuiltIndex.size();
+	mDataEnd = offset;
+	mIndexRebuilt = true;
+}
+
+void MappedCaptureReader::scanRing()
+{
+	const uint64_t headerSize = getFileHeader().headerSize;
+	if( headerSize < sizeof( CaptureFileHeader ) + sizeof( CaptureRingHeader )) {
+		throw CaptureException( __FUNCTION__, mPath + " has a damaged ring header", VmbErrorInvalidValue );
+	}
+	CaptureRingHeader ring;
+	std::memcpy( &ring, mData + sizeof( CaptureFileHeader ), sizeof( ring ));
+
+	if( ring.slotCount > 0 && ring.slotSize >= sizeof( CaptureFrameHeader ) && 0 == ring.slotSize % 8 ) {
+		const uint64_t count = std::min( ring.framesWritten, ring.slotCount );
+		const uint64_t oldest = ring.framesWritten > ring.slotCount ? ring.framesWritten % ring.slotCount : 0;
+		mRebuiltIndex.reserve( static_cast<size_t>( count ));
+		for( uint64_t i = 0; i < count; ++i ) {
+			const uint64_t offset = headerSize + (( oldest + i ) % ring.slotCount ) * ring.slotSize;
+			if( offset + ring.slotSize > mSize ) {
+				continue;
+			}
+			const CaptureFrameHeader &header = *reinterpret_cast<const CaptureFrameHeader*>( mData + offset );
+			if( CAPTURE_FRAME_MAGIC == header.magic && getCaptureRecordSize( header.imageSize ) <= ring.slotSize ) {
+				mRebuiltIndex.push_back( makeCaptureIndexEntry( header, offset ));
+			}
+		}
+	}
+
+	mEntries = mRebuiltIndex.data();
+	mEntryCount = mRebuiltIndex.size();
+	mDataEnd = mSize;
+}
+
+const CaptureFrameHeader& MappedCaptureReader::getFrameHeader( size_t index ) const
+{
+	if( index >= mEntryCount ) {
+		throw CaptureException( __FUNCTION__, "Frame index out of range", VmbErrorBadParameter );
+	}
+	// the index is only validated as a whole, check the record before handing out pointers into the mapping
+	const uint64_t offset = mEntries[index].offset;
+	if( 0 != offset % 8 || offset < getFileHeader().headerSize || offset + sizeof( CaptureFrameHeader ) > mDataEnd ) {
+		throw CaptureException( __FUNCTION__, mPath + " has a damaged index", VmbErrorInvalidValue );
+	}
+	const CaptureFrameHeader &header = *reinterpret_cast<const CaptureFrameHeader*>( mData + offset );
+	if( CAPTURE_FRAME_MAGIC != header.magic || getCaptureRecordSize( header.imageSize ) > mDataEnd - offset ) {
+		throw CaptureException( __FUNCTION__, mPath + " has a damaged frame record", VmbErrorInvalidValue );
+	}
+	return header;
+}
+
+RawFrame MappedCaptureReader::getFrame( size_t index ) const
+{
+	const CaptureFrameHeader &header = getFrameHeader( index );
+	if( header.flags & CAPTURE_FRAME_FLAG_COMPRESSED ) {
+		throw CaptureException( __FUNCTION__, "Frame is compressed, use decodeFrame()", VmbErrorInvalidCall );
+	}
+	return makeRawFrame( header, reinterpret_cast<const VmbUchar_t*>( &header ) + sizeof( CaptureFrameHeader ));
+}
+
+bool MappedCaptureReader::isCompressed( size_t index ) const
+{
+	return 0 != ( getFrameHeader( index ).flags & CAPTURE_FRAME_FLAG_COMPRESSED );
+}
+
+RawFrame MappedCaptureReader::decodeFrame( size_t index, std::vector<VmbUchar_t> &decoded, unsigned threads ) const
+{
+	const CaptureFrameHeader &header = getFrameHeader( index );
+	const VmbUchar_t *data = reinterpret_cast<const VmbUchar_t*>( &header ) + sizeof( CaptureFrameHeader );
+	if( ! ( header.flags & CAPTURE_FRAME_FLAG_COMPRESSED )) {
+		decoded.assign( data, data + header.imageSize );
+		return makeRawFrame( header, decoded.data() );
+	}
+
+	CaptureFrameHeader frameHeader = header;
+	try {
+		frameHeader.imageSize = static_cast<uint32_t>( FrameCodec::decode( data, header.imageSize, decoded, threads ));
+	}
+	catch( const FrameCodec::FrameCodecException &exc ) {
+		throw CaptureException( __FUNCTION__, "Damaged compressed frame: " + exc.Message(), VmbErrorInvalidValue );
+	}
+	frameHeader.flags &= ~CAPTURE_FRAME_FLAG_COMPRESSED;
+	return makeRawFrame( frameHeader, decoded.data() );
+}
+
+size_t MappedCaptureReader::findFrameID( uint64_t frameID ) const
+{
+	if( 0 == mEntryCount ) {
+		return npos;
+	}
+
+	// frame IDs normally increase by one per frame, which turns the lookup into an array access
+	const uint64_t first = mEntries[0].frameID;
+	if( frameID >= first && frameID - first < mEntryCount && mEntries[frameID - first].frameID == frameID ) {
+		return static_cast<size_t>( frameID - first );
+	}
+
+	if( mByFrameID.empty() ) {
+		const CaptureIndexEntry *end = mEntries + mEntryCount;
+		const CaptureIndexEntry *it = std::lower_bound( mEntries, end, frameID, []( const CaptureIndexEntry &entry, uint64_t id ) {
+			return entry.frameID < id;
+		} );
+		return ( end != it && it->frameID == frameID ) ? static_cast<size_t>( it - mEntries ) : npos;
+	}
+
+	auto it = std::lower_bound( mByFrameID.begin(), mByFrameID.end(), frameID, [this]( size_t index, uint64_t id ) {
+		return mEntries[index].frameID < id;
+	} );
+	return ( mByFrameID.end() != it && mEntries[*it].frameID == frameID ) ? *it : npos;
+}
+
+size_t MappedCaptureReader::findTimestamp( uint64_t timestamp ) const
+{
+	if( mByTimestamp.empty() ) {
+		const CaptureIndexEntry *end = mEntries + mEntryCount;
+		const CaptureIndexEntry *it = std::upper_bound( mEntries, end, timestamp, []( uint64_t time, const CaptureIndexEntry &entry ) {
+			return time < entry.timestamp;
+		} );
+		return mEntries == it ? npos : static_cast<size_t>( it - mEntries ) - 1;
+	}
+
+	auto it = std::upper_bound( mByTimestamp.begin(), mByTimestamp.end(), timestamp, [this]( uint64_t time, size_t index ) {
+		return time < mEntries[index].timestamp;
+	} );
+	return mByTimestamp.begin() == it ? npos : *( it - 1 );
+}
+
+size_t MappedCaptureReader::rebuildIndex( const std::string &path )
+{
+	size_t frames = 0;
+	uint64_t dataEnd = 0;
+	std::vector<VmbUchar_t> index;
+	{
+		MappedCaptureReader reader( path );
+		frames = reader.getFrameCount();
+		if( reader.isRing() || ! reader.wasIndexRebuilt() ) {
+			return frames;
+		}
+		dataEnd = reader.mDataEnd;
+		index = makeCaptureIndex( reader.mRebuiltIndex, dataEnd );
+	}
+
+	int file = ::open( path.c_str(), O_WRONLY );
+	if( file < 0
+	    || 0 != ::ftruncate( file, static_cast<off_t>( dataEnd ))
+	    || static_cast<ssize_t>( index.size() ) != ::pwrite( file, index.data(), index.size(), static_cast<off_t>( dataEnd ))) {
+		int error = errno;
+		if( file >= 0 ) {
+			::close( file );
+		}
+		throw CaptureException( __FUNCTION__, "Unable to write the index of " + path + ": " + std::strerror( error ),
+		                        VmbErrorResources );
+	}
+	::fsync( file );
+	::close( file );
+	return frames;
+}
+
+} // namespace civimba
@@ -0,0 +1,237 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/MappedRecorder.h"
+
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cinder/Log.h"
+
+namespace civimba {
+
+MappedRecorder::MappedRecorder( const Options &options, const std::string &cameraID, uint64_t timestampFrequency )
+		: mOptions( options ), mFile( -1 ), mData( nullptr ), mHeaderSize( 0 ), mOffset( 0 ), mSlotSize( 0 ),
+		  mSlotCount( 0 ), mRingHeader( nullptr ), mFramesWritten( 0 ), mFramesDropped( 0 ), mBytesWritten( 0 )
+{
+	open( cameraID, timestampFrequency );
+}
+
+MappedRecorder::MappedRecorder( const Options &options, CameraController &camera )
+		: mOptions( options ), mFile( -1 ), mData( nullptr ), mHeaderSize( 0 ), mOffset( 0 ), mSlotSize( 0 ),
+		  mSlotCount( 0 ), mRingHeader( nullptr ), mFramesWritten( 0 ), mFramesDropped( 0 ), mBytesWritten( 0 )
+{
+	open( camera.getID(), camera.getTimestampFrequency() );
+	attach( camera );
+}
+
+MappedRecorder::~MappedRecorder()
+{
+	close();
+}
+
+void MappedRecorder::open( const std::string &cameraID, uint64_t timestampFrequency )
+{
+	const bool ring = mOptions.getRing();
+	const uint64_t capacity = mOptions.getCapacity();
+	mHeaderSize = sizeof( CaptureFileHeader ) + ( ring ? sizeof( CaptureRingHeader ) : 0 );
+	if( capacity < mHeaderSize + sizeof( CaptureFrameHeader )) {
+		throw MappedRecorderException( __FUNCTION__, "Capacity is too small for a single frame", VmbErrorBadParameter );
+	}
+
+	mFile = ::open( mOptions.getPath().c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+	if( mFile < 0 ) {
+		throw MappedRecorderException( __FUNCTION__, "Unable to open " + mOptions.getPath() + ": " + std::strerror( errno ),
+		                               VmbErrorResources );
+	}
+
+	// reserve the blocks now so running out of disk space is an error here and not a SIGBUS while recording
+	int error = 0;
+	if( 0 != ::ftruncate( mFile, static_cast<off_t>( capacity ))) {
+		error = errno;
+	}
+#if defined( __linux__ )
+	else {
+		error = ::posix_fallocate( mFile, 0, static_cast<off_t>( capacity ));
+		if( EOPNOTSUPP == error || EINVAL == error ) {
+			CI_LOG_W( "File system does not support preallocation, recording to a sparse file" );
+			error = 0;
+		}
+	}
+#endif
+	int flags = MAP_SHARED;
+#if defined( __linux__ )
+	if( mOptions.getPopulate() ) {
+		flags |= MAP_POPULATE;
+	}
+#endif
+	void *data = MAP_FAILED;
+	if( 0 == error ) {
+		data = ::mmap( nullptr, static_cast<size_t>( capacity ), PROT_READ | PROT_WRITE, flags, mFile, 0 );
+		if( MAP_FAILED == data ) {
+			error = errno;
+		}
+	}
+	if( 0 != error ) {
+		::close( mFile );
+		mFile = -1;
+		::unlink( mOptions.getPath().c_str() );
+		throw MappedRecorderException( __FUNCTION__, "Unable to preallocate " + mOptions.getPath() + ": " + std::strerror( error ),
+		                               VmbErrorResources );
+	}
+	mData = static_cast<VmbUchar_t*>( data );
+
+	CaptureFileHeader header = makeCaptureFileHeader( cameraID, timestampFrequency, ring ? CAPTURE_FILE_FLAG_RING : 0 );
+	header.headerSize = static_cast<uint32_t>( mHeaderSize );
+	std::memcpy( mData, &header, sizeof( header ));
+	mOffset = mHeaderSize;
+
+	if( ring ) {
+		mRingHeader = reinterpret_cast<CaptureRingHeader*>( mData + sizeof( CaptureFileHeader ));
+		std::memset( mRingHeader, 0, sizeof( CaptureRingHeader ));
+		if( mOptions.getSlotSize() > 0 ) {
+			setupRing( mOptions.getSlotSize() );
+		}
+	}
+}
+
+void MappedRecorder::setupRing( uint64_t slotSize )
+{
+	slotSize = ( slotSize + 7 ) & ~static_cast<uint64_t>( 7 );
+	uint64_t slotCount = ( mOptions.getCapacity() - mHeaderSize ) / slotSize;
+	if( 0 == slotCount ) {
+		throw MappedRecorderException( __FUNCTION__, "Capacity is too small for a single ring slot", VmbErrorBadParameter );
+	}
+	mSlotSize = slotSize;
+	mSlotCount = slotCount;
+	mRingHeader->slotSize = slotSize;
+	mRingHeader->slotCount = slotCount;
+}
+
+void MappedRecorder::attach( CameraController &camera )
+{
+	detach();
+	mConnection = camera.getSignalRawFrame().connect( [this]( const RawFrame &frame ) { write( frame ); } );
+}
+
+void MappedRecorder::detach()
+{
+	mConnection.disconnect();
+}
+
+bool MappedRecorder::write( const RawFrame &frame )
+{
+	return writeRecord( makeCaptureFrameHeader( frame ), frame.buffer );
+}
+
+bool MappedRecorder::writeRecord( const CaptureFrameHeader &frameHeader, const VmbUchar_t *data )
+{
+	if( ! mData ) {
+		throw MappedRecorderException( __FUNCTION__, "Recorder is closed", VmbErrorInvalidCall );
+	}
+
+	const uint64_t recordSize = getCaptureRecordSize( frameHeader.imageSize );
+	VmbUchar_t *record = nullptr;
+	if( mRingHeader ) {
+		if( 0 == mSlotCount ) {
+			setupRing( recordSize );
+		}
+		if( recordSize > mSlotSize ) {
+			++mFramesDropped;
+			return false;
+		}
+		record = mData + mHeaderSize + ( mFramesWritten % mSlotCount ) * mSlotSize;
+	} else {
+		if( mOffset + recordSize > mOptions.getCapacity() ) {
+			++mFramesDropped;
+			return false;
+		}
+		record = mData + mOffset;
+		mOffset += recordSize;
+	}
+
+	// the magic is written last so a reader never takes a half written (or half overwritten) record for a frame
+	CaptureFrameHeader header = frameHeader;
+	header.magic = 0;
+	std::memcpy( record, &header, sizeof( header ));
+	std::memcpy( record + sizeof( header ), data, header.imageSize );
+	std::atomic_thread_fence( std::memory_order_release );
+	std::memcpy( record, &CAPTURE_FRAME_MAGIC, sizeof( CAPTURE_FRAME_MAGIC ));
+
+	uint64_t framesWritten = ++mFramesWritten;
+	if( mRingHeader ) {
+		mRingHeader->framesWritten = framesWritten;
+	}
+	mBytesWritten += recordSize;
+	return true;
+}
+
+void MappedRecorder::close()
+{
+	detach();
+	if( ! mData ) {
+		return;
+	}
+
+	const uint64_t fileSize = mRingHeader ? mHeaderSize + mSlotCount * mSlotSize : mOffset;
+
+	// linear files get the trailing index, collected from the mapping so recording never had to keep one
+	std::vector<VmbUchar_t> index;
+	if( ! mRingHeader ) {
+		std::vector<CaptureIndexEntry> entries;
+		entries.reserve( static_cast<size_t>( mFramesWritten ));
+		for( uint64_t offset = mHeaderSize; offset < mOffset; ) {
+			const CaptureFrameHeader *header = reinterpret_cast<const CaptureFrameHeader*>( mData + offset );
+			entries.push_back( makeCaptureIndexEntry( *header, offset ));
+			offset += getCaptureRecordSize( header->imageSize );
+		}
+		index = makeCaptureIndex( entries, mOffset );
+	}
+
+	if( mOptions.getSyncOnClose() ) {
+		::msync( mData, static_cast<size_t>( fileSize ), MS_SYNC );
+	}
+	::munmap( mData, static_cast<size_t>( mOptions.getCapacity() ));
+	mData = nullptr;
+	mRingHeader = nullptr;
+
+	if( 0 != ::ftruncate( mFile, static_cast<off_t>( fileSize ))) {
+		CI_LOG_W( "Unable to truncate " << mOptions.getPath() << ": " << std::strerror( errno ));
+	}
+	if( ! index.empty()
+	    && static_cast<ssize_t>( index.size() ) != ::pwrite( mFile, index.data(), index.size(), static_cast<off_t>( fileSize ))) {
+		CI_LOG_W( "Unable to write the index of " << mOptions.getPath() << ": " << std::strerror( errno ));
+	}
+	if( mOptions.getSyncOnClose() ) {
+		::fsync( mFile );
+	}
+	::close( mFile );
+	mFile = -1;
+}
+
+} // namespace civimba
@@ -0,0 +1,216 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "civimba/ReplayCamera.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "cinder/Log.h"
+
+namespace civimba {
+
+ReplayCamera::ReplayCamera( const Options &options )
+		: mOptions( options ),
+		  mRunning( false ),
+		  mFramesReplayed( 0 )
+{
+	try {
+		mReader = std::make_shared<CaptureReader>( mOptions.getPath() );
+	} catch( CaptureException &e ) {
+		throw ReplayCameraException( __FUNCTION__, e.Message(), e.Result() );
+	}
+}
+
+ReplayCamera::~ReplayCamera()
+{
+	stop();
+}
+
+std::string ReplayCamera::getID() const
+{
+	const CaptureFileHeader &header = mReader->getFileHeader();
+	const char *end = std::find( header.cameraID, header.cameraID + sizeof( header.cameraID ), '\0' );
+	return std::string( header.cameraID, end );
+}
+
+void ReplayCamera::start( uint32_t numberFrames, RawFrameCallback callback )
+{
+	if( mRunning || mThread.joinable() ) {
+		stop();
+	}
+	if( 0 == numberFrames ) {
+		throw ReplayCameraException( __FUNCTION__, "Replay camera needs at least one frame.", VmbErrorBadParameter );
+	}
+
+	mReader->rewind();
+	if( mOptions.getPreload() && mPreloaded.empty() ) {
+		Record record;
+		while( mReader->readNext( record.header, record.data )) {
+			mPreloaded.push_back( record );
+		}
+		if( mPreloaded.empty() ) {
+			throw ReplayCameraException( __FUNCTION__, mOptions.getPath() + " has no frames", VmbErrorNotFound );
+		}
+	}
+	mBuffers.resize( mOptions.getPreload() ? 0 : numberFrames );
+
+	if( mOptions.getRecordedPace() && 0 == mReader->getFileHeader().timestampFrequency ) {
+		CI_LOG_W( "Capture " << mOptions.getPath() << " has no timestamp frequency, replaying as fast as possible" );
+	}
+
+	mCallback = callback;
+	mFramesReplayed = 0;
+	mRunning = true;
+	mThread = std::thread( &ReplayCamera::run, this );
+}
+
+void ReplayCamera::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock( mStopMutex );
+		mRunning = false;
+	}
+	mStopCondition.notify_all();
+
+	if( mThread.joinable() && mThread.get_id() != std::this_thread::get_id() ) {
+		mThread.join();
+	}
+}
+
+bool ReplayCamera::nextRecord( size_t &preloadIndex, Record *scratch, const Record *&record )
+{
+	if( mOptions.getPreload() ) {
+		if( preloadIndex >= mPreloaded.size() ) {
+			return false;
+		}
+		record = &mPreloaded[preloadIndex++];
+		return true;
+	}
+
+	// a damaged compressed record ends the replay like the end of the file, run() must not throw
+	try {
+		if( ! mReader->readNext( scratch->header, scratch->data )) {
+			return false;
+		}
+	}
+	catch( const CaptureException &exc ) {
+		CI_LOG_E( "Unable to replay " << mOptions.getPath() << ": " << exc.Message() );
+		return false;
+	}
+	record = scratch;
+	return true;
+}
+
+void ReplayCamera::run()
+{
+	using namespace std::chrono;
+
+	const uint64_t frequency = mReader->getFileHeader().timestampFrequency;
+	const bool paced = mOptions.getRecordedPace() && 0 != frequency;
+
+	size_t preloadIndex = 0;
+	uint64_t slot = 0;
+	uint64_t framesInPass = 0;
+
+	bool haveFirst = false;
+	VmbUint64_t firstID = 0, lastID = 0;
+	VmbUint64_t firstTimestamp = 0, lastTimestamp = 0;
+	VmbUint64_t idOffset = 0, timestampOffset = 0;
+	// frame.timestamp that is due at hostStart
+	VmbUint64_t paceTimestamp = 0;
+	auto hostStart = steady_clock::now();
+	auto lastDue = hostStart;
+	bool newPass = false;
+
+	while( mRunning ) {
+		const Record *record = nullptr;
+		Record *scratch = mBuffers.empty() ? nullptr : &mBuffers[slot % mBuffers.size()];
+		if( ! nextRecord( preloadIndex, scratch, record )) {
+			if( ! mOptions.getLoop() || 0 == framesInPass ) {
+				break;
+			}
+			// the next pass continues where this one ended, one average frame period later
+			VmbUint64_t span = lastTimestamp > firstTimestamp ? lastTimestamp - firstTimestamp : 0;
+			VmbUint64_t period = framesInPass > 1 ? span / ( framesInPass - 1 ) : 0;
+			timestampOffset += span + period;
+			idOffset += ( lastID > firstID ? lastID - firstID : 0 ) + 1;
+			if( paced ) {
+				hostStart = lastDue + duration_cast<steady_clock::duration>(
+				                          duration<double>( static_cast<double>( period ) / frequency ));
+				newPass = true;
+			}
+			framesInPass = 0;
+			preloadIndex = 0;
+			mReader->rewind();
+			continue;
+		}
+
+		if( ! haveFirst ) {
+			firstID = record->header.frameID;
+			firstTimestamp = record->header.timestamp;
+			lastID = firstID;
+			lastTimestamp = firstTimestamp;
+			paceTimestamp = firstTimestamp;
+			hostStart = steady_clock::now();
+			haveFirst = true;
+		}
+
+		RawFrame frame = makeRawFrame( record->header, record->data.data() );
+		frame.frameID += idOffset;
+		frame.timestamp += timestampOffset;
+
+		if( paced ) {
+			// A pass starts one period after the last frame of the previous one.  Records older than the anchor, e.g.
+			// after a camera clock reset or from a file written in arrival order, are due now and pace the next ones.
+			if( newPass ) {
+				paceTimestamp = frame.timestamp;
+				newPass = false;
+			} else if( frame.timestamp < paceTimestamp ) {
+				paceTimestamp = frame.timestamp;
+				hostStart = steady_clock::now();
+			}
+			double seconds = static_cast<double>( frame.timestamp - paceTimestamp ) / frequency;
+			auto due = hostStart + duration_cast<steady_clock::duration>( duration<double>( seconds ));
+			lastDue = std::max( lastDue, due );
+			std::unique_lock<std::mutex> lock( mStopMutex );
+			mStopCondition.wait_until( lock, due, [this]() { return ! mRunning; } );
+			if( ! mRunning ) {
+				break;
+			}
+		}
+
+		mCallback( frame );
+
+		// the newest of the pass, the file need not be in order
+		lastID = std::max<VmbUint64_t>( lastID, record->header.frameID );
+		lastTimestamp = std::max<VmbUint64_t>( lastTimestamp, record->header.timestamp );
+		++framesInPass;
+		++mFramesReplayed;
+		++slot;
+	}
+
+	mRunning = false;
+}
+
+} // namespace civimba
@@ -0,0 +1,182 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/SharedFrameConsumer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace civimba {
+
+SharedFrameConsumer::SharedFrameConsumer( const std::string &name )
+		: mName( getSharedFrameName( name )), mHeader( nullptr ), mSlots( nullptr ), mMappedSize( 0 ), mNext( 1 ),
+		  mFramesMissed( 0 )
+{
+	int fd = ::shm_open( mName.c_str(), O_RDONLY, 0 );
+	if( fd < 0 ) {
+		throw SharedFrameConsumerException( __FUNCTION__, "Unable to open shared memory " + mName + ": " + std::strerror( errno ),
+		                                    ENOENT == errno ? VmbErrorNotFound : VmbErrorResources );
+	}
+
+	struct stat info;
+	void *data = MAP_FAILED;
+	std::string error;
+	if( 0 != ::fstat( fd, &info )) {
+		error = std::strerror( errno );
+	} else if( static_cast<uint64_t>( info.st_size ) < sizeof( SharedFrameRingHeader )) {
+		error = "not a frame ring";
+	} else {
+		mMappedSize = static_cast<uint64_t>( info.st_size );
+		data = ::mmap( nullptr, static_cast<size_t>( mMappedSize ), PROT_READ, MAP_SHARED, fd, 0 );
+		if( MAP_FAILED == data ) {
+			error = std::strerror( errno );
+		}
+	}
+	::close( fd );
+	if( ! error.empty() ) {
+		throw SharedFrameConsumerException( __FUNCTION__, "Unable to map shared memory " + mName + ": " + error,
+		                                    VmbErrorResources );
+	}
+
+	mHeader = static_cast<const SharedFrameRingHeader*>( data );
+	const bool valid = 0 == std::memcmp( mHeader->magic, SHARED_FRAME_MAGIC, sizeof( mHeader->magic ));
+	std::atomic_thread_fence( std::memory_order_acquire );
+	if( ! valid || SHARED_FRAME_VERSION != mHeader->version || 0 == mHeader->slotCount
+	    || mHeader->slotSize < sizeof( SharedFrameSlotHeader )
+	    || mHeader->headerSize + mHeader->slotSize * mHeader->slotCount > mMappedSize ) {
+		::munmap( data, static_cast<size_t>( mMappedSize ));
+		throw SharedFrameConsumerException( __FUNCTION__, mName + " is not a civimba frame ring or is not ready",
+		                                    VmbErrorInvalidValue );
+	}
+	mSlots = static_cast<const VmbUchar_t*>( data ) + mHeader->headerSize;
+	mNext = mHeader->published.load( std::memory_order_acquire ) + 1;
+}
+
+SharedFrameConsumer::~SharedFrameConsumer()
+{
+	::munmap( const_cast<SharedFrameRingHeader*>( mHeader ), static_cast<size_t>( mMappedSize ));
+}
+
+std::string SharedFrameConsumer::getCameraID() const
+{
+	return std::string( mHeader->cameraID, strnlen( mHeader->cameraID, sizeof( mHeader->cameraID )));
+}
+
+const SharedFrameSlotHeader& SharedFrameConsumer::getSlot( uint64_t sequence ) const
+{
+	return *reinterpret_cast<const SharedFrameSlotHeader*>( mSlots + ( sequence % mHeader->slotCount ) * mHeader->slotSize );
+}
+
+bool SharedFrameConsumer::view( uint64_t sequence, RawFrame &frame ) const
+{
+	const SharedFrameSlotHeader &slot = getSlot( sequence );
+	if( sequence != slot.sequence.load( std::memory_order_acquire )) {
+		return false;
+	}
+
+	frame.buffer = reinterpret_cast<const VmbUchar_t*>( &slot ) + sizeof( SharedFrameSlotHeader );
+	frame.imageSize = static_cast<VmbUint32_t>( std::min<uint64_t>( slot.imageSize, mHeader->slotSize - sizeof( SharedFrameSlotHeader )));
+	frame.width = slot.width;
+	frame.height = slot.height;
+	frame.pixelFormat = static_cast<VmbPixelFormatType>( slot.pixelFormat );
+	frame.frameID = slot.frameID;
+	frame.frameIDValid = 0 != ( slot.flags & SHARED_FRAME_FLAG_ID_VALID );
+	frame.timestamp = slot.timestamp;
+	frame.receiveStatus = static_cast<VmbFrameStatusType>( slot.receiveStatus );
+
+	// the metadata only counts if the slot still holds the same frame after it was read
+	return isValid( sequence );
+}
+
+bool SharedFrameConsumer::readLatest( RawFrame &frame, uint64_t &sequence )
+{
+	for( ;; ) {
+		const uint64_t published = mHeader->published.load( std::memory_order_acquire );
+		if( 0 == published ) {
+			return false;
+		}
+		if( view( published, frame )) {
+			sequence = published;
+			return true;
+		}
+		// overwritten while reading, the publisher lapped the whole ring, try the newer frame
+	}
+}
+
+bool SharedFrameConsumer::readNext( RawFrame &frame, uint64_t &sequence )
+{
+	for( ;; ) {
+		const uint64_t published = mHeader->published.load( std::memory_order_acquire );
+		if( mNext > published ) {
+			return false;
+		}
+
+		// skip to the oldest frame still in the ring
+		const uint64_t slotCount = mHeader->slotCount;
+		if( published - mNext >= slotCount ) {
+			const uint64_t oldest = published - slotCount + 1;
+			mFramesMissed += oldest - mNext;
+			mNext = oldest;
+		}
+
+		if( view( mNext, frame )) {
+			sequence = mNext++;
+			return true;
+		}
+		++mFramesMissed;
+		++mNext;
+	}
+}
+
+bool SharedFrameConsumer::waitNext( RawFrame &frame, uint64_t &sequence, double timeout )
+{
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>( timeout );
+	while( ! readNext( frame, sequence )) {
+		if( isPublisherClosed() || std::chrono::steady_clock::now() >= deadline ) {
+			return false;
+		}
+		std::this_thread::sleep_for( std::chrono::microseconds( 100 ));
+	}
+	return true;
+}
+
+bool SharedFrameConsumer::isValid( uint64_t sequence ) const
+{
+	std::atomic_thread_fence( std::memory_order_acquire );
+	return sequence == getSlot( sequence ).sequence.load( std::memory_order_relaxed );
+}
+
+bool SharedFrameConsumer::isPublisherClosed() const
+{
+	return 0 != mHeader->closed.load( std::memory_order_acquire );
+}
+
+} // namespace civimba
@@ -0,0 +1,185 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/SharedFramePublisher.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cinder/Log.h"
+
+namespace civimba {
+
+SharedFramePublisher::SharedFramePublisher( const Options &options, const std::string &cameraID,
+                                            uint64_t timestampFrequency )
+		: mOptions( options ), mName( getSharedFrameName( options.getName() )), mCameraID( cameraID ),
+		  mTimestampFrequency( timestampFrequency ), mClosed( false ), mHeader( nullptr ), mSlots( nullptr ),
+		  mMappedSize( 0 ), mSlotSize( 0 ), mSlotCount( 0 ), mFramesPublished( 0 ), mFramesDropped( 0 )
+{
+	if( options.getName().empty() || 0 == options.getSlotCount() ) {
+		throw SharedFramePublisherException( __FUNCTION__, "A name and at least one slot are required", VmbErrorBadParameter );
+	}
+	if( mOptions.getMaxImageSize() > 0 ) {
+		open( mOptions.getMaxImageSize() );
+	}
+}
+
+SharedFramePublisher::SharedFramePublisher( const Options &options, CameraController &camera )
+		: mOptions( options ), mName( getSharedFrameName( options.getName() )), mCameraID( camera.getID() ),
+		  mTimestampFrequency( camera.getTimestampFrequency() ), mClosed( false ), mHeader( nullptr ),
+		  mSlots( nullptr ), mMappedSize( 0 ), mSlotSize( 0 ), mSlotCount( 0 ), mFramesPublished( 0 ),
+		  mFramesDropped( 0 )
+{
+	if( options.getName().empty() || 0 == options.getSlotCount() ) {
+		throw SharedFramePublisherException( __FUNCTION__, "A name and at least one slot are required", VmbErrorBadParameter );
+	}
+	if( mOptions.getMaxImageSize() > 0 ) {
+		open( mOptions.getMaxImageSize() );
+	}
+	attach( camera );
+}
+
+SharedFramePublisher::~SharedFramePublisher()
+{
+	close();
+}
+
+void SharedFramePublisher::open( uint64_t maxImageSize )
+{
+	mSlotSize = getSharedFrameSlotSize( maxImageSize );
+	mSlotCount = mOptions.getSlotCount();
+	mMappedSize = sizeof( SharedFrameRingHeader ) + mSlotSize * mSlotCount;
+
+	// a new object rather than a truncated old one, readers of a previous ring keep a valid mapping
+	::shm_unlink( mName.c_str() );
+	int fd = ::shm_open( mName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644 );
+	if( fd < 0 ) {
+		throw SharedFramePublisherException( __FUNCTION__, "Unable to create shared memory " + mName + ": " + std::strerror( errno ),
+		                                     VmbErrorResources );
+	}
+
+	void *data = MAP_FAILED;
+	int error = 0;
+	if( 0 != ::ftruncate( fd, static_cast<off_t>( mMappedSize ))) {
+		error = errno;
+	} else {
+		data = ::mmap( nullptr, static_cast<size_t>( mMappedSize ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+		if( MAP_FAILED == data ) {
+			error = errno;
+		}
+	}
+	::close( fd );
+	if( 0 != error ) {
+		::shm_unlink( mName.c_str() );
+		throw SharedFramePublisherException( __FUNCTION__, "Unable to map shared memory " + mName + ": " + std::strerror( error ),
+		                                     VmbErrorResources );
+	}
+
+	// the object is zero filled, which is also the initial state of every atomic in it
+	mHeader = static_cast<SharedFrameRingHeader*>( data );
+	mSlots = static_cast<VmbUchar_t*>( data ) + sizeof( SharedFrameRingHeader );
+	mHeader->version = SHARED_FRAME_VERSION;
+	mHeader->headerSize = sizeof( SharedFrameRingHeader );
+	mHeader->slotSize = mSlotSize;
+	mHeader->slotCount = mSlotCount;
+	mHeader->timestampFrequency = mTimestampFrequency;
+	std::strncpy( mHeader->cameraID, mCameraID.c_str(), sizeof( mHeader->cameraID ) - 1 );
+
+	// readers check the magic first, it is published last
+	std::atomic_thread_fence( std::memory_order_release );
+	std::memcpy( mHeader->magic, SHARED_FRAME_MAGIC, sizeof( mHeader->magic ));
+}
+
+void SharedFramePublisher::attach( CameraController &camera )
+{
+	detach();
+	mConnection = camera.getSignalRawFrame().connect( [this]( const RawFrame &frame ) { write( frame ); } );
+}
+
+void SharedFramePublisher::detach()
+{
+	mConnection.disconnect();
+}
+
+bool SharedFramePublisher::write( const RawFrame &frame )
+{
+	if( mClosed ) {
+		throw SharedFramePublisherException( __FUNCTION__, "Publisher is closed", VmbErrorInvalidCall );
+	}
+	if( ! mHeader ) {
+		open( frame.imageSize );
+	}
+	if( getSharedFrameSlotSize( frame.imageSize ) > mSlotSize ) {
+		++mFramesDropped;
+		return false;
+	}
+
+	const uint64_t sequence = mFramesPublished + 1;
+	VmbUchar_t *slotData = mSlots + ( sequence % mSlotCount ) * mSlotSize;
+	SharedFrameSlotHeader *slot = reinterpret_cast<SharedFrameSlotHeader*>( slotData );
+
+	// a reader that still looks at the previous frame in this slot sees the cleared sequence and drops its view
+	slot->sequence.store( 0, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+
+	slot->frameID = frame.frameID;
+	slot->timestamp = frame.timestamp;
+	slot->pixelFormat = static_cast<uint32_t>( frame.pixelFormat );
+	slot->width = frame.width;
+	slot->height = frame.height;
+	slot->receiveStatus = static_cast<int32_t>( frame.receiveStatus );
+	slot->imageSize = frame.imageSize;
+	slot->flags = frame.frameIDValid ? SHARED_FRAME_FLAG_ID_VALID : 0;
+	std::memcpy( slotData + sizeof( SharedFrameSlotHeader ), frame.buffer, frame.imageSize );
+
+	slot->sequence.store( sequence, std::memory_order_release );
+	mHeader->published.store( sequence, std::memory_order_release );
+	mFramesPublished = sequence;
+	return true;
+}
+
+void SharedFramePublisher::close()
+{
+	detach();
+	if( mClosed ) {
+		return;
+	}
+	mClosed = true;
+	if( ! mHeader ) {
+		return;
+	}
+
+	mHeader->closed.store( 1, std::memory_order_release );
+	::munmap( mHeader, static_cast<size_t>( mMappedSize ));
+	mHeader = nullptr;
+	mSlots = nullptr;
+	if( mOptions.getUnlinkOnClose() && 0 != ::shm_unlink( mName.c_str() ) && ENOENT != errno ) {
+		CI_LOG_W( "Unable to remove shared memory " << mName << ": " << std::strerror( errno ));
+	}
+}
+
+} // namespace civimba
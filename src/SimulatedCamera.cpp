@@ -0,0 +1,173 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "civimba/SimulatedCamera.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+namespace civimba {
+
+SimulatedCamera::SimulatedCamera( const Options &options )
+		: mOptions( options ),
+		  mRunning( false ),
+		  mFramesGenerated( 0 ),
+		  mFramesDropped( 0 )
+{
+	if( 0 == mOptions.getWidth() || 0 == mOptions.getHeight() ) {
+		throw SimulatedCameraException( __FUNCTION__, "Simulated camera needs a non zero size.", VmbErrorBadParameter );
+	}
+	if( 0 == RawFrame::getBitsPerPixel( mOptions.getPixelFormat() )) {
+		throw SimulatedCameraException( __FUNCTION__, "Unsupported pixel format.", VmbErrorBadParameter );
+	}
+}
+
+SimulatedCamera::~SimulatedCamera()
+{
+	stop();
+}
+
+void SimulatedCamera::fillTestPattern( std::vector<VmbUchar_t> &data, VmbPixelFormatType format, uint32_t seed )
+{
+	std::mt19937 rng( seed );
+	for( auto &byte : data ) {
+		byte = static_cast<VmbUchar_t>( rng() );
+	}
+
+	// unpacked 10-16 bit formats are little endian, keep the high byte within 12 bits
+	if( 16 == RawFrame::getBitsPerPixel( format ) && VmbPixelFormatYuv422 != format ) {
+		for( size_t i = 1; i < data.size(); i += 2 ) {
+			data[i] &= 0x0F;
+		}
+	}
+}
+
+void SimulatedCamera::start( uint32_t numberFrames, RawFrameCallback callback )
+{
+	if( mRunning || mThread.joinable() ) {
+		stop();
+	}
+	if( 0 == numberFrames ) {
+		throw SimulatedCameraException( __FUNCTION__, "Simulated camera needs at least one frame.", VmbErrorBadParameter );
+	}
+
+	// all allocation happens here so the acquisition thread only touches preallocated buffers
+	uint32_t imageSize = RawFrame::getImageSize( mOptions.getPixelFormat(), mOptions.getWidth(), mOptions.getHeight() );
+	mBuffers.resize( numberFrames );
+	for( uint32_t i = 0; i < numberFrames; ++i ) {
+		mBuffers[i].resize( imageSize );
+		fillTestPattern( mBuffers[i], mOptions.getPixelFormat(), mOptions.getSeed() + i );
+	}
+
+	mCallback = callback;
+	mFramesGenerated = 0;
+	mFramesDropped = 0;
+	mRunning = true;
+	mThread = std::thread( &SimulatedCamera::run, this );
+}
+
+void SimulatedCamera::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock( mStopMutex );
+		mRunning = false;
+	}
+	mStopCondition.notify_all();
+
+	if( mThread.joinable() && mThread.get_id() != std::this_thread::get_id() ) {
+		mThread.join();
+	}
+}
+
+void SimulatedCamera::run()
+{
+	using namespace std::chrono;
+
+	std::mt19937 rng( mOptions.getSeed() );
+	std::uniform_real_distribution<double> unit( 0.0, 1.0 );
+	std::uniform_int_distribution<uint32_t> gapSize( 1, std::max<uint32_t>( 1, mOptions.getMaxFrameIDGap() ));
+
+	const bool freeRunning = mOptions.getFrameRate() <= 0.0;
+	const nanoseconds period = freeRunning ? nanoseconds( 0 )
+	                                       : duration_cast<nanoseconds>( duration<double>( 1.0 / mOptions.getFrameRate() ));
+	const uint64_t queueDepth = mBuffers.size();
+	const auto startTime = steady_clock::now();
+
+	RawFrame frame;
+	frame.imageSize = static_cast<VmbUint32_t>( mBuffers[0].size() );
+	frame.width = mOptions.getWidth();
+	frame.height = mOptions.getHeight();
+	frame.pixelFormat = mOptions.getPixelFormat();
+	frame.frameIDValid = true;
+
+	VmbUint64_t frameID = 0;
+	uint64_t slot = 0;
+
+	while( mRunning ) {
+		if( mOptions.getFrameLimit() && mFramesGenerated >= mOptions.getFrameLimit() ) {
+			break;
+		}
+
+		// the sensor ID sequence is decided first so it does not depend on timing
+		if( frameID > 0 && unit( rng ) < mOptions.getFrameIDGapProbability() ) {
+			frameID += gapSize( rng );
+		}
+		bool incomplete = unit( rng ) < mOptions.getIncompleteProbability();
+		double jitter = ( unit( rng ) * 2.0 - 1.0 ) * mOptions.getJitter();
+
+		auto arrival = startTime + period * slot + duration_cast<nanoseconds>( period * jitter );
+
+		if( ! freeRunning ) {
+			auto now = steady_clock::now();
+			if( now < arrival ) {
+				std::unique_lock<std::mutex> lock( mStopMutex );
+				mStopCondition.wait_until( lock, arrival, [this]() { return ! mRunning; } );
+				if( ! mRunning ) {
+					break;
+				}
+			} else if( now - arrival > period * queueDepth ) {
+				// consumer fell behind by more than the buffer queue, the camera has nowhere to put this frame
+				++mFramesDropped;
+				++frameID;
+				++slot;
+				continue;
+			}
+		}
+
+		frame.buffer = mBuffers[slot % queueDepth].data();
+		frame.frameID = frameID;
+		frame.timestamp = static_cast<VmbUint64_t>( duration_cast<nanoseconds>( steady_clock::now() - startTime ).count() );
+		frame.receiveStatus = incomplete ? VmbFrameStatusIncomplete : VmbFrameStatusComplete;
+
+		mCallback( frame );
+
+		++mFramesGenerated;
+		++frameID;
+		++slot;
+	}
+
+	mRunning = false;
+}
+
+} // namespace civimba
@@ -0,0 +1,410 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/SnapshotWriter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+
+#include "cinder/Channel.h"
+#include "cinder/ImageIo.h"
+#include "cinder/Log.h"
+
+namespace civimba {
+
+namespace {
+
+// significant bits of the samples of a format with a 16 bit representation, 0 for every other format
+uint32_t getSignificantBits( VmbPixelFormatType pixelFormat )
+{
+	switch( pixelFormat ) {
+		case VmbPixelFormatMono8:
+		case VmbPixelFormatBayerGR8:
+		case VmbPixelFormatBayerRG8:
+		case VmbPixelFormatBayerGB8:
+		case VmbPixelFormatBayerBG8:
+			return 8;
+		case VmbPixelFormatMono10:
+		case VmbPixelFormatBayerGR10:
+		case VmbPixelFormatBayerRG10:
+		case VmbPixelFormatBayerGB10:
+		case VmbPixelFormatBayerBG10:
+			return 10;
+		case VmbPixelFormatMono12:
+		case VmbPixelFormatBayerGR12:
+		case VmbPixelFormatBayerRG12:
+		case VmbPixelFormatBayerGB12:
+		case VmbPixelFormatBayerBG12:
+		case VmbPixelFormatMono12Packed:
+		case VmbPixelFormatBayerGR12Packed:
+		case VmbPixelFormatBayerRG12Packed:
+		case VmbPixelFormatBayerGB12Packed:
+		case VmbPixelFormatBayerBG12Packed:
+			return 12;
+		case VmbPixelFormatMono14:
+			return 14;
+		case VmbPixelFormatMono16:
+		case VmbPixelFormatBayerGR16:
+		case VmbPixelFormatBayerRG16:
+		case VmbPixelFormatBayerGB16:
+		case VmbPixelFormatBayerBG16:
+			return 16;
+		default:
+			return 0;
+	}
+}
+
+// samples of frame scaled to the full 16 bit range, false if the format is not supported or the buffer is short
+bool unpackTo16( const RawFrame &frame, std::vector<uint16_t> &samples )
+{
+	const uint32_t significantBits = getSignificantBits( frame.pixelFormat );
+	if( 0 == significantBits || frame.imageSize < RawFrame::getImageSize( frame.pixelFormat, frame.width, frame.height )) {
+		return false;
+	}
+
+	const size_t count = static_cast<size_t>( frame.width ) * frame.height;
+	const unsigned shift = 16 - significantBits;
+	const VmbUchar_t *in = frame.buffer;
+	samples.resize( count );
+	switch( RawFrame::getBitsPerPixel( frame.pixelFormat )) {
+		case 8:
+			for( size_t i = 0; i < count; ++i ) {
+				samples[i] = static_cast<uint16_t>( in[i] << 8 );
+			}
+			break;
+		case 16:
+			for( size_t i = 0; i < count; ++i ) {
+				samples[i] = static_cast<uint16_t>(( in[2 * i] | ( in[2 * i + 1] << 8 )) << shift );
+			}
+			break;
+		case 12:
+			// GigE 12 bit packed: high bits of the first sample, the low nibbles of both, high bits of the second
+			for( size_t i = 0; i < count; i += 2, in += 3 ) {
+				samples[i] = static_cast<uint16_t>((( in[0] << 4 ) | ( in[1] & 0x0F )) << shift );
+				if( i + 1 < count ) {
+					samples[i + 1] = static_cast<uint16_t>((( in[2] << 4 ) | ( in[1] >> 4 )) << shift );
+				}
+			}
+			break;
+		default:
+			return false;
+	}
+	return true;
+}
+
+bool isTiff( const std::string &path )
+{
+	std::string extension = path.substr( std::min( path.size(), path.find_last_of( '.' )));
+	std::transform( extension.begin(), extension.end(), extension.begin(), ::tolower );
+	return ".tif" == extension || ".tiff" == extension;
+}
+
+// Baseline uncompressed single channel 16 bit TIFF, little endian, one strip
+bool writeTiff16( const std::string &path, const std::vector<uint16_t> &samples, uint32_t width, uint32_t height )
+{
+	struct Entry {
+		uint16_t tag;
+		uint16_t type;              // 3 SHORT, 4 LONG
+		uint32_t count;
+		uint32_t value;
+	};
+	static_assert( sizeof( Entry ) == 12, "TIFF directory entry layout" );
+
+	const uint64_t dataSize = static_cast<uint64_t>( samples.size() ) * sizeof( uint16_t );
+	if( dataSize + 8 + 2 + 9 * sizeof( Entry ) + 4 > 0xFFFFFFFFull ) {
+		return false;
+	}
+	const uint32_t dataOffset = 8;
+	const uint32_t directoryOffset = dataOffset + static_cast<uint32_t>( dataSize );
+
+	const Entry entries[] = {
+		{ 256, 4, 1, width },                                   // ImageWidth
+		{ 257, 4, 1, height },                                  // ImageLength
+		{ 258, 3, 1, 16 },                                      // BitsPerSample
+		{ 259, 3, 1, 1 },                                       // Compression: none
+		{ 262, 3, 1, 1 },                                       // PhotometricInterpretation: BlackIsZero
+		{ 273, 4, 1, dataOffset },                              // StripOffsets
+		{ 277, 3, 1, 1 },                                       // SamplesPerPixel
+		{ 278, 4, 1, height },                                  // RowsPerStrip
+		{ 279, 4, 1, static_cast<uint32_t>( dataSize ) },       // StripByteCounts
+	};
+	const uint8_t header[8] = { 'I', 'I', 42, 0,
+	                            static_cast<uint8_t>( directoryOffset ), static_cast<uint8_t>( directoryOffset >> 8 ),
+	                            static_cast<uint8_t>( directoryOffset >> 16 ), static_cast<uint8_t>( directoryOffset >> 24 ) };
+	const uint16_t entryCount = sizeof( entries ) / sizeof( entries[0] );
+	const uint32_t nextDirectory = 0;
+
+	std::FILE *file = std::fopen( path.c_str(), "wb" );
+	if( ! file ) {
+		return false;
+	}
+	bool success = 1 == std::fwrite( header, sizeof( header ), 1, file )
+	               && samples.size() == std::fwrite( samples.data(), sizeof( uint16_t ), samples.size(), file )
+	               && 1 == std::fwrite( &entryCount, sizeof( entryCount ), 1, file )
+	               && 1 == std::fwrite( entries, sizeof( entries ), 1, file )
+	               && 1 == std::fwrite( &nextDirectory, sizeof( nextDirectory ), 1, file );
+	success = 0 == std::fclose( file ) && success;
+	return success;
+}
+
+} // anonymous namespace
+
+SnapshotWriter::SnapshotWriter( const Options &options )
+		: mOptions( options ), mBusy( 0 ), mRawRequests( 0 ), mSnapshotsWritten( 0 ), mSnapshotsRejected( 0 ),
+		  mStop( false )
+{
+	if( 0 == mOptions.getQueueDepth() ) {
+		throw SnapshotWriterException( __FUNCTION__, "Queue depth must be at least 1", VmbErrorBadParameter );
+	}
+	for( uint32_t i = 0; i < mOptions.getQueueDepth(); ++i ) {
+		mJobs.push_back( std::unique_ptr<Job>( new Job() ));
+		mFree.push_back( mJobs.back().get() );
+	}
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+	waitForSnapshots();
+
+	std::deque<Job*> abandoned;
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		abandoned.swap( mWaitingForRaw );
+		mStop = true;
+	}
+	mPendingCondition.notify_all();
+	if( mThread.joinable() ) {
+		mThread.join();
+	}
+
+	for( Job *job : abandoned ) {
+		if( job->callback ) {
+			job->callback( job->path, false );
+		}
+	}
+}
+
+bool SnapshotWriter::supportsRaw( VmbPixelFormatType pixelFormat )
+{
+	return 0 != getSignificantBits( pixelFormat );
+}
+
+bool SnapshotWriter::write( const cinder::Surface8uRef &surface, const std::string &path, const SnapshotCallback &callback )
+{
+	if( ! surface ) {
+		++mSnapshotsRejected;
+		return false;
+	}
+	Job *job = acquire();
+	if( ! job ) {
+		return false;
+	}
+	job->path = path;
+	job->callback = callback;
+	job->surface = surface;
+	queue( job );
+	return true;
+}
+
+bool SnapshotWriter::write( const RawFrame &frame, const std::string &path, const SnapshotCallback &callback )
+{
+	if( ! supportsRaw( frame.pixelFormat )) {
+		++mSnapshotsRejected;
+		return false;
+	}
+	Job *job = acquire();
+	if( ! job ) {
+		return false;
+	}
+	job->path = path;
+	job->callback = callback;
+	copyRaw( job, frame );
+	queue( job );
+	return true;
+}
+
+bool SnapshotWriter::writeNextRaw( const std::string &path, const SnapshotCallback &callback )
+{
+	Job *job = acquire();
+	if( ! job ) {
+		return false;
+	}
+	job->path = path;
+	job->callback = callback;
+
+	std::lock_guard<std::mutex> lock( mMutex );
+	mWaitingForRaw.push_back( job );
+	++mRawRequests;
+	return true;
+}
+
+void SnapshotWriter::rawFrame( const RawFrame &frame )
+{
+	// the common case, no snapshot is waiting, costs one atomic load on the acquisition thread
+	if( 0 == mRawRequests.load( std::memory_order_relaxed ) || VmbFrameStatusComplete != frame.receiveStatus ) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		for( Job *job : mWaitingForRaw ) {
+			// unsupported formats are handed on without data and fail on the writer thread, which runs the callback
+			if( supportsRaw( frame.pixelFormat )) {
+				copyRaw( job, frame );
+			} else {
+				job->frame = RawFrame();
+				job->frame.pixelFormat = frame.pixelFormat;
+			}
+			mPending.push_back( job );
+		}
+		mRawRequests -= mWaitingForRaw.size();
+		mWaitingForRaw.clear();
+		if( ! mThread.joinable() ) {
+			mThread = std::thread( &SnapshotWriter::run, this );
+		}
+	}
+	mPendingCondition.notify_one();
+}
+
+void SnapshotWriter::waitForSnapshots()
+{
+	std::unique_lock<std::mutex> lock( mMutex );
+	mDoneCondition.wait( lock, [this] { return mPending.empty() && 0 == mBusy; } );
+}
+
+SnapshotWriter::Job* SnapshotWriter::acquire()
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	if( mFree.empty() ) {
+		++mSnapshotsRejected;
+		return nullptr;
+	}
+	Job *job = mFree.back();
+	mFree.pop_back();
+	return job;
+}
+
+void SnapshotWriter::queue( Job *job )
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mPending.push_back( job );
+		// the thread is only started by the first snapshot, most controllers never take one
+		if( ! mThread.joinable() ) {
+			mThread = std::thread( &SnapshotWriter::run, this );
+		}
+	}
+	mPendingCondition.notify_one();
+}
+
+void SnapshotWriter::copyRaw( Job *job, const RawFrame &frame )
+{
+	// the buffer keeps its capacity between snapshots, so only the first snapshot of a size allocates
+	job->raw.assign( frame.buffer, frame.buffer + frame.imageSize );
+	job->frame = frame;
+	job->frame.buffer = job->raw.data();
+}
+
+ThreadPlacementReport SnapshotWriter::getPlacementReport()
+{
+	std::lock_guard<std::mutex> lock( mMutex );
+	return mPlacementReport;
+}
+
+void SnapshotWriter::run()
+{
+	{
+		ThreadPlacementReport report = mOptions.getPlacement().apply( "SnapshotWriter" );
+		std::lock_guard<std::mutex> lock( mMutex );
+		mPlacementReport = report;
+	}
+
+	for( ;; ) {
+		Job *job = nullptr;
+		{
+			std::unique_lock<std::mutex> lock( mMutex );
+			mPendingCondition.wait( lock, [this] { return mStop || ! mPending.empty(); } );
+			if( mPending.empty() ) {
+				return;
+			}
+			job = mPending.front();
+			mPending.pop_front();
+			++mBusy;
+		}
+
+		const bool success = writeJob( *job );
+		if( success ) {
+			++mSnapshotsWritten;
+		}
+		if( job->callback ) {
+			job->callback( job->path, success );
+		}
+
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			job->callback = SnapshotCallback();
+			job->surface.reset();
+			job->frame = RawFrame();
+			mFree.push_back( job );
+			--mBusy;
+		}
+		mDoneCondition.notify_all();
+	}
+}
+
+bool SnapshotWriter::writeJob( Job &job )
+{
+	try {
+		if( job.surface ) {
+			cinder::writeImage( job.path, *job.surface );
+			return true;
+		}
+
+		std::vector<uint16_t> samples;
+		if( ! job.frame.buffer || ! unpackTo16( job.frame, samples )) {
+			CI_LOG_E( "Unable to write snapshot " << job.path << ": pixel format 0x" << std::hex << job.frame.pixelFormat
+			          << std::dec << " has no 16 bit representation" );
+			return false;
+		}
+		if( isTiff( job.path )) {
+			if( ! writeTiff16( job.path, samples, job.frame.width, job.frame.height )) {
+				CI_LOG_E( "Unable to write snapshot " << job.path << ": " << std::strerror( errno ));
+				return false;
+			}
+			return true;
+		}
+		cinder::Channel16u channel( static_cast<int32_t>( job.frame.width ), static_cast<int32_t>( job.frame.height ),
+		                            static_cast<ptrdiff_t>( job.frame.width * sizeof( uint16_t )), 1, samples.data() );
+		cinder::writeImage( job.path, channel );
+		return true;
+	}
+	catch( const std::exception &exc ) {
+		CI_LOG_E( "Unable to write snapshot " << job.path << ": " << exc.what() );
+		return false;
+	}
+}
+
+} // namespace civimba
@@ -0,0 +1,369 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/StreamTuner.h"
+#include "civimba/ClockMapper.h"
+#include "civimba/ErrorCodeToMessage.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#include "cinder/Log.h"
+
+namespace civimba {
+
+using namespace AVT::VmbAPI;
+
+namespace {
+
+// sizes worth trying below the negotiated packet size: AVT jumbo default, half jumbo and standard Ethernet
+const uint32_t kPacketSizes[] = { 8228, 4500, 1500 };
+
+bool getIntFeature( CameraController &camera, const char *name, FeaturePtr &feature )
+{
+	return camera.getCamera() && VmbErrorSuccess == camera.getCamera()->GetFeatureByName( name, feature );
+}
+
+// value clamped to the range and rounded down to the increment of the feature
+VmbInt64_t fitIntFeature( const FeaturePtr &feature, VmbInt64_t value )
+{
+	VmbInt64_t minimum = 0;
+	VmbInt64_t maximum = 0;
+	VmbInt64_t increment = 1;
+	if( VmbErrorSuccess == feature->GetRange( minimum, maximum )) {
+		value = std::min( std::max( value, minimum ), maximum );
+	}
+	if( VmbErrorSuccess == feature->GetIncrement( increment ) && increment > 1 ) {
+		value = minimum + ( value - minimum ) / increment * increment;
+	}
+	return value;
+}
+
+void setIntFeature( CameraController &camera, const char *name, VmbInt64_t value )
+{
+	FeaturePtr feature;
+	if( ! getIntFeature( camera, name, feature )) {
+		CI_LOG_W( camera.getID() << " has no " << name << ", not changed" );
+		return;
+	}
+	VmbErrorType result = feature->SetValue( fitIntFeature( feature, value ));
+	if( VmbErrorSuccess != result ) {
+		throw StreamTuner::StreamTunerException( __FUNCTION__, std::string( name ) + ": " + ErrorCodeToMessage( result ),
+		                                         result );
+	}
+}
+
+double getCpuTime()
+{
+	return static_cast<double>( std::clock() ) / CLOCKS_PER_SEC;
+}
+
+std::string trim( const std::string &s )
+{
+	const size_t first = s.find_first_not_of( " \t\r" );
+	if( std::string::npos == first ) {
+		return std::string();
+	}
+	return s.substr( first, s.find_last_not_of( " \t\r" ) - first + 1 );
+}
+
+} // anonymous namespace
+
+StreamTuner::StreamTuner( const Options &options )
+		: mOptions( options )
+{
+	if( mOptions.getTrialDuration() <= 0.0 || mOptions.getWarmup() < 0.0 ) {
+		throw StreamTunerException( __FUNCTION__, "Invalid trial duration", VmbErrorBadParameter );
+	}
+}
+
+// ----------------------------------------------------------------------------------------------------
+// MARK: - Trials
+// ----------------------------------------------------------------------------------------------------
+
+bool StreamTuner::isBetter( const StreamTrialResult &a, const StreamTrialResult &b )
+{
+	if( VmbErrorSuccess != a.error || VmbErrorSuccess != b.error ) {
+		return VmbErrorSuccess == a.error;
+	}
+	if( std::fabs( a.completeRate - b.completeRate ) > 1e-4 ) {
+		return a.completeRate > b.completeRate;
+	}
+	// throughput limits below the stream rate cost frame rate
+	if( std::fabs( a.frameRate - b.frameRate ) > 0.01 * std::max( a.frameRate, b.frameRate )) {
+		return a.frameRate > b.frameRate;
+	}
+	if( std::fabs( a.cpu - b.cpu ) > 0.02 ) {
+		return a.cpu < b.cpu;
+	}
+	return a.latencyMean < b.latencyMean;
+}
+
+StreamTrialResult StreamTuner::runTrial( const CameraControllerRef &camera, const StreamSettings &settings )
+{
+	StreamTrialResult result;
+	result.settings = settings;
+
+	// the latency of a frame is its arrival after the mapped camera timestamp, which is the fastest frame's
+	ClockMapper clock( camera->getTimestampFrequency() );
+	std::mutex latencyMutex;
+	std::atomic<bool> measuring( false );
+	double latencySum = 0.0;
+	uint64_t latencyCount = 0;
+	cinder::signals::Connection connection = camera->getSignalRawFrame().connect( [&]( const RawFrame &frame ) {
+		const uint64_t arrival = ClockMapper::getHostTime();
+		const uint64_t mapped = clock.map( frame.timestamp, arrival );
+		if( ! measuring ) {
+			return;
+		}
+		const double latency = arrival > mapped ? static_cast<double>( arrival - mapped ) * 1e-9 : 0.0;
+		std::lock_guard<std::mutex> lock( latencyMutex );
+		latencySum += latency;
+		result.latencyMax = std::max( result.latencyMax, latency );
+		++latencyCount;
+	} );
+
+	try {
+		apply( *camera, settings );
+		camera->startContinuousImageAcquisition();
+		std::this_thread::sleep_for( std::chrono::duration<double>( mOptions.getWarmup() ));
+
+		const FrameStatistics before = camera->getFrameStatistics();
+		const double cpuBefore = getCpuTime();
+		const auto start = std::chrono::steady_clock::now();
+		measuring = true;
+		std::this_thread::sleep_for( std::chrono::duration<double>( mOptions.getTrialDuration() ));
+		measuring = false;
+		const FrameStatistics after = camera->getFrameStatistics();
+		result.cpu = getCpuTime() - cpuBefore;
+		result.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+		camera->stopContinuousImageAcquisition();
+
+		result.frames.framesReceived = after.framesReceived - before.framesReceived;
+		result.frames.framesDelivered = after.framesDelivered - before.framesDelivered;
+		result.frames.framesIncomplete = after.framesIncomplete - before.framesIncomplete;
+		result.frames.framesMissing = after.framesMissing - before.framesMissing;
+		result.frames.transformErrors = after.transformErrors - before.transformErrors;
+	}
+	catch( const BaseException &exc ) {
+		result.error = exc.Result();
+		result.message = exc.Message();
+	}
+	if( camera->isAcquiring() ) {
+		camera->stopContinuousImageAcquisition();
+	}
+	connection.disconnect();
+
+	if( VmbErrorSuccess == result.error ) {
+		const uint64_t expected = result.frames.framesReceived + result.frames.framesMissing;
+		result.completeRate = expected ? static_cast<double>( result.frames.framesDelivered ) / expected : 0.0;
+		result.frameRate = result.seconds > 0.0 ? result.frames.framesDelivered / result.seconds : 0.0;
+		result.cpu = result.seconds > 0.0 ? result.cpu / result.seconds : 0.0;
+		std::lock_guard<std::mutex> lock( latencyMutex );
+		result.latencyMean = latencyCount ? latencySum / latencyCount : 0.0;
+		if( 0 == expected ) {
+			result.error = VmbErrorTimeout;
+			result.message = "No frames received";
+		}
+	}
+	return result;
+}
+
+StreamTuningResult StreamTuner::tune( const CameraControllerRef &camera )
+{
+	if( ! camera ) {
+		throw StreamTunerException( __FUNCTION__, "Camera is null", VmbErrorBadParameter );
+	}
+	if( camera->isAcquiring() ) {
+		throw StreamTunerException( __FUNCTION__, "Stop acquisition before tuning", VmbErrorInvalidAccess );
+	}
+
+	StreamTuningResult tuning;
+	bool haveBest = false;
+	auto search = [&]( const std::vector<StreamSettings> &candidates ) {
+		for( const auto &settings : candidates ) {
+			StreamTrialResult trial = runTrial( camera, settings );
+			CI_LOG_I( camera->getID() << " packet size " << settings.packetSize << ", " << settings.numberFrames
+			          << " frames, " << settings.streamBytesPerSecond << " bytes/s: " << trial.completeRate * 100.0
+			          << "% complete at " << trial.frameRate << " fps, cpu " << trial.cpu << ", latency "
+			          << trial.latencyMean * 1000.0 << " ms" << ( trial.message.empty() ? "" : " " ) << trial.message );
+			tuning.trials.push_back( trial );
+			if( ! haveBest || isBetter( trial, tuning.bestTrial )) {
+				tuning.best = settings;
+				tuning.bestTrial = trial;
+				haveBest = true;
+			}
+		}
+	};
+
+	// start from the current settings
+	FeaturePtr packetSize;
+	FeaturePtr throughput;
+	VmbInt64_t value = 0;
+	tuning.best.numberFrames = camera->getNumberFrames();
+	if( getIntFeature( *camera, "GevSCPSPacketSize", packetSize ) && VmbErrorSuccess == packetSize->GetValue( value )) {
+		tuning.best.packetSize = static_cast<uint32_t>( value );
+	}
+	if( getIntFeature( *camera, "StreamBytesPerSecond", throughput ) && VmbErrorSuccess == throughput->GetValue( value )) {
+		tuning.best.streamBytesPerSecond = static_cast<uint64_t>( value );
+	}
+
+	// packet sizes up to the one the camera negotiated, which is the largest the path carries
+	std::vector<StreamSettings> candidates;
+	if( tuning.best.packetSize ) {
+		std::vector<uint32_t> sizes = mOptions.getPacketSizes();
+		if( sizes.empty() ) {
+			sizes.push_back( tuning.best.packetSize );
+			for( uint32_t size : kPacketSizes ) {
+				if( size < tuning.best.packetSize ) {
+					sizes.push_back( size );
+				}
+			}
+		}
+		for( uint32_t size : sizes ) {
+			StreamSettings settings = tuning.best;
+			settings.packetSize = static_cast<uint32_t>( fitIntFeature( packetSize, size ));
+			candidates.push_back( settings );
+		}
+		search( candidates );
+	}
+
+	candidates.clear();
+	for( uint32_t count : mOptions.getNumberFrames() ) {
+		StreamSettings settings = tuning.best;
+		settings.numberFrames = count;
+		candidates.push_back( settings );
+	}
+	search( candidates );
+
+	VmbInt64_t minimum = 0;
+	VmbInt64_t maximum = 0;
+	candidates.clear();
+	if( tuning.best.streamBytesPerSecond && VmbErrorSuccess == throughput->GetRange( minimum, maximum )) {
+		for( double fraction : mOptions.getThroughputs() ) {
+			StreamSettings settings = tuning.best;
+			settings.streamBytesPerSecond = static_cast<uint64_t>( fitIntFeature( throughput,
+					static_cast<VmbInt64_t>( fraction * static_cast<double>( maximum ))));
+			candidates.push_back( settings );
+		}
+		search( candidates );
+	}
+
+	if( ! haveBest || VmbErrorSuccess != tuning.bestTrial.error ) {
+		throw StreamTunerException( __FUNCTION__, "No trial succeeded: " + tuning.bestTrial.message,
+		                            haveBest ? tuning.bestTrial.error : VmbErrorOther );
+	}
+	apply( *camera, tuning.best );
+	return tuning;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// MARK: - Settings
+// ----------------------------------------------------------------------------------------------------
+
+void StreamTuner::apply( CameraController &camera, const StreamSettings &settings )
+{
+	if( settings.packetSize ) {
+		setIntFeature( camera, "GevSCPSPacketSize", settings.packetSize );
+	}
+	if( settings.streamBytesPerSecond ) {
+		setIntFeature( camera, "StreamBytesPerSecond", static_cast<VmbInt64_t>( settings.streamBytesPerSecond ));
+	}
+	if( settings.numberFrames ) {
+		camera.setNumberFrames( settings.numberFrames );
+	}
+}
+
+void StreamTuner::save( const std::string &path, const std::map<std::string, StreamSettings> &settings )
+{
+	std::ofstream file( path.c_str() );
+	if( ! file ) {
+		throw StreamTunerException( __FUNCTION__, "Can't write " + path );
+	}
+	file << "# stream settings found by civimba::StreamTuner\n";
+	for( const auto &camera : settings ) {
+		file << "\n[" << camera.first << "]\n";
+		file << "packetSize=" << camera.second.packetSize << "\n";
+		file << "numberFrames=" << camera.second.numberFrames << "\n";
+		file << "streamBytesPerSecond=" << camera.second.streamBytesPerSecond << "\n";
+	}
+	if( ! file.flush() ) {
+		throw StreamTunerException( __FUNCTION__, "Can't write " + path );
+	}
+}
+
+std::map<std::string, StreamSettings> StreamTuner::load( const std::string &path )
+{
+	std::map<std::string, StreamSettings> settings;
+	std::ifstream file( path.c_str() );
+	if( ! file ) {
+		return settings;
+	}
+
+	StreamSettings *camera = nullptr;
+	std::string line;
+	while( std::getline( file, line )) {
+		line = trim( line );
+		if( line.empty() || '#' == line[0] ) {
+			continue;
+		}
+		if( '[' == line[0] && ']' == line[line.size() - 1] ) {
+			camera = &settings[line.substr( 1, line.size() - 2 )];
+			continue;
+		}
+		const size_t equals = line.find( '=' );
+		if( ! camera || std::string::npos == equals ) {
+			continue;
+		}
+		const std::string key = trim( line.substr( 0, equals ));
+		const unsigned long long value = std::strtoull( line.c_str() + equals + 1, nullptr, 10 );
+		if( "packetSize" == key ) {
+			camera->packetSize = static_cast<uint32_t>( value );
+		} else if( "numberFrames" == key ) {
+			camera->numberFrames = static_cast<uint32_t>( value );
+		} else if( "streamBytesPerSecond" == key ) {
+			camera->streamBytesPerSecond = value;
+		}
+	}
+	return settings;
+}
+
+bool StreamTuner::applySaved( const std::string &path, CameraController &camera )
+{
+	const std::map<std::string, StreamSettings> settings = load( path );
+	auto it = settings.find( camera.getID() );
+	if( it == settings.end() ) {
+		return false;
+	}
+	apply( camera, it->second );
+	return true;
+}
+
+} // namespace civimba
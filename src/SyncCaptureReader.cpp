@@ -0,0 +1,156 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/SyncCaptureReader.h"
+
+#include <cstring>
+
+namespace civimba {
+
+const size_t SyncCaptureReader::npos = static_cast<size_t>( -1 );
+
+SyncCaptureReader::SyncCaptureReader( const std::string &path )
+		: mReader( path ), mStreamTable( nullptr ), mStreamCount( 0 ), mWindow( 0 ), mGroups( nullptr ), mGroupCount( 0 ),
+		  mGroupsRebuilt( false )
+{
+	const CaptureFileHeader &header = mReader.getFileHeader();
+	if( ! ( header.flags & CAPTURE_FILE_FLAG_SYNC )) {
+		throw CaptureException( __FUNCTION__, path + " is not a synchronized capture file", VmbErrorInvalidValue );
+	}
+
+	CaptureSyncHeader syncHeader;
+	if( header.headerSize < sizeof( CaptureFileHeader ) + sizeof( syncHeader )) {
+		throw CaptureException( __FUNCTION__, path + " has a damaged stream table", VmbErrorInvalidValue );
+	}
+	std::memcpy( &syncHeader, mReader.getData() + sizeof( CaptureFileHeader ), sizeof( syncHeader ));
+	if( 0 == syncHeader.streamCount || syncHeader.streamCount > CAPTURE_MAX_STREAMS
+	    || header.headerSize < sizeof( CaptureFileHeader ) + sizeof( syncHeader ) + syncHeader.streamCount * sizeof( CaptureStreamEntry )) {
+		throw CaptureException( __FUNCTION__, path + " has a damaged stream table", VmbErrorInvalidValue );
+	}
+	mStreamTable = reinterpret_cast<const CaptureStreamEntry*>( mReader.getData() + sizeof( CaptureFileHeader ) + sizeof( syncHeader ));
+	mStreamCount = syncHeader.streamCount;
+	mWindow = syncHeader.window;
+
+	if( mReader.wasIndexRebuilt() || ! mapGroups() ) {
+		rebuildGroups();
+	}
+}
+
+bool SyncCaptureReader::mapGroups()
+{
+	// the group index ends where the capture index starts
+	const uint64_t dataEnd = mReader.getDataEnd();
+	const uint64_t headerSize = mReader.getFileHeader().headerSize;
+	if( dataEnd < headerSize + sizeof( CaptureSyncIndexHeader ) + sizeof( CaptureSyncIndexFooter )) {
+		return false;
+	}
+
+	CaptureSyncIndexFooter footer;
+	std::memcpy( &footer, mReader.getData() + dataEnd - sizeof( footer ), sizeof( footer ));
+	if( CAPTURE_SYNC_MAGIC != footer.magic || 0 != footer.size % 8 || footer.size > dataEnd - headerSize
+	    || footer.size < sizeof( CaptureSyncIndexHeader ) + sizeof( footer )) {
+		return false;
+	}
+
+	const uint64_t offset = dataEnd - footer.size;
+	CaptureSyncIndexHeader index;
+	std::memcpy( &index, mReader.getData() + offset, sizeof( index ));
+	const uint64_t stride = ( 1 + mStreamCount ) * sizeof( uint64_t );
+	if( CAPTURE_SYNC_MAGIC != index.magic || index.streamCount != mStreamCount || index.headerSize < sizeof( index )
+	    || 0 != index.headerSize % 8 || index.headerSize > footer.size - sizeof( footer )
+	    || index.groupCount * stride != footer.size - sizeof( footer ) - index.headerSize ) {
+		return false;
+	}
+
+	mGroups = reinterpret_cast<const uint64_t*>( mReader.getData() + offset + index.headerSize );
+	mGroupCount = static_cast<size_t>( index.groupCount );
+	return true;
+}
+
+void SyncCaptureReader::rebuildGroups()
+{
+	std::vector<CaptureSyncFrame> frames;
+	frames.reserve( mReader.getFrameCount() );
+	for( size_t i = 0; i < mReader.getFrameCount(); ++i ) {
+		CaptureSyncFrame frame;
+		frame.timestamp = mReader.getIndexEntry( i ).timestamp;
+		frame.frame = i;
+		frame.stream = getCaptureFrameStream( mReader.getFrameHeader( i ));
+		frames.push_back( frame );
+	}
+
+	mRebuiltGroups = makeCaptureSyncGroups( frames, static_cast<uint32_t>( mStreamCount ), mWindow );
+	mGroups = mRebuiltGroups.data();
+	mGroupCount = mRebuiltGroups.size() / ( 1 + mStreamCount );
+	mGroupsRebuilt = true;
+}
+
+uint64_t SyncCaptureReader::getGroupTimestamp( size_t group ) const
+{
+	if( group >= mGroupCount ) {
+		throw CaptureException( __FUNCTION__, "Group index out of range", VmbErrorBadParameter );
+	}
+	return mGroups[group * ( 1 + mStreamCount )];
+}
+
+size_t SyncCaptureReader::getFrameIndex( size_t group, size_t stream ) const
+{
+	if( group >= mGroupCount || stream >= mStreamCount ) {
+		throw CaptureException( __FUNCTION__, "Group or stream out of range", VmbErrorBadParameter );
+	}
+	const uint64_t frame = mGroups[group * ( 1 + mStreamCount ) + 1 + stream];
+	if( CAPTURE_SYNC_NO_FRAME == frame ) {
+		return npos;
+	}
+	if( frame >= mReader.getFrameCount() ) {
+		throw CaptureException( __FUNCTION__, "Damaged group index", VmbErrorInvalidValue );
+	}
+	return static_cast<size_t>( frame );
+}
+
+bool SyncCaptureReader::getFrame( size_t group, size_t stream, RawFrame &frame ) const
+{
+	const size_t index = getFrameIndex( group, stream );
+	if( npos == index ) {
+		return false;
+	}
+	frame = mReader.getFrame( index );
+	return true;
+}
+
+size_t SyncCaptureReader::findGroup( uint64_t timestamp ) const
+{
+	// groups are sorted by time
+	size_t first = 0, count = mGroupCount;
+	while( count > 0 ) {
+		size_t step = count / 2;
+		if( mGroups[( first + step ) * ( 1 + mStreamCount )] <= timestamp ) {
+			first += step + 1;
+			count -= step + 1;
+		} else {
+			count = step;
+		}
+	}
+	return 0 == first ? npos : first - 1;
+}
+
+} // namespace civimba
@@ -0,0 +1,154 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/SyncRecorder.h"
+
+namespace civimba {
+
+SyncRecorder::SyncRecorder( const Options &options, const std::vector<CaptureStreamEntry> &streams )
+		: mOptions( options ), mWindow( 0 ), mGroupCount( 0 ), mClosed( false )
+{
+	open( streams );
+}
+
+SyncRecorder::SyncRecorder( const Options &options, const std::vector<CameraControllerRef> &cameras )
+		: mOptions( options ), mWindow( 0 ), mGroupCount( 0 ), mClosed( false )
+{
+	std::vector<CaptureStreamEntry> streams;
+	for( const auto &camera : cameras ) {
+		if( ! camera ) {
+			throw SyncRecorderException( __FUNCTION__, "Camera is null", VmbErrorBadParameter );
+		}
+		streams.push_back( makeCaptureStreamEntry( camera->getID(), camera->getTimestampFrequency() ));
+	}
+	open( streams );
+	for( size_t i = 0; i < cameras.size(); ++i ) {
+		attach( i, *cameras[i] );
+	}
+}
+
+SyncRecorder::~SyncRecorder()
+{
+	close();
+}
+
+void SyncRecorder::open( const std::vector<CaptureStreamEntry> &streams )
+{
+	if( streams.empty() || streams.size() > CAPTURE_MAX_STREAMS ) {
+		throw SyncRecorderException( __FUNCTION__, "Synchronized recordings hold 1 to 256 cameras", VmbErrorBadParameter );
+	}
+	if( mOptions.getWindow() < 0.0 || mOptions.getClockWindow() <= 0.0 ) {
+		throw SyncRecorderException( __FUNCTION__, "Invalid window", VmbErrorBadParameter );
+	}
+	mWindow = static_cast<uint64_t>( mOptions.getWindow() * 1e9 );
+
+	mStreams.resize( streams.size() );
+	for( size_t i = 0; i < streams.size(); ++i ) {
+		mStreams[i].entry = streams[i];
+		mStreams[i].clock = ClockMapper( streams[i].timestampFrequency, mOptions.getClockWindow() );
+	}
+	mFrames.reserve( 4096 );
+
+	try {
+		mWriter.reset( new DiskWriter( mOptions.getWriterOptions(), makeCaptureSyncFileHeader( streams, mWindow )));
+	}
+	catch( const DiskWriter::DiskWriterException &exc ) {
+		throw SyncRecorderException( __FUNCTION__, exc.Message(), exc.Result() );
+	}
+}
+
+void SyncRecorder::attach( size_t stream, CameraController &camera )
+{
+	if( stream >= mStreams.size() ) {
+		throw SyncRecorderException( __FUNCTION__, "Stream out of range", VmbErrorBadParameter );
+	}
+	mStreams[stream].connection.disconnect();
+	mStreams[stream].connection = camera.getSignalRawFrame().connect( [this, stream]( const RawFrame &frame ) {
+		write( stream, frame );
+	} );
+}
+
+void SyncRecorder::detach()
+{
+	for( auto &stream : mStreams ) {
+		stream.connection.disconnect();
+	}
+}
+
+uint64_t SyncRecorder::getHostTime()
+{
+	return ClockMapper::getHostTime();
+}
+
+bool SyncRecorder::write( size_t stream, const RawFrame &frame )
+{
+	return write( stream, frame, getHostTime() );
+}
+
+bool SyncRecorder::write( size_t stream, const RawFrame &frame, uint64_t arrival )
+{
+	if( stream >= mStreams.size() ) {
+		throw SyncRecorderException( __FUNCTION__, "Stream out of range", VmbErrorBadParameter );
+	}
+
+	CaptureFrameHeader header = makeCaptureFrameHeader( frame );
+	header.timestamp = mStreams[stream].clock.map( frame.timestamp, arrival );
+	header.flags |= static_cast<uint32_t>( stream ) << CAPTURE_FRAME_STREAM_SHIFT;
+
+	uint64_t index = 0;
+	if( ! mWriter->writeRecord( header, frame.buffer, &index )) {
+		return false;
+	}
+
+	CaptureSyncFrame syncFrame;
+	syncFrame.timestamp = header.timestamp;
+	syncFrame.frame = index;
+	syncFrame.stream = static_cast<uint32_t>( stream );
+	std::lock_guard<std::mutex> lock( mFramesMutex );
+	mFrames.push_back( syncFrame );
+	return true;
+}
+
+void SyncRecorder::close()
+{
+	detach();
+	if( mClosed || ! mWriter ) {
+		return;
+	}
+	mClosed = true;
+
+	std::vector<uint64_t> groups;
+	{
+		std::lock_guard<std::mutex> lock( mFramesMutex );
+		groups = makeCaptureSyncGroups( mFrames, static_cast<uint32_t>( mStreams.size() ), mWindow );
+	}
+	mGroupCount = groups.size() / ( 1 + mStreams.size() );
+	mWriter->close( makeCaptureSyncIndex( groups, static_cast<uint32_t>( mStreams.size() )));
+}
+
+uint64_t SyncRecorder::getFramesRecorded() const
+{
+	std::lock_guard<std::mutex> lock( mFramesMutex );
+	return mFrames.size();
+}
+
+} // namespace civimba
@@ -0,0 +1,280 @@
+/*
+ Copyright (c) 2016, Lucas Vickers
+
+ This code is intended to be used with the Cinder C++ library, http://libcinder.org
+
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that
+ the following conditions are met:
+
+	* Redistributions of source code must retain the above copyright notice, this list of conditions and
+	the following disclaimer.
+	* Redistributions in binary form must reproduce the above copyright notice, this list of conditions and
+	the following disclaimer in the documentation and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED
+ WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "civimba/ThreadPlacement.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#if defined( __linux__ )
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define CIVIMBA_NUMA 1
+#endif
+
+#include "cinder/Log.h"
+
+namespace civimba {
+
+namespace {
+
+#if defined( CIVIMBA_NUMA )
+// from linux/mempolicy.h, which is not installed everywhere
+const int kMemPolicyDefault = 0;
+const int kMemPolicyPreferred = 1;
+// enough for 1024 nodes
+const size_t kNodeMaskWords = 1024 / ( sizeof( unsigned long ) * CHAR_BIT );
+const unsigned long kMaxNode = kNodeMaskWords * sizeof( unsigned long ) * CHAR_BIT;
+
+long setMemPolicy( int mode, const unsigned long *nodes, unsigned long maxNode )
+{
+	return syscall( SYS_set_mempolicy, mode, nodes, maxNode );
+}
+
+long getMemPolicy( int *mode, unsigned long *nodes, unsigned long maxNode )
+{
+	return syscall( SYS_get_mempolicy, mode, nodes, maxNode, nullptr, 0UL );
+}
+
+bool preferNode( int node )
+{
+	std::vector<unsigned long> nodes( kNodeMaskWords, 0 );
+	const size_t bits = sizeof( unsigned long ) * CHAR_BIT;
+	nodes[node / bits] |= 1UL << ( node % bits );
+	return 0 == setMemPolicy( kMemPolicyPreferred, nodes.data(), kMaxNode );
+}
+#endif
+
+bool readLine( const std::string &path, std::string &line )
+{
+	std::ifstream file( path.c_str() );
+	return file && std::getline( file, line );
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------------------------------
+// MARK: - ThreadPlacementReport
+// ----------------------------------------------------------------------------------------------------
+
+std::string ThreadPlacementReport::toString() const
+{
+	std::stringstream ss;
+	ss << name << ":";
+	if( cpus.empty() ) {
+		ss << " cpus ?";
+	} else {
+		// print as ranges, like the kernel does
+		ss << " cpus ";
+		for( size_t i = 0; i < cpus.size(); ) {
+			size_t j = i;
+			while( j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1 ) {
+				++j;
+			}
+			ss << ( i ? "," : "" ) << cpus[i];
+			if( j > i ) {
+				ss << "-" << cpus[j];
+			}
+			i = j + 1;
+		}
+	}
+	ss << " running on cpu " << cpu << " node " << numaNode;
+	ss << ( placed ? ", placed" : ", not placed" );
+	if( memoryPolicy ) {
+		ss << ", local allocation";
+	}
+	if( ! error.empty() ) {
+		ss << " (" << error << ")";
+	}
+	return ss.str();
+}
+
+// ----------------------------------------------------------------------------------------------------
+// MARK: - ThreadPlacement
+// ----------------------------------------------------------------------------------------------------
+
+std::vector<int> ThreadPlacement::parseCpuList( const std::string &list )
+{
+	std::vector<int> cpus;
+	std::stringstream ss( list );
+	std::string range;
+	while( std::getline( ss, range, ',' )) {
+		char *end = nullptr;
+		const long first = std::strtol( range.c_str(), &end, 10 );
+		if( end == range.c_str() || first < 0 ) {
+			continue;
+		}
+		long last = first;
+		if( '-' == *end ) {
+			last = std::strtol( end + 1, nullptr, 10 );
+		}
+		for( long cpu = first; cpu <= last; ++cpu ) {
+			cpus.push_back( static_cast<int>( cpu ));
+		}
+	}
+	std::sort( cpus.begin(), cpus.end() );
+	cpus.erase( std::unique( cpus.begin(), cpus.end() ), cpus.end() );
+	return cpus;
+}
+
+int ThreadPlacement::getNumaNodeCount()
+{
+	std::string line;
+	if( readLine( "/sys/devices/system/node/possible", line )) {
+		std::vector<int> nodes = parseCpuList( line );
+		if( ! nodes.empty() ) {
+			return nodes.back() + 1;
+		}
+	}
+	return 1;
+}
+
+std::vector<int> ThreadPlacement::getNumaNodeCpus( int node )
+{
+	std::string line;
+	if( node >= 0 && readLine( "/sys/devices/system/node/node" + std::to_string( node ) + "/cpulist", line )) {
+		return parseCpuList( line );
+	}
+	return std::vector<int>();
+}
+
+int ThreadPlacement::getCpuNumaNode( int cpu )
+{
+	if( cpu < 0 ) {
+		return -1;
+	}
+	const int nodes = getNumaNodeCount();
+	for( int node = 0; node < nodes; ++node ) {
+		const std::vector<int> cpus = getNumaNodeCpus( node );
+		if( std::binary_search( cpus.begin(), cpus.end(), cpu )) {
+			return node;
+		}
+	}
+	return -1;
+}
+
+std::vector<int> ThreadPlacement::getEffectiveCpus() const
+{
+	if( mCpus.empty() && mNumaNode >= 0 ) {
+		return getNumaNodeCpus( mNumaNode );
+	}
+	return mCpus;
+}
+
+ThreadPlacementReport ThreadPlacement::apply( const std::string &name ) const
+{
+	ThreadPlacementReport report;
+	report.name = name;
+
+#if defined( CIVIMBA_NUMA )
+	const std::vector<int> cpus = getEffectiveCpus();
+	if( ! cpus.empty() ) {
+		cpu_set_t set;
+		CPU_ZERO( &set );
+		for( int cpu : cpus ) {
+			if( cpu >= 0 && cpu < CPU_SETSIZE ) {
+				CPU_SET( cpu, &set );
+			}
+		}
+		const int res = pthread_setaffinity_np( pthread_self(), sizeof( set ), &set );
+		if( 0 == res ) {
+			report.placed = true;
+		} else {
+			report.error = std::string( "affinity: " ) + std::strerror( res );
+		}
+	} else if( mNumaNode >= 0 ) {
+		report.error = "node " + std::to_string( mNumaNode ) + " has no cpus";
+	}
+
+	if( mNumaNode >= 0 ) {
+		if( mNumaNode < getNumaNodeCount() && preferNode( mNumaNode )) {
+			report.memoryPolicy = true;
+		} else {
+			report.error += ( report.error.empty() ? "" : ", " ) + std::string( "memory policy: " )
+			                + ( mNumaNode < getNumaNodeCount() ? std::strerror( errno ) : "no such node" );
+		}
+	}
+
+	cpu_set_t current;
+	CPU_ZERO( &current );
+	if( 0 == pthread_getaffinity_np( pthread_self(), sizeof( current ), &current )) {
+		for( int cpu = 0; cpu < CPU_SETSIZE; ++cpu ) {
+			if( CPU_ISSET( cpu, &current )) {
+				report.cpus.push_back( cpu );
+			}
+		}
+	}
+	// the scheduler moves the thread onto an allowed cpu before setaffinity returns
+	report.cpu = sched_getcpu();
+	report.numaNode = getCpuNumaNode( report.cpu );
+#else
+	if( ! isDefault() ) {
+		report.error = "thread placement is not supported on this platform";
+	}
+#endif
+
+	if( ! report.error.empty() ) {
+		CI_LOG_W( report.toString() );
+	} else if( ! isDefault() ) {
+		CI_LOG_I( report.toString() );
+	}
+	return report;
+}
+
+// ----------------------------------------------------------------------------------------------------
+// MARK: - ScopedMemoryPolicy
+// ----------------------------------------------------------------------------------------------------
+
+ScopedMemoryPolicy::ScopedMemoryPolicy( int node )
+		: mActive( false ), mMode( 0 )
+{
+#if defined( CIVIMBA_NUMA )
+	if( node < 0 || node >= ThreadPlacement::getNumaNodeCount() ) {
+		return;
+	}
+	mNodes.assign( kNodeMaskWords, 0 );
+	if( 0 != getMemPolicy( &mMode, mNodes.data(), kMaxNode )) {
+		return;
+	}
+	mActive = preferNode( node );
+#endif
+}
+
+ScopedMemoryPolicy::~ScopedMemoryPolicy()
+{
+#if defined( CIVIMBA_NUMA )
+	if( mActive && kMemPolicyDefault == mMode ) {
+		setMemPolicy( mMode, nullptr, 0 );
+	} else if( mActive ) {
+		setMemPolicy( mMode, mNodes.data(), kMaxNode );
+	}
+#endif
+}
+
+} // namespace civimba
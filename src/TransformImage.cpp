@@ -28,72 +28,97 @@
 
 namespace civimba {
 
+namespace {
+
+// Frames also come from files, sockets and shared memory, so the buffer and the surface are checked against the
+// frame size before VmbImageTransform() reads and writes them.
+bool fitsBuffers( const RawFrame &Source, const VmbImage &Destination, const cinder::Surface8u &Surface )
+{
+    if( ! Source.holdsImage() )
+    {
+        return false;
+    }
+    if( static_cast<int64_t>( Surface.getWidth() ) != Source.width || static_cast<int64_t>( Surface.getHeight() ) != Source.height )
+    {
+        return false;
+    }
+    const uint64_t RowBytes = ( static_cast<uint64_t>( Source.width ) * Destination.ImageInfo.PixelInfo.BitsPerPixel + 7 ) / 8;
+    return static_cast<uint64_t>( Surface.getRowBytes() ) >= RowBytes;
+}
+
+} // anonymous namespace
+
 VmbErrorType TransformImage::transform( const AVT::VmbAPI::FramePtr &SourceFrame,
                                         cinder::Surface8uRef &DestinationSurface,
                                         const std::string &DestinationFormat )
 {
-    if( SP_ISNULL( SourceFrame) )
-    {
-        return VmbErrorBadParameter;
-    }
-    VmbErrorType        Result;
-    VmbPixelFormatType  InputFormat;
-    VmbUint32_t         InputWidth, InputHeight;
-    Result = SP_ACCESS( SourceFrame )->GetPixelFormat( InputFormat ) ;
+    RawFrame Source;
+    VmbErrorType Result = RawFrame::fromFrame( SourceFrame, Source );
     if( VmbErrorSuccess != Result )
     {
         return Result;
     }
-    Result = SP_ACCESS( SourceFrame )->GetWidth( InputWidth );
+    return transform( Source, DestinationSurface, DestinationFormat );
+}
+
+VmbErrorType TransformImage::transform( const AVT::VmbAPI::FramePtr &SourceFrame,
+                                        cinder::Surface8uRef &DestinationSurface,
+                                        const std::string &DestinationFormat,
+                                        const VmbFloat_t *Matrix )
+{
+    RawFrame Source;
+    VmbErrorType Result = RawFrame::fromFrame( SourceFrame, Source );
     if( VmbErrorSuccess != Result )
     {
         return Result;
     }
-    Result = SP_ACCESS( SourceFrame )->GetHeight( InputHeight );
-    if( VmbErrorSuccess != Result )
+    return transform( Source, DestinationSurface, DestinationFormat, Matrix );
+}
+
+VmbErrorType TransformImage::transform( const RawFrame &SourceFrame,
+                                        cinder::Surface8uRef &DestinationSurface,
+                                        const std::string &DestinationFormat )
+{
+    if( NULL == SourceFrame.buffer || ! DestinationSurface )
     {
-        return Result;
+        return VmbErrorBadParameter;
     }
+    VmbErrorType        Result;
 
     // Prepare source image
     VmbImage SourceImage;
     SourceImage.Size = sizeof( SourceImage );
-    Result = static_cast<VmbErrorType>( VmbSetImageInfoFromPixelFormat( InputFormat, InputWidth, InputHeight, &SourceImage ));
+    Result = static_cast<VmbErrorType>( VmbSetImageInfoFromPixelFormat( SourceFrame.pixelFormat, SourceFrame.width, SourceFrame.height, &SourceImage ));
     if( VmbErrorSuccess != Result )
     {
         return Result;
     }
-    VmbUchar_t *DataBegin = NULL;
-    Result = SP_ACCESS( SourceFrame )->GetBuffer( DataBegin );
-    if( VmbErrorSuccess != Result ) 
-    {
-        return Result;
-    }
-    SourceImage.Data = DataBegin;
+    SourceImage.Data = const_cast<VmbUchar_t*>( SourceFrame.buffer );
 
     // Prepare destination image
     VmbImage DestinationImage;
     DestinationImage.Size = sizeof( DestinationImage );
-    Result = static_cast<VmbErrorType>( VmbSetImageInfoFromString( DestinationFormat.c_str(), static_cast<VmbUint32_t>(DestinationFormat.size()), InputWidth, InputHeight, &DestinationImage) );
+    Result = static_cast<VmbErrorType>( VmbSetImageInfoFromString( DestinationFormat.c_str(), static_cast<VmbUint32_t>(DestinationFormat.size()), SourceFrame.width, SourceFrame.height, &DestinationImage) );
     if ( VmbErrorSuccess != Result )
     {
         return Result;
     }
-    const size_t ByteCount = ( DestinationImage.ImageInfo.PixelInfo.BitsPerPixel * InputWidth * InputHeight ) / 8 ;
-    //DestinationData.resize( ByteCount );
-    //DestinationImage.Data = &*DestinationData.begin();
+    if( ! fitsBuffers( SourceFrame, DestinationImage, *DestinationSurface ))
+    {
+        return VmbErrorBadParameter;
+    }
     DestinationImage.Data = DestinationSurface->getData();
     // Transform data
     Result = static_cast<VmbErrorType>( VmbImageTransform( &SourceImage, &DestinationImage, NULL , 0 ));
     return Result;
 }
 
-VmbErrorType TransformImage::transform( const AVT::VmbAPI::FramePtr &SourceFrame,
+VmbErrorType TransformImage::transform( const RawFrame &SourceFrame,
                                         cinder::Surface8uRef &DestinationSurface,
                                         const std::string &DestinationFormat,
                                         const VmbFloat_t *Matrix )
 {
-    if( SP_ISNULL( SourceFrame ))
+    if( NULL == SourceFrame.buffer || ! DestinationSurface )
     {
         return VmbErrorBadParameter;
     }
@@ -102,49 +127,28 @@ VmbErrorType TransformImage::transform( const AVT::VmbAPI::FramePtr &SourceFrame
         return VmbErrorBadParameter;
     }
     VmbErrorType        Result;
-    VmbPixelFormatType  InputFormat;
-    VmbUint32_t         InputWidth,InputHeight;
-    Result = SP_ACCESS( SourceFrame )->GetPixelFormat( InputFormat ) ;
-    if( VmbErrorSuccess != Result )
-    {
-        return Result;
-    }
-    Result = SP_ACCESS( SourceFrame )->GetWidth( InputWidth );
-    if( VmbErrorSuccess != Result )
-    {
-        return Result;
-    }
-    Result = SP_ACCESS( SourceFrame )->GetHeight( InputHeight );
-    if( VmbErrorSuccess != Result )
-    {
-        return Result;
-    }
+
     // Prepare source image
     VmbImage SourceImage;
     SourceImage.Size = sizeof( SourceImage );
-    Result = static_cast<VmbErrorType>( VmbSetImageInfoFromPixelFormat( InputFormat, InputWidth, InputHeight, &SourceImage ));
+    Result = static_cast<VmbErrorType>( VmbSetImageInfoFromPixelFormat( SourceFrame.pixelFormat, SourceFrame.width, SourceFrame.height, &SourceImage ));
     if( VmbErrorSuccess != Result)
     {
         return Result;
     }
-    VmbUchar_t *DataBegin = NULL;
-    Result = SP_ACCESS( SourceFrame )->GetBuffer( DataBegin );
-    if( VmbErrorSuccess != Result ) 
-    {
-        return Result;
-    }
-    SourceImage.Data = DataBegin;
+    SourceImage.Data = const_cast<VmbUchar_t*>( SourceFrame.buffer );
     // Prepare destination image
     VmbImage DestinationImage;
     DestinationImage.Size = sizeof( DestinationImage );
-    Result = static_cast<VmbErrorType>( VmbSetImageInfoFromString( DestinationFormat.c_str(), static_cast<VmbUint32_t>(DestinationFormat.size()), InputWidth, InputHeight, &DestinationImage ));
+    Result = static_cast<VmbErrorType>( VmbSetImageInfoFromString( DestinationFormat.c_str(), static_cast<VmbUint32_t>(DestinationFormat.size()), SourceFrame.width, SourceFrame.height, &DestinationImage ));
     if ( VmbErrorSuccess != Result )
     {
         return Result;
     }
-    const size_t ByteCount = ( DestinationImage.ImageInfo.PixelInfo.BitsPerPixel * InputWidth * InputHeight ) / 8 ;
-    //DestinationData.resize( ByteCount );
-    //DestinationImage.Data = &*DestinationData.begin();
+    if( ! fitsBuffers( SourceFrame, DestinationImage, *DestinationSurface ))
+    {
+        return VmbErrorBadParameter;
+    }
     DestinationImage.Data = DestinationSurface->getData();
 
     // Setup Transform parameter